@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "AlignmentTable.hpp"
+#include "Json.hpp"
+#include "jsScanApplication.hpp"
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+using namespace joescan;
+
+void AlignmentTable::LoadFile(const std::string &path)
+{
+  JsonValue j = JsonValue::ParseFile(path);
+
+  if (j.Has("ScanHeads")) {
+    for (auto &head : j["ScanHeads"].GetArray()) {
+      ParseScanHead((uint32_t) head["Serial"].AsNumber(), head);
+    }
+  } else if (j.Has("Serial")) {
+    ParseScanHead((uint32_t) j["Serial"].AsNumber(), j);
+  } else {
+    throw std::runtime_error(path + ": no \"Serial\" or \"ScanHeads\"");
+  }
+}
+
+bool AlignmentTable::LoadScanHeadFile(uint32_t serial_number,
+                                      const std::string &path)
+{
+  if (!std::ifstream(path)) {
+    return false;
+  }
+
+  ParseScanHead(serial_number, JsonValue::ParseFile(path));
+  return true;
+}
+
+bool AlignmentTable::HasScanHead(uint32_t serial_number) const
+{
+  return m_scan_heads.end() != m_scan_heads.find(serial_number);
+}
+
+void AlignmentTable::ParseScanHead(uint32_t serial_number, const JsonValue &j)
+{
+  ScanHeadAlignment alignment;
+  alignment.is_cable_downstream = j.Has("Orientation") &&
+                                  (0 != (int32_t) j["Orientation"].AsNumber());
+  for (uint32_t n = 0; n < kMaxElements; n++) {
+    alignment.elements[n].roll_deg = 0.0;
+    alignment.elements[n].shift_x = 0.0;
+    alignment.elements[n].shift_y = 0.0;
+  }
+
+  for (auto &e : j["Alignment"].GetArray()) {
+    const JsonValue &element = e.Has("Laser") ? e["Laser"] : e["Camera"];
+    int32_t id = (int32_t) element["Id"].AsNumber();
+    if ((1 > id) || ((int32_t) kMaxElements < id)) {
+      throw std::runtime_error("alignment for scan head " +
+                               std::to_string(serial_number) +
+                               " has invalid element id " +
+                               std::to_string(id));
+    }
+
+    ElementAlignment &a = alignment.elements[id - 1];
+    a.roll_deg = element["RollDeg"].AsNumber();
+    a.shift_x = element["ShiftX"].AsNumber();
+    a.shift_y = element["ShiftY"].AsNumber();
+  }
+
+  m_scan_heads[serial_number] = alignment;
+}
+
+void AlignmentTable::Apply(const std::vector<jsScanHead> &scan_heads,
+                           uint32_t element_count,
+                           bool is_mode_camera,
+                           bool is_host)
+{
+  const double kPi = 3.14159265358979323846;
+  int32_t r = 0;
+
+  m_transforms.assign(scan_heads.size() * kMaxElements,
+                      RigidTransform{ 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, true });
+  m_is_mode_camera = is_mode_camera;
+  m_is_host = is_host;
+
+  for (uint32_t h = 0; h < scan_heads.size(); h++) {
+    auto iter = m_scan_heads.find(jsScanHeadGetSerial(scan_heads[h]));
+    if (m_scan_heads.end() == iter) {
+      continue;
+    }
+
+    const ScanHeadAlignment &alignment = iter->second;
+    jsCableOrientation cable = (alignment.is_cable_downstream && !is_host) ?
+                               JS_CABLE_ORIENTATION_DOWNSTREAM :
+                               JS_CABLE_ORIENTATION_UPSTREAM;
+    r = jsScanHeadSetCableOrientation(scan_heads[h], cable);
+    if (0 > r) {
+      throw ApiError("jsScanHeadSetCableOrientation failed", r);
+    }
+
+    for (uint32_t n = 0; n < element_count; n++) {
+      const ElementAlignment &a = alignment.elements[n];
+      double roll = (is_host) ? 0.0 : a.roll_deg;
+      double shift_x = (is_host) ? 0.0 : a.shift_x;
+      double shift_y = (is_host) ? 0.0 : a.shift_y;
+
+      if (is_mode_camera) {
+        r = jsScanHeadSetAlignmentCamera(scan_heads[h],
+                                         (jsCamera) (JS_CAMERA_A + n),
+                                         roll,
+                                         shift_x,
+                                         shift_y);
+      } else {
+        r = jsScanHeadSetAlignmentLaser(scan_heads[h],
+                                        (jsLaser) (JS_LASER_1 + n),
+                                        roll,
+                                        shift_x,
+                                        shift_y);
+      }
+
+      if (0 > r) {
+        throw ApiError("failed to set alignment", r);
+      }
+
+      if (!is_host) {
+        continue;
+      }
+
+      // Same convention as the scan head: roll about the origin, mirror X
+      // when the cable is downstream, then shift.
+      double rad = a.roll_deg * kPi / 180.0;
+      double yaw = (alignment.is_cable_downstream) ? -1.0 : 1.0;
+      RigidTransform &t = m_transforms[h * kMaxElements + n];
+      t.xx = yaw * cos(rad);
+      t.xy = -sin(rad);
+      t.yx = yaw * sin(rad);
+      t.yy = cos(rad);
+      // profiles are in thousandths of an inch
+      t.shift_x = a.shift_x * 1000.0;
+      t.shift_y = a.shift_y * 1000.0;
+      t.is_identity = (0.0 == a.roll_deg) && (0.0 == a.shift_x) &&
+                      (0.0 == a.shift_y) && !alignment.is_cable_downstream;
+    }
+  }
+}
+
+void AlignmentTable::Transform(uint32_t head_index, jsProfile *profile) const
+{
+  uint32_t element = (m_is_mode_camera) ?
+                     ((uint32_t) profile->camera) - 1 :
+                     ((uint32_t) profile->laser) - 1;
+  uint32_t idx = head_index * kMaxElements + element;
+  if ((kMaxElements <= element) || (idx >= m_transforms.size()) ||
+      m_transforms[idx].is_identity) {
+    return;
+  }
+
+  // Hoisted into locals so the compiler can keep the coefficients in
+  // registers across the loop.
+  const RigidTransform &t = m_transforms[idx];
+  const double xx = t.xx;
+  const double xy = t.xy;
+  const double yx = t.yx;
+  const double yy = t.yy;
+  const double shift_x = t.shift_x;
+  const double shift_y = t.shift_y;
+  jsProfileData *__restrict data = profile->data;
+
+  for (uint32_t n = 0; n < profile->data_len; n++) {
+    if (JS_INVALID_XY == data[n].x) {
+      continue;
+    }
+
+    double xn = (double) data[n].x;
+    double yn = (double) data[n].y;
+    data[n].x = (int32_t) lround(xx * xn + xy * yn + shift_x);
+    data[n].y = (int32_t) lround(yx * xn + yy * yn + shift_y);
+  }
+}
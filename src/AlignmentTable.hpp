@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_ALIGNMENT_TABLE_H
+#define JOESCAN_ALIGNMENT_TABLE_H
+
+#include "joescan_pinchot.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace joescan {
+
+class JsonValue;
+
+/**
+ * @brief Per scan head, per element roll and shift read from JSON files.
+ *
+ * Two file layouts are accepted. A single scan head file:
+ *
+ *   {
+ *     "Serial": 12345,
+ *     "Orientation": 0,
+ *     "Alignment": [
+ *       { "Laser": { "Id": 1, "RollDeg": 0.0, "ShiftX": 0.0, "ShiftY": 0.0 } }
+ *     ]
+ *   }
+ *
+ * where "Serial" may be omitted when the serial is implied by the file name,
+ * "Camera" may be used in place of "Laser" for camera driven heads, and a
+ * non-zero "Orientation" means the cable is downstream. A system file holds
+ * several of those in a "ScanHeads" array.
+ *
+ * The alignment can either be programmed into the scan heads, or the heads
+ * can be left unaligned and the transform applied to each profile on the
+ * host, which allows changing it without reconfiguring the heads.
+ */
+class AlignmentTable {
+ public:
+  static const uint32_t kMaxElements = 8;
+
+  /**
+   * @brief Loads a system or single scan head file.
+   *
+   * @throw std::runtime_error on a missing or malformed file.
+   */
+  void LoadFile(const std::string &path);
+
+  /**
+   * @brief Loads a single scan head file for the given serial.
+   *
+   * @return `false` if the file does not exist.
+   * @throw std::runtime_error on a malformed file.
+   */
+  bool LoadScanHeadFile(uint32_t serial_number, const std::string &path);
+
+  bool HasScanHead(uint32_t serial_number) const;
+
+  /**
+   * @brief Configures alignment for the scan heads. If `is_host` is set,
+   * the scan heads are programmed with an identity alignment and the
+   * transforms are kept for `Transform`. Must be called while not scanning.
+   *
+   * @param scan_heads Scan heads, in the order used for `head_index`.
+   * @param element_count Number of cameras or lasers per scan head.
+   * @param is_mode_camera `true` if elements are cameras, `false` if lasers.
+   * @param is_host Apply alignment on the host rather than the scan heads.
+   */
+  void Apply(const std::vector<jsScanHead> &scan_heads,
+             uint32_t element_count,
+             bool is_mode_camera,
+             bool is_host);
+
+  /**
+   * @brief Applies the host side transform of the profile's element to it,
+   * in place, leaving invalid points alone. A no-op unless `Apply` was
+   * called with `is_host` set.
+   *
+   * Profiles are transformed as they are read, before anything records or
+   * publishes them, so everything downstream sees aligned data just as
+   * when the scan heads align it.
+   */
+  void Transform(uint32_t head_index, jsProfile *profile) const;
+
+  bool IsHost() const { return m_is_host; }
+
+ private:
+  struct ElementAlignment {
+    double roll_deg;
+    double shift_x;
+    double shift_y;
+  };
+
+  struct ScanHeadAlignment {
+    bool is_cable_downstream;
+    ElementAlignment elements[kMaxElements];
+  };
+
+  // camera to mill transform, see `Transform`
+  struct RigidTransform {
+    double xx;
+    double xy;
+    double yx;
+    double yy;
+    double shift_x;
+    double shift_y;
+    bool is_identity;
+  };
+
+  void ParseScanHead(uint32_t serial_number, const JsonValue &j);
+
+  std::map<uint32_t, ScanHeadAlignment> m_scan_heads;
+  std::vector<RigidTransform> m_transforms;
+  bool m_is_mode_camera = false;
+  bool m_is_host = false;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "AllocationCounter.hpp"
+#include "imgui.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+using namespace joescan;
+
+// ImGui doesn't say how large a block it frees is, so every block starts
+// with its size, padded to keep what follows aligned
+static const size_t kImGuiHeaderLen = alignof(std::max_align_t);
+
+static std::atomic<uint64_t> s_imgui_allocations(0);
+static std::atomic<uint64_t> s_imgui_bytes(0);
+static std::atomic<uint64_t> s_allocations(0);
+// plain and zero initialized, so counting needs nothing set up first, even
+// for allocations made while a thread is starting
+static thread_local uint64_t s_thread_allocations = 0;
+
+static void *ImGuiAlloc(size_t len, void *)
+{
+  char *block = (char *) malloc(kImGuiHeaderLen + len);
+  if (nullptr == block) {
+    return nullptr;
+  }
+
+  *(size_t *) block = len;
+  s_imgui_allocations++;
+  s_imgui_bytes += len;
+  return block + kImGuiHeaderLen;
+}
+
+static void ImGuiFree(void *p, void *)
+{
+  if (nullptr == p) {
+    return;
+  }
+
+  char *block = (char *) p - kImGuiHeaderLen;
+  s_imgui_bytes -= *(size_t *) block;
+  free(block);
+}
+
+void AllocationCounter::InstallImGuiAllocator()
+{
+  ImGui::SetAllocatorFunctions(ImGuiAlloc, ImGuiFree, nullptr);
+}
+
+uint64_t AllocationCounter::GetImGuiAllocations()
+{
+  return s_imgui_allocations;
+}
+
+uint64_t AllocationCounter::GetImGuiBytes()
+{
+  return s_imgui_bytes;
+}
+
+uint64_t AllocationCounter::GetAllocations()
+{
+  return s_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::GetThreadAllocations()
+{
+  return s_thread_allocations;
+}
+
+// The array and nothrow forms of the standard library all end up in these,
+// so they are all that need replacing.
+void *operator new(size_t len)
+{
+  s_thread_allocations++;
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc((0 != len) ? len : 1);
+  if (nullptr == p) {
+    throw std::bad_alloc();
+  }
+
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_ALLOCATION_COUNTER_H
+#define JOESCAN_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+namespace joescan {
+
+/**
+ * @brief Counts heap allocations, so the render loop can be shown to make
+ * none once it has warmed up.
+ *
+ * ImGui, and ImPlot through it, allocate with the functions installed by
+ * `InstallImGuiAllocator`. Everything else is counted by replacing the
+ * global `operator new` of the program, per thread, so each thread only
+ * sees its own allocations.
+ */
+class AllocationCounter {
+ public:
+  /**
+   * @brief Has ImGui allocate through counting functions; must be called
+   * before the ImGui context is created.
+   */
+  static void InstallImGuiAllocator();
+
+  /**
+   * @return Allocations made by ImGui and ImPlot, on any thread.
+   */
+  static uint64_t GetImGuiAllocations();
+
+  /**
+   * @return Bytes currently allocated by ImGui and ImPlot.
+   */
+  static uint64_t GetImGuiBytes();
+
+  /**
+   * @return Allocations made with `operator new` by every thread.
+   */
+  static uint64_t GetAllocations();
+
+  /**
+   * @return Allocations made with `operator new` by the calling thread.
+   */
+  static uint64_t GetThreadAllocations();
+};
+
+} // namespace joescan
+
+#endif
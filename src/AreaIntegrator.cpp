@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "AreaIntegrator.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace joescan;
+
+AreaIntegrator::AreaIntegrator() :
+  m_counts_per_inch(1000.0),
+  m_area(0.0),
+  m_volume(0.0),
+  m_travel(0.0),
+  m_is_first(true),
+  m_last_encoder(0),
+  m_last_area(0.0),
+  m_sector_x(kSectors),
+  m_sector_y(kSectors),
+  m_sector_r2(kSectors),
+  m_history_encoder(kHistoryLen),
+  m_history_area(kHistoryLen),
+  m_history_next(0),
+  m_history_count(0)
+{
+}
+
+void AreaIntegrator::SetCountsPerInch(double counts_per_inch)
+{
+  if (0.0 < counts_per_inch) {
+    m_counts_per_inch = counts_per_inch;
+  }
+}
+
+void AreaIntegrator::Reset()
+{
+  m_volume = 0.0;
+  m_travel = 0.0;
+  m_is_first = true;
+  m_history_next = 0;
+  m_history_count = 0;
+}
+
+uint32_t AreaIntegrator::GetHistoryOffset() const
+{
+  return (kHistoryLen == m_history_count) ? m_history_next : 0;
+}
+
+void AreaIntegrator::AddFrame(const double *x,
+                              const double *y,
+                              uint32_t count,
+                              int64_t encoder)
+{
+  m_area = ComputeArea(x, y, count);
+
+  if (m_is_first) {
+    m_is_first = false;
+  } else if (encoder != m_last_encoder) {
+    double travel = (double) (encoder - m_last_encoder) / m_counts_per_inch;
+    m_volume += 0.5 * (m_area + m_last_area) * travel;
+    m_travel += travel;
+  } else {
+    // standing still; keep the area current but don't add to the history
+    m_last_area = m_area;
+    return;
+  }
+
+  m_last_encoder = encoder;
+  m_last_area = m_area;
+
+  m_history_encoder[m_history_next] = (double) encoder;
+  m_history_area[m_history_next] = m_area;
+  m_history_next = (m_history_next + 1) % kHistoryLen;
+  if (kHistoryLen > m_history_count) {
+    m_history_count++;
+  }
+}
+
+double AreaIntegrator::ComputeArea(const double *x,
+                                   const double *y,
+                                   uint32_t count)
+{
+  if (3 > count) {
+    return 0.0;
+  }
+
+  double sum_x = 0.0;
+  double sum_y = 0.0;
+  for (uint32_t n = 0; n < count; n++) {
+    sum_x += x[n];
+    sum_y += y[n];
+  }
+  const double cx = sum_x / count;
+  const double cy = sum_y / count;
+
+  std::fill(m_sector_r2.begin(), m_sector_r2.end(), -1.0);
+
+  // Sectors are indexed by a pseudo-angle in [0, 4) that increases with
+  // the true angle, avoiding atan2; sectors don't need equal widths, only
+  // the right order around the centroid.
+  const double scale = kSectors / 4.0;
+  for (uint32_t n = 0; n < count; n++) {
+    double dx = x[n] - cx;
+    double dy = y[n] - cy;
+    double sum = fabs(dx) + fabs(dy);
+    if (0.0 == sum) {
+      continue;
+    }
+
+    double p = dy / sum;
+    double angle = (0.0 <= dx) ? ((0.0 <= dy) ? p : 4.0 + p) : 2.0 - p;
+    uint32_t sector = (uint32_t) (angle * scale);
+    sector = (kSectors <= sector) ? kSectors - 1 : sector;
+
+    double r2 = dx * dx + dy * dy;
+    if (r2 > m_sector_r2[sector]) {
+      m_sector_r2[sector] = r2;
+      m_sector_x[sector] = dx;
+      m_sector_y[sector] = dy;
+    }
+  }
+
+  // shoelace over the occupied sectors in order; empty sectors are
+  // bridged by a straight edge
+  double twice_area = 0.0;
+  int32_t first = -1;
+  int32_t last = -1;
+  for (uint32_t n = 0; n < kSectors; n++) {
+    if (0.0 > m_sector_r2[n]) {
+      continue;
+    }
+
+    if (0 <= last) {
+      twice_area += m_sector_x[last] * m_sector_y[n] -
+                    m_sector_x[n] * m_sector_y[last];
+    } else {
+      first = n;
+    }
+    last = n;
+  }
+
+  if ((0 > first) || (first == last)) {
+    return 0.0;
+  }
+
+  twice_area += m_sector_x[last] * m_sector_y[first] -
+                m_sector_x[first] * m_sector_y[last];
+  return 0.5 * fabs(twice_area);
+}
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_AREA_INTEGRATOR_H
+#define JOESCAN_AREA_INTEGRATOR_H
+
+#include <cstdint>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Measures the cross-sectional area of each scan period and
+ * integrates it into a volume as the encoder advances.
+ *
+ * The outline of a cross-section is taken as the farthest point from the
+ * centroid in each of a fixed number of angular sectors, so the area comes
+ * from a single pass over the points and a pass over the sectors, without
+ * sorting. Shapes must be star-shaped as seen from their centroid, which
+ * holds for logs and boards. Each cross-section adds the trapezoid between
+ * its area and the previous one over the encoder travel in between; history
+ * is never revisited. Travel is signed, so a conveyor running backwards
+ * takes back the volume it added going forwards.
+ */
+class AreaIntegrator {
+ public:
+  static const uint32_t kSectors = 720;
+  static const uint32_t kHistoryLen = 4096;
+
+  AreaIntegrator();
+
+  /**
+   * @brief Sets the encoder resolution used to turn counts into travel.
+   */
+  void SetCountsPerInch(double counts_per_inch);
+  double GetCountsPerInch() const { return m_counts_per_inch; }
+
+  /**
+   * @brief Adds the cross-section of one scan period. Volume only changes
+   * when the encoder has moved since the previous one; the area is updated
+   * either way.
+   *
+   * @param x X coordinates, in inches.
+   * @param y Y coordinates, in inches.
+   * @param count Number of points.
+   * @param encoder Encoder value of the scan period.
+   */
+  void AddFrame(const double *x, const double *y, uint32_t count,
+                int64_t encoder);
+
+  /**
+   * @brief Clears the volume, travel and history.
+   */
+  void Reset();
+
+  /**
+   * @return Area of the latest cross-section, in square inches.
+   */
+  double GetArea() const { return m_area; }
+
+  /**
+   * @return Volume since the last reset, in cubic inches.
+   */
+  double GetVolume() const { return m_volume; }
+
+  /**
+   * @return Net encoder travel since the last reset, in inches.
+   */
+  double GetTravel() const { return m_travel; }
+
+  /**
+   * @brief Area against encoder value of recent cross-sections, kept in a
+   * ring; `GetHistoryOffset` is the index of the oldest entry.
+   */
+  const double *GetHistoryEncoder() const { return m_history_encoder.data(); }
+  const double *GetHistoryArea() const { return m_history_area.data(); }
+  uint32_t GetHistoryCount() const { return m_history_count; }
+  uint32_t GetHistoryOffset() const;
+
+ private:
+  double ComputeArea(const double *x, const double *y, uint32_t count);
+
+  double m_counts_per_inch;
+  double m_area;
+  double m_volume;
+  double m_travel;
+  bool m_is_first;
+  int64_t m_last_encoder;
+  double m_last_area;
+
+  // farthest point per sector, relative to the centroid
+  std::vector<double> m_sector_x;
+  std::vector<double> m_sector_y;
+  std::vector<double> m_sector_r2;
+
+  std::vector<double> m_history_encoder;
+  std::vector<double> m_history_area;
+  uint32_t m_history_next;
+  uint32_t m_history_count;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "AutoExposure.hpp"
+#include "jsScanApplication.hpp"
+#include <cstring>
+
+using namespace joescan;
+
+constexpr std::chrono::milliseconds AutoExposure::kMinApplyInterval;
+constexpr double AutoExposure::kMaxStep;
+constexpr double AutoExposure::kDeadband;
+
+AutoExposure::AutoExposure(uint32_t head_count,
+                           uint32_t element_count,
+                           bool is_mode_camera,
+                           uint32_t on_time_min_us,
+                           uint32_t on_time_def_us,
+                           uint32_t on_time_max_us,
+                           uint32_t brightness_bit_depth) :
+  m_elements(new ElementState[head_count * kMaxElements]),
+  m_head_count(head_count),
+  m_element_count(element_count),
+  m_is_mode_camera(is_mode_camera),
+  m_on_time_min_us(on_time_min_us),
+  m_brightness_shift((8 < brightness_bit_depth) ?
+                     (int32_t) brightness_bit_depth - 8 : 0),
+  m_on_time_def_us(on_time_def_us),
+  m_on_time_max_us(on_time_max_us),
+  m_is_enabled(false),
+  m_target_brightness(180),
+  m_target_percentile(95),
+  m_is_fixed(false)
+{
+  for (uint32_t n = 0; n < head_count * kMaxElements; n++) {
+    ElementState &state = m_elements[n];
+    ResetWindow(state);
+    state.applied_on_time_us = on_time_def_us;
+    state.brightness = 0;
+    state.proposed_on_time_us = on_time_def_us;
+  }
+}
+
+void AutoExposure::SetEnabled(bool is_enabled)
+{
+  m_is_enabled = is_enabled;
+}
+
+bool AutoExposure::IsEnabled() const
+{
+  return m_is_enabled;
+}
+
+void AutoExposure::SetTarget(uint32_t brightness, uint32_t percentile)
+{
+  m_target_brightness = (kLevels <= brightness) ? kLevels - 1 : brightness;
+  m_target_percentile = (100 < percentile) ? 100 : percentile;
+}
+
+void AutoExposure::ResetWindow(ElementState &state)
+{
+  memset(state.histogram, 0, sizeof(state.histogram));
+  state.points = 0;
+  state.profiles = 0;
+}
+
+void AutoExposure::AddProfile(uint32_t head_index, const jsProfile &profile)
+{
+  uint32_t element = (m_is_mode_camera) ?
+                     ((uint32_t) profile.camera) - 1 :
+                     ((uint32_t) profile.laser) - 1;
+  if (kMaxElements <= element) {
+    return;
+  }
+
+  ElementState &state = m_elements[head_index * kMaxElements + element];
+  for (uint32_t n = 0; n < profile.data_len; n++) {
+    int32_t b = profile.data[n].brightness >> m_brightness_shift;
+    if ((JS_INVALID_XY == profile.data[n].x) || (0 > b)) {
+      continue;
+    }
+    state.histogram[((int32_t) kLevels <= b) ? kLevels - 1 : b]++;
+    state.points++;
+  }
+  state.profiles++;
+
+  // an element looking at nothing gives no information about exposure, so
+  // keep collecting rather than driving the on time to its maximum
+  if ((kWindowProfiles > state.profiles) || (kWindowPoints > state.points)) {
+    return;
+  }
+
+  uint32_t rank = (uint32_t) (((uint64_t) state.points *
+                               m_target_percentile) / 100);
+  uint32_t sum = 0;
+  uint32_t brightness = 0;
+  for (brightness = 0; brightness < kLevels - 1; brightness++) {
+    sum += state.histogram[brightness];
+    if (sum > rank) {
+      break;
+    }
+  }
+  ResetWindow(state);
+  state.brightness = brightness;
+
+  // Brightness is roughly proportional to laser on time until the sensor
+  // saturates; when saturated the true level is unknown, so step down.
+  double target = (double) m_target_brightness;
+  double ratio = (kLevels - 1 <= brightness) ?
+                 1.0 - kMaxStep :
+                 target / ((0 == brightness) ? 1.0 : (double) brightness);
+  if ((1.0 - kDeadband <= ratio) && (1.0 + kDeadband >= ratio)) {
+    state.proposed_on_time_us = profile.laser_on_time_us;
+    return;
+  }
+
+  if (1.0 - kMaxStep > ratio) {
+    ratio = 1.0 - kMaxStep;
+  } else if (1.0 + kMaxStep < ratio) {
+    ratio = 1.0 + kMaxStep;
+  }
+
+  double on_time = profile.laser_on_time_us * ratio;
+  if (m_on_time_min_us > on_time) {
+    on_time = m_on_time_min_us;
+  } else if (m_on_time_max_us < on_time) {
+    on_time = m_on_time_max_us;
+  }
+  state.proposed_on_time_us = (uint32_t) on_time;
+}
+
+bool AutoExposure::IsUpdatePending() const
+{
+  if (!m_is_enabled) {
+    // restore the original bounds once after the loop is turned off
+    return m_is_fixed;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (kMinApplyInterval > now - m_last_apply) {
+    return false;
+  }
+
+  // treat changes below the deadband as noise
+  for (uint32_t h = 0; h < m_head_count; h++) {
+    for (uint32_t n = 0; n < m_element_count; n++) {
+      const ElementState &state = m_elements[h * kMaxElements + n];
+      double delta = (double) state.proposed_on_time_us -
+                     (double) state.applied_on_time_us;
+      delta = (0 > delta) ? -delta : delta;
+      if (kDeadband * state.applied_on_time_us < delta) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+void AutoExposure::Apply(jsScanSystem scan_system,
+                         const std::vector<jsScanHead> &scan_heads)
+{
+  bool is_fixed = m_is_enabled;
+  int32_t r = 0;
+
+  // same layout as `ScanApplication::ConfigureDistinctElementPhaseTable`,
+  // one phase per element with every scan head firing that element
+  r = jsScanSystemPhaseClearAll(scan_system);
+  if (0 > r) {
+    throw ApiError("jsScanSystemPhaseClearAll failed", r);
+  }
+
+  for (uint32_t n = 0; n < m_element_count; n++) {
+    r = jsScanSystemPhaseCreate(scan_system);
+    if (0 > r) {
+      throw ApiError("jsScanSystemPhaseCreate failed", r);
+    }
+
+    for (uint32_t h = 0; h < scan_heads.size(); h++) {
+      ElementState &state = m_elements[h * kMaxElements + n];
+      jsScanHeadConfiguration cfg;
+      r = jsScanHeadGetConfiguration(scan_heads[h], &cfg);
+      if (0 > r) {
+        throw ApiError("jsScanHeadGetConfiguration failed", r);
+      }
+
+      if (is_fixed) {
+        state.applied_on_time_us = state.proposed_on_time_us;
+        cfg.laser_on_time_min_us = state.applied_on_time_us;
+        cfg.laser_on_time_def_us = state.applied_on_time_us;
+        cfg.laser_on_time_max_us = state.applied_on_time_us;
+      } else {
+        state.applied_on_time_us = m_on_time_def_us;
+        state.proposed_on_time_us = m_on_time_def_us;
+        cfg.laser_on_time_min_us = m_on_time_min_us;
+        cfg.laser_on_time_def_us = m_on_time_def_us;
+        cfg.laser_on_time_max_us = m_on_time_max_us;
+      }
+
+      if (m_is_mode_camera) {
+        jsCamera camera = (jsCamera) (JS_CAMERA_A + n);
+        r = jsScanSystemPhaseInsertConfigurationCamera(scan_system,
+                                                       scan_heads[h],
+                                                       camera,
+                                                       &cfg);
+      } else {
+        jsLaser laser = (jsLaser) (JS_LASER_1 + n);
+        r = jsScanSystemPhaseInsertConfigurationLaser(scan_system,
+                                                      scan_heads[h],
+                                                      laser,
+                                                      &cfg);
+      }
+      if (0 > r) {
+        throw ApiError("failed to insert phase configuration", r);
+      }
+
+      // data collected at the old on time no longer applies
+      ResetWindow(state);
+    }
+  }
+
+  m_is_fixed = is_fixed;
+  m_last_apply = std::chrono::steady_clock::now();
+}
+
+uint32_t AutoExposure::GetBrightness(uint32_t head_index,
+                                     uint32_t element) const
+{
+  return m_elements[head_index * kMaxElements + element].brightness;
+}
+
+uint32_t AutoExposure::GetProposedOnTime(uint32_t head_index,
+                                         uint32_t element) const
+{
+  return m_elements[head_index * kMaxElements + element].proposed_on_time_us;
+}
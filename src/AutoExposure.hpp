@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_AUTO_EXPOSURE_H
+#define JOESCAN_AUTO_EXPOSURE_H
+
+#include "joescan_pinchot.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Closed loop laser on time control driven by profile brightness.
+ *
+ * Brightness of every valid point is binned into a per element histogram on
+ * the acquisition thread. Once enough data has been seen, the configured
+ * percentile is read from the histogram and a new laser on time is proposed
+ * that moves it towards the target brightness. Each step is limited in size
+ * and proposals within a deadband of the target are ignored, so the loop
+ * settles instead of hunting.
+ *
+ * New on times are applied by rebuilding the phase table with a fixed laser
+ * on time per element. That can only be done while not scanning, so the
+ * render thread polls `IsUpdatePending` and calls `Apply` with scanning and
+ * acquisition stopped; applies are spaced at least `kMinApplyInterval`
+ * apart.
+ */
+class AutoExposure {
+ public:
+  static const uint32_t kMaxElements = 8;
+  static const uint32_t kLevels = 256;
+
+  /**
+   * @brief Constructs the controller.
+   *
+   * @param head_count Number of scan heads.
+   * @param element_count Number of cameras or lasers per scan head.
+   * @param is_mode_camera `true` if elements are cameras, `false` if lasers.
+   * @param on_time_min_us Lowest laser on time the loop may select.
+   * @param on_time_def_us Starting laser on time.
+   * @param on_time_max_us Highest laser on time the loop may select.
+   * @param brightness_bit_depth Bits of brightness the scan heads report,
+   * as given by their capabilities; deeper brightness is scaled down to
+   * `kLevels` the way `LoadProfileBuffer` does, so targets compare with
+   * what the viewer shows.
+   */
+  AutoExposure(uint32_t head_count,
+               uint32_t element_count,
+               bool is_mode_camera,
+               uint32_t on_time_min_us,
+               uint32_t on_time_def_us,
+               uint32_t on_time_max_us,
+               uint32_t brightness_bit_depth = 8);
+
+  void SetEnabled(bool is_enabled);
+  bool IsEnabled() const;
+
+  /**
+   * @brief Sets the brightness the given percentile of points should reach.
+   */
+  void SetTarget(uint32_t brightness, uint32_t percentile);
+
+  /**
+   * @brief Bins the brightness of a profile; called on the acquisition
+   * thread of the profile's scan head.
+   */
+  void AddProfile(uint32_t head_index, const jsProfile &profile);
+
+  /**
+   * @brief Checks whether a new set of laser on times should be applied.
+   */
+  bool IsUpdatePending() const;
+
+  /**
+   * @brief Rebuilds the phase table with the proposed laser on times, or
+   * with the original min/max bounds once the loop has been disabled. The
+   * scan system must not be scanning and acquisition must be stopped.
+   */
+  void Apply(jsScanSystem scan_system,
+             const std::vector<jsScanHead> &scan_heads);
+
+  /**
+   * @brief Gets the last measured brightness percentile of an element.
+   */
+  uint32_t GetBrightness(uint32_t head_index, uint32_t element) const;
+
+  /**
+   * @brief Gets the laser on time the loop is currently proposing.
+   */
+  uint32_t GetProposedOnTime(uint32_t head_index, uint32_t element) const;
+
+ private:
+  // min time between phase table rebuilds, each briefly pauses scanning
+  static constexpr std::chrono::milliseconds kMinApplyInterval{ 1000 };
+  // largest relative change of on time per step
+  static constexpr double kMaxStep = 0.25;
+  // relative brightness error tolerated without adjusting
+  static constexpr double kDeadband = 0.1;
+  // data needed before the percentile is evaluated
+  static const uint32_t kWindowProfiles = 16;
+  static const uint32_t kWindowPoints = 1024;
+
+  struct ElementState {
+    uint32_t histogram[kLevels];
+    uint32_t points;
+    uint32_t profiles;
+    uint32_t applied_on_time_us;
+    std::atomic<uint32_t> brightness;
+    std::atomic<uint32_t> proposed_on_time_us;
+  };
+
+  void ResetWindow(ElementState &state);
+
+  std::unique_ptr<ElementState[]> m_elements;
+  uint32_t m_head_count;
+  uint32_t m_element_count;
+  bool m_is_mode_camera;
+  uint32_t m_on_time_min_us;
+  int32_t m_brightness_shift;
+  uint32_t m_on_time_def_us;
+  uint32_t m_on_time_max_us;
+
+  std::atomic<bool> m_is_enabled;
+  std::atomic<uint32_t> m_target_brightness;
+  std::atomic<uint32_t> m_target_percentile;
+  bool m_is_fixed;
+  std::chrono::steady_clock::time_point m_last_apply;
+};
+
+} // namespace joescan
+
+#endif
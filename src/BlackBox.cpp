@@ -0,0 +1,297 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "BlackBox.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+using namespace joescan;
+
+static uint64_t NowNs()
+{
+  return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// names recordings after the local time the dump started, to the
+// millisecond, so they sort in the order they were made
+static std::string DumpFileName()
+{
+  auto now = std::chrono::system_clock::now();
+  std::time_t t = std::chrono::system_clock::to_time_t(now);
+  uint32_t ms = (uint32_t)
+    (std::chrono::duration_cast<std::chrono::milliseconds>(
+      now.time_since_epoch()).count() % 1000);
+  std::tm tm;
+#if defined(_WIN32)
+  localtime_s(&tm, &t);
+#else
+  localtime_r(&t, &tm);
+#endif
+
+  char name[64];
+  size_t len = strftime(name, sizeof(name), "blackbox-%Y%m%d-%H%M%S", &tm);
+  snprintf(name + len, sizeof(name) - len, "-%03u.jsrec", ms);
+  return name;
+}
+
+bool BlackBox::ParseSpec(const std::string &spec,
+                         double *seconds,
+                         uint64_t *bytes)
+{
+  *seconds = 0.0;
+  *bytes = 0;
+
+  size_t pos = 0;
+  while (pos <= spec.size()) {
+    size_t end = spec.find(',', pos);
+    if (std::string::npos == end) {
+      end = spec.size();
+    }
+    std::string part = spec.substr(pos, end - pos);
+    pos = end + 1;
+
+    char *suffix = nullptr;
+    double value = strtod(part.c_str(), &suffix);
+    std::string unit = suffix;
+    std::transform(unit.begin(), unit.end(), unit.begin(),
+                   [](unsigned char c) { return (char) tolower(c); });
+    if ((suffix == part.c_str()) || (0.0 >= value)) {
+      return false;
+    }
+
+    if ("s" == unit) {
+      *seconds = value;
+    } else if ("min" == unit) {
+      *seconds = 60.0 * value;
+    } else if ("kb" == unit) {
+      *bytes = (uint64_t) (value * 1024.0);
+    } else if ("mb" == unit) {
+      *bytes = (uint64_t) (value * 1024.0 * 1024.0);
+    } else if ("gb" == unit) {
+      *bytes = (uint64_t) (value * 1024.0 * 1024.0 * 1024.0);
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+BlackBox::BlackBox(const RecordingInfo &info,
+                   const std::string &directory,
+                   double max_seconds,
+                   uint64_t max_bytes,
+                   double profile_rate_hz) :
+  m_info(info),
+  m_directory(directory),
+  m_max_seconds(max_seconds),
+  m_profile_rate_hz(profile_rate_hz),
+  m_write_seq(0),
+  m_is_dumping(false),
+  m_dumps(0),
+  m_dumped(0),
+  m_lost(0)
+{
+  // a duration alone is sized for the expected rate, with a quarter to
+  // spare for scan heads running faster than expected
+  if ((0 == max_bytes) && (0.0 < max_seconds) && (0.0 < profile_rate_hz)) {
+    double bytes = 1.25 * max_seconds * profile_rate_hz * sizeof(Slot);
+    max_bytes = ((double) kMaxDurationBytes < bytes) ?
+                kMaxDurationBytes :
+                (uint64_t) bytes;
+  } else if (0 == max_bytes) {
+    max_bytes = kDefaultBytes;
+  }
+
+  uint64_t slot_count = max_bytes / sizeof(Slot);
+  if (0 == slot_count) {
+    throw std::runtime_error("black box too small for a single profile");
+  }
+
+  // the slots are zeroed here rather than as profiles first arrive, so the
+  // memory behind them is all faulted in before capture starts
+  m_slots = std::vector<Slot>((size_t) slot_count);
+}
+
+BlackBox::~BlackBox()
+{
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void BlackBox::Add(uint32_t head_index, const jsProfile &profile)
+{
+  uint64_t seq = m_write_seq.fetch_add(1, std::memory_order_acq_rel);
+  Slot &slot = m_slots[seq % m_slots.size()];
+
+  // zero marks the slot as being written before any of it changes, so a
+  // dump that reads it at the same time can tell
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint32_t len = (JS_PROFILE_DATA_LEN < profile.data_len) ?
+                 JS_PROFILE_DATA_LEN : profile.data_len;
+  slot.added_ns = NowNs();
+  slot.head_index = head_index;
+  memcpy(&slot.profile, &profile,
+         offsetof(jsProfile, data) + len * sizeof(jsProfileData));
+  slot.profile.data_len = len;
+
+  slot.seq.store(seq + 1, std::memory_order_release);
+}
+
+bool BlackBox::Dump()
+{
+  if (m_is_dumping) {
+    return false;
+  }
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+
+  std::string path = DumpFileName();
+  if (!m_directory.empty()) {
+    path = m_directory + "/" + path;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_last_path = path;
+    m_last_error.clear();
+  }
+  m_dumped = 0;
+  m_lost = 0;
+
+  m_is_dumping = true;
+  m_thread = std::thread(&BlackBox::DumpThread, this, path);
+  return true;
+}
+
+size_t BlackBox::GetMemoryUsage() const
+{
+  return m_slots.size() * sizeof(Slot);
+}
+
+BlackBox::Stats BlackBox::GetStats() const
+{
+  Stats stats;
+  stats.slot_count = (uint32_t) m_slots.size();
+  stats.added = m_write_seq.load(std::memory_order_relaxed);
+  stats.dumps = m_dumps;
+  stats.dumped = m_dumped;
+  stats.lost = m_lost;
+  stats.expected_s = (0.0 < m_profile_rate_hz) ?
+                     m_slots.size() / m_profile_rate_hz :
+                     0.0;
+
+  // once full, the slot written next holds the oldest profile
+  stats.span_s = 0.0;
+  if (m_slots.size() < stats.added) {
+    const uint64_t seq = stats.added - m_slots.size();
+    const Slot &slot = m_slots[seq % m_slots.size()];
+    if (seq + 1 == slot.seq.load(std::memory_order_acquire)) {
+      uint64_t added_ns = slot.added_ns;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t now_ns = NowNs();
+      if ((seq + 1 == slot.seq.load(std::memory_order_relaxed)) &&
+          (added_ns < now_ns)) {
+        stats.span_s = (now_ns - added_ns) / 1.0e9;
+      }
+    }
+  }
+
+  return stats;
+}
+
+void BlackBox::GetLastDump(std::string *path, std::string *error) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  *path = m_last_path;
+  *error = m_last_error;
+}
+
+uint64_t BlackBox::Read(double oldest_s,
+                        double newest_s,
+                        const ReadCallback &callback) const
+{
+  const uint64_t end = m_write_seq.load(std::memory_order_acquire);
+  const uint64_t start = (m_slots.size() < end) ? end - m_slots.size() : 0;
+  const uint64_t now_ns = NowNs();
+  const uint64_t oldest_ns = (uint64_t) (oldest_s * 1.0e9);
+  const uint64_t newest_ns = (uint64_t) (newest_s * 1.0e9);
+  const uint64_t from_ns = ((0 < oldest_ns) && (oldest_ns < now_ns)) ?
+                           now_ns - oldest_ns : 0;
+  const uint64_t to_ns = (newest_ns < now_ns) ? now_ns - newest_ns : 0;
+  std::unique_ptr<jsProfile> profile(new jsProfile);
+  uint64_t lost = 0;
+
+  // oldest first, racing the writers that are overwriting them
+  for (uint64_t seq = start; seq < end; seq++) {
+    const Slot &slot = m_slots[seq % m_slots.size()];
+    if (seq + 1 != slot.seq.load(std::memory_order_acquire)) {
+      lost++;
+      continue;
+    }
+
+    uint64_t added_ns = slot.added_ns;
+    uint32_t head_index = slot.head_index;
+    uint32_t len = (JS_PROFILE_DATA_LEN < slot.profile.data_len) ?
+                   JS_PROFILE_DATA_LEN : slot.profile.data_len;
+    memcpy(profile.get(), &slot.profile,
+           offsetof(jsProfile, data) + len * sizeof(jsProfileData));
+    profile->data_len = len;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq + 1 != slot.seq.load(std::memory_order_relaxed)) {
+      lost++;
+      continue;
+    }
+
+    if ((from_ns > added_ns) || (to_ns < added_ns)) {
+      continue;
+    }
+
+    double fraction = (double) (seq + 1 - start) / (end - start);
+    if (!callback(head_index, *profile, fraction)) {
+      break;
+    }
+  }
+
+  return lost;
+}
+
+void BlackBox::DumpThread(std::string path)
+{
+  Trace::SetThreadName("Black Box Dump");
+  TraceSpan span("Dump Black Box");
+  try {
+    RecordingWriter writer(path, m_info);
+    uint64_t dumped = 0;
+    m_lost = Read(m_max_seconds, 0.0,
+                  [&](uint32_t head_index, const jsProfile &p, double) {
+      writer.Append(head_index, p);
+      m_dumped = ++dumped;
+      return true;
+    });
+    writer.Flush();
+  } catch (std::exception &e) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_last_error = e.what();
+  }
+
+  m_dumps++;
+  m_is_dumping = false;
+}
@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_BLACK_BOX_H
+#define JOESCAN_BLACK_BOX_H
+
+#include "Recording.hpp"
+#include "joescan_pinchot.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Keeps the most recent profiles in memory so that whatever led up
+ * to a problem can be saved to a recording after the fact.
+ *
+ * Profiles are copied into a ring of fixed size slots allocated once up
+ * front, so adding one never allocates and never blocks; it may be done
+ * from several threads at once. A dump writes the ring out on a thread of
+ * its own while profiles keep being added, losing only those overwritten
+ * before the dump got to them.
+ */
+class BlackBox {
+ public:
+  /**
+   * @brief Called with each profile read and the fraction of the profiles
+   * to read done so far; returns `false` to stop reading.
+   */
+  typedef std::function<bool(uint32_t head_index, const jsProfile &profile,
+                             double fraction)> ReadCallback;
+
+  /**
+   * @brief Memory used when only a duration is given and the rate profiles
+   * arrive at isn't known.
+   */
+  static const uint64_t kDefaultBytes = 256ULL << 20;
+  /**
+   * @brief Most memory given to a ring sized from a duration.
+   */
+  static const uint64_t kMaxDurationBytes = 4ULL << 30;
+
+  struct Stats {
+    uint32_t slot_count;
+    uint64_t added;
+    uint64_t dumps;
+    // profiles written and lost to being overwritten by the last dump
+    uint64_t dumped;
+    uint64_t lost;
+    // seconds the ring should hold at the expected rate, zero if unknown
+    double expected_s;
+    // seconds back to the oldest profile held, zero until the ring is full
+    double span_s;
+  };
+
+  /**
+   * @brief Parses how much to keep, as a duration, a size, or both joined
+   * by a comma, such as "30s", "512MB" or "30s,1GB".
+   *
+   * @param seconds Receives the duration, or zero if none is given.
+   * @param bytes Receives the size, or zero if none is given.
+   * @return `false` if the text isn't understood.
+   */
+  static bool ParseSpec(const std::string &spec, double *seconds,
+                        uint64_t *bytes);
+
+  /**
+   * @brief Allocates the ring.
+   *
+   * @param info What the profiles added are of, for the recording.
+   * @param directory Where recordings are written.
+   * @param max_seconds How far back a dump goes, or zero for as far as the
+   * ring does.
+   * @param max_bytes Memory given to the ring, or zero to size it for
+   * `max_seconds` at `profile_rate_hz`, up to `kMaxDurationBytes`.
+   * @param profile_rate_hz Profiles expected per second across all scan
+   * heads and elements, or zero if not known.
+   * @throw std::runtime_error if that isn't enough for a single profile.
+   */
+  BlackBox(const RecordingInfo &info, const std::string &directory,
+           double max_seconds, uint64_t max_bytes, double profile_rate_hz);
+
+  /**
+   * @brief Waits for a dump in progress to finish.
+   */
+  ~BlackBox();
+
+  /**
+   * @brief Copies a profile into the ring, overwriting the oldest.
+   */
+  void Add(uint32_t head_index, const jsProfile &profile);
+
+  /**
+   * @brief Starts writing the ring out to a new recording, named after the
+   * time and available from `GetLastDump` straight away.
+   *
+   * @return `false` if a dump is already in progress.
+   */
+  bool Dump();
+
+  /**
+   * @brief Reads the profiles added from `oldest_s` to `newest_s` seconds
+   * ago, oldest first, while profiles keep being added.
+   *
+   * @param oldest_s How far back to start, or zero for as far as the ring
+   * goes.
+   * @return Profiles overwritten before they could be read.
+   */
+  uint64_t Read(double oldest_s, double newest_s,
+                const ReadCallback &callback) const;
+
+  const RecordingInfo &GetInfo() const { return m_info; }
+  double GetMaxSeconds() const { return m_max_seconds; }
+  bool IsDumping() const { return m_is_dumping; }
+  Stats GetStats() const;
+
+  /**
+   * @return Bytes allocated for the ring, all of it allocated up front.
+   */
+  size_t GetMemoryUsage() const;
+
+  /**
+   * @brief Gets the path of the last recording written, and what went
+   * wrong with it, if anything.
+   */
+  void GetLastDump(std::string *path, std::string *error) const;
+
+ private:
+  struct alignas(64) Slot {
+    // sequence number plus one once written, zero while being written
+    std::atomic<uint64_t> seq;
+    uint64_t added_ns;
+    uint32_t head_index;
+    jsProfile profile;
+  };
+
+  void DumpThread(std::string path);
+
+  RecordingInfo m_info;
+  std::string m_directory;
+  double m_max_seconds;
+  double m_profile_rate_hz;
+  std::vector<Slot> m_slots;
+  alignas(64) std::atomic<uint64_t> m_write_seq;
+  std::thread m_thread;
+  std::atomic<bool> m_is_dumping;
+  std::atomic<uint64_t> m_dumps;
+  std::atomic<uint64_t> m_dumped;
+  std::atomic<uint64_t> m_lost;
+  mutable std::mutex m_mutex;
+  std::string m_last_path;
+  std::string m_last_error;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "BrightnessView.hpp"
+#include "implot_internal.h"
+#include <cstring>
+
+using namespace joescan;
+
+BrightnessView::BrightnessView(uint32_t head_count) :
+  m_cmap(-1),
+  m_histograms(new Histogram[head_count * kMaxElements]),
+  m_histogram_count(head_count * kMaxElements)
+{
+  memset(m_lut, 0, sizeof(m_lut));
+  for (uint32_t n = 0; n < m_histogram_count; n++) {
+    memset(m_histograms[n].counts, 0, sizeof(m_histograms[n].counts));
+    m_histograms[n].is_stale = true;
+  }
+}
+
+void BrightnessView::SetColormap(ImPlotColormap cmap)
+{
+  if (cmap == m_cmap) {
+    return;
+  }
+
+  m_cmap = cmap;
+  for (uint32_t n = 0; n < kLevels; n++) {
+    float t = (float) n / (float) (kLevels - 1);
+    m_lut[n] = ImGui::ColorConvertFloat4ToU32(ImPlot::SampleColormap(t, cmap));
+  }
+}
+
+void BrightnessView::BeginHistogramUpdate()
+{
+  for (uint32_t n = 0; n < m_histogram_count; n++) {
+    m_histograms[n].is_stale = true;
+  }
+}
+
+void BrightnessView::AddToHistogram(uint32_t head_index,
+                                    uint32_t element,
+                                    const uint8_t *brightness,
+                                    uint32_t count)
+{
+  uint32_t idx = head_index * kMaxElements + element;
+  if ((kMaxElements <= element) || (m_histogram_count <= idx)) {
+    return;
+  }
+
+  Histogram &histogram = m_histograms[idx];
+  if (histogram.is_stale) {
+    memset(histogram.counts, 0, sizeof(histogram.counts));
+    histogram.is_stale = false;
+  }
+
+  for (uint32_t n = 0; n < count; n++) {
+    histogram.counts[brightness[n]]++;
+  }
+}
+
+void joescan::PlotColorScatter(const char *label_id,
+                               const double *xs,
+                               const double *ys,
+                               const uint8_t *levels,
+                               const ImU32 *lut,
+                               int count,
+                               float size)
+{
+  if (!ImPlot::BeginItem(label_id)) {
+    return;
+  }
+
+  if (ImPlot::FitThisFrame()) {
+    for (int n = 0; n < count; n++) {
+      ImPlot::FitPoint(ImPlotPoint(xs[n], ys[n]));
+    }
+  }
+
+  // legend swatch uses the middle of the table
+  ImPlot::GetCurrentItem()->Color = lut[128];
+
+  // Linear plot-to-pixel transform, computed once for the whole item. Both
+  // axes are linear in this view, so this matches ImPlot::PlotToPixels.
+  const ImPlotRect limits = ImPlot::GetPlotLimits();
+  const ImVec2 pos = ImPlot::GetPlotPos();
+  const ImVec2 plot_size = ImPlot::GetPlotSize();
+  const double sx = plot_size.x / limits.X.Size();
+  const double sy = plot_size.y / limits.Y.Size();
+  const double ox = pos.x - limits.X.Min * sx;
+  const double oy = pos.y + limits.Y.Max * sy;
+  const float half = (size < 0.5f) ? 0.5f : size;
+  const float x_min = pos.x - half;
+  const float x_max = pos.x + plot_size.x + half;
+  const float y_min = pos.y - half;
+  const float y_max = pos.y + plot_size.y + half;
+
+  ImDrawList &draw_list = *ImPlot::GetPlotDrawList();
+  ImPlot::PushPlotClipRect();
+  draw_list.PrimReserve(count * 6, count * 4);
+
+  int drawn = 0;
+  for (int n = 0; n < count; n++) {
+    float px = (float) (ox + xs[n] * sx);
+    float py = (float) (oy - ys[n] * sy);
+    if ((px < x_min) || (px > x_max) || (py < y_min) || (py > y_max)) {
+      continue;
+    }
+
+    draw_list.PrimRect(ImVec2(px - half, py - half),
+                       ImVec2(px + half, py + half),
+                       lut[levels[n]]);
+    drawn++;
+  }
+
+  // give back what was reserved for points outside the plot area
+  draw_list.PrimUnreserve((count - drawn) * 6, (count - drawn) * 4);
+  ImPlot::PopPlotClipRect();
+  ImPlot::EndItem();
+}
+
+void BrightnessView::PlotScatter(const char *label_id,
+                                 const double *xs,
+                                 const double *ys,
+                                 const uint8_t *brightness,
+                                 int count,
+                                 float size)
+{
+  PlotColorScatter(label_id, xs, ys, brightness, m_lut, count, size);
+}
+
+void BrightnessView::PlotHistogram(const char *label_id,
+                                   uint32_t head_index,
+                                   uint32_t element)
+{
+  uint32_t idx = head_index * kMaxElements + element;
+  if ((kMaxElements <= element) || (m_histogram_count <= idx)) {
+    return;
+  }
+
+  ImPlot::PlotStairs(label_id, m_histograms[idx].counts, (int) kLevels);
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_BRIGHTNESS_VIEW_H
+#define JOESCAN_BRIGHTNESS_VIEW_H
+
+#include "imgui.h"
+#include "implot.h"
+#include <stdint.h>
+#include <memory>
+
+namespace joescan {
+
+/**
+ * @brief Plots points as square markers, each colored by looking up its
+ * level in a 256 entry table. Must be called between `ImPlot::BeginPlot`
+ * and `ImPlot::EndPlot`; the item shows in the legend and can be toggled
+ * like any other.
+ *
+ * @param label_id Item label.
+ * @param xs X coordinates.
+ * @param ys Y coordinates.
+ * @param levels Lookup table index of every point.
+ * @param lut Colors indexed by level.
+ * @param count Number of points.
+ * @param size Half the marker width, in pixels.
+ */
+void PlotColorScatter(const char *label_id, const double *xs,
+                      const double *ys, const uint8_t *levels,
+                      const ImU32 *lut, int count, float size);
+
+/**
+ * @brief Plots profile points colored by their brightness and keeps a live
+ * brightness histogram per element of each scan head.
+ *
+ * Colors come from a lookup table sampled once from an ImPlot colormap, so
+ * drawing a point is a table lookup plus a quad written straight into the
+ * plot's draw list; no per point color conversion is done.
+ */
+class BrightnessView {
+ public:
+  static const uint32_t kMaxElements = 8;
+  static const uint32_t kLevels = 256;
+
+  /**
+   * @param head_count Number of scan heads histograms are kept for.
+   */
+  explicit BrightnessView(uint32_t head_count);
+
+  /**
+   * @brief Selects the colormap used to color points, rebuilding the lookup
+   * table if it changed.
+   */
+  void SetColormap(ImPlotColormap cmap);
+  ImPlotColormap GetColormap() const { return m_cmap; }
+
+  /**
+   * @brief Marks all histograms as stale; the next call to `AddToHistogram`
+   * for an element replaces its counts rather than adding to them. Elements
+   * that receive no data keep showing their previous histogram.
+   */
+  void BeginHistogramUpdate();
+
+  /**
+   * @brief Bins brightness levels, already scaled to `kLevels`, of one
+   * element of a scan head.
+   */
+  void AddToHistogram(uint32_t head_index, uint32_t element,
+                      const uint8_t *brightness, uint32_t count);
+
+  /**
+   * @brief Plots points colored by brightness; see `PlotColorScatter`.
+   */
+  void PlotScatter(const char *label_id, const double *xs, const double *ys,
+                   const uint8_t *brightness, int count, float size);
+
+  /**
+   * @brief Plots the brightness histogram of one element of a scan head as
+   * a stairs plot.
+   */
+  void PlotHistogram(const char *label_id, uint32_t head_index,
+                     uint32_t element);
+
+ private:
+  struct Histogram {
+    uint32_t counts[kLevels];
+    bool is_stale;
+  };
+
+  ImPlotColormap m_cmap;
+  ImU32 m_lut[kLevels];
+  // one per element of each scan head, indexed as `AutoExposure` does
+  std::unique_ptr<Histogram[]> m_histograms;
+  uint32_t m_histogram_count;
+};
+
+} // namespace joescan
+
+#endif
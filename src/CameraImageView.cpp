@@ -0,0 +1,335 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "CameraImageView.hpp"
+#include "Trace.hpp"
+#include "imgui.h"
+#include "implot.h"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GLFW/glfw3.h>
+
+using namespace joescan;
+
+// The OpenGL 2 headers shipped with some platforms (notably Windows) only
+// expose OpenGL 1.1, so the buffer object entry points needed for pixel
+// buffer objects are looked up at run time.
+#if defined(_WIN32)
+#define JS_GL_APIENTRY __stdcall
+#else
+#define JS_GL_APIENTRY
+#endif
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY 0x88B9
+#endif
+
+typedef void (JS_GL_APIENTRY *js_gl_gen_buffers)(GLsizei, GLuint *);
+typedef void (JS_GL_APIENTRY *js_gl_delete_buffers)(GLsizei, const GLuint *);
+typedef void (JS_GL_APIENTRY *js_gl_bind_buffer)(GLenum, GLuint);
+typedef void (JS_GL_APIENTRY *js_gl_buffer_data)(GLenum,
+                                                 ptrdiff_t,
+                                                 const void *,
+                                                 GLenum);
+typedef void *(JS_GL_APIENTRY *js_gl_map_buffer)(GLenum, GLenum);
+typedef GLboolean (JS_GL_APIENTRY *js_gl_unmap_buffer)(GLenum);
+
+static struct {
+  js_gl_gen_buffers GenBuffers;
+  js_gl_delete_buffers DeleteBuffers;
+  js_gl_bind_buffer BindBuffer;
+  js_gl_buffer_data BufferData;
+  js_gl_map_buffer MapBuffer;
+  js_gl_unmap_buffer UnmapBuffer;
+  bool is_loaded;
+  bool is_supported;
+} gl_pbo;
+
+static bool load_gl_pbo_functions()
+{
+  if (gl_pbo.is_loaded) {
+    return gl_pbo.is_supported;
+  }
+
+  gl_pbo.is_loaded = true;
+  gl_pbo.GenBuffers =
+    (js_gl_gen_buffers) glfwGetProcAddress("glGenBuffers");
+  gl_pbo.DeleteBuffers =
+    (js_gl_delete_buffers) glfwGetProcAddress("glDeleteBuffers");
+  gl_pbo.BindBuffer =
+    (js_gl_bind_buffer) glfwGetProcAddress("glBindBuffer");
+  gl_pbo.BufferData =
+    (js_gl_buffer_data) glfwGetProcAddress("glBufferData");
+  gl_pbo.MapBuffer =
+    (js_gl_map_buffer) glfwGetProcAddress("glMapBuffer");
+  gl_pbo.UnmapBuffer =
+    (js_gl_unmap_buffer) glfwGetProcAddress("glUnmapBuffer");
+
+  gl_pbo.is_supported = (nullptr != gl_pbo.GenBuffers) &&
+                        (nullptr != gl_pbo.DeleteBuffers) &&
+                        (nullptr != gl_pbo.BindBuffer) &&
+                        (nullptr != gl_pbo.BufferData) &&
+                        (nullptr != gl_pbo.MapBuffer) &&
+                        (nullptr != gl_pbo.UnmapBuffer);
+
+  return gl_pbo.is_supported;
+}
+
+CameraImageView::CameraImageView() :
+  m_write_slot(0),
+  m_read_slot(1),
+  m_shared_slot(2),
+  m_scan_head(0),
+  m_camera(JS_CAMERA_A),
+  m_laser(JS_LASER_1),
+  m_is_running(false),
+  m_texture(0),
+  m_pbo_index(0),
+  m_is_pbo_pending(false),
+  m_width(0),
+  m_height(0),
+  m_tex_width(0),
+  m_tex_height(0),
+  m_exposure_time_us(0),
+  m_frames_captured(0),
+  m_frames_dropped(0),
+  m_frames_uploaded(0)
+{
+  m_pbo[0] = 0;
+  m_pbo[1] = 0;
+
+  // images are large, keep them off the stack and out of the object
+  for (uint32_t n = 0; n < kSlotCount; n++) {
+    m_slots[n] = new jsCameraImage;
+    m_slots[n]->image_width = 0;
+    m_slots[n]->image_height = 0;
+  }
+}
+
+CameraImageView::~CameraImageView()
+{
+  Stop();
+  DestroyGLObjects();
+
+  for (uint32_t n = 0; n < kSlotCount; n++) {
+    delete m_slots[n];
+  }
+}
+
+void CameraImageView::Start(jsScanHead scan_head,
+                            jsCamera camera,
+                            jsLaser laser)
+{
+  Stop();
+
+  m_scan_head = scan_head;
+  m_camera = camera;
+  m_laser = laser;
+  m_frames_captured = 0;
+  m_frames_dropped = 0;
+  m_frames_uploaded = 0;
+  m_is_running = true;
+  m_thread = std::thread(&CameraImageView::CaptureThread, this);
+}
+
+void CameraImageView::Stop()
+{
+  m_is_running = false;
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+bool CameraImageView::IsRunning() const
+{
+  return m_is_running;
+}
+
+size_t CameraImageView::GetTextureBytes() const
+{
+  // one byte per pixel, and a pixel buffer of the image size either side
+  // of the texture when they are used
+  size_t len = (size_t) m_tex_width * m_tex_height;
+  if (0 != m_pbo[0]) {
+    len += 2 * (size_t) m_width * m_height;
+  }
+
+  return len;
+}
+
+std::string CameraImageView::GetLastError()
+{
+  std::lock_guard<std::mutex> lock(m_error_mutex);
+  return m_last_error;
+}
+
+void CameraImageView::CaptureThread()
+{
+  Trace::SetThreadName("Camera Image");
+  while (m_is_running) {
+    jsCameraImage *image = m_slots[m_write_slot];
+    int32_t r = 0;
+    {
+      TraceSpan span("Capture Image");
+      r = jsScanHeadGetCameraImage(m_scan_head, m_camera, m_laser, image);
+    }
+    if (0 > r) {
+      const char *err_str = nullptr;
+      jsGetError(r, &err_str);
+      {
+        std::lock_guard<std::mutex> lock(m_error_mutex);
+        m_last_error = (nullptr != err_str) ? err_str : "unknown error";
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+
+    // publish the image; if the previous one was never consumed it gets
+    // recycled as the next write slot, dropping it
+    uint32_t prev = m_shared_slot.exchange(m_write_slot | kSlotFresh);
+    if (prev & kSlotFresh) {
+      m_frames_dropped++;
+    }
+    m_write_slot = prev & ~kSlotFresh;
+    m_frames_captured++;
+  }
+}
+
+void CameraImageView::CreateGLObjects()
+{
+  if (0 == m_texture) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    m_texture = texture;
+  }
+
+  if ((0 == m_pbo[0]) && load_gl_pbo_functions()) {
+    GLuint pbo[2];
+    gl_pbo.GenBuffers(2, pbo);
+    m_pbo[0] = pbo[0];
+    m_pbo[1] = pbo[1];
+  }
+}
+
+void CameraImageView::DestroyGLObjects()
+{
+  // only touch OpenGL if objects were ever created; the context may already
+  // be gone otherwise
+  if (0 != m_texture) {
+    GLuint texture = m_texture;
+    glDeleteTextures(1, &texture);
+    m_texture = 0;
+  }
+
+  if (0 != m_pbo[0]) {
+    GLuint pbo[2] = { m_pbo[0], m_pbo[1] };
+    gl_pbo.DeleteBuffers(2, pbo);
+    m_pbo[0] = 0;
+    m_pbo[1] = 0;
+  }
+}
+
+void CameraImageView::Upload()
+{
+  CreateGLObjects();
+
+  glBindTexture(GL_TEXTURE_2D, m_texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  // Transfer the image written into a PBO on the previous call; by now the
+  // copy into the buffer has long completed, so the driver can DMA it into
+  // the texture without synchronizing with this thread.
+  if (m_is_pbo_pending) {
+    gl_pbo.BindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo[m_pbo_index]);
+    if ((m_tex_width != m_width) || (m_tex_height != m_height)) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, m_width, m_height, 0,
+                   GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+      m_tex_width = m_width;
+      m_tex_height = m_height;
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height,
+                    GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+    gl_pbo.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_is_pbo_pending = false;
+    m_frames_uploaded++;
+  }
+
+  if (0 == (m_shared_slot.load() & kSlotFresh)) {
+    return;
+  }
+
+  uint32_t prev = m_shared_slot.exchange(m_read_slot);
+  m_read_slot = prev & ~kSlotFresh;
+  const jsCameraImage *image = m_slots[m_read_slot];
+  uint32_t width = image->image_width;
+  uint32_t height = image->image_height;
+  if ((0 == width) || (0 == height)) {
+    return;
+  }
+
+  m_exposure_time_us = image->camera_exposure_time_us;
+  m_width = width;
+  m_height = height;
+
+  if (0 == m_pbo[0]) {
+    // no PBO support, upload straight from client memory
+    if ((m_tex_width != width) || (m_tex_height != height)) {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, width, height, 0,
+                   GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+      m_tex_width = width;
+      m_tex_height = height;
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                    GL_LUMINANCE, GL_UNSIGNED_BYTE, image->data);
+    m_frames_uploaded++;
+    return;
+  }
+
+  // Fill the other PBO; orphaning the old storage first means the map never
+  // waits on a transfer that may still be reading from it.
+  const ptrdiff_t size = (ptrdiff_t) width * height;
+  m_pbo_index ^= 1;
+  gl_pbo.BindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo[m_pbo_index]);
+  gl_pbo.BufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  void *dst = gl_pbo.MapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+  if (nullptr != dst) {
+    memcpy(dst, image->data, size);
+    gl_pbo.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    m_is_pbo_pending = true;
+  }
+  gl_pbo.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void CameraImageView::PlotImage(const char *label_id)
+{
+  if ((0 == m_texture) || (0 == m_tex_width) || (0 == m_tex_height)) {
+    return;
+  }
+
+  // plot y axis points up while image rows go down, so the first row of the
+  // image lands at the top of the bounds
+  ImPlot::PlotImage(label_id,
+                    (ImTextureID) (intptr_t) m_texture,
+                    ImPlotPoint(0.0, 0.0),
+                    ImPlotPoint(m_tex_width, m_tex_height));
+}
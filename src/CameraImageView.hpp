@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_CAMERA_IMAGE_VIEW_H
+#define JOESCAN_CAMERA_IMAGE_VIEW_H
+
+#include "joescan_pinchot.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace joescan {
+
+/**
+ * @brief Streams camera images from a scan head into an OpenGL texture.
+ *
+ * Images are fetched on a background thread and handed to the render thread
+ * through a triple buffer; if the render thread has not yet consumed the
+ * newest image, it is overwritten so that only the latest frame is shown.
+ * On the render thread, pixel data is copied into one of two pixel buffer
+ * objects while the other one is transferred into the texture, so the GPU
+ * upload never stalls the frame.
+ *
+ * Note that the Pinchot API only captures camera images while the scan
+ * system is not scanning; the caller is responsible for stopping scanning
+ * before calling `Start`.
+ */
+class CameraImageView {
+ public:
+  CameraImageView();
+  ~CameraImageView();
+
+  /**
+   * @brief Starts capturing images on a background thread.
+   *
+   * @param scan_head The scan head to capture images from.
+   * @param camera The camera to capture from.
+   * @param laser The laser to turn on during image exposure.
+   */
+  void Start(jsScanHead scan_head, jsCamera camera, jsLaser laser);
+
+  /**
+   * @brief Stops the capture thread; blocks until it has exited.
+   */
+  void Stop();
+
+  bool IsRunning() const;
+
+  /**
+   * @brief Uploads the newest captured image, if any, to the texture. Must
+   * be called from the thread owning the OpenGL context.
+   */
+  void Upload();
+
+  /**
+   * @brief Draws the texture into the current ImPlot plot with the image
+   * origin in the top left corner and one plot unit per pixel.
+   */
+  void PlotImage(const char *label_id);
+
+  uint32_t GetWidth() const { return m_width; }
+  uint32_t GetHeight() const { return m_height; }
+  uint32_t GetFramesCaptured() const { return m_frames_captured; }
+  uint32_t GetFramesDropped() const { return m_frames_dropped; }
+  uint32_t GetFramesUploaded() const { return m_frames_uploaded; }
+  uint32_t GetExposureTime() const { return m_exposure_time_us; }
+  std::string GetLastError();
+
+  /**
+   * @return Bytes of GPU memory taken by the texture and pixel buffers.
+   */
+  size_t GetTextureBytes() const;
+
+ private:
+  static const uint32_t kSlotCount = 3;
+  // bit set in the shared slot index when it holds an image not yet consumed
+  static const uint32_t kSlotFresh = 0x4;
+
+  void CaptureThread();
+  void CreateGLObjects();
+  void DestroyGLObjects();
+
+  // `m_slots` is a triple buffer; the capture thread owns `m_write_slot`,
+  // the render thread owns `m_read_slot`, and `m_shared_slot` is exchanged
+  // atomically between them.
+  jsCameraImage *m_slots[kSlotCount];
+  uint32_t m_write_slot;
+  uint32_t m_read_slot;
+  std::atomic<uint32_t> m_shared_slot;
+
+  jsScanHead m_scan_head;
+  jsCamera m_camera;
+  jsLaser m_laser;
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+
+  std::mutex m_error_mutex;
+  std::string m_last_error;
+
+  uint32_t m_texture;
+  uint32_t m_pbo[2];
+  uint32_t m_pbo_index;
+  bool m_is_pbo_pending;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_tex_width;
+  uint32_t m_tex_height;
+  uint32_t m_exposure_time_us;
+
+  std::atomic<uint32_t> m_frames_captured;
+  std::atomic<uint32_t> m_frames_dropped;
+  uint32_t m_frames_uploaded;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ElementStats.hpp"
+
+using namespace joescan;
+
+void ElementStats::Extreme::Reset(bool is_maximum)
+{
+  seq.resize(kWindowLen);
+  value.resize(kWindowLen);
+  head = 0;
+  tail = 0;
+  is_max = is_maximum;
+}
+
+void ElementStats::Extreme::Push(uint64_t sequence, double v)
+{
+  // values the new one beats can never be the extreme again, as it stays
+  // in the window longer than they do
+  while (!IsEmpty()) {
+    double last = value[(tail - 1) % kWindowLen];
+    if ((is_max) ? (last > v) : (last < v)) {
+      break;
+    }
+    tail--;
+  }
+
+  seq[tail % kWindowLen] = sequence;
+  value[tail % kWindowLen] = v;
+  tail++;
+}
+
+void ElementStats::Extreme::Expire(uint64_t oldest)
+{
+  while (!IsEmpty() && (seq[head % kWindowLen] < oldest)) {
+    head++;
+  }
+}
+
+ElementStats::ElementStats(uint32_t element_count) :
+  m_elements(element_count)
+{
+  for (auto &e : m_elements) {
+    e.samples.resize(kWindowLen);
+  }
+  Reset();
+}
+
+void ElementStats::Reset()
+{
+  for (auto &e : m_elements) {
+    e.next_seq = 0;
+    e.count = 0;
+    e.sum_total = 0;
+    e.sum_points = 0.0;
+    e.sum_x = 0.0;
+    e.sum_y = 0.0;
+    e.sum_brightness = 0.0;
+    e.x_min.Reset(false);
+    e.x_max.Reset(true);
+    e.y_min.Reset(false);
+    e.y_max.Reset(true);
+  }
+}
+
+void ElementStats::Add(uint32_t element,
+                       uint32_t total,
+                       const ProfileBuffer &buffer)
+{
+  Element &e = m_elements[element];
+  const uint64_t seq = e.next_seq++;
+  Sample &s = e.samples[seq % kWindowLen];
+
+  // the new sample takes the place of the oldest one once the window is
+  // full, so that one's share of the sums goes first
+  if (kWindowLen == e.count) {
+    e.sum_total -= s.total;
+    e.sum_points -= s.points;
+    e.sum_x -= s.sum_x;
+    e.sum_y -= s.sum_y;
+    e.sum_brightness -= s.sum_brightness;
+  } else {
+    e.count++;
+  }
+
+  const uint64_t previous_ns = (0 == seq) ?
+    0 : e.samples[(seq - 1) % kWindowLen].timestamp_ns;
+
+  s.timestamp_ns = buffer.timestamp_ns;
+  s.total = total;
+  s.points = buffer.data_len;
+  s.rate_hz = (previous_ns < buffer.timestamp_ns) ?
+              1.0e9 / (double) (buffer.timestamp_ns - previous_ns) : 0.0;
+  s.sum_x = 0.0;
+  s.sum_y = 0.0;
+  s.sum_brightness = 0.0;
+  s.x_min = 0.0;
+  s.x_max = 0.0;
+  s.y_min = 0.0;
+  s.y_max = 0.0;
+
+  if (0 != buffer.data_len) {
+    s.x_min = s.x_max = buffer.x[0];
+    s.y_min = s.y_max = buffer.y[0];
+  }
+  for (uint32_t n = 0; n < buffer.data_len; n++) {
+    const double x = buffer.x[n];
+    const double y = buffer.y[n];
+    s.sum_x += x;
+    s.sum_y += y;
+    s.sum_brightness += buffer.brightness[n];
+    s.x_min = (x < s.x_min) ? x : s.x_min;
+    s.x_max = (x > s.x_max) ? x : s.x_max;
+    s.y_min = (y < s.y_min) ? y : s.y_min;
+    s.y_max = (y > s.y_max) ? y : s.y_max;
+  }
+  s.brightness_mean = (0 != buffer.data_len) ?
+                      s.sum_brightness / buffer.data_len : 0.0;
+
+  e.sum_total += s.total;
+  e.sum_points += s.points;
+  e.sum_x += s.sum_x;
+  e.sum_y += s.sum_y;
+  e.sum_brightness += s.sum_brightness;
+
+  const uint64_t oldest = seq + 1 - e.count;
+  e.x_min.Expire(oldest);
+  e.x_max.Expire(oldest);
+  e.y_min.Expire(oldest);
+  e.y_max.Expire(oldest);
+
+  // profiles without points have no extent to contribute
+  if (0 != buffer.data_len) {
+    e.x_min.Push(seq, s.x_min);
+    e.x_max.Push(seq, s.x_max);
+    e.y_min.Push(seq, s.y_min);
+    e.y_max.Push(seq, s.y_max);
+  }
+}
+
+ElementStats::Summary ElementStats::GetSummary(uint32_t element) const
+{
+  const Element &e = m_elements[element];
+  Summary summary;
+  summary.profiles = e.count;
+  summary.points_mean = (0 != e.count) ? e.sum_points / e.count : 0.0;
+  summary.valid_ratio = (0 != e.sum_total) ?
+                        e.sum_points / (double) e.sum_total : 0.0;
+
+  const bool is_points = (0.0 < e.sum_points);
+  summary.x_mean = (is_points) ? e.sum_x / e.sum_points : 0.0;
+  summary.y_mean = (is_points) ? e.sum_y / e.sum_points : 0.0;
+  summary.brightness_mean =
+    (is_points) ? e.sum_brightness / e.sum_points : 0.0;
+  summary.x_min = (e.x_min.IsEmpty()) ? 0.0 : e.x_min.Get();
+  summary.x_max = (e.x_max.IsEmpty()) ? 0.0 : e.x_max.Get();
+  summary.y_min = (e.y_min.IsEmpty()) ? 0.0 : e.y_min.Get();
+  summary.y_max = (e.y_max.IsEmpty()) ? 0.0 : e.y_max.Get();
+
+  // profiles in the window over the time they span
+  summary.rate_hz = 0.0;
+  if (1 < e.count) {
+    const Sample &newest = e.samples[(e.next_seq - 1) % kWindowLen];
+    const Sample &oldest = e.samples[(e.next_seq - e.count) % kWindowLen];
+    if (oldest.timestamp_ns < newest.timestamp_ns) {
+      summary.rate_hz = (e.count - 1) * 1.0e9 /
+                        (double) (newest.timestamp_ns - oldest.timestamp_ns);
+    }
+  }
+
+  return summary;
+}
+
+const ElementStats::Sample *ElementStats::GetSamples(uint32_t element) const
+{
+  return m_elements[element].samples.data();
+}
+
+uint32_t ElementStats::GetSampleCount(uint32_t element) const
+{
+  return m_elements[element].count;
+}
+
+uint32_t ElementStats::GetSampleOffset(uint32_t element) const
+{
+  const Element &e = m_elements[element];
+  return (kWindowLen == e.count) ?
+         (uint32_t) (e.next_seq % kWindowLen) : 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_ELEMENT_STATS_H
+#define JOESCAN_ELEMENT_STATS_H
+
+#include "ProfileBuffer.hpp"
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Rolling statistics over the most recent profiles of every
+ * element.
+ *
+ * Each profile is reduced to a sample once, as it arrives. Sums over the
+ * window are kept up to date by adding the new sample and subtracting the
+ * one it replaces, and minimums and maximums come from monotonic queues,
+ * so adding a profile and reading the statistics both take constant time
+ * no matter the window length.
+ */
+class ElementStats {
+ public:
+  static const uint32_t kWindowLen = 256;
+
+  /**
+   * @brief Reduction of a single profile.
+   */
+  struct Sample {
+    uint64_t timestamp_ns;
+    // points the profile carries, valid or not
+    uint32_t total;
+    // valid points, as a double so the samples can be plotted directly
+    double points;
+    // rate from the interval since the previous profile, zero for the
+    // first one
+    double rate_hz;
+    double brightness_mean;
+    double sum_x;
+    double sum_y;
+    double sum_brightness;
+    double x_min;
+    double x_max;
+    double y_min;
+    double y_max;
+  };
+
+  struct Summary {
+    uint32_t profiles;
+    double points_mean;
+    // fraction of the points carried that were valid
+    double valid_ratio;
+    double x_min;
+    double x_max;
+    double x_mean;
+    double y_min;
+    double y_max;
+    double y_mean;
+    double brightness_mean;
+    double rate_hz;
+  };
+
+  explicit ElementStats(uint32_t element_count);
+
+  /**
+   * @brief Adds a profile to an element's window, dropping the oldest once
+   * the window is full.
+   *
+   * @param element Index of the element.
+   * @param total Number of points the profile carried, valid or not.
+   * @param buffer The profile's valid points.
+   */
+  void Add(uint32_t element, uint32_t total, const ProfileBuffer &buffer);
+
+  /**
+   * @brief Empties the windows of all elements.
+   */
+  void Reset();
+
+  /**
+   * @brief Gets the statistics over an element's window. Coordinates are
+   * zero while the window holds no points.
+   */
+  Summary GetSummary(uint32_t element) const;
+
+  /**
+   * @brief Samples of an element's window, kept in a ring;
+   * `GetSampleOffset` is the index of the oldest one.
+   */
+  const Sample *GetSamples(uint32_t element) const;
+  uint32_t GetSampleCount(uint32_t element) const;
+  uint32_t GetSampleOffset(uint32_t element) const;
+
+ private:
+  // values of the window in the order they arrived, minus any that can no
+  // longer be the extreme because a later one beats them; the front is
+  // the extreme of the window
+  struct Extreme {
+    std::vector<uint64_t> seq;
+    std::vector<double> value;
+    uint64_t head;
+    uint64_t tail;
+    bool is_max;
+
+    void Reset(bool is_maximum);
+    void Push(uint64_t sequence, double v);
+    void Expire(uint64_t oldest);
+    bool IsEmpty() const { return head == tail; }
+    double Get() const { return value[head % kWindowLen]; }
+  };
+
+  struct Element {
+    std::vector<Sample> samples;
+    uint64_t next_seq;
+    uint32_t count;
+    uint64_t sum_total;
+    double sum_points;
+    double sum_x;
+    double sum_y;
+    double sum_brightness;
+    Extreme x_min;
+    Extreme x_max;
+    Extreme y_min;
+    Extreme y_max;
+  };
+
+  std::vector<Element> m_elements;
+};
+
+} // namespace joescan
+
+#endif
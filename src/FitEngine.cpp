@@ -0,0 +1,636 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "FitEngine.hpp"
+#include "Trace.hpp"
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace joescan;
+
+// candidates are scored on about this many points
+static const uint32_t kScorePoints = 1024;
+// fewer points than this and a frame isn't fit at all
+static const uint32_t kMinPoints = 10;
+// largest circle accepted, in units of the RMS radius of the frame, which
+// keeps nearly straight runs of points from being fit as huge circles
+static const double kMaxRadius = 20.0;
+
+/**
+ * @brief Solves `a * x = b` by Gaussian elimination with partial pivoting.
+ *
+ * @param a Row major `n` by `n` matrix, destroyed.
+ * @param b Right hand side, replaced by the solution.
+ * @return `false` if the matrix is singular.
+ */
+static bool Solve(double *a, double *b, uint32_t n)
+{
+  for (uint32_t col = 0; col < n; col++) {
+    uint32_t pivot = col;
+    for (uint32_t row = col + 1; row < n; row++) {
+      if (fabs(a[row * n + col]) > fabs(a[pivot * n + col])) {
+        pivot = row;
+      }
+    }
+
+    if (1e-12 > fabs(a[pivot * n + col])) {
+      return false;
+    }
+
+    if (pivot != col) {
+      for (uint32_t k = 0; k < n; k++) {
+        std::swap(a[col * n + k], a[pivot * n + k]);
+      }
+      std::swap(b[col], b[pivot]);
+    }
+
+    for (uint32_t row = col + 1; row < n; row++) {
+      double f = a[row * n + col] / a[col * n + col];
+      for (uint32_t k = col; k < n; k++) {
+        a[row * n + k] -= f * a[col * n + k];
+      }
+      b[row] -= f * b[col];
+    }
+  }
+
+  for (int32_t row = n - 1; 0 <= row; row--) {
+    double sum = b[row];
+    for (uint32_t k = row + 1; k < n; k++) {
+      sum -= a[row * n + k] * b[k];
+    }
+    b[row] = sum / a[row * n + row];
+  }
+
+  return true;
+}
+
+/**
+ * @brief Circle through three points.
+ */
+static bool CircleFrom3(const double *x, const double *y, double *c)
+{
+  double d = 2.0 * (x[0] * (y[1] - y[2]) + x[1] * (y[2] - y[0]) +
+                    x[2] * (y[0] - y[1]));
+  if (1e-12 > fabs(d)) {
+    return false;
+  }
+
+  double s0 = x[0] * x[0] + y[0] * y[0];
+  double s1 = x[1] * x[1] + y[1] * y[1];
+  double s2 = x[2] * x[2] + y[2] * y[2];
+  c[0] = (s0 * (y[1] - y[2]) + s1 * (y[2] - y[0]) + s2 * (y[0] - y[1])) / d;
+  c[1] = (s0 * (x[2] - x[1]) + s1 * (x[0] - x[2]) + s2 * (x[1] - x[0])) / d;
+  c[2] = sqrt((x[0] - c[0]) * (x[0] - c[0]) + (y[0] - c[1]) * (y[0] - c[1]));
+  return kMaxRadius > c[2];
+}
+
+static inline double CircleDistance(const double *c, double x, double y)
+{
+  double dx = x - c[0];
+  double dy = y - c[1];
+  return fabs(sqrt(dx * dx + dy * dy) - c[2]);
+}
+
+/**
+ * @brief Approximate distance of a point to the conic
+ * `a x^2 + b xy + c y^2 + d x + e y - 1 = 0`: the conic value divided by
+ * its gradient.
+ */
+static inline double ConicDistance(const double *p, double x, double y)
+{
+  double q = p[0] * x * x + p[1] * x * y + p[2] * y * y + p[3] * x +
+             p[4] * y - 1.0;
+  double gx = 2.0 * p[0] * x + p[1] * y + p[3];
+  double gy = p[1] * x + 2.0 * p[2] * y + p[4];
+  double g = sqrt(gx * gx + gy * gy);
+  return (1e-12 < g) ? fabs(q) / g : HUGE_VAL;
+}
+
+/**
+ * @brief Adds a point to the normal equations of the conic fit.
+ */
+static inline void AddConicRow(double *ata, double *atb, double x, double y)
+{
+  double row[5] = { x * x, x * y, y * y, x, y };
+  for (uint32_t i = 0; i < 5; i++) {
+    for (uint32_t k = 0; k < 5; k++) {
+      ata[i * 5 + k] += row[i] * row[k];
+    }
+    atb[i] += row[i];
+  }
+}
+
+/**
+ * @brief Center, semi-axes and angle of a conic, if it is an ellipse.
+ */
+static bool ConicToEllipse(const double *p, double *e)
+{
+  double a = p[0];
+  double b = p[1];
+  double c = p[2];
+  double d = p[3];
+  double f = -1.0;
+  double den = b * b - 4.0 * a * c;
+  if (0.0 <= den) {
+    return false;
+  }
+
+  double x0 = (2.0 * c * d - b * p[4]) / den;
+  double y0 = (2.0 * a * p[4] - b * d) / den;
+  double f0 = f + 0.5 * (d * x0 + p[4] * y0);
+
+  // rotate onto the axes of the ellipse
+  double theta = 0.5 * atan2(b, a - c);
+  double cs = cos(theta);
+  double sn = sin(theta);
+  double a_rot = a * cs * cs + b * cs * sn + c * sn * sn;
+  double c_rot = a * sn * sn - b * cs * sn + c * cs * cs;
+  if ((0.0 < -f0 / a_rot) && (0.0 < -f0 / c_rot)) {
+    double axis_u = sqrt(-f0 / a_rot);
+    double axis_v = sqrt(-f0 / c_rot);
+    e[0] = x0;
+    e[1] = y0;
+    if (axis_u >= axis_v) {
+      e[2] = axis_u;
+      e[3] = axis_v;
+      e[4] = theta;
+    } else {
+      e[2] = axis_v;
+      e[3] = axis_u;
+      e[4] = theta + 0.5 * 3.14159265358979323846;
+    }
+    return true;
+  }
+
+  return false;
+}
+
+FitEngine::FitEngine(uint32_t max_points, WorkerPool &pool) :
+  m_pool(pool),
+  m_is_pending(false),
+  m_shapes(0),
+  m_tolerance(0.05),
+  m_encoder(0),
+  m_count(0),
+  m_x(max_points),
+  m_y(max_points),
+  m_xn(max_points),
+  m_yn(max_points),
+  m_is_used(max_points),
+  m_fit_tolerance(0.05),
+  m_mean_x(0.0),
+  m_mean_y(0.0),
+  m_scale(1.0),
+  m_stride(1),
+  m_random(0x12345678),
+  m_history(kHistoryLen),
+  m_frames_fit(0),
+  m_frames_skipped(0),
+  m_start(std::chrono::steady_clock::now())
+{
+  memset(&m_result, 0, sizeof(m_result));
+}
+
+FitEngine::~FitEngine()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cv.wait(lock, [this] { return !m_is_pending; });
+}
+
+void FitEngine::SetShapes(uint32_t shapes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_shapes = shapes;
+}
+
+void FitEngine::SetTolerance(double tolerance)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_tolerance = tolerance;
+}
+
+bool FitEngine::Submit(const double *x,
+                       const double *y,
+                       uint32_t count,
+                       int64_t encoder)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_is_pending) {
+      m_frames_skipped++;
+      return false;
+    }
+  }
+
+  // the fit task leaves the request alone until it is marked pending
+  if (count > m_x.size()) {
+    count = (uint32_t) m_x.size();
+  }
+  memcpy(m_x.data(), x, count * sizeof(double));
+  memcpy(m_y.data(), y, count * sizeof(double));
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_count = count;
+    m_encoder = encoder;
+    m_is_pending = true;
+  }
+  m_pool.Submit([this] { FitTask(); });
+
+  return true;
+}
+
+bool FitEngine::GetResult(Result *result) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  *result = m_result;
+  return 0 != m_frames_fit;
+}
+
+void FitEngine::GetHistory(std::vector<Result> *history) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  uint32_t count = (kHistoryLen < m_frames_fit) ?
+                   kHistoryLen : (uint32_t) m_frames_fit;
+  uint32_t first = (uint32_t) ((m_frames_fit - count) % kHistoryLen);
+
+  history->resize(count);
+  for (uint32_t n = 0; n < count; n++) {
+    (*history)[n] = m_history[(first + n) % kHistoryLen];
+  }
+}
+
+size_t FitEngine::GetMemoryUsage() const
+{
+  // every buffer is sized once, when the engine is created
+  return (m_x.size() + m_y.size() + m_xn.size() + m_yn.size()) *
+         sizeof(double) +
+         m_is_used.size() +
+         m_history.size() * sizeof(Result);
+}
+
+uint64_t FitEngine::GetFramesFit() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_frames_fit;
+}
+
+uint64_t FitEngine::GetFramesSkipped() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_frames_skipped;
+}
+
+void FitEngine::FitTask()
+{
+  Result result;
+  Fit(&result);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    result.frame = m_frames_fit;
+    m_result = result;
+    m_history[m_frames_fit % kHistoryLen] = result;
+    m_frames_fit++;
+    m_is_pending = false;
+    // still under the lock, as the engine may be gone the moment it's let go
+    m_cv.notify_all();
+  }
+}
+
+uint32_t FitEngine::Random(uint32_t count)
+{
+  // xorshift; quality is plenty for picking samples
+  m_random ^= m_random << 13;
+  m_random ^= m_random >> 17;
+  m_random ^= m_random << 5;
+  return m_random % count;
+}
+
+void FitEngine::Fit(Result *result)
+{
+  TraceSpan span("Fit");
+  auto start = std::chrono::steady_clock::now();
+  uint32_t shapes = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    shapes = m_shapes;
+    m_fit_tolerance = m_tolerance;
+  }
+
+  memset(result, 0, sizeof(*result));
+  result->encoder = m_encoder;
+  result->point_count = m_count;
+  result->time_s =
+    std::chrono::duration<double>(start - m_start).count();
+
+  if (kMinPoints <= m_count) {
+    Normalize();
+    if (0 != (shapes & kFitCircle)) {
+      FitCircle(result);
+    }
+    if (0 != (shapes & kFitEllipse)) {
+      FitEllipse(result);
+    }
+    if (0 != (shapes & kFitLines)) {
+      FitLines(result);
+    }
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  result->fit_time_ms =
+    std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void FitEngine::Normalize()
+{
+  const uint32_t count = m_count;
+  double sum_x = 0.0;
+  double sum_y = 0.0;
+  for (uint32_t n = 0; n < count; n++) {
+    sum_x += m_x[n];
+    sum_y += m_y[n];
+  }
+  m_mean_x = sum_x / count;
+  m_mean_y = sum_y / count;
+
+  double sum_r2 = 0.0;
+  for (uint32_t n = 0; n < count; n++) {
+    double dx = m_x[n] - m_mean_x;
+    double dy = m_y[n] - m_mean_y;
+    sum_r2 += dx * dx + dy * dy;
+  }
+  m_scale = sqrt(sum_r2 / count);
+  if (1e-9 > m_scale) {
+    m_scale = 1e-9;
+  }
+
+  const double inv_scale = 1.0 / m_scale;
+  for (uint32_t n = 0; n < count; n++) {
+    m_xn[n] = (m_x[n] - m_mean_x) * inv_scale;
+    m_yn[n] = (m_y[n] - m_mean_y) * inv_scale;
+  }
+
+  m_stride = (kScorePoints < count) ? count / kScorePoints : 1;
+}
+
+void FitEngine::FitCircle(Result *result)
+{
+  const uint32_t count = m_count;
+  const double tolerance = m_fit_tolerance / m_scale;
+  const double *x = m_xn.data();
+  const double *y = m_yn.data();
+  double best[3] = { 0.0, 0.0, 0.0 };
+  uint32_t best_score = 0;
+
+  for (uint32_t k = 0; k < kIterations; k++) {
+    uint32_t idx[3] = { Random(count), Random(count), Random(count) };
+    double sx[3] = { x[idx[0]], x[idx[1]], x[idx[2]] };
+    double sy[3] = { y[idx[0]], y[idx[1]], y[idx[2]] };
+    double c[3];
+    if (!CircleFrom3(sx, sy, c)) {
+      continue;
+    }
+
+    uint32_t score = 0;
+    for (uint32_t n = 0; n < count; n += m_stride) {
+      score += (tolerance >= CircleDistance(c, x[n], y[n])) ? 1 : 0;
+    }
+    if (score > best_score) {
+      best_score = score;
+      memcpy(best, c, sizeof(best));
+    }
+  }
+
+  if (3 > best_score) {
+    return;
+  }
+
+  // Least squares refit on the inliers, minimizing the algebraic distance
+  // x^2 + y^2 + d x + e y + f.
+  double ata[9] = { 0.0 };
+  double atb[3] = { 0.0 };
+  uint32_t inliers = 0;
+  for (uint32_t n = 0; n < count; n++) {
+    if (tolerance < CircleDistance(best, x[n], y[n])) {
+      continue;
+    }
+
+    double row[3] = { x[n], y[n], 1.0 };
+    double rhs = -(x[n] * x[n] + y[n] * y[n]);
+    for (uint32_t i = 0; i < 3; i++) {
+      for (uint32_t j = 0; j < 3; j++) {
+        ata[i * 3 + j] += row[i] * row[j];
+      }
+      atb[i] += row[i] * rhs;
+    }
+    inliers++;
+  }
+
+  double c[3] = { best[0], best[1], best[2] };
+  if (Solve(ata, atb, 3)) {
+    double cx = -0.5 * atb[0];
+    double cy = -0.5 * atb[1];
+    double r2 = cx * cx + cy * cy - atb[2];
+    if ((0.0 < r2) && (kMaxRadius * kMaxRadius > r2)) {
+      c[0] = cx;
+      c[1] = cy;
+      c[2] = sqrt(r2);
+    }
+  }
+
+  result->is_circle_valid = true;
+  result->circle_x = c[0] * m_scale + m_mean_x;
+  result->circle_y = c[1] * m_scale + m_mean_y;
+  result->circle_r = c[2] * m_scale;
+  result->circle_inliers = inliers;
+}
+
+void FitEngine::FitEllipse(Result *result)
+{
+  const uint32_t count = m_count;
+  const double tolerance = m_fit_tolerance / m_scale;
+  const double *x = m_xn.data();
+  const double *y = m_yn.data();
+  double best[5] = { 0.0 };
+  uint32_t best_score = 0;
+
+  // Conics are written as a x^2 + b xy + c y^2 + d x + e y = 1, which
+  // can't describe one through the origin. The origin is the centroid of
+  // the frame here, which lies inside any ellipse the points are on.
+  for (uint32_t k = 0; k < kIterations; k++) {
+    double a[25];
+    double p[5];
+    for (uint32_t i = 0; i < 5; i++) {
+      uint32_t idx = Random(count);
+      double row[5] = { x[idx] * x[idx], x[idx] * y[idx], y[idx] * y[idx],
+                        x[idx], y[idx] };
+      memcpy(&a[i * 5], row, sizeof(row));
+      p[i] = 1.0;
+    }
+
+    double e[5];
+    if (!Solve(a, p, 5) || !ConicToEllipse(p, e)) {
+      continue;
+    }
+
+    uint32_t score = 0;
+    for (uint32_t n = 0; n < count; n += m_stride) {
+      score += (tolerance >= ConicDistance(p, x[n], y[n])) ? 1 : 0;
+    }
+    if (score > best_score) {
+      best_score = score;
+      memcpy(best, p, sizeof(best));
+    }
+  }
+
+  if (5 > best_score) {
+    return;
+  }
+
+  double ata[25] = { 0.0 };
+  double atb[5] = { 0.0 };
+  uint32_t inliers = 0;
+  for (uint32_t n = 0; n < count; n++) {
+    if (tolerance >= ConicDistance(best, x[n], y[n])) {
+      AddConicRow(ata, atb, x[n], y[n]);
+      inliers++;
+    }
+  }
+
+  double e[5];
+  if (!Solve(ata, atb, 5) || !ConicToEllipse(atb, e)) {
+    if (!ConicToEllipse(best, e)) {
+      return;
+    }
+  }
+
+  result->is_ellipse_valid = true;
+  result->ellipse_x = e[0] * m_scale + m_mean_x;
+  result->ellipse_y = e[1] * m_scale + m_mean_y;
+  result->ellipse_major = e[2] * m_scale;
+  result->ellipse_minor = e[3] * m_scale;
+  result->ellipse_angle_deg = e[4] * 180.0 / 3.14159265358979323846;
+  result->ellipse_inliers = inliers;
+}
+
+void FitEngine::FitLines(Result *result)
+{
+  const uint32_t count = m_count;
+  const double tolerance = m_fit_tolerance / m_scale;
+  const double *x = m_xn.data();
+  const double *y = m_yn.data();
+  const uint32_t min_inliers = (20 * 20 < count) ? count / 20 : 20;
+  uint8_t *is_used = m_is_used.data();
+
+  // Lines are found one after the other, each from the points the earlier
+  // ones didn't claim.
+  memset(is_used, 0, count);
+  for (uint32_t l = 0; l < kMaxLines; l++) {
+    double best[3] = { 0.0, 0.0, 0.0 };
+    uint32_t best_score = 0;
+
+    for (uint32_t k = 0; k < kIterations; k++) {
+      uint32_t i0 = Random(count);
+      uint32_t i1 = Random(count);
+      if (is_used[i0] || is_used[i1]) {
+        continue;
+      }
+
+      // unit normal and offset
+      double nx = y[i0] - y[i1];
+      double ny = x[i1] - x[i0];
+      double len = sqrt(nx * nx + ny * ny);
+      if (1e-9 > len) {
+        continue;
+      }
+      nx /= len;
+      ny /= len;
+      double c = nx * x[i0] + ny * y[i0];
+
+      uint32_t score = 0;
+      for (uint32_t n = 0; n < count; n += m_stride) {
+        bool is_inlier = tolerance >= fabs(nx * x[n] + ny * y[n] - c);
+        score += (is_inlier && !is_used[n]) ? 1 : 0;
+      }
+      if (score > best_score) {
+        best_score = score;
+        best[0] = nx;
+        best[1] = ny;
+        best[2] = c;
+      }
+    }
+
+    if (min_inliers > best_score * m_stride) {
+      break;
+    }
+
+    // total least squares refit: the line runs through the inlier mean
+    // along the principal axis of their spread
+    double sum_x = 0.0;
+    double sum_y = 0.0;
+    uint32_t inliers = 0;
+    for (uint32_t n = 0; n < count; n++) {
+      double d = fabs(best[0] * x[n] + best[1] * y[n] - best[2]);
+      if ((tolerance >= d) && !is_used[n]) {
+        sum_x += x[n];
+        sum_y += y[n];
+        inliers++;
+      }
+    }
+    if (min_inliers > inliers) {
+      break;
+    }
+
+    double mx = sum_x / inliers;
+    double my = sum_y / inliers;
+    double sxx = 0.0;
+    double sxy = 0.0;
+    double syy = 0.0;
+    for (uint32_t n = 0; n < count; n++) {
+      double d = fabs(best[0] * x[n] + best[1] * y[n] - best[2]);
+      if ((tolerance >= d) && !is_used[n]) {
+        double dx = x[n] - mx;
+        double dy = y[n] - my;
+        sxx += dx * dx;
+        sxy += dx * dy;
+        syy += dy * dy;
+      }
+    }
+    double angle = 0.5 * atan2(2.0 * sxy, sxx - syy);
+    double ux = cos(angle);
+    double uy = sin(angle);
+
+    // claim the inliers of the refit line and find how far it extends
+    double t_min = HUGE_VAL;
+    double t_max = -HUGE_VAL;
+    for (uint32_t n = 0; n < count; n++) {
+      double dx = x[n] - mx;
+      double dy = y[n] - my;
+      if (is_used[n] || (tolerance < fabs(dx * uy - dy * ux))) {
+        continue;
+      }
+
+      double t = dx * ux + dy * uy;
+      t_min = (t < t_min) ? t : t_min;
+      t_max = (t > t_max) ? t : t_max;
+      is_used[n] = 1;
+    }
+    if (t_min > t_max) {
+      break;
+    }
+
+    Line &line = result->lines[result->line_count++];
+    line.x0 = (mx + ux * t_min) * m_scale + m_mean_x;
+    line.y0 = (my + uy * t_min) * m_scale + m_mean_y;
+    line.x1 = (mx + ux * t_max) * m_scale + m_mean_x;
+    line.y1 = (my + uy * t_max) * m_scale + m_mean_y;
+    line.inliers = inliers;
+  }
+}
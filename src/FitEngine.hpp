@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_FIT_ENGINE_H
+#define JOESCAN_FIT_ENGINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace joescan {
+
+class WorkerPool;
+
+/**
+ * @brief Fits circles, ellipses and lines to whole frames as background
+ * tasks on a worker pool.
+ *
+ * Fits are RANSAC with a fixed number of iterations, followed by a least
+ * squares refit on the inliers of the best candidate, so the time a frame
+ * takes is bounded regardless of how noisy it is. Candidates are scored on
+ * an evenly spaced subset of the points. All buffers are allocated up
+ * front. Frames submitted while the previous one is still being fit are
+ * skipped rather than queued, so results never lag behind.
+ */
+class FitEngine {
+ public:
+  static const uint32_t kFitCircle = 0x1;
+  static const uint32_t kFitEllipse = 0x2;
+  static const uint32_t kFitLines = 0x4;
+
+  static const uint32_t kMaxLines = 4;
+  static const uint32_t kIterations = 64;
+  static const uint32_t kHistoryLen = 1024;
+
+  struct Line {
+    double x0;
+    double y0;
+    double x1;
+    double y1;
+    uint32_t inliers;
+  };
+
+  struct Result {
+    uint64_t frame;
+    int64_t encoder;
+    // seconds since the engine was created
+    double time_s;
+    double fit_time_ms;
+    uint32_t point_count;
+
+    bool is_circle_valid;
+    double circle_x;
+    double circle_y;
+    double circle_r;
+    uint32_t circle_inliers;
+
+    bool is_ellipse_valid;
+    double ellipse_x;
+    double ellipse_y;
+    // semi-axes, major axis angle from X in degrees
+    double ellipse_major;
+    double ellipse_minor;
+    double ellipse_angle_deg;
+    uint32_t ellipse_inliers;
+
+    uint32_t line_count;
+    Line lines[kMaxLines];
+  };
+
+  /**
+   * @param max_points Largest number of points a frame may have.
+   * @param pool Pool the fits run on; must outlive the engine.
+   */
+  FitEngine(uint32_t max_points, WorkerPool &pool);
+
+  /**
+   * @brief Waits for the frame being fit, if any.
+   */
+  ~FitEngine();
+
+  /**
+   * @brief Selects the shapes to fit, a combination of the `kFit` flags.
+   */
+  void SetShapes(uint32_t shapes);
+
+  /**
+   * @brief Sets how far a point may be from a shape and still count as
+   * one of its inliers, in inches.
+   */
+  void SetTolerance(double tolerance);
+
+  /**
+   * @brief Queues a frame to be fit. The points are copied.
+   *
+   * @return `false` if the previous frame is still being fit, in which case
+   * this frame is skipped.
+   */
+  bool Submit(const double *x, const double *y, uint32_t count,
+              int64_t encoder);
+
+  /**
+   * @brief Gets the most recent result.
+   *
+   * @return `false` if no frame has been fit yet.
+   */
+  bool GetResult(Result *result) const;
+
+  /**
+   * @brief Copies the most recent results, oldest first, for plotting.
+   */
+  void GetHistory(std::vector<Result> *history) const;
+
+  uint64_t GetFramesFit() const;
+  uint64_t GetFramesSkipped() const;
+
+  /**
+   * @return Bytes allocated for the points to fit and the history.
+   */
+  size_t GetMemoryUsage() const;
+
+ private:
+  void FitTask();
+  void Fit(Result *result);
+  void Normalize();
+  void FitCircle(Result *result);
+  void FitEllipse(Result *result);
+  void FitLines(Result *result);
+  uint32_t Random(uint32_t count);
+
+  WorkerPool &m_pool;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_is_pending;
+
+  // request, only touched by the fit task while pending
+  uint32_t m_shapes;
+  double m_tolerance;
+  int64_t m_encoder;
+  uint32_t m_count;
+  std::vector<double> m_x;
+  std::vector<double> m_y;
+
+  // workspace; points are centered and scaled to unit RMS radius before
+  // fitting to keep the normal equations well conditioned
+  std::vector<double> m_xn;
+  std::vector<double> m_yn;
+  std::vector<uint8_t> m_is_used;
+  double m_fit_tolerance;
+  double m_mean_x;
+  double m_mean_y;
+  double m_scale;
+  uint32_t m_stride;
+  uint32_t m_random;
+
+  Result m_result;
+  std::vector<Result> m_history;
+  uint64_t m_frames_fit;
+  uint64_t m_frames_skipped;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace joescan
+
+#endif
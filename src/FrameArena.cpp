@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "FrameArena.hpp"
+
+using namespace joescan;
+
+FrameArena::FrameArena(size_t capacity) :
+  m_block(NewBlock(capacity)),
+  m_capacity(capacity),
+  m_used(0),
+  m_frame_len(0),
+  m_high_water(0),
+  m_overflows(0)
+{
+  // enough room to list the overflow of a few frames without growing
+  m_overflow.reserve(64);
+}
+
+void *FrameArena::Allocate(size_t len, size_t align)
+{
+  const size_t offset = (m_used + align - 1) & ~(align - 1);
+  m_frame_len += offset - m_used + len;
+  if (m_frame_len > m_high_water) {
+    m_high_water = m_frame_len;
+  }
+
+  if (offset + len <= m_capacity) {
+    m_used = offset + len;
+    return (char *) m_block.get() + offset;
+  }
+
+  m_overflows++;
+  m_overflow.push_back(NewBlock(len));
+  return m_overflow.back().get();
+}
+
+void FrameArena::Reset()
+{
+  // grown with room to spare, so a frame slightly larger again doesn't
+  // overflow straight away
+  if (m_frame_len > m_capacity) {
+    m_capacity = m_frame_len + m_frame_len / 2;
+    m_block = NewBlock(m_capacity);
+  }
+
+  m_overflow.clear();
+  m_used = 0;
+  m_frame_len = 0;
+}
+
+FrameArena::Stats FrameArena::GetStats() const
+{
+  Stats stats;
+  stats.capacity = m_capacity;
+  stats.used = m_used;
+  stats.high_water = m_high_water;
+  stats.overflows = m_overflows;
+  return stats;
+}
+
+FrameArena::Block FrameArena::NewBlock(size_t len)
+{
+  const size_t count =
+    (len + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+  return Block(new std::max_align_t[(0 != count) ? count : 1]);
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_FRAME_ARENA_H
+#define JOESCAN_FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Scratch memory for the render thread that only lasts until the
+ * end of the frame.
+ *
+ * Allocating moves a pointer along a block allocated up front, and
+ * `Reset` at the start of every frame takes it all back at once. A frame
+ * that needs more than the block has gets the rest from the heap, and the
+ * block is grown at the next reset to what that frame needed, so once the
+ * largest frame has been seen frames allocate nothing from the heap.
+ *
+ * Nothing allocated is ever destructed, so only types that need no
+ * destructor should be put here. Not thread safe.
+ */
+class FrameArena {
+ public:
+  struct Stats {
+    size_t capacity;
+    // taken by the current frame so far
+    size_t used;
+    // most taken by any one frame
+    size_t high_water;
+    // allocations that didn't fit and came from the heap instead
+    uint64_t overflows;
+  };
+
+  explicit FrameArena(size_t capacity);
+
+  /**
+   * @brief Allocates memory that stays valid until the next `Reset`.
+   */
+  void *Allocate(size_t len, size_t align = alignof(std::max_align_t));
+
+  template <typename T>
+  T *AllocateArray(size_t count)
+  {
+    return (T *) Allocate(count * sizeof(T), alignof(T));
+  }
+
+  /**
+   * @brief Takes back everything allocated; called at the start of every
+   * frame.
+   */
+  void Reset();
+
+  Stats GetStats() const;
+
+ private:
+  typedef std::unique_ptr<std::max_align_t[]> Block;
+
+  static Block NewBlock(size_t len);
+
+  Block m_block;
+  size_t m_capacity;
+  size_t m_used;
+  // everything asked for this frame, whether it fitted or not
+  size_t m_frame_len;
+  size_t m_high_water;
+  std::vector<Block> m_overflow;
+  uint64_t m_overflows;
+};
+
+} // namespace joescan
+
+#endif
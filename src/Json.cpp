@@ -0,0 +1,280 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "Json.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace joescan {
+
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string &text) : m_text(text), m_pos(0) {}
+
+  JsonValue ParseDocument()
+  {
+    JsonValue value = ParseValue(0);
+    SkipSpace();
+    if (m_pos != m_text.size()) {
+      Fail("unexpected trailing characters");
+    }
+    return value;
+  }
+
+ private:
+  // guards against stack exhaustion on hostile input
+  static const int kMaxDepth = 64;
+
+  [[noreturn]] void Fail(const char *what)
+  {
+    throw std::runtime_error(std::string("JSON parse error at offset ") +
+                             std::to_string(m_pos) + ": " + what);
+  }
+
+  void SkipSpace()
+  {
+    while (m_pos < m_text.size()) {
+      char c = m_text[m_pos];
+      if ((' ' != c) && ('\t' != c) && ('\n' != c) && ('\r' != c)) {
+        break;
+      }
+      m_pos++;
+    }
+  }
+
+  void Expect(char c)
+  {
+    SkipSpace();
+    if ((m_pos >= m_text.size()) || (c != m_text[m_pos])) {
+      std::string what = std::string("expected '") + c + "'";
+      Fail(what.c_str());
+    }
+    m_pos++;
+  }
+
+  // separator between members or elements, anything else ends the list
+  bool ConsumeComma()
+  {
+    SkipSpace();
+    if ((m_pos < m_text.size()) && (',' == m_text[m_pos])) {
+      m_pos++;
+      return true;
+    }
+    return false;
+  }
+
+  bool Consume(const char *literal)
+  {
+    size_t len = std::char_traits<char>::length(literal);
+    if (0 == m_text.compare(m_pos, len, literal)) {
+      m_pos += len;
+      return true;
+    }
+    return false;
+  }
+
+  JsonValue ParseValue(int depth)
+  {
+    if (kMaxDepth < depth) {
+      Fail("nesting too deep");
+    }
+
+    SkipSpace();
+    if (m_pos >= m_text.size()) {
+      Fail("unexpected end of input");
+    }
+
+    JsonValue value;
+    char c = m_text[m_pos];
+    if ('{' == c) {
+      m_pos++;
+      value.m_type = JsonValue::kObject;
+      SkipSpace();
+      if ((m_pos < m_text.size()) && ('}' == m_text[m_pos])) {
+        m_pos++;
+        return value;
+      }
+      do {
+        SkipSpace();
+        std::string key = ParseString();
+        Expect(':');
+        value.m_object[key] = ParseValue(depth + 1);
+      } while (ConsumeComma());
+      Expect('}');
+    } else if ('[' == c) {
+      m_pos++;
+      value.m_type = JsonValue::kArray;
+      SkipSpace();
+      if ((m_pos < m_text.size()) && (']' == m_text[m_pos])) {
+        m_pos++;
+        return value;
+      }
+      do {
+        value.m_array.push_back(ParseValue(depth + 1));
+      } while (ConsumeComma());
+      Expect(']');
+    } else if ('"' == c) {
+      value.m_type = JsonValue::kString;
+      value.m_string = ParseString();
+    } else if (Consume("true")) {
+      value.m_type = JsonValue::kBool;
+      value.m_bool = true;
+    } else if (Consume("false")) {
+      value.m_type = JsonValue::kBool;
+      value.m_bool = false;
+    } else if (Consume("null")) {
+      value.m_type = JsonValue::kNull;
+    } else {
+      const char *begin = m_text.c_str() + m_pos;
+      char *end = nullptr;
+      value.m_type = JsonValue::kNumber;
+      value.m_number = strtod(begin, &end);
+      if (begin == end) {
+        Fail("invalid value");
+      }
+      m_pos += end - begin;
+    }
+
+    return value;
+  }
+
+  std::string ParseString()
+  {
+    if ((m_pos >= m_text.size()) || ('"' != m_text[m_pos])) {
+      Fail("expected string");
+    }
+    m_pos++;
+
+    std::string str;
+    while (m_pos < m_text.size()) {
+      char c = m_text[m_pos++];
+      if ('"' == c) {
+        return str;
+      } else if ('\\' != c) {
+        str += c;
+        continue;
+      }
+
+      if (m_pos >= m_text.size()) {
+        break;
+      }
+      c = m_text[m_pos++];
+      switch (c) {
+        case 'b': str += '\b'; break;
+        case 'f': str += '\f'; break;
+        case 'n': str += '\n'; break;
+        case 'r': str += '\r'; break;
+        case 't': str += '\t'; break;
+        case 'u': {
+          if (m_pos + 4 > m_text.size()) {
+            Fail("truncated escape");
+          }
+          // configuration files are ASCII; encode the code point as UTF-8
+          // without surrogate pair handling
+          unsigned long cp = strtoul(m_text.substr(m_pos, 4).c_str(),
+                                     nullptr, 16);
+          m_pos += 4;
+          if (0x80 > cp) {
+            str += (char) cp;
+          } else if (0x800 > cp) {
+            str += (char) (0xC0 | (cp >> 6));
+            str += (char) (0x80 | (cp & 0x3F));
+          } else {
+            str += (char) (0xE0 | (cp >> 12));
+            str += (char) (0x80 | ((cp >> 6) & 0x3F));
+            str += (char) (0x80 | (cp & 0x3F));
+          }
+          break;
+        }
+        default: str += c; break;
+      }
+    }
+
+    Fail("unterminated string");
+  }
+
+  const std::string &m_text;
+  size_t m_pos;
+};
+
+} // namespace joescan
+
+using namespace joescan;
+
+static const JsonValue kJsonNull;
+
+JsonValue::JsonValue() :
+  m_type(kNull),
+  m_bool(false),
+  m_number(0.0)
+{
+}
+
+JsonValue JsonValue::Parse(const std::string &text)
+{
+  JsonParser parser(text);
+  return parser.ParseDocument();
+}
+
+JsonValue JsonValue::ParseFile(const std::string &path)
+{
+  std::ifstream fstream(path);
+  if (!fstream) {
+    throw std::runtime_error("failed to open " + path);
+  }
+
+  std::stringstream ss;
+  ss << fstream.rdbuf();
+  return Parse(ss.str());
+}
+
+bool JsonValue::Has(const std::string &key) const
+{
+  return m_object.end() != m_object.find(key);
+}
+
+const JsonValue &JsonValue::operator[](const std::string &key) const
+{
+  auto iter = m_object.find(key);
+  return (m_object.end() == iter) ? kJsonNull : iter->second;
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const
+{
+  return (index < m_array.size()) ? m_array[index] : kJsonNull;
+}
+
+size_t JsonValue::Size() const
+{
+  return (kArray == m_type) ? m_array.size() : m_object.size();
+}
+
+double JsonValue::AsNumber() const
+{
+  if (kNumber != m_type) {
+    throw std::runtime_error("JSON value is not a number");
+  }
+  return m_number;
+}
+
+bool JsonValue::AsBool() const
+{
+  if (kBool != m_type) {
+    throw std::runtime_error("JSON value is not a boolean");
+  }
+  return m_bool;
+}
+
+const std::string &JsonValue::AsString() const
+{
+  if (kString != m_type) {
+    throw std::runtime_error("JSON value is not a string");
+  }
+  return m_string;
+}
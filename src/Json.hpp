@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_JSON_H
+#define JOESCAN_JSON_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Minimal JSON document model, enough to read configuration files
+ * without pulling in a third party library.
+ */
+class JsonValue {
+ public:
+  enum Type {
+    kNull,
+    kBool,
+    kNumber,
+    kString,
+    kArray,
+    kObject
+  };
+
+  JsonValue();
+
+  /**
+   * @brief Parses a JSON document.
+   *
+   * @param text The document.
+   * @return The root value.
+   * @throw std::runtime_error if the document is malformed.
+   */
+  static JsonValue Parse(const std::string &text);
+
+  /**
+   * @brief Reads and parses a JSON file.
+   *
+   * @throw std::runtime_error if the file can't be read or is malformed.
+   */
+  static JsonValue ParseFile(const std::string &path);
+
+  Type GetType() const { return m_type; }
+  bool IsNull() const { return kNull == m_type; }
+  bool IsNumber() const { return kNumber == m_type; }
+  bool IsString() const { return kString == m_type; }
+  bool IsArray() const { return kArray == m_type; }
+  bool IsObject() const { return kObject == m_type; }
+
+  /**
+   * @brief Checks if an object has a member.
+   */
+  bool Has(const std::string &key) const;
+
+  /**
+   * @brief Gets an object member; missing members read as null.
+   */
+  const JsonValue &operator[](const std::string &key) const;
+
+  /**
+   * @brief Gets an array element; out of range elements read as null.
+   */
+  const JsonValue &operator[](size_t index) const;
+
+  /**
+   * @brief Number of array elements or object members.
+   */
+  size_t Size() const;
+
+  /**
+   * @throw std::runtime_error if the value is not of the requested type.
+   */
+  double AsNumber() const;
+  bool AsBool() const;
+  const std::string &AsString() const;
+
+  const std::vector<JsonValue> &GetArray() const { return m_array; }
+
+ private:
+  friend class JsonParser;
+
+  Type m_type;
+  bool m_bool;
+  double m_number;
+  std::string m_string;
+  std::vector<JsonValue> m_array;
+  std::map<std::string, JsonValue> m_object;
+};
+
+} // namespace joescan
+
+#endif
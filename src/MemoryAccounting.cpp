@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "MemoryAccounting.hpp"
+#include "implot.h"
+#include "implot_internal.h"
+#include <cstdio>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+using namespace joescan;
+
+template <typename T>
+static uint64_t VectorBytes(const ImVector<T> &v)
+{
+  return (uint64_t) v.Capacity * sizeof(T);
+}
+
+template <typename T>
+static uint64_t PoolBytes(const ImPool<T> &pool)
+{
+  return VectorBytes(pool.Buf) + VectorBytes(pool.Map.Data);
+}
+
+static uint64_t ItemGroupBytes(const ImPlotItemGroup &items)
+{
+  return PoolBytes(items.ItemPool) +
+         VectorBytes(items.Legend.Indices) +
+         VectorBytes(items.Legend.Labels.Buf);
+}
+
+// Resident size from /proc, the figure the OS goes by when memory runs
+// short.
+static uint64_t ReadResidentBytes()
+{
+#if defined(__linux__)
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (nullptr == file) {
+    return 0;
+  }
+
+  unsigned long long pages = 0;
+  unsigned long long resident = 0;
+  int count = fscanf(file, "%llu %llu", &pages, &resident);
+  fclose(file);
+  return (2 == count) ? resident * (uint64_t) sysconf(_SC_PAGESIZE) : 0;
+#else
+  return 0;
+#endif
+}
+
+MemoryAccounting::MemoryAccounting() :
+  m_start_time(std::chrono::steady_clock::now()),
+  m_resident(ReadResidentBytes()),
+  m_resident_high_water(m_resident)
+{
+}
+
+uint32_t MemoryAccounting::AddRow(const char *name,
+                                  bool is_sized,
+                                  bool is_counted)
+{
+  Row row;
+  row.name = name;
+  row.is_sized = is_sized;
+  row.is_counted = is_counted;
+  row.bytes = 0;
+  row.high_water = 0;
+  row.allocations = 0;
+  row.bytes_per_s = 0.0;
+  row.allocations_per_s = 0.0;
+  m_rows.push_back(row);
+
+  Sample sample;
+  sample.bytes = 0;
+  sample.allocations = 0;
+  m_start.push_back(sample);
+
+  return (uint32_t) m_rows.size() - 1;
+}
+
+void MemoryAccounting::Set(uint32_t row, uint64_t bytes, uint64_t allocations)
+{
+  Row &r = m_rows[row];
+  r.bytes = bytes;
+  r.allocations = allocations;
+  if (bytes > r.high_water) {
+    r.high_water = bytes;
+  }
+}
+
+void MemoryAccounting::Update()
+{
+  auto now = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(now - m_start_time).count();
+  if (1.0 > seconds) {
+    return;
+  }
+
+  for (uint32_t n = 0; n < m_rows.size(); n++) {
+    Row &row = m_rows[n];
+    Sample &start = m_start[n];
+    row.bytes_per_s = ((double) row.bytes - (double) start.bytes) / seconds;
+    row.allocations_per_s =
+      (double) (row.allocations - start.allocations) / seconds;
+    start.bytes = row.bytes;
+    start.allocations = row.allocations;
+  }
+  m_start_time = now;
+
+  m_resident = ReadResidentBytes();
+  if (m_resident > m_resident_high_water) {
+    m_resident_high_water = m_resident;
+  }
+}
+
+uint64_t MemoryAccounting::GetImPlotBytes()
+{
+  const ImPlotContext *ctx = ImPlot::GetCurrentContext();
+  if (nullptr == ctx) {
+    return 0;
+  }
+
+  // every plot and subplot keeps the items drawn in it, with their legend;
+  // pools are gone through by their maps, which skip removed entries
+  uint64_t len = PoolBytes(ctx->Plots) + PoolBytes(ctx->Subplots);
+  for (int n = 0; n < ctx->Plots.Map.Data.Size; n++) {
+    int idx = ctx->Plots.Map.Data[n].val_i;
+    if (-1 != idx) {
+      const ImPlotPlot &plot = ctx->Plots.Buf[idx];
+      len += ItemGroupBytes(plot.Items) + VectorBytes(plot.TextBuffer.Buf);
+    }
+  }
+  for (int n = 0; n < ctx->Subplots.Map.Data.Size; n++) {
+    int idx = ctx->Subplots.Map.Data[n].val_i;
+    if (-1 != idx) {
+      len += ItemGroupBytes(ctx->Subplots.Buf[idx].Items);
+    }
+  }
+
+  const ImPlotColormapData &colormaps = ctx->ColormapData;
+  len += VectorBytes(colormaps.Keys) +
+         VectorBytes(colormaps.KeyCounts) +
+         VectorBytes(colormaps.KeyOffsets) +
+         VectorBytes(colormaps.Tables) +
+         VectorBytes(colormaps.TableSizes) +
+         VectorBytes(colormaps.TableOffsets) +
+         VectorBytes(colormaps.Text.Buf) +
+         VectorBytes(colormaps.TextOffsets) +
+         VectorBytes(colormaps.Quals) +
+         VectorBytes(colormaps.Map.Data);
+
+  return len;
+}
@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_MEMORY_ACCOUNTING_H
+#define JOESCAN_MEMORY_ACCOUNTING_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Memory taken by each subsystem of the viewer, along with the most
+ * it has ever taken and how fast it is changing, so a viewer left running
+ * can be shown not to grow without bound.
+ *
+ * Every subsystem is a row, measured by its owner once a frame: the bytes
+ * it has in use, a running count of its allocations, or both. Rates are
+ * worked out over the last whole second.
+ */
+class MemoryAccounting {
+ public:
+  struct Row {
+    const char *name;
+    bool is_sized;
+    bool is_counted;
+    uint64_t bytes;
+    uint64_t high_water;
+    uint64_t allocations;
+    // change over the last whole second
+    double bytes_per_s;
+    double allocations_per_s;
+  };
+
+  MemoryAccounting();
+
+  /**
+   * @param name Name of the subsystem, which has to outlive this.
+   * @param is_sized Whether the subsystem reports bytes in use.
+   * @param is_counted Whether it reports a running count of allocations.
+   * @return Index of the row.
+   */
+  uint32_t AddRow(const char *name, bool is_sized, bool is_counted);
+
+  void Set(uint32_t row, uint64_t bytes, uint64_t allocations = 0);
+
+  /**
+   * @brief Updates the rates, and the resident size of the process, once a
+   * second has passed since they were last updated; called once a frame
+   * after every row is set.
+   */
+  void Update();
+
+  const std::vector<Row> &GetRows() const { return m_rows; }
+
+  /**
+   * @return Memory of the process resident in RAM, or zero where that
+   * isn't known.
+   */
+  uint64_t GetResidentBytes() const { return m_resident; }
+  uint64_t GetResidentHighWater() const { return m_resident_high_water; }
+
+  /**
+   * @return Bytes taken by the plots, plot items and colormaps of the
+   * current ImPlot context.
+   */
+  static uint64_t GetImPlotBytes();
+
+ private:
+  struct Sample {
+    uint64_t bytes;
+    uint64_t allocations;
+  };
+
+  std::vector<Row> m_rows;
+  // rows as they were at the start of the current second
+  std::vector<Sample> m_start;
+  std::chrono::steady_clock::time_point m_start_time;
+  uint64_t m_resident;
+  uint64_t m_resident_high_water;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "MergedCloud.hpp"
+#include "WorkerPool.hpp"
+#include <cstring>
+
+using namespace joescan;
+
+MergedCloud::MergedCloud(uint32_t buffer_count) :
+  m_x(buffer_count * JS_PROFILE_DATA_LEN),
+  m_y(buffer_count * JS_PROFILE_DATA_LEN),
+  m_brightness(buffer_count * JS_PROFILE_DATA_LEN),
+  m_offsets(buffer_count + 1),
+  m_count(0)
+{
+}
+
+void MergedCloud::Merge(const std::vector<ProfileBuffer> &buffers,
+                        const std::vector<bool> &is_enabled,
+                        WorkerPool &pool)
+{
+  uint32_t count = (uint32_t) buffers.size();
+  if (count + 1 > m_offsets.size()) {
+    count = (uint32_t) m_offsets.size() - 1;
+  }
+
+  // exclusive prefix sum gives every buffer its own output range, so the
+  // copies below never touch the same memory
+  m_offsets[0] = 0;
+  for (uint32_t n = 0; n < count; n++) {
+    uint32_t len = (is_enabled[n]) ? buffers[n].data_len : 0;
+    m_offsets[n + 1] = m_offsets[n] + len;
+  }
+  m_count = m_offsets[count];
+
+  pool.ParallelFor(count, [&](uint32_t n) {
+    uint32_t offset = m_offsets[n];
+    uint32_t len = m_offsets[n + 1] - offset;
+    if (0 == len) {
+      return;
+    }
+
+    const ProfileBuffer &buffer = buffers[n];
+    memcpy(&m_x[offset], buffer.x, len * sizeof(double));
+    memcpy(&m_y[offset], buffer.y, len * sizeof(double));
+    memcpy(&m_brightness[offset], buffer.brightness, len);
+  });
+}
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_MERGED_CLOUD_H
+#define JOESCAN_MERGED_CLOUD_H
+
+#include "ProfileBuffer.hpp"
+#include <vector>
+
+namespace joescan {
+
+class WorkerPool;
+
+/**
+ * @brief Combines the latest profile of every scan head element into one
+ * point set, so a whole frame can be drawn as a single plot item.
+ *
+ * Storage is sized for the worst case up front and reused every frame.
+ */
+class MergedCloud {
+ public:
+  /**
+   * @param buffer_count Number of element buffers that may be merged.
+   */
+  explicit MergedCloud(uint32_t buffer_count);
+
+  /**
+   * @brief Merges the given buffers. Offsets of each buffer in the output
+   * are computed first, after which buffers are copied in parallel.
+   *
+   * @param buffers Element buffers, at most the count given on construction.
+   * @param is_enabled Per buffer flag, disabled buffers are left out.
+   * @param pool Workers to copy with.
+   */
+  void Merge(const std::vector<ProfileBuffer> &buffers,
+             const std::vector<bool> &is_enabled,
+             WorkerPool &pool);
+
+  const double *GetX() const { return m_x.data(); }
+  const double *GetY() const { return m_y.data(); }
+  const uint8_t *GetBrightness() const { return m_brightness.data(); }
+  uint32_t GetCount() const { return m_count; }
+
+ private:
+  std::vector<double> m_x;
+  std::vector<double> m_y;
+  std::vector<uint8_t> m_brightness;
+  std::vector<uint32_t> m_offsets;
+  uint32_t m_count;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "Metrics.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace joescan;
+
+// Formats a sample value the way Prometheus expects, with no more digits
+// than it takes to read back the same and its own spelling of infinity
+// and NaN.
+static void AppendValue(std::string *out, double value)
+{
+  if (std::isnan(value)) {
+    out->append("NaN");
+  } else if (std::isinf(value)) {
+    out->append((0.0 < value) ? "+Inf" : "-Inf");
+  } else {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.15g", value);
+    if (strtod(buf, nullptr) != value) {
+      snprintf(buf, sizeof(buf), "%.17g", value);
+    }
+    out->append(buf);
+  }
+}
+
+static void AppendSample(std::string *out,
+                         const std::string &name,
+                         const std::string &labels,
+                         const std::string &extra_label,
+                         double value)
+{
+  out->append(name);
+  if (!labels.empty() || !extra_label.empty()) {
+    out->push_back('{');
+    out->append(labels);
+    if (!labels.empty() && !extra_label.empty()) {
+      out->push_back(',');
+    }
+    out->append(extra_label);
+    out->push_back('}');
+  }
+  out->push_back(' ');
+  AppendValue(out, value);
+  out->push_back('\n');
+}
+
+Metrics::Histogram::Histogram(const std::vector<double> &bounds) :
+  m_bounds(bounds),
+  m_buckets(new std::atomic<uint64_t>[bounds.size() + 1]),
+  m_sum(0.0)
+{
+  for (size_t n = 0; n <= m_bounds.size(); n++) {
+    m_buckets[n] = 0;
+  }
+}
+
+void Metrics::Histogram::Observe(double value)
+{
+  // bounds are few, a linear search beats anything cleverer
+  size_t n = 0;
+  while ((n < m_bounds.size()) && (value > m_bounds[n])) {
+    n++;
+  }
+  m_buckets[n].fetch_add(1, std::memory_order_relaxed);
+
+  double sum = m_sum.load(std::memory_order_relaxed);
+  while (!m_sum.compare_exchange_weak(sum, sum + value,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+void Metrics::Histogram::GetCounts(std::vector<uint64_t> *counts) const
+{
+  counts->resize(m_bounds.size() + 1);
+  uint64_t total = 0;
+  for (size_t n = 0; n <= m_bounds.size(); n++) {
+    total += m_buckets[n].load(std::memory_order_relaxed);
+    (*counts)[n] = total;
+  }
+}
+
+Metrics::Counter *Metrics::AddCounter(const std::string &name,
+                                      const std::string &help,
+                                      const std::string &labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Series &series = *AddSeries(name, help, kTypeCounter, labels);
+  series.counter.reset(new Counter);
+  return series.counter.get();
+}
+
+Metrics::Gauge *Metrics::AddGauge(const std::string &name,
+                                  const std::string &help,
+                                  const std::string &labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Series &series = *AddSeries(name, help, kTypeGauge, labels);
+  series.gauge.reset(new Gauge);
+  return series.gauge.get();
+}
+
+Metrics::Histogram *Metrics::AddHistogram(const std::string &name,
+                                          const std::string &help,
+                                          const std::vector<double> &bounds,
+                                          const std::string &labels)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Series &series = *AddSeries(name, help, kTypeHistogram, labels);
+  series.histogram.reset(new Histogram(bounds));
+  return series.histogram.get();
+}
+
+std::string Metrics::Label(const std::string &key, const std::string &value)
+{
+  std::string label = key + "=\"";
+  for (char c : value) {
+    if ('\n' == c) {
+      label += "\\n";
+    } else {
+      if (('"' == c) || ('\\' == c)) {
+        label += '\\';
+      }
+      label += c;
+    }
+  }
+  label += '"';
+
+  return label;
+}
+
+std::vector<double> Metrics::ExponentialBounds(double start,
+                                               double factor,
+                                               uint32_t count)
+{
+  std::vector<double> bounds(count);
+  for (uint32_t n = 0; n < count; n++) {
+    bounds[n] = start;
+    start *= factor;
+  }
+
+  return bounds;
+}
+
+void Metrics::Render(std::string *out) const
+{
+  out->clear();
+  std::vector<uint64_t> counts;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &f : m_families) {
+    const Family &family = *f;
+    const char *type = (kTypeCounter == family.type) ? "counter" :
+                       (kTypeGauge == family.type) ? "gauge" :
+                       "histogram";
+    out->append("# HELP " + family.name + " " + family.help + "\n");
+    out->append("# TYPE " + family.name + " " + type + "\n");
+
+    for (auto &series : family.series) {
+      if (series.counter) {
+        AppendSample(out, family.name, series.labels, "",
+                     (double) series.counter->Get());
+      } else if (series.gauge) {
+        AppendSample(out, family.name, series.labels, "",
+                     series.gauge->Get());
+      } else {
+        // buckets are cumulative, ending with one for every value
+        const Histogram &histogram = *series.histogram;
+        const std::vector<double> &bounds = histogram.GetBounds();
+        histogram.GetCounts(&counts);
+        for (size_t n = 0; n <= bounds.size(); n++) {
+          std::string le = "+Inf";
+          if (n < bounds.size()) {
+            le.clear();
+            AppendValue(&le, bounds[n]);
+          }
+          AppendSample(out, family.name + "_bucket", series.labels,
+                       Label("le", le), (double) counts[n]);
+        }
+        AppendSample(out, family.name + "_sum", series.labels, "",
+                     histogram.GetSum());
+        AppendSample(out, family.name + "_count", series.labels, "",
+                     (double) counts.back());
+      }
+    }
+  }
+}
+
+Metrics::Series *Metrics::AddSeries(const std::string &name,
+                                    const std::string &help,
+                                    Type type,
+                                    const std::string &labels)
+{
+  Family *family = nullptr;
+  for (auto &f : m_families) {
+    if (name == f->name) {
+      family = f.get();
+      break;
+    }
+  }
+
+  if (nullptr == family) {
+    std::unique_ptr<Family> f(new Family);
+    f->name = name;
+    f->help = help;
+    f->type = type;
+    family = f.get();
+    m_families.push_back(std::move(f));
+  } else if (type != family->type) {
+    throw std::runtime_error("metric " + name + " added as another type");
+  }
+
+  family->series.emplace_back();
+  family->series.back().labels = labels;
+  return &family->series.back();
+}
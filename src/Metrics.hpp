@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_METRICS_H
+#define JOESCAN_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Counters, gauges and histograms of how the program is doing,
+ * rendered in the Prometheus text exposition format for monitoring to
+ * scrape.
+ *
+ * Metrics are added up front and kept for the life of the registry, so the
+ * pointers handed out stay valid. Their values are atomics: updating one
+ * takes no lock and never allocates, and they can be rendered on another
+ * thread while being updated.
+ */
+class Metrics {
+ public:
+  /**
+   * @brief Total that only ever goes up, such as profiles received.
+   */
+  class Counter {
+   public:
+    Counter() : m_value(0) {}
+
+    void Add(uint64_t n = 1)
+    {
+      m_value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Sets the total outright, for totals kept elsewhere.
+     */
+    void Set(uint64_t total)
+    {
+      m_value.store(total, std::memory_order_relaxed);
+    }
+
+    uint64_t Get() const { return m_value.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<uint64_t> m_value;
+  };
+
+  /**
+   * @brief Value that goes up and down, such as the depth of a queue.
+   */
+  class Gauge {
+   public:
+    Gauge() : m_value(0.0) {}
+
+    void Set(double value)
+    {
+      m_value.store(value, std::memory_order_relaxed);
+    }
+
+    double Get() const { return m_value.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<double> m_value;
+  };
+
+  /**
+   * @brief Distribution of values, such as frame times, counted into
+   * buckets by upper bound.
+   */
+  class Histogram {
+   public:
+    explicit Histogram(const std::vector<double> &bounds);
+
+    void Observe(double value);
+
+    const std::vector<double> &GetBounds() const { return m_bounds; }
+
+    /**
+     * @brief Gets the number of values observed up to each bound, followed
+     * by the number of every value observed.
+     */
+    void GetCounts(std::vector<uint64_t> *counts) const;
+    double GetSum() const { return m_sum.load(std::memory_order_relaxed); }
+
+   private:
+    std::vector<double> m_bounds;
+    // values in each bucket alone, the last one past every bound
+    std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+    std::atomic<double> m_sum;
+  };
+
+  /**
+   * @param name Name of the metric; a counter's ends in `_total`.
+   * @param help Description shown along with it.
+   * @param labels Labels telling this one apart from others of the same
+   * name, as made by `Label`; all of the same name must share their type
+   * and help.
+   * @return The metric, owned by the registry.
+   */
+  Counter *AddCounter(const std::string &name,
+                      const std::string &help,
+                      const std::string &labels = "");
+  Gauge *AddGauge(const std::string &name,
+                  const std::string &help,
+                  const std::string &labels = "");
+  Histogram *AddHistogram(const std::string &name,
+                          const std::string &help,
+                          const std::vector<double> &bounds,
+                          const std::string &labels = "");
+
+  /**
+   * @brief Formats a label, `key="value"`, escaping the value; labels are
+   * joined with commas.
+   */
+  static std::string Label(const std::string &key, const std::string &value);
+
+  /**
+   * @return `count` bucket bounds, the first `start` and each `factor`
+   * times the one before.
+   */
+  static std::vector<double> ExponentialBounds(double start,
+                                               double factor,
+                                               uint32_t count);
+
+  /**
+   * @brief Renders every metric in the Prometheus text format; may be
+   * called from any thread.
+   */
+  void Render(std::string *out) const;
+
+ private:
+  enum Type {
+    kTypeCounter,
+    kTypeGauge,
+    kTypeHistogram
+  };
+
+  struct Series {
+    std::string labels;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  struct Family {
+    std::string name;
+    std::string help;
+    Type type;
+    std::vector<Series> series;
+  };
+
+  // called with `m_mutex` held
+  Series *AddSeries(const std::string &name,
+                    const std::string &help,
+                    Type type,
+                    const std::string &labels);
+
+  // guards the families themselves, not the values
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<Family>> m_families;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "MetricsServer.hpp"
+#include "ProfileProtocol.hpp"
+#include "Trace.hpp"
+
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+using namespace joescan;
+
+// how long the server thread waits for a scraper before checking whether
+// it has been asked to stop
+static const int kPollTimeoutMs = 100;
+// the most of a request read before giving up on it
+static const size_t kMaxRequestLen = 8192;
+
+MetricsServer::MetricsServer(const std::string &address,
+                             const Metrics &metrics) :
+  m_address(address),
+  m_listen_fd(-1),
+  m_metrics(metrics),
+  m_is_running(true),
+  m_scrapes(0)
+{
+  // metrics are for the machine itself unless a host says otherwise
+  if ((std::string::npos == address.find(':')) &&
+      (std::string::npos == address.find('/'))) {
+    m_address = "127.0.0.1:" + address;
+  }
+
+  m_listen_fd = OpenListenSocket(m_address, &m_unix_path);
+  m_thread = std::thread(&MetricsServer::ServerThread, this);
+}
+
+#if defined(_WIN32)
+
+MetricsServer::~MetricsServer()
+{
+}
+
+void MetricsServer::ServerThread() {}
+void MetricsServer::Serve(int fd) {}
+
+#else
+
+MetricsServer::~MetricsServer()
+{
+  m_is_running = false;
+  m_thread.join();
+
+  CloseSocket(m_listen_fd);
+  if (!m_unix_path.empty()) {
+    unlink(m_unix_path.c_str());
+  }
+}
+
+void MetricsServer::Serve(int fd)
+{
+  timeval timeout;
+  timeout.tv_sec = 1;
+  timeout.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  // only the request line matters, but the headers are read through so
+  // the scraper isn't cut off while still sending them
+  char buf[1024];
+  m_request.clear();
+  while ((std::string::npos == m_request.find("\r\n\r\n")) &&
+         (kMaxRequestLen > m_request.size())) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (0 >= n) {
+      return;
+    }
+    m_request.append(buf, n);
+  }
+
+  const char *status = "200 OK";
+  const char *type = "text/plain; version=0.0.4; charset=utf-8";
+  if (0 != m_request.compare(0, 4, "GET ")) {
+    status = "405 Method Not Allowed";
+    m_body = "only GET is supported\n";
+  } else if ((0 == m_request.compare(4, 9, "/metrics ")) ||
+             (0 == m_request.compare(4, 9, "/metrics?"))) {
+    TraceSpan span("Render Metrics");
+    m_metrics.Render(&m_body);
+    m_scrapes++;
+  } else {
+    status = "404 Not Found";
+    m_body = "metrics are served from /metrics\n";
+  }
+
+  m_response = "HTTP/1.1 ";
+  m_response += status;
+  m_response += "\r\nContent-Type: ";
+  m_response += type;
+  m_response += "\r\nContent-Length: " + std::to_string(m_body.size());
+  m_response += "\r\nConnection: close\r\n\r\n";
+  m_response += m_body;
+
+  size_t sent = 0;
+  while (sent < m_response.size()) {
+    ssize_t n = send(fd, m_response.data() + sent, m_response.size() - sent,
+                     MSG_NOSIGNAL);
+    if (0 >= n) {
+      return;
+    }
+    sent += n;
+  }
+}
+
+void MetricsServer::ServerThread()
+{
+  Trace::SetThreadName("Metrics");
+  while (m_is_running) {
+    pollfd fd;
+    fd.fd = m_listen_fd;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    if ((0 >= poll(&fd, 1, kPollTimeoutMs)) || (0 == (fd.revents & POLLIN))) {
+      continue;
+    }
+
+    int client = accept(m_listen_fd, nullptr, nullptr);
+    if (0 > client) {
+      continue;
+    }
+    Serve(client);
+    CloseSocket(client);
+  }
+}
+
+#endif
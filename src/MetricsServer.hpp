@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_METRICS_SERVER_H
+#define JOESCAN_METRICS_SERVER_H
+
+#include "Metrics.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace joescan {
+
+/**
+ * @brief Serves metrics over HTTP for Prometheus, or anything else that
+ * scrapes its text format, to fetch from `/metrics`.
+ *
+ * The server runs on a thread of its own and only reads the metrics, so
+ * being scraped takes nothing from acquisition or rendering. It answers
+ * one request at a time and closes the connection after each; a scraper
+ * that stalls is given up on after a second.
+ */
+class MetricsServer {
+ public:
+  /**
+   * @brief Starts listening and the server thread.
+   *
+   * @param address Address as for `OpenListenSocket`, except that a port
+   * alone listens on the loopback interface only.
+   * @param metrics Metrics to serve, which have to outlive the server.
+   * @throw std::runtime_error if the address can't be listened on.
+   */
+  MetricsServer(const std::string &address, const Metrics &metrics);
+
+  /**
+   * @brief Stops the server thread.
+   */
+  ~MetricsServer();
+
+  const std::string &GetAddress() const { return m_address; }
+  uint64_t GetScrapes() const { return m_scrapes; }
+
+ private:
+  void ServerThread();
+  void Serve(int fd);
+
+  std::string m_address;
+  std::string m_unix_path;
+  int m_listen_fd;
+  const Metrics &m_metrics;
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+  std::atomic<uint64_t> m_scrapes;
+
+  // only touched by the server thread
+  std::string m_request;
+  std::string m_body;
+  std::string m_response;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "PluginHost.hpp"
+#include "Trace.hpp"
+#include "WorkerPool.hpp"
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using namespace joescan;
+
+static void *OpenLibrary(const std::string &path, std::string *error)
+{
+#if defined(_WIN32)
+  void *library = (void *) LoadLibraryA(path.c_str());
+  if (nullptr == library) {
+    *error = "LoadLibrary failed with " + std::to_string(GetLastError());
+  }
+#else
+  void *library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (nullptr == library) {
+    *error = dlerror();
+  }
+#endif
+  return library;
+}
+
+static void *FindSymbol(void *library, const char *name)
+{
+#if defined(_WIN32)
+  return (void *) GetProcAddress((HMODULE) library, name);
+#else
+  return dlsym(library, name);
+#endif
+}
+
+static void CloseLibrary(void *library)
+{
+#if defined(_WIN32)
+  FreeLibrary((HMODULE) library);
+#else
+  dlclose(library);
+#endif
+}
+
+PluginHost::PluginHost() :
+  m_running(0),
+  m_batch(),
+  m_batches_skipped(0)
+{
+}
+
+PluginHost::~PluginHost()
+{
+  while (0 != m_running) {
+    std::this_thread::yield();
+  }
+
+  for (auto &plugin : m_plugins) {
+    if (nullptr != plugin->api->destroy) {
+      plugin->api->destroy(plugin->ctx);
+    }
+    CloseLibrary(plugin->library);
+  }
+}
+
+void PluginHost::Load(const std::string &path)
+{
+  std::string error;
+  void *library = OpenLibrary(path, &error);
+  if (nullptr == library) {
+    throw std::runtime_error(path + ": " + error);
+  }
+
+  jsPluginEntryFn entry =
+    (jsPluginEntryFn) FindSymbol(library, JS_PLUGIN_ENTRY_NAME);
+  const jsPluginInterface *api =
+    (nullptr == entry) ? nullptr : entry(JS_PLUGIN_API_VERSION);
+  if ((nullptr == api) || (JS_PLUGIN_API_VERSION != api->api_version) ||
+      (nullptr == api->process)) {
+    CloseLibrary(library);
+    throw std::runtime_error(path + ": not a compatible plugin");
+  }
+
+  std::unique_ptr<Plugin> plugin(new Plugin);
+  plugin->library = library;
+  plugin->api = api;
+  plugin->ctx = (nullptr != api->create) ? api->create() : nullptr;
+  for (uint32_t n = 0; n < 2; n++) {
+    plugin->primitives[n].resize(kMaxPrimitives);
+    plugin->metrics[n].resize(kMaxMetrics);
+  }
+  plugin->num_primitives = 0;
+  plugin->num_metrics = 0;
+  plugin->sit_out = 0;
+  plugin->seconds = nullptr;
+  plugin->overruns = nullptr;
+  plugin->stats.name = (nullptr != api->name) ? api->name : path;
+  plugin->stats.budget_us =
+    (0 != api->budget_us) ? api->budget_us : kDefaultBudgetUs;
+  plugin->stats.calls = 0;
+  plugin->stats.overruns = 0;
+  plugin->stats.skipped = 0;
+  plugin->stats.last_us = 0.0;
+  plugin->stats.mean_us = 0.0;
+  plugin->stats.max_us = 0.0;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_plugins.push_back(std::move(plugin));
+  m_run.reserve(m_plugins.size());
+}
+
+void PluginHost::AddMetrics(Metrics *metrics)
+{
+  // buckets from 100 uS to about 0.8 S
+  const std::vector<double> bounds =
+    Metrics::ExponentialBounds(0.0001, 2.0, 14);
+  for (auto &plugin : m_plugins) {
+    std::string labels = Metrics::Label("plugin", plugin->stats.name);
+    plugin->seconds =
+      metrics->AddHistogram("profile_view_plugin_seconds",
+                            "Time plugins took to process a batch.",
+                            bounds,
+                            labels);
+    plugin->overruns =
+      metrics->AddCounter("profile_view_plugin_overruns_total",
+                          "Batches plugins took longer than their budget on.",
+                          labels);
+  }
+}
+
+uint32_t PluginHost::GetPluginCount() const
+{
+  return (uint32_t) m_plugins.size();
+}
+
+bool PluginHost::IsBusy() const
+{
+  return 0 != m_running;
+}
+
+bool PluginHost::Run(const jsPluginBatch &batch, WorkerPool &pool)
+{
+  if (0 != m_running) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_batches_skipped++;
+    return false;
+  }
+
+  // workers are all idle here, so the batch and the sit out counts are
+  // free to change
+  m_batch = batch;
+  m_run.clear();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (uint32_t n = 0; n < m_plugins.size(); n++) {
+      Plugin &plugin = *m_plugins[n];
+      if (0 != plugin.sit_out) {
+        plugin.sit_out--;
+        plugin.stats.skipped++;
+      } else {
+        m_run.push_back(n);
+      }
+    }
+  }
+
+  m_running = (uint32_t) m_run.size();
+  for (auto n : m_run) {
+    pool.Submit([this, n] { Process(n); });
+  }
+
+  return true;
+}
+
+void PluginHost::Process(uint32_t index)
+{
+  Plugin &plugin = *m_plugins[index];
+  jsPluginOutput output;
+  output.primitives = plugin.primitives[1].data();
+  output.max_primitives = kMaxPrimitives;
+  output.num_primitives = 0;
+  output.metrics = plugin.metrics[1].data();
+  output.max_metrics = kMaxMetrics;
+  output.num_metrics = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    TraceSpan span("Plugin");
+    plugin.api->process(plugin.ctx, &m_batch, &output);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double us = std::chrono::duration<double, std::micro>(end - start).count();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::swap(plugin.primitives[0], plugin.primitives[1]);
+    std::swap(plugin.metrics[0], plugin.metrics[1]);
+    plugin.num_primitives = (kMaxPrimitives < output.num_primitives) ?
+                            kMaxPrimitives : output.num_primitives;
+    plugin.num_metrics = (kMaxMetrics < output.num_metrics) ?
+                         kMaxMetrics : output.num_metrics;
+
+    Stats &stats = plugin.stats;
+    stats.calls++;
+    stats.last_us = us;
+    stats.mean_us = (1 == stats.calls) ? us : 0.9 * stats.mean_us + 0.1 * us;
+    stats.max_us = (us > stats.max_us) ? us : stats.max_us;
+    if (us > stats.budget_us) {
+      stats.overruns++;
+      plugin.sit_out = (uint32_t) ceil(us / stats.budget_us) - 1;
+      if (nullptr != plugin.overruns) {
+        plugin.overruns->Add();
+      }
+    }
+  }
+  if (nullptr != plugin.seconds) {
+    plugin.seconds->Observe(us / 1.0e6);
+  }
+
+  m_running--;
+}
+
+void PluginHost::GetOutput(uint32_t index,
+                           std::vector<jsPluginPrimitive> *primitives,
+                           std::vector<jsPluginMetric> *metrics) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const Plugin &plugin = *m_plugins[index];
+  primitives->assign(plugin.primitives[0].begin(),
+                     plugin.primitives[0].begin() + plugin.num_primitives);
+  metrics->assign(plugin.metrics[0].begin(),
+                  plugin.metrics[0].begin() + plugin.num_metrics);
+  for (auto &metric : *metrics) {
+    metric.name[JS_PLUGIN_METRIC_NAME_LEN - 1] = '\0';
+  }
+}
+
+PluginHost::Stats PluginHost::GetStats(uint32_t index) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_plugins[index]->stats;
+}
+
+uint64_t PluginHost::GetBatchesSkipped() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_batches_skipped;
+}
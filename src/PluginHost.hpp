@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PLUGIN_HOST_H
+#define JOESCAN_PLUGIN_HOST_H
+
+#include "joescan_profile_plugin.h"
+#include "Metrics.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace joescan {
+
+class WorkerPool;
+
+/**
+ * @brief Loads processing plugins and runs them on batches of profiles.
+ *
+ * Every plugin of a batch runs as its own task on a worker pool, so the
+ * render thread never waits on them. A new batch is only taken once all
+ * plugins are done with the previous one, which is what lets plugins read
+ * the caller's buffers without copies. Calls are timed; a plugin that
+ * runs over its budget sits out as many batches as it ran over by.
+ */
+class PluginHost {
+ public:
+  static const uint32_t kMaxPrimitives = 4096;
+  static const uint32_t kMaxMetrics = 64;
+  static const uint32_t kDefaultBudgetUs = 5000;
+
+  struct Stats {
+    std::string name;
+    uint32_t budget_us;
+    uint64_t calls;
+    uint64_t overruns;
+    uint64_t skipped;
+    double last_us;
+    double mean_us;
+    double max_us;
+  };
+
+  PluginHost();
+
+  /**
+   * @brief Waits for running plugins, then unloads all of them.
+   */
+  ~PluginHost();
+
+  /**
+   * @brief Loads a plugin library and creates its state.
+   *
+   * @throw std::runtime_error if the library can't be loaded or isn't a
+   * compatible plugin.
+   */
+  void Load(const std::string &path);
+
+  uint32_t GetPluginCount() const;
+
+  /**
+   * @return `true` while plugins are still working on a batch; the
+   * batch's buffers must not be touched until this returns `false`.
+   */
+  bool IsBusy() const;
+
+  /**
+   * @brief Starts running all plugins on a batch.
+   *
+   * @return `false` if still busy with the previous batch, in which case
+   * this one is skipped.
+   */
+  bool Run(const jsPluginBatch &batch, WorkerPool &pool);
+
+  /**
+   * @brief Copies a plugin's results from the last batch it processed.
+   */
+  void GetOutput(uint32_t index,
+                 std::vector<jsPluginPrimitive> *primitives,
+                 std::vector<jsPluginMetric> *metrics) const;
+
+  Stats GetStats(uint32_t index) const;
+
+  /**
+   * @brief Has every plugin loaded so far report how long its calls take,
+   * and how often it runs over budget, to metrics; must be called before
+   * the first batch is run.
+   */
+  void AddMetrics(Metrics *metrics);
+
+  uint64_t GetBatchesSkipped() const;
+
+ private:
+  struct Plugin {
+    void *library;
+    const jsPluginInterface *api;
+    void *ctx;
+    // written by the plugin, then swapped with the results shown
+    std::vector<jsPluginPrimitive> primitives[2];
+    std::vector<jsPluginMetric> metrics[2];
+    uint32_t num_primitives;
+    uint32_t num_metrics;
+    uint32_t sit_out;
+    Stats stats;
+    Metrics::Histogram *seconds;
+    Metrics::Counter *overruns;
+  };
+
+  void Process(uint32_t index);
+
+  std::vector<std::unique_ptr<Plugin>> m_plugins;
+  mutable std::mutex m_mutex;
+  std::atomic<uint32_t> m_running;
+  jsPluginBatch m_batch;
+  // plugins taking part in the current batch, kept to save allocating it
+  // every batch
+  std::vector<uint32_t> m_run;
+  uint64_t m_batches_skipped;
+};
+
+} // namespace joescan
+
+#endif
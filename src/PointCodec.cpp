@@ -0,0 +1,243 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "PointCodec.hpp"
+#include <cstring>
+
+// the SSSE3 decoder is compiled in on any x86 build and picked at run time,
+// so the build needs no extra flags
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define JOESCAN_POINT_CODEC_SSSE3
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define JOESCAN_TARGET_SSSE3
+#else
+#define JOESCAN_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+using namespace joescan;
+
+static_assert(3 * sizeof(int32_t) == sizeof(jsProfileData),
+              "points are decoded as three packed 32-bit values");
+
+static const uint32_t kChunkHeaderLen = 8;
+
+static uint32_t ZigZag(uint32_t delta)
+{
+  return (delta << 1) ^ (uint32_t) ((int32_t) delta >> 31);
+}
+
+static uint32_t UnZigZag(uint32_t v)
+{
+  return (v >> 1) ^ (0u - (v & 1));
+}
+
+static uint32_t ReadLe32(const uint8_t *p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void WriteLe32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+
+void joescan::EncodePointChunk(const jsProfileData *points,
+                               uint32_t count,
+                               std::vector<uint8_t> *out)
+{
+  const uint32_t value_count = 3 * count;
+  const uint32_t control_len = (value_count + 3) / 4;
+  const size_t start = out->size();
+
+  // sized for the worst case of four bytes a value, trimmed at the end;
+  // every value is written as four bytes and only its length kept
+  out->resize(start + kChunkHeaderLen + control_len + 4 * value_count);
+  uint8_t *control = out->data() + start + kChunkHeaderLen;
+  uint8_t *values = control + control_len;
+  uint8_t *p = values;
+  memset(control, 0, control_len);
+
+  uint32_t prev[3] = { 0, 0, 0 };
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const uint32_t point[3] = { (uint32_t) points[i].x,
+                                (uint32_t) points[i].y,
+                                (uint32_t) points[i].brightness };
+    for (uint32_t k = 0; k < 3; k++, n++) {
+      uint32_t z = ZigZag(point[k] - prev[k]);
+      prev[k] = point[k];
+
+      uint32_t len = (z < (1u << 8)) ? 1 :
+                     (z < (1u << 16)) ? 2 :
+                     (z < (1u << 24)) ? 3 : 4;
+      control[n >> 2] |= (uint8_t) ((len - 1) << (2 * (n & 3)));
+      WriteLe32(p, z);
+      p += len;
+    }
+  }
+
+  uint32_t values_len = (uint32_t) (p - values);
+  WriteLe32(out->data() + start, count);
+  WriteLe32(out->data() + start + 4, values_len);
+  out->resize(start + kChunkHeaderLen + control_len + values_len);
+}
+
+uint32_t joescan::GetPointChunkCount(const uint8_t *data, size_t len)
+{
+  return (kChunkHeaderLen > len) ? 0 : ReadLe32(data);
+}
+
+#if defined(JOESCAN_POINT_CODEC_SSSE3)
+
+// for every control byte, the shuffle spreading its group's value bytes
+// into four 32-bit lanes, and how many bytes the group takes
+struct GroupTables {
+  uint8_t shuffle[256][16];
+  uint8_t length[256];
+
+  GroupTables()
+  {
+    for (uint32_t c = 0; c < 256; c++) {
+      uint8_t offset = 0;
+      for (uint32_t k = 0; k < 4; k++) {
+        uint32_t len = ((c >> (2 * k)) & 3) + 1;
+        for (uint32_t b = 0; b < 4; b++) {
+          // a set high bit makes the shuffle write a zero
+          shuffle[c][4 * k + b] = (b < len) ? (uint8_t) (offset + b) : 0x80;
+        }
+        offset += (uint8_t) len;
+      }
+      length[c] = offset;
+    }
+  }
+};
+
+/**
+ * Decodes whole groups for as long as a full 16 byte load stays within the
+ * value bytes, leaving the rest to the scalar decoder.
+ */
+JOESCAN_TARGET_SSSE3
+static uint32_t DecodeGroupsSsse3(const uint8_t *control,
+                                  const uint8_t **p,
+                                  const uint8_t *end,
+                                  int32_t *out,
+                                  uint32_t value_count)
+{
+  static const GroupTables tables;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi32(1);
+  const uint8_t *q = *p;
+  uint32_t n = 0;
+
+  for (; (n + 4 <= value_count) && (16 <= end - q); n += 4) {
+    uint8_t c = control[n >> 2];
+    __m128i bytes = _mm_loadu_si128((const __m128i *) q);
+    __m128i mask = _mm_loadu_si128((const __m128i *) tables.shuffle[c]);
+    __m128i v = _mm_shuffle_epi8(bytes, mask);
+    __m128i d = _mm_xor_si128(_mm_srli_epi32(v, 1),
+                              _mm_sub_epi32(zero, _mm_and_si128(v, one)));
+    _mm_storeu_si128((__m128i *) (out + n), d);
+    q += tables.length[c];
+  }
+
+  *p = q;
+  return n;
+}
+
+#endif
+
+bool joescan::HasPointCodecSimd()
+{
+#if !defined(JOESCAN_POINT_CODEC_SSSE3)
+  return false;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return 0 != (info[2] & (1 << 9));
+#else
+  static const bool is_supported = __builtin_cpu_supports("ssse3");
+  return is_supported;
+#endif
+}
+
+size_t joescan::DecodePointChunk(const uint8_t *data,
+                                 size_t len,
+                                 jsProfileData *points,
+                                 uint32_t capacity,
+                                 bool is_simd_allowed)
+{
+  if (kChunkHeaderLen > len) {
+    return 0;
+  }
+
+  const uint32_t count = ReadLe32(data);
+  const uint32_t values_len = ReadLe32(data + 4);
+  if (capacity < count) {
+    return 0;
+  }
+
+  const uint32_t value_count = 3 * count;
+  const uint32_t control_len = (value_count + 3) / 4;
+  const uint64_t chunk_len =
+    (uint64_t) kChunkHeaderLen + control_len + values_len;
+  if (len < chunk_len) {
+    return 0;
+  }
+
+  const uint8_t *control = data + kChunkHeaderLen;
+  const uint8_t *p = control + control_len;
+  const uint8_t *end = p + values_len;
+  int32_t *out = (int32_t *) points;
+  uint32_t n = 0;
+
+#if defined(JOESCAN_POINT_CODEC_SSSE3)
+  if (is_simd_allowed && HasPointCodecSimd()) {
+    n = DecodeGroupsSsse3(control, &p, end, out, value_count);
+  }
+#endif
+
+  for (; n < value_count; n++) {
+    uint32_t value_len = ((control[n >> 2] >> (2 * (n & 3))) & 3) + 1;
+    if ((size_t) (end - p) < value_len) {
+      return 0;
+    }
+
+    uint32_t z = 0;
+    for (uint32_t b = 0; b < value_len; b++) {
+      z |= (uint32_t) p[b] << (8 * b);
+    }
+    p += value_len;
+    out[n] = (int32_t) UnZigZag(z);
+  }
+
+  if (end != p) {
+    return 0;
+  }
+
+  // differences back to values, each of X, Y and brightness on its own
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t brightness = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    x += (uint32_t) points[i].x;
+    y += (uint32_t) points[i].y;
+    brightness += (uint32_t) points[i].brightness;
+    points[i].x = (int32_t) x;
+    points[i].y = (int32_t) y;
+    points[i].brightness = (int32_t) brightness;
+  }
+
+  return (size_t) chunk_len;
+}
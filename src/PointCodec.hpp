@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_POINT_CODEC_H
+#define JOESCAN_POINT_CODEC_H
+
+#include "joescan_pinchot.h"
+#include <cstddef>
+#include <vector>
+
+/**
+ * Lossless codec for chunks of profile points, for recording.
+ *
+ * The X, Y and brightness of every point are replaced by their difference
+ * to the previous point's, zigzag encoded so small negative differences
+ * stay small, and the resulting values are stored in groups of four: one
+ * control byte holding the byte length of each value, followed later by
+ * the values themselves in as few bytes as they need. Neighbouring points
+ * along a profile are close, so most values take a single byte, just under
+ * four bytes a point all told against twelve raw.
+ *
+ * Keeping the lengths apart from the values lets the decoder expand a
+ * whole group with a single shuffle on CPUs with SSSE3; others decode one
+ * value at a time.
+ *
+ * A chunk is laid out as the number of points and the length of the value
+ * bytes, both 32-bit little endian, then the control bytes, then the value
+ * bytes. Differences run on across profiles within a chunk and start over
+ * with every chunk, so chunks decode independently.
+ */
+
+namespace joescan {
+
+/**
+ * @brief Appends a chunk of points to `out`.
+ */
+void EncodePointChunk(const jsProfileData *points, uint32_t count,
+                      std::vector<uint8_t> *out);
+
+/**
+ * @brief Reads the number of points in a chunk without decoding it.
+ *
+ * @return The number of points, or zero if `len` is too short to tell.
+ */
+uint32_t GetPointChunkCount(const uint8_t *data, size_t len);
+
+/**
+ * @brief Decodes a chunk of points.
+ *
+ * @param data Start of the chunk.
+ * @param len Bytes available from `data`, at least the chunk's length.
+ * @param points Receives the points.
+ * @param capacity Number of points `points` has room for.
+ * @param is_simd_allowed Whether the SSSE3 decoder may be used where the
+ * CPU supports it; the result is the same either way.
+ * @return Length of the chunk, or zero if it is malformed or holds more
+ * than `capacity` points.
+ */
+size_t DecodePointChunk(const uint8_t *data, size_t len,
+                        jsProfileData *points, uint32_t capacity,
+                        bool is_simd_allowed = true);
+
+/**
+ * @return `true` if `DecodePointChunk` uses SSSE3 on this CPU.
+ */
+bool HasPointCodecSimd();
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,298 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileAcquisition.hpp"
+#include "Trace.hpp"
+#include "WorkerPool.hpp"
+#include "jsScanApplication.hpp"
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+using namespace joescan;
+
+// how long an acquisition thread waits for data before checking whether it
+// has been asked to stop
+static const uint32_t kWaitTimeoutUs = 100000;
+
+ProfileAcquisition::ProfileAcquisition(
+  const std::vector<jsScanHead> &scan_heads) :
+  m_is_running(false),
+  m_is_raw(false),
+  m_pool(nullptr),
+  m_is_processing(false),
+  m_processing_pending(0),
+  m_error_code(0)
+{
+  static_assert(0 == (kRingSize & (kRingSize - 1)),
+                "ring size must be a power of two");
+
+  for (auto scan_head : scan_heads) {
+    std::unique_ptr<HeadContext> ctx(new HeadContext);
+    ctx->scan_head = scan_head;
+    ctx->ring.resize(kRingSize);
+    ctx->is_ready.reset(new std::atomic<bool>[kRingSize]);
+    for (uint32_t n = 0; n < kRingSize; n++) {
+      ctx->is_ready[n] = false;
+    }
+    ctx->read_idx = 0;
+    ctx->write_idx = 0;
+    ctx->received = 0;
+    ctx->dropped = 0;
+    ctx->raw.reset(new jsRawProfile);
+    ctx->scratch.reset(new jsProfile);
+    m_heads.push_back(std::move(ctx));
+  }
+}
+
+ProfileAcquisition::~ProfileAcquisition()
+{
+  Stop();
+}
+
+void ProfileAcquisition::AddObserver(ProfileObserver observer)
+{
+  m_observers.push_back(observer);
+}
+
+void ProfileAcquisition::SetRawProfiles(bool is_raw)
+{
+  m_is_raw = is_raw;
+}
+
+void ProfileAcquisition::SetPreprocessor(ProfileProcessor preprocessor)
+{
+  m_preprocessor = preprocessor;
+}
+
+void ProfileAcquisition::SetProcessor(ProfileProcessor processor,
+                                      WorkerPool *pool)
+{
+  m_processor = processor;
+  m_pool = pool;
+}
+
+void ProfileAcquisition::SetProcessingEnabled(bool is_enabled)
+{
+  m_is_processing = is_enabled;
+}
+
+void ProfileAcquisition::Start()
+{
+  if (m_is_running) {
+    return;
+  }
+
+  m_is_running = true;
+  for (uint32_t n = 0; n < m_heads.size(); n++) {
+    m_heads[n]->thread =
+      std::thread(&ProfileAcquisition::AcquisitionThread, this, n);
+  }
+}
+
+void ProfileAcquisition::Stop()
+{
+  m_is_running = false;
+  for (auto &ctx : m_heads) {
+    if (ctx->thread.joinable()) {
+      ctx->thread.join();
+    }
+  }
+
+  // processing tasks refer to the rings, wait for the last of them
+  while (0 != m_processing_pending) {
+    std::this_thread::yield();
+  }
+}
+
+bool ProfileAcquisition::IsRunning() const
+{
+  return m_is_running;
+}
+
+size_t ProfileAcquisition::GetMemoryUsage() const
+{
+  size_t len = 0;
+  for (auto &ctx : m_heads) {
+    len += ctx->ring.size() * sizeof(jsProfile) +
+           kRingSize * sizeof(std::atomic<bool>) +
+           sizeof(jsRawProfile) + sizeof(jsProfile);
+  }
+
+  return len;
+}
+
+uint32_t ProfileAcquisition::GetScanHeadCount() const
+{
+  return (uint32_t) m_heads.size();
+}
+
+bool ProfileAcquisition::GetProfile(uint32_t head_index, jsProfile *profile)
+{
+  HeadContext &ctx = *m_heads[head_index];
+  uint32_t read_idx = ctx.read_idx.load(std::memory_order_relaxed);
+  if (read_idx == ctx.write_idx.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  uint32_t slot = read_idx & (kRingSize - 1);
+  if (!ctx.is_ready[slot].load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  // only copy the points actually used
+  const jsProfile &src = ctx.ring[slot];
+  memcpy(profile, &src, offsetof(jsProfile, data));
+  memcpy(profile->data, src.data, src.data_len * sizeof(jsProfileData));
+  ctx.read_idx.store(read_idx + 1, std::memory_order_release);
+
+  return true;
+}
+
+uint64_t ProfileAcquisition::GetProfilesReceived(uint32_t head_index) const
+{
+  return m_heads[head_index]->received;
+}
+
+uint64_t ProfileAcquisition::GetProfilesDropped(uint32_t head_index) const
+{
+  return m_heads[head_index]->dropped;
+}
+
+uint32_t ProfileAcquisition::GetQueueDepth(uint32_t head_index) const
+{
+  const HeadContext &ctx = *m_heads[head_index];
+  return ctx.write_idx.load(std::memory_order_relaxed) -
+         ctx.read_idx.load(std::memory_order_relaxed);
+}
+
+void ProfileAcquisition::CheckError()
+{
+  std::lock_guard<std::mutex> lock(m_error_mutex);
+  if (0 > m_error_code) {
+    int32_t r = m_error_code;
+    m_error_code = 0;
+    throw ApiError(m_error_what.c_str(), r);
+  }
+}
+
+void ProfileAcquisition::SetError(const char *what, int32_t r)
+{
+  std::lock_guard<std::mutex> lock(m_error_mutex);
+  m_error_what = what;
+  m_error_code = r;
+}
+
+void ProfileAcquisition::Process(uint32_t head_index, uint32_t slot)
+{
+  HeadContext &ctx = *m_heads[head_index];
+  {
+    TraceSpan span("Process Profile");
+    m_processor(head_index, &ctx.ring[slot]);
+  }
+  ctx.is_ready[slot].store(true, std::memory_order_release);
+  m_processing_pending--;
+}
+
+void ProfileAcquisition::AcquisitionThread(uint32_t head_index)
+{
+  HeadContext &ctx = *m_heads[head_index];
+  int32_t r = 0;
+  Trace::SetThreadName("Acquisition " + std::to_string(head_index));
+
+  while (m_is_running) {
+    {
+      TraceSpan span("Wait for Profiles");
+      r = jsScanHeadWaitUntilProfilesAvailable(ctx.scan_head, 1,
+                                               kWaitTimeoutUs);
+    }
+    if (0 > r) {
+      SetError("jsScanHeadWaitUntilProfilesAvailable failed", r);
+      return;
+    }
+
+    uint32_t profiles_available = r;
+    for (uint32_t k = 0; k < profiles_available; k++) {
+      TraceSpan span("Read Profile");
+      // read straight into the ring when there is room, otherwise into a
+      // scratch profile so observers still see it
+      uint32_t write_idx = ctx.write_idx.load(std::memory_order_relaxed);
+      uint32_t read_idx = ctx.read_idx.load(std::memory_order_acquire);
+      bool is_full = (kRingSize == (write_idx - read_idx));
+      jsProfile *profile = (is_full) ?
+                           ctx.scratch.get() :
+                           &ctx.ring[write_idx & (kRingSize - 1)];
+
+      if (m_is_raw) {
+        const jsRawProfile &raw = *ctx.raw;
+        r = jsScanHeadGetRawProfiles(ctx.scan_head, ctx.raw.get(), 1);
+        if (0 > r) {
+          SetError("jsScanHeadGetRawProfiles failed", r);
+          return;
+        } else if (0 == r) {
+          break;
+        }
+
+        profile->scan_head_id = raw.scan_head_id;
+        profile->camera = raw.camera;
+        profile->laser = raw.laser;
+        profile->timestamp_ns = raw.timestamp_ns;
+        profile->flags = raw.flags;
+        profile->sequence_number = raw.sequence_number;
+        memcpy(profile->encoder_values, raw.encoder_values,
+               sizeof(profile->encoder_values));
+        profile->num_encoder_values = raw.num_encoder_values;
+        profile->laser_on_time_us = raw.laser_on_time_us;
+        profile->format = raw.format;
+        profile->packets_received = raw.packets_received;
+        profile->packets_expected = raw.packets_expected;
+
+        uint32_t len = 0;
+        for (uint32_t n = 0; n < raw.data_len; n++) {
+          if (JS_INVALID_XY != raw.data[n].x) {
+            profile->data[len++] = raw.data[n];
+          }
+        }
+        profile->data_len = len;
+      } else {
+        r = jsScanHeadGetProfiles(ctx.scan_head, profile, 1);
+        if (0 > r) {
+          SetError("jsScanHeadGetProfiles failed", r);
+          return;
+        } else if (0 == r) {
+          break;
+        }
+      }
+
+      ctx.received++;
+      if (m_preprocessor) {
+        m_preprocessor(head_index, profile);
+      }
+      for (auto &observer : m_observers) {
+        observer(head_index, *profile);
+      }
+
+      if (is_full) {
+        ctx.dropped++;
+        continue;
+      }
+
+      // the slot is published right away but only marked ready once
+      // processed, which keeps the queue in order
+      uint32_t slot = write_idx & (kRingSize - 1);
+      bool is_processing = m_is_processing && (nullptr != m_pool);
+      ctx.is_ready[slot].store(!is_processing, std::memory_order_relaxed);
+      ctx.write_idx.store(write_idx + 1, std::memory_order_release);
+      if (is_processing) {
+        m_processing_pending++;
+        m_pool->Submit([this, head_index, slot] {
+          Process(head_index, slot);
+        });
+      }
+    }
+  }
+}
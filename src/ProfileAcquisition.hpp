@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_ACQUISITION_H
+#define JOESCAN_PROFILE_ACQUISITION_H
+
+#include "joescan_pinchot.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+
+class WorkerPool;
+
+/**
+ * @brief Reads profiles from the scan heads on background threads, one per
+ * scan head, so that the render thread never waits on the network.
+ *
+ * Each thread drains its scan head into a single producer / single consumer
+ * ring that the render thread empties once per frame. Observers registered
+ * with `AddObserver` see every profile on the acquisition thread, before it
+ * is queued, including profiles that get dropped because the render thread
+ * fell behind.
+ *
+ * A preprocessor set with `SetPreprocessor` runs on the acquisition thread
+ * before the observers, so they see what it did to the profile. A processor
+ * set with `SetProcessor` runs on a worker pool after the observers. Queued
+ * profiles only become visible to `GetProfile` once processed, in order, so
+ * neither the acquisition thread nor the render thread waits for the
+ * processing.
+ */
+class ProfileAcquisition {
+ public:
+  /**
+   * @brief Called on the acquisition thread for every profile received.
+   *
+   * @param head_index Index of the scan head in the vector passed to the
+   * constructor.
+   * @param profile The profile; only valid for the duration of the call.
+   */
+  typedef std::function<void(uint32_t head_index, const jsProfile &profile)>
+    ProfileObserver;
+
+  /**
+   * @brief Called on a worker pool thread for every queued profile, which
+   * it may modify in place.
+   */
+  typedef std::function<void(uint32_t head_index, jsProfile *profile)>
+    ProfileProcessor;
+
+  /**
+   * @brief Number of profiles buffered per scan head; must be a power of
+   * two.
+   */
+  static const uint32_t kRingSize = 256;
+
+  explicit ProfileAcquisition(const std::vector<jsScanHead> &scan_heads);
+  ~ProfileAcquisition();
+
+  /**
+   * @brief Registers an observer; may only be called while stopped.
+   */
+  void AddObserver(ProfileObserver observer);
+
+  /**
+   * @brief Selects between processed and raw profiles. Raw profiles are
+   * compacted, dropping invalid points, before being handed out so that
+   * consumers only ever deal with `jsProfile`.
+   */
+  void SetRawProfiles(bool is_raw);
+
+  /**
+   * @brief Sets the preprocessor, run on the acquisition thread for every
+   * profile received; may only be called while stopped. It holds up the
+   * scan head's thread, so must be quick.
+   */
+  void SetPreprocessor(ProfileProcessor preprocessor);
+
+  /**
+   * @brief Sets the processor and the pool it runs on; may only be called
+   * while stopped. Processing starts out disabled.
+   */
+  void SetProcessor(ProfileProcessor processor, WorkerPool *pool);
+
+  /**
+   * @brief Turns processing of newly queued profiles on or off.
+   */
+  void SetProcessingEnabled(bool is_enabled);
+
+  /**
+   * @brief Starts one acquisition thread per scan head. The scan system
+   * must already be scanning.
+   */
+  void Start();
+
+  /**
+   * @brief Stops the acquisition threads; blocks until all have exited and
+   * all profiles handed to the processor are done. Must be called before
+   * scanning is stopped.
+   */
+  void Stop();
+
+  bool IsRunning() const;
+
+  uint32_t GetScanHeadCount() const;
+
+  /**
+   * @brief Pops the oldest queued profile of a scan head.
+   *
+   * @param head_index Index of the scan head.
+   * @param profile Receives the profile.
+   * @return `true` if a profile was returned, `false` if the queue is empty
+   * or the oldest profile is still being processed.
+   */
+  bool GetProfile(uint32_t head_index, jsProfile *profile);
+
+  uint64_t GetProfilesReceived(uint32_t head_index) const;
+  uint64_t GetProfilesDropped(uint32_t head_index) const;
+
+  /**
+   * @return Profiles queued for a scan head, processed or not.
+   */
+  uint32_t GetQueueDepth(uint32_t head_index) const;
+
+  /**
+   * @return Bytes allocated for the rings of profiles.
+   */
+  size_t GetMemoryUsage() const;
+
+  /**
+   * @brief Rethrows an API failure that ended an acquisition thread as a
+   * `joescan::ApiError` on the calling thread.
+   */
+  void CheckError();
+
+ private:
+  struct HeadContext {
+    jsScanHead scan_head;
+    std::thread thread;
+    std::vector<jsProfile> ring;
+    std::unique_ptr<std::atomic<bool>[]> is_ready;
+    std::atomic<uint32_t> read_idx;
+    std::atomic<uint32_t> write_idx;
+    std::atomic<uint64_t> received;
+    std::atomic<uint64_t> dropped;
+    std::unique_ptr<jsRawProfile> raw;
+    std::unique_ptr<jsProfile> scratch;
+  };
+
+  void AcquisitionThread(uint32_t head_index);
+  void SetError(const char *what, int32_t r);
+  void Process(uint32_t head_index, uint32_t slot);
+
+  std::vector<std::unique_ptr<HeadContext>> m_heads;
+  std::vector<ProfileObserver> m_observers;
+  std::atomic<bool> m_is_running;
+  std::atomic<bool> m_is_raw;
+
+  ProfileProcessor m_preprocessor;
+  ProfileProcessor m_processor;
+  WorkerPool *m_pool;
+  std::atomic<bool> m_is_processing;
+  std::atomic<uint32_t> m_processing_pending;
+
+  std::mutex m_error_mutex;
+  std::string m_error_what;
+  int32_t m_error_code;
+};
+
+} // namespace joescan
+
+#endif
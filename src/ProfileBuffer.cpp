@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileBuffer.hpp"
+
+void joescan::LoadProfileBuffer(const jsProfile &profile,
+                                ProfileBuffer *buffer,
+                                uint32_t brightness_bit_depth)
+{
+  // deeper brightness keeps its most significant 8 bits
+  const int32_t shift =
+    (8 < brightness_bit_depth) ? (int32_t) brightness_bit_depth - 8 : 0;
+
+  buffer->laser_on_time_us = profile.laser_on_time_us;
+  buffer->encoder = profile.encoder_values[0];
+  buffer->timestamp_ns = profile.timestamp_ns;
+  buffer->camera = profile.camera;
+  buffer->laser = profile.laser;
+
+  uint32_t len = 0;
+  for (uint32_t n = 0; n < profile.data_len; n++) {
+    const jsProfileData &d = profile.data[n];
+    if (JS_INVALID_XY == d.x) {
+      continue;
+    }
+
+    buffer->x[len] = d.x / 1000.0;
+    buffer->y[len] = d.y / 1000.0;
+    int32_t b = d.brightness >> shift;
+    buffer->brightness[len] = (255 < b) ? 255 : (0 > b) ? 0 : (uint8_t) b;
+    len++;
+  }
+
+  buffer->data_len = len;
+}
@@ -0,0 +1,45 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_BUFFER_H
+#define JOESCAN_PROFILE_BUFFER_H
+
+#include "joescan_pinchot.h"
+
+namespace joescan {
+
+/**
+ * @brief A profile converted to inches, with coordinates and brightness in
+ * separate arrays so they can be passed straight to ImPlot and processed
+ * with simple loops.
+ */
+struct ProfileBuffer {
+  double x[JS_PROFILE_DATA_LEN];
+  double y[JS_PROFILE_DATA_LEN];
+  uint8_t brightness[JS_PROFILE_DATA_LEN];
+  uint32_t data_len;
+  uint32_t laser_on_time_us;
+  int64_t encoder;
+  uint64_t timestamp_ns;
+  jsCamera camera;
+  jsLaser laser;
+};
+
+/**
+ * @brief Fills a buffer from a profile, skipping invalid points and
+ * scaling brightness down to 8 bits.
+ *
+ * @param brightness_bit_depth Bits of brightness the scan head reports, as
+ * given by its capabilities; levels past the range are clamped.
+ */
+void LoadProfileBuffer(const jsProfile &profile,
+                       ProfileBuffer *buffer,
+                       uint32_t brightness_bit_depth = 8);
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileClient.hpp"
+#include "Trace.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#endif
+
+using namespace joescan;
+
+ProfileClient::ProfileClient(const std::string &address) :
+  m_fd(-1),
+  m_scratch(new jsProfile),
+  m_is_running(true),
+  m_is_connected(true),
+  m_received(0),
+  m_dropped(0),
+  m_bytes_received(0)
+{
+  static_assert(0 == (kRingSize & (kRingSize - 1)),
+                "ring size must be a power of two");
+
+  m_fd = OpenConnectSocket(address);
+
+  // the server always starts with its hello
+  try {
+    bool is_hello = false;
+    while (!is_hello) {
+      if (!Receive()) {
+        throw std::runtime_error(address + ": " + GetError());
+      }
+
+      uint8_t type = 0;
+      const uint8_t *payload = nullptr;
+      uint32_t payload_len = 0;
+      size_t len = ParseMessage(m_in.data(), m_in.size(), &type, &payload,
+                                &payload_len);
+      if (0 == len) {
+        continue;
+      }
+
+      if ((kMessageHello != type) ||
+          !DecodeHello(payload, payload_len, &m_hello) ||
+          m_hello.serial_numbers.empty()) {
+        throw std::runtime_error(address + ": not a compatible server");
+      }
+      m_in.erase(m_in.begin(), m_in.begin() + len);
+      is_hello = true;
+    }
+  } catch (...) {
+    CloseSocket(m_fd);
+    throw;
+  }
+
+  for (uint32_t n = 0; n < m_hello.serial_numbers.size(); n++) {
+    std::unique_ptr<HeadRing> head(new HeadRing);
+    head->ring.resize(kRingSize);
+    head->read_idx = 0;
+    head->write_idx = 0;
+    m_heads.push_back(std::move(head));
+  }
+
+  m_thread = std::thread(&ProfileClient::ReceiveThread, this);
+}
+
+ProfileClient::~ProfileClient()
+{
+  m_is_running = false;
+#if !defined(_WIN32)
+  // wakes the receive thread out of `recv`
+  shutdown(m_fd, SHUT_RDWR);
+#endif
+  m_thread.join();
+  CloseSocket(m_fd);
+}
+
+const ProfileHello &ProfileClient::GetHello() const
+{
+  return m_hello;
+}
+
+size_t ProfileClient::GetMemoryUsage() const
+{
+  size_t len = sizeof(jsProfile);
+  for (auto &head : m_heads) {
+    len += head->ring.size() * sizeof(jsProfile);
+  }
+
+  return len;
+}
+
+uint32_t ProfileClient::GetScanHeadCount() const
+{
+  return (uint32_t) m_heads.size();
+}
+
+void ProfileClient::Subscribe(const ProfileSubscription &subscription)
+{
+  if ((subscription == m_subscription) || !m_is_connected) {
+    return;
+  }
+
+  // small enough to never block for long; a failure shows up as the
+  // connection ending on the receive thread
+  std::vector<uint8_t> message;
+  EncodeSubscribe(subscription, &message);
+#if !defined(_WIN32)
+  send(m_fd, message.data(), message.size(), MSG_NOSIGNAL);
+#endif
+  m_subscription = subscription;
+}
+
+const ProfileSubscription &ProfileClient::GetSubscription() const
+{
+  return m_subscription;
+}
+
+bool ProfileClient::GetProfile(uint32_t head_index, jsProfile *profile)
+{
+  HeadRing &head = *m_heads[head_index];
+  uint32_t read_idx = head.read_idx.load(std::memory_order_relaxed);
+  if (read_idx == head.write_idx.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  // only copy the points actually used
+  const jsProfile &src = head.ring[read_idx & (kRingSize - 1)];
+  memcpy(profile, &src, offsetof(jsProfile, data));
+  memcpy(profile->data, src.data, src.data_len * sizeof(jsProfileData));
+  head.read_idx.store(read_idx + 1, std::memory_order_release);
+
+  return true;
+}
+
+bool ProfileClient::IsConnected() const
+{
+  return m_is_connected;
+}
+
+std::string ProfileClient::GetError() const
+{
+  std::lock_guard<std::mutex> lock(m_error_mutex);
+  return m_error;
+}
+
+uint64_t ProfileClient::GetProfilesReceived() const
+{
+  return m_received;
+}
+
+uint64_t ProfileClient::GetProfilesDropped() const
+{
+  return m_dropped;
+}
+
+uint64_t ProfileClient::GetBytesReceived() const
+{
+  return m_bytes_received;
+}
+
+void ProfileClient::SetError(const std::string &error)
+{
+  std::lock_guard<std::mutex> lock(m_error_mutex);
+  m_error = error;
+}
+
+bool ProfileClient::Receive()
+{
+#if defined(_WIN32)
+  return false;
+#else
+  uint8_t buf[64 * 1024];
+  ssize_t n = 0;
+  do {
+    n = recv(m_fd, buf, sizeof(buf), 0);
+  } while ((0 > n) && (EINTR == errno));
+
+  if (0 < n) {
+    m_in.insert(m_in.end(), buf, buf + n);
+    m_bytes_received += n;
+    return true;
+  }
+
+  SetError((0 == n) ? "connection closed by server" : strerror(errno));
+  return false;
+#endif
+}
+
+void ProfileClient::Push(uint32_t head_index, const jsProfile &profile)
+{
+  HeadRing &head = *m_heads[head_index];
+  uint32_t write_idx = head.write_idx.load(std::memory_order_relaxed);
+  if (kRingSize == write_idx - head.read_idx.load(std::memory_order_acquire)) {
+    m_dropped++;
+    return;
+  }
+
+  jsProfile &dst = head.ring[write_idx & (kRingSize - 1)];
+  memcpy(&dst, &profile, offsetof(jsProfile, data));
+  memcpy(dst.data, profile.data, profile.data_len * sizeof(jsProfileData));
+  head.write_idx.store(write_idx + 1, std::memory_order_release);
+}
+
+void ProfileClient::ReceiveThread()
+{
+  Trace::SetThreadName("Client");
+  try {
+    while (m_is_running && Receive()) {
+      TraceSpan span("Decode Profiles");
+      size_t used = 0;
+      while (true) {
+        uint8_t type = 0;
+        const uint8_t *payload = nullptr;
+        uint32_t payload_len = 0;
+        size_t len = ParseMessage(m_in.data() + used, m_in.size() - used,
+                                  &type, &payload, &payload_len);
+        if (0 == len) {
+          break;
+        }
+        used += len;
+
+        // unknown messages are skipped, so newer servers can add some
+        uint32_t head_index = 0;
+        if (kMessageProfile != type) {
+          continue;
+        }
+        if (!DecodeProfile(payload, payload_len, &head_index,
+                           m_scratch.get()) ||
+            (m_heads.size() <= head_index)) {
+          throw std::runtime_error("malformed profile message");
+        }
+
+        m_received++;
+        Push(head_index, *m_scratch);
+      }
+      m_in.erase(m_in.begin(), m_in.begin() + used);
+    }
+  } catch (std::runtime_error &e) {
+    SetError(e.what());
+  }
+
+  m_is_connected = false;
+}
@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_CLIENT_H
+#define JOESCAN_PROFILE_CLIENT_H
+
+#include "ProfileProtocol.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Receives profiles from a `ProfileServer`, standing in for
+ * `ProfileAcquisition` in a viewer that has no scan heads of its own.
+ *
+ * A background thread decodes profiles as they arrive into one single
+ * producer / single consumer ring per scan head, which the render thread
+ * empties once per frame. Profiles that arrive while a ring is full are
+ * dropped.
+ */
+class ProfileClient {
+ public:
+  /**
+   * @brief Number of profiles buffered per scan head; must be a power of
+   * two.
+   */
+  static const uint32_t kRingSize = 256;
+
+  /**
+   * @brief Connects and waits for the server's hello.
+   *
+   * @param address Address as for `OpenConnectSocket`.
+   * @throw std::runtime_error if the connection fails.
+   */
+  explicit ProfileClient(const std::string &address);
+
+  /**
+   * @brief Disconnects and stops the receive thread.
+   */
+  ~ProfileClient();
+
+  const ProfileHello &GetHello() const;
+
+  uint32_t GetScanHeadCount() const;
+
+  /**
+   * @brief Changes what the server sends from now on; only sends a request
+   * if the subscription changes. Profiles already on their way arrive as
+   * subscribed before.
+   */
+  void Subscribe(const ProfileSubscription &subscription);
+
+  const ProfileSubscription &GetSubscription() const;
+
+  /**
+   * @brief Pops the oldest received profile of a scan head.
+   *
+   * @return `true` if a profile was returned, `false` if none is queued.
+   */
+  bool GetProfile(uint32_t head_index, jsProfile *profile);
+
+  /**
+   * @return `false` once the server has gone away.
+   */
+  bool IsConnected() const;
+
+  /**
+   * @return Why the connection ended, if it has.
+   */
+  std::string GetError() const;
+
+  uint64_t GetProfilesReceived() const;
+  uint64_t GetProfilesDropped() const;
+  uint64_t GetBytesReceived() const;
+
+  /**
+   * @return Bytes allocated for the rings of profiles.
+   */
+  size_t GetMemoryUsage() const;
+
+ private:
+  struct HeadRing {
+    std::vector<jsProfile> ring;
+    std::atomic<uint32_t> read_idx;
+    std::atomic<uint32_t> write_idx;
+  };
+
+  void ReceiveThread();
+  bool Receive();
+  void Push(uint32_t head_index, const jsProfile &profile);
+  void SetError(const std::string &error);
+
+  int m_fd;
+  std::vector<uint8_t> m_in;
+  ProfileHello m_hello;
+  ProfileSubscription m_subscription;
+  std::vector<std::unique_ptr<HeadRing>> m_heads;
+  std::unique_ptr<jsProfile> m_scratch;
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+  std::atomic<bool> m_is_connected;
+  std::atomic<uint64_t> m_received;
+  std::atomic<uint64_t> m_dropped;
+  std::atomic<uint64_t> m_bytes_received;
+
+  mutable std::mutex m_error_mutex;
+  std::string m_error;
+};
+
+} // namespace joescan
+
+#endif
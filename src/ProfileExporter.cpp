@@ -0,0 +1,447 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileExporter.hpp"
+#include "Trace.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace joescan;
+
+// output is formatted into a buffer this large and written a buffer at a
+// time, bypassing stdio's own buffering
+static const size_t kBufferLen = 4 << 20;
+// longest a single point can take in any format, with room to spare
+static const size_t kMaxPointLen = 256;
+// the PLY vertex count is written as this many digits once it is known
+static const int kPlyCountDigits = 10;
+// profiles of different scan heads arrive a little out of order, so a
+// recording is read this far past the end of the range
+static const double kRecordingSlackSeconds = 1.0;
+
+static const char kDigitPairs[] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// Formats an integer two digits at a time, back to front, which is several
+// times faster than printf for the millions of numbers in an export.
+static char *FormatUnsigned(char *p, uint64_t v)
+{
+  char digits[20];
+  char *end = digits + sizeof(digits);
+  char *d = end;
+  while (100 <= v) {
+    uint32_t pair = (uint32_t) (v % 100) * 2;
+    v /= 100;
+    d -= 2;
+    d[0] = kDigitPairs[pair];
+    d[1] = kDigitPairs[pair + 1];
+  }
+  if (10 <= v) {
+    d -= 2;
+    d[0] = kDigitPairs[v * 2];
+    d[1] = kDigitPairs[v * 2 + 1];
+  } else {
+    *--d = (char) ('0' + v);
+  }
+
+  memcpy(p, d, end - d);
+  return p + (end - d);
+}
+
+static char *FormatSigned(char *p, int64_t v)
+{
+  if (0 > v) {
+    *p++ = '-';
+    return FormatUnsigned(p, 0 - (uint64_t) v);
+  }
+
+  return FormatUnsigned(p, (uint64_t) v);
+}
+
+static char *WriteLe32(char *p, uint32_t v)
+{
+  p[0] = (char) v;
+  p[1] = (char) (v >> 8);
+  p[2] = (char) (v >> 16);
+  p[3] = (char) (v >> 24);
+  return p + 4;
+}
+
+static char *WriteLe64(char *p, uint64_t v)
+{
+  p = WriteLe32(p, (uint32_t) v);
+  return WriteLe32(p, (uint32_t) (v >> 32));
+}
+
+/**
+ * @brief Formats points into a large buffer and writes it out when full.
+ */
+class ProfileExporter::File {
+ public:
+  File(const RecordingInfo &info, Format format, const std::string &path) :
+    m_format(format),
+    m_path(path),
+    m_serial_numbers(info.serial_numbers),
+    m_buffer(kBufferLen),
+    m_len(0),
+    m_bytes(0),
+    m_points(0),
+    m_count_offset(0)
+  {
+    // binary even for text, so the PLY vertex count is where it was put
+    m_file = fopen(path.c_str(), "wb");
+    if (nullptr == m_file) {
+      throw std::runtime_error("failed to create " + path);
+    }
+    setvbuf(m_file, nullptr, _IONBF, 0);
+
+    if (kFormatCsv == m_format) {
+      Append("serial,camera,laser,timestamp_ns,encoder,x,y,brightness\n");
+    } else if (kFormatPly == m_format) {
+      Append("ply\n"
+             "format ascii 1.0\n"
+             "comment x and y in 1/1000 inch, z is the encoder value\n"
+             "element vertex ");
+      m_count_offset = m_len;
+      Append(std::string(kPlyCountDigits, '0') + "\n");
+      Append("property int x\n"
+             "property int y\n"
+             "property double z\n"
+             "property int intensity\n"
+             "end_header\n");
+    }
+  }
+
+  ~File()
+  {
+    fclose(m_file);
+  }
+
+  /**
+   * @return Number of points written.
+   */
+  uint32_t Add(uint32_t head_index, const jsProfile &profile)
+  {
+    const uint32_t serial_number = (head_index < m_serial_numbers.size()) ?
+                                   m_serial_numbers[head_index] :
+                                   0;
+    const int64_t encoder = (0 != profile.num_encoder_values) ?
+                            profile.encoder_values[0] :
+                            0;
+
+    // CSV columns that are the same for every point of the profile
+    char prefix[kMaxPointLen];
+    char *end = prefix;
+    if (kFormatCsv == m_format) {
+      end = FormatUnsigned(end, serial_number);
+      *end++ = ',';
+      end = FormatUnsigned(end, (uint32_t) profile.camera);
+      *end++ = ',';
+      end = FormatUnsigned(end, (uint32_t) profile.laser);
+      *end++ = ',';
+      end = FormatUnsigned(end, profile.timestamp_ns);
+      *end++ = ',';
+      end = FormatSigned(end, encoder);
+      *end++ = ',';
+    }
+    const size_t prefix_len = end - prefix;
+
+    uint32_t count = 0;
+    for (uint32_t n = 0; n < profile.data_len; n++) {
+      const jsProfileData &d = profile.data[n];
+      if (JS_INVALID_XY == d.x) {
+        continue;
+      }
+
+      if (kBufferLen - m_len < kMaxPointLen) {
+        Flush();
+      }
+      char *p = &m_buffer[m_len];
+      if (kFormatCsv == m_format) {
+        memcpy(p, prefix, prefix_len);
+        p += prefix_len;
+        p = FormatSigned(p, d.x);
+        *p++ = ',';
+        p = FormatSigned(p, d.y);
+        *p++ = ',';
+        p = FormatSigned(p, d.brightness);
+        *p++ = '\n';
+      } else if (kFormatPly == m_format) {
+        p = FormatSigned(p, d.x);
+        *p++ = ' ';
+        p = FormatSigned(p, d.y);
+        *p++ = ' ';
+        p = FormatSigned(p, encoder);
+        *p++ = ' ';
+        p = FormatSigned(p, d.brightness);
+        *p++ = '\n';
+      } else {
+        p = WriteLe64(p, profile.timestamp_ns);
+        p = WriteLe64(p, (uint64_t) encoder);
+        p = WriteLe32(p, serial_number);
+        p = WriteLe32(p, (uint32_t) profile.camera);
+        p = WriteLe32(p, (uint32_t) profile.laser);
+        p = WriteLe32(p, (uint32_t) d.x);
+        p = WriteLe32(p, (uint32_t) d.y);
+        p = WriteLe32(p, (uint32_t) d.brightness);
+      }
+      m_len = p - m_buffer.data();
+      count++;
+    }
+
+    m_points += count;
+    return count;
+  }
+
+  /**
+   * @brief Writes out what is left, and fills in the PLY vertex count.
+   */
+  void Finish()
+  {
+    Flush();
+    if (kFormatPly == m_format) {
+      char count[kPlyCountDigits + 1];
+      snprintf(count, sizeof(count), "%0*llu", kPlyCountDigits,
+               (unsigned long long) m_points);
+      if ((0 != fseek(m_file, (long) m_count_offset, SEEK_SET)) ||
+          (kPlyCountDigits != fwrite(count, 1, kPlyCountDigits, m_file))) {
+        throw std::runtime_error("failed to write " + m_path);
+      }
+    }
+  }
+
+  uint64_t GetBytes() const { return m_bytes + m_len; }
+
+ private:
+  void Append(const std::string &text)
+  {
+    memcpy(&m_buffer[m_len], text.data(), text.size());
+    m_len += text.size();
+  }
+
+  void Flush()
+  {
+    if (m_len != fwrite(m_buffer.data(), 1, m_len, m_file)) {
+      throw std::runtime_error("failed to write " + m_path);
+    }
+    m_bytes += m_len;
+    m_len = 0;
+  }
+
+  Format m_format;
+  std::string m_path;
+  std::vector<uint32_t> m_serial_numbers;
+  FILE *m_file;
+  std::vector<char> m_buffer;
+  size_t m_len;
+  uint64_t m_bytes;
+  uint64_t m_points;
+  size_t m_count_offset;
+};
+
+const char *ProfileExporter::GetExtension(Format format)
+{
+  switch (format) {
+    case kFormatCsv:
+      return "csv";
+    case kFormatPly:
+      return "ply";
+    case kFormatBinary:
+      return "bin";
+  }
+
+  return "";
+}
+
+ProfileExporter::ProfileExporter() :
+  m_is_running(false),
+  m_is_cancelled(false),
+  m_fraction(0.0),
+  m_profiles(0),
+  m_points(0),
+  m_bytes(0),
+  m_elapsed_ns(0)
+{
+}
+
+ProfileExporter::~ProfileExporter()
+{
+  Cancel();
+}
+
+bool ProfileExporter::Start(const BlackBox &black_box,
+                            double oldest_s,
+                            double newest_s,
+                            Format format,
+                            const std::string &path)
+{
+  if (!Begin(path)) {
+    return false;
+  }
+
+  const BlackBox *source = &black_box;
+  m_thread = std::thread([=]() {
+    Run([&]() {
+      File file(source->GetInfo(), format, path);
+      source->Read(oldest_s, newest_s,
+                   [&](uint32_t head_index, const jsProfile &p, double f) {
+        return Add(&file, head_index, p, f);
+      });
+      file.Finish();
+      m_bytes = file.GetBytes();
+    });
+  });
+  return true;
+}
+
+bool ProfileExporter::Start(const std::string &recording,
+                            double from_s,
+                            double to_s,
+                            Format format,
+                            const std::string &path)
+{
+  if (!Begin(path)) {
+    return false;
+  }
+
+  m_thread = std::thread([=]() {
+    Run([&]() {
+      RecordingReader reader(recording);
+      File file(reader.GetInfo(), format, path);
+      std::unique_ptr<jsProfile> profile(new jsProfile);
+      const double size = (double) reader.GetSize();
+      // scan heads are recorded in turn, so a profile of one can be older
+      // than those of another before it; times are from the oldest yet
+      uint64_t first_timestamp_ns = UINT64_MAX;
+      uint32_t head_index = 0;
+      while (reader.Next(&head_index, profile.get())) {
+        if (first_timestamp_ns > profile->timestamp_ns) {
+          first_timestamp_ns = profile->timestamp_ns;
+        }
+
+        double t = (profile->timestamp_ns - first_timestamp_ns) / 1.0e9;
+        if (to_s + kRecordingSlackSeconds < t) {
+          break;
+        }
+        if ((from_s > t) || (to_s < t)) {
+          continue;
+        }
+        if (!Add(&file, head_index, *profile, reader.GetPosition() / size)) {
+          break;
+        }
+      }
+      file.Finish();
+      m_bytes = file.GetBytes();
+    });
+  });
+  return true;
+}
+
+void ProfileExporter::Cancel()
+{
+  m_is_cancelled = true;
+  Join();
+}
+
+size_t ProfileExporter::GetMemoryUsage() const
+{
+  return (m_is_running) ? kBufferLen : 0;
+}
+
+ProfileExporter::Progress ProfileExporter::GetProgress() const
+{
+  Progress progress;
+  progress.is_running = m_is_running;
+  progress.fraction = m_fraction;
+  progress.profiles = m_profiles;
+  progress.points = m_points;
+  progress.bytes = m_bytes;
+  progress.seconds = m_elapsed_ns / 1.0e9;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  progress.path = m_path;
+  progress.error = m_error;
+  return progress;
+}
+
+bool ProfileExporter::Begin(const std::string &path)
+{
+  if (m_is_running) {
+    return false;
+  }
+
+  Join();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path = path;
+    m_error.clear();
+  }
+  m_is_cancelled = false;
+  m_fraction = 0.0;
+  m_profiles = 0;
+  m_points = 0;
+  m_bytes = 0;
+  m_elapsed_ns = 0;
+  m_start = std::chrono::steady_clock::now();
+  m_is_running = true;
+  return true;
+}
+
+bool ProfileExporter::Add(File *file,
+                          uint32_t head_index,
+                          const jsProfile &profile,
+                          double fraction)
+{
+  if (m_is_cancelled) {
+    return false;
+  }
+
+  m_points += file->Add(head_index, profile);
+  m_profiles++;
+  m_bytes = file->GetBytes();
+  m_fraction = fraction;
+  m_elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - m_start).count();
+  return true;
+}
+
+void ProfileExporter::Run(const std::function<void()> &body)
+{
+  Trace::SetThreadName("Exporter");
+  try {
+    TraceSpan span("Export");
+    body();
+    if (!m_is_cancelled) {
+      m_fraction = 1.0;
+    }
+  } catch (std::exception &e) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_error = e.what();
+  }
+
+  if (m_is_cancelled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_error = "cancelled";
+  }
+  m_elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - m_start).count();
+  m_is_running = false;
+}
+
+void ProfileExporter::Join()
+{
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
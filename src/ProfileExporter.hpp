@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_EXPORTER_H
+#define JOESCAN_PROFILE_EXPORTER_H
+
+#include "BlackBox.hpp"
+#include "Recording.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace joescan {
+
+/**
+ * @brief Exports profiles from a black box or a recording to a file other
+ * programs can read, on a thread of its own.
+ *
+ * Every valid point is written with the scan head's serial number, the
+ * element and the profile's timestamp and encoder value. Coordinates are
+ * as recorded, in 1/1000 inch, so host alignment has been applied if it
+ * was on.
+ *
+ * - CSV has a header row naming the columns, then a row per point:
+ *   `serial,camera,laser,timestamp_ns,encoder,x,y,brightness`.
+ * - PLY is an ASCII point cloud with integer `x` and `y` properties, a
+ *   `z` property holding the encoder value, and an integer `intensity`
+ *   for brightness, unscaled, so it can go past 255 on scan heads with
+ *   deeper brightness. PLY has no 64-bit integer type, so `z` is declared
+ *   `double`; it is written as the full integer, which a double holds
+ *   exactly up to 2^53.
+ * - Binary is a 40 byte little endian record per point: timestamp (u64),
+ *   encoder (i64), serial, camera, laser (u32) then x, y and brightness
+ *   (i32).
+ */
+class ProfileExporter {
+ public:
+  enum Format {
+    kFormatCsv,
+    kFormatPly,
+    kFormatBinary
+  };
+
+  struct Progress {
+    bool is_running;
+    // fraction of the source read, zero to one
+    double fraction;
+    uint64_t profiles;
+    uint64_t points;
+    uint64_t bytes;
+    double seconds;
+    std::string path;
+    std::string error;
+  };
+
+  /**
+   * @return Usual file name extension for a format, without the dot.
+   */
+  static const char *GetExtension(Format format);
+
+  ProfileExporter();
+
+  /**
+   * @brief Stops any export in progress, leaving its file incomplete.
+   */
+  ~ProfileExporter();
+
+  /**
+   * @brief Starts exporting the profiles a black box kept from `oldest_s`
+   * to `newest_s` seconds ago. The black box must outlive the export.
+   *
+   * @return `false` if an export is already in progress.
+   */
+  bool Start(const BlackBox &black_box, double oldest_s, double newest_s,
+             Format format, const std::string &path);
+
+  /**
+   * @brief Starts exporting the profiles of a recording from `from_s` to
+   * `to_s` seconds after its oldest profile.
+   *
+   * @return `false` if an export is already in progress.
+   */
+  bool Start(const std::string &recording, double from_s, double to_s,
+             Format format, const std::string &path);
+
+  /**
+   * @brief Stops the export in progress, if any, and waits for it.
+   */
+  void Cancel();
+
+  Progress GetProgress() const;
+
+  /**
+   * @return Bytes allocated for the output buffer, while exporting.
+   */
+  size_t GetMemoryUsage() const;
+
+ private:
+  class File;
+
+  bool Begin(const std::string &path);
+  bool Add(File *file, uint32_t head_index, const jsProfile &profile,
+           double fraction);
+  void Run(const std::function<void()> &body);
+  void Join();
+
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+  std::atomic<bool> m_is_cancelled;
+  std::atomic<double> m_fraction;
+  std::atomic<uint64_t> m_profiles;
+  std::atomic<uint64_t> m_points;
+  std::atomic<uint64_t> m_bytes;
+  std::chrono::steady_clock::time_point m_start;
+  std::atomic<int64_t> m_elapsed_ns;
+  mutable std::mutex m_mutex;
+  std::string m_path;
+  std::string m_error;
+};
+
+} // namespace joescan
+
+#endif
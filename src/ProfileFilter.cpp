@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileFilter.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace joescan;
+
+// The kernels below work on the points split out into separate arrays and
+// are kept free of branches so the compiler can vectorize them; the
+// interleaved `jsProfileData` layout would otherwise defeat it.
+struct FilterPoints {
+  int32_t x[JS_PROFILE_DATA_LEN];
+  int32_t y[JS_PROFILE_DATA_LEN];
+  int32_t brightness[JS_PROFILE_DATA_LEN];
+  int32_t tmp[JS_PROFILE_DATA_LEN];
+  float dist[JS_PROFILE_DATA_LEN];
+  uint8_t keep[JS_PROFILE_DATA_LEN];
+  uint32_t len;
+};
+
+static inline int32_t Median3(int32_t a, int32_t b, int32_t c)
+{
+  return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+static inline int32_t Median5(int32_t a,
+                              int32_t b,
+                              int32_t c,
+                              int32_t d,
+                              int32_t e)
+{
+  // the smallest and largest of a..d can't be the median, which leaves the
+  // median of the remaining three
+  int32_t f = std::max(std::min(a, b), std::min(c, d));
+  int32_t g = std::min(std::max(a, b), std::max(c, d));
+  return Median3(e, f, g);
+}
+
+static void Compact(FilterPoints *p)
+{
+  int32_t *__restrict x = p->x;
+  int32_t *__restrict y = p->y;
+  int32_t *__restrict brightness = p->brightness;
+  const uint8_t *__restrict keep = p->keep;
+  uint32_t len = 0;
+
+  // always store, then only advance past points that are kept
+  for (uint32_t n = 0; n < p->len; n++) {
+    x[len] = x[n];
+    y[len] = y[n];
+    brightness[len] = brightness[n];
+    len += keep[n];
+  }
+  p->len = len;
+}
+
+static void MaskBrightness(FilterPoints *p, int32_t min_brightness)
+{
+  const int32_t *__restrict brightness = p->brightness;
+  uint8_t *__restrict keep = p->keep;
+
+  for (uint32_t n = 0; n < p->len; n++) {
+    keep[n] = (uint8_t) (brightness[n] >= min_brightness);
+  }
+}
+
+static void MaskSpikes(FilterPoints *p, int32_t distance)
+{
+  const int32_t *__restrict x = p->x;
+  const int32_t *__restrict y = p->y;
+  float *__restrict d = p->dist;
+  uint8_t *__restrict keep = p->keep;
+  const float limit = (float) distance * (float) distance;
+  const uint32_t len = p->len;
+
+  if (2 > len) {
+    memset(keep, 1, len);
+    return;
+  }
+
+  // squared distance from every point to the next one; differences of
+  // points at opposite ends of the range don't fit in 32 bits
+  for (uint32_t n = 0; n < len - 1; n++) {
+    float dx = (float) ((int64_t) x[n + 1] - x[n]);
+    float dy = (float) ((int64_t) y[n + 1] - y[n]);
+    d[n] = dx * dx + dy * dy;
+  }
+
+  keep[0] = (uint8_t) (d[0] <= limit);
+  for (uint32_t n = 1; n < len - 1; n++) {
+    keep[n] = (uint8_t) ((d[n - 1] <= limit) | (d[n] <= limit));
+  }
+  keep[len - 1] = (uint8_t) (d[len - 2] <= limit);
+}
+
+static void MedianY(FilterPoints *p, uint32_t window)
+{
+  const int32_t *__restrict y = p->y;
+  int32_t *__restrict m = p->tmp;
+  const uint32_t len = p->len;
+
+  if (3 > len) {
+    return;
+  }
+
+  // the ends keep their values, or fall back to the 3 point median when
+  // the 5 point window doesn't fit
+  m[0] = y[0];
+  m[len - 1] = y[len - 1];
+  if ((5 <= window) && (5 <= len)) {
+    m[1] = Median3(y[0], y[1], y[2]);
+    m[len - 2] = Median3(y[len - 3], y[len - 2], y[len - 1]);
+    for (uint32_t n = 2; n < len - 2; n++) {
+      m[n] = Median5(y[n - 2], y[n - 1], y[n + 1], y[n + 2], y[n]);
+    }
+  } else {
+    for (uint32_t n = 1; n < len - 1; n++) {
+      m[n] = Median3(y[n - 1], y[n], y[n + 1]);
+    }
+  }
+
+  memcpy(p->y, p->tmp, len * sizeof(int32_t));
+}
+
+ProfileFilter::ProfileFilter(uint32_t brightness_bit_depth) :
+  m_brightness_shift((8 < brightness_bit_depth) ?
+                     (int32_t) brightness_bit_depth - 8 : 0),
+  m_min_brightness(0),
+  m_spike_distance(0),
+  m_median_window(0)
+{
+}
+
+void ProfileFilter::SetMinBrightness(int32_t brightness)
+{
+  m_min_brightness = (0 > brightness) ? 0 : brightness;
+}
+
+int32_t ProfileFilter::GetMinBrightness() const
+{
+  return m_min_brightness;
+}
+
+void ProfileFilter::SetSpikeDistance(int32_t distance)
+{
+  m_spike_distance = (0 > distance) ? 0 : distance;
+}
+
+int32_t ProfileFilter::GetSpikeDistance() const
+{
+  return m_spike_distance;
+}
+
+void ProfileFilter::SetMedianWindow(uint32_t window)
+{
+  if (3 > window) {
+    window = 0;
+  } else if (kMedianWindowMax < window) {
+    window = kMedianWindowMax;
+  }
+  m_median_window = window;
+}
+
+uint32_t ProfileFilter::GetMedianWindow() const
+{
+  return m_median_window;
+}
+
+bool ProfileFilter::IsEnabled() const
+{
+  return (0 != m_min_brightness) || (0 != m_spike_distance) ||
+         (0 != m_median_window);
+}
+
+void ProfileFilter::Apply(jsProfile *profile) const
+{
+  const int32_t min_brightness = m_min_brightness;
+  const int32_t spike_distance = m_spike_distance;
+  const uint32_t median_window = m_median_window;
+
+  if ((0 == min_brightness) && (0 == spike_distance) &&
+      (0 == median_window)) {
+    return;
+  }
+
+  // about 30 KiB, fine on the stack of any thread this runs on
+  FilterPoints p;
+  const uint32_t data_len = (JS_PROFILE_DATA_LEN < profile->data_len) ?
+                            JS_PROFILE_DATA_LEN : profile->data_len;
+
+  // invalid points would read as outliers to every kernel, so they are
+  // left out the same way `Compact` drops points
+  uint32_t len = 0;
+  for (uint32_t n = 0; n < data_len; n++) {
+    const jsProfileData &d = profile->data[n];
+    p.x[len] = d.x;
+    p.y[len] = d.y;
+    p.brightness[len] = d.brightness;
+    len += (uint32_t) ((JS_INVALID_XY != d.x) & (JS_INVALID_XY != d.y));
+  }
+  p.len = len;
+
+  // brightness first, so dim specks don't shield real spikes from being
+  // seen as isolated
+  if (0 != min_brightness) {
+    MaskBrightness(&p, min_brightness << m_brightness_shift);
+    Compact(&p);
+  }
+
+  if (0 != spike_distance) {
+    MaskSpikes(&p, spike_distance);
+    Compact(&p);
+  }
+
+  if (0 != median_window) {
+    MedianY(&p, median_window);
+  }
+
+  for (uint32_t n = 0; n < p.len; n++) {
+    profile->data[n].x = p.x[n];
+    profile->data[n].y = p.y[n];
+    profile->data[n].brightness = p.brightness[n];
+  }
+  profile->data_len = p.len;
+}
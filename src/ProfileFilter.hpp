@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_FILTER_H
+#define JOESCAN_PROFILE_FILTER_H
+
+#include "joescan_pinchot.h"
+#include <atomic>
+
+namespace joescan {
+
+/**
+ * @brief Removes specks caused by dust and reflections from profiles.
+ *
+ * Three stages run in order, each of which can be disabled on its own:
+ * a minimum brightness gate, rejection of isolated points that are far
+ * from both of their neighbors, and a sliding median over Y. Settings may
+ * be changed from any thread while `Apply` runs on others.
+ */
+class ProfileFilter {
+ public:
+  static const uint32_t kMedianWindowMax = 5;
+
+  /**
+   * @param brightness_bit_depth Bits of brightness the scan heads report,
+   * as given by their capabilities.
+   */
+  explicit ProfileFilter(uint32_t brightness_bit_depth = 8);
+
+  /**
+   * @brief Drops points dimmer than `brightness`, on the 8 bit scale the
+   * viewer shows brightness on whatever the scan heads' bit depth; zero
+   * disables the gate.
+   */
+  void SetMinBrightness(int32_t brightness);
+  int32_t GetMinBrightness() const;
+
+  /**
+   * @brief Drops points whose distance to both neighbors exceeds
+   * `distance`, in 1/1000 inch; zero disables spike rejection.
+   */
+  void SetSpikeDistance(int32_t distance);
+  int32_t GetSpikeDistance() const;
+
+  /**
+   * @brief Sets the sliding median window over Y; 3 or 5 points, any
+   * smaller value disables the median.
+   */
+  void SetMedianWindow(uint32_t window);
+  uint32_t GetMedianWindow() const;
+
+  /**
+   * @return `true` if at least one stage is enabled.
+   */
+  bool IsEnabled() const;
+
+  /**
+   * @brief Filters a profile in place, dropping its invalid points along
+   * with the ones filtered out. Safe to call concurrently on different
+   * profiles.
+   */
+  void Apply(jsProfile *profile) const;
+
+ private:
+  // the gate is scaled up to the scan heads' depth rather than every
+  // point's brightness down
+  int32_t m_brightness_shift;
+  std::atomic<int32_t> m_min_brightness;
+  std::atomic<int32_t> m_spike_distance;
+  std::atomic<uint32_t> m_median_window;
+};
+
+} // namespace joescan
+
+#endif
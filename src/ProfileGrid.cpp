@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileGrid.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace joescan;
+
+ProfileGrid::ProfileGrid(double x_min,
+                         double x_max,
+                         double pitch,
+                         uint32_t row_count) :
+  m_x_min(x_min),
+  m_x_max(x_max),
+  m_pitch(0.0),
+  m_max_gap(0.25),
+  m_column_count(0),
+  m_row_count(row_count)
+{
+  SetPitch(pitch);
+}
+
+void ProfileGrid::SetPitch(double pitch)
+{
+  const double kMinPitch = 0.001;
+  if (kMinPitch > pitch) {
+    pitch = kMinPitch;
+  }
+
+  // small bias so a range that is a whole multiple of the pitch doesn't
+  // lose its last column to rounding
+  m_pitch = pitch;
+  m_column_count = (uint32_t) floor((m_x_max - m_x_min) / pitch + 1e-9) + 1;
+
+  m_x.resize(m_column_count);
+  for (uint32_t n = 0; n < m_column_count; n++) {
+    m_x[n] = m_x_min + n * pitch;
+  }
+
+  m_y.resize((size_t) m_row_count * m_column_count);
+  m_hits.resize((size_t) m_row_count * m_column_count);
+  m_valid_count.resize(m_row_count);
+  for (uint32_t n = 0; n < m_row_count; n++) {
+    Clear(n);
+  }
+}
+
+void ProfileGrid::SetMaxGap(double max_gap)
+{
+  m_max_gap = (0.0 > max_gap) ? 0.0 : max_gap;
+}
+
+void ProfileGrid::Clear(uint32_t row)
+{
+  double *y = &m_y[(size_t) row * m_column_count];
+  std::fill(y, y + m_column_count, std::numeric_limits<double>::quiet_NaN());
+  m_valid_count[row] = 0;
+}
+
+void ProfileGrid::Resample(uint32_t row, const ProfileBuffer &buffer)
+{
+  const uint32_t columns = m_column_count;
+  const double scale = 1.0 / m_pitch;
+  const double x_min = m_x_min;
+  double *__restrict y = &m_y[(size_t) row * columns];
+  uint32_t *__restrict hits = &m_hits[(size_t) row * columns];
+
+  std::fill(y, y + columns, 0.0);
+  std::fill(hits, hits + columns, 0);
+
+  // Bin every point into its nearest column. Profiles aren't guaranteed to
+  // be sorted in X once aligned, binning doesn't care.
+  for (uint32_t n = 0; n < buffer.data_len; n++) {
+    double c = floor((buffer.x[n] - x_min) * scale + 0.5);
+    if ((0.0 > c) || ((double) columns <= c)) {
+      continue;
+    }
+
+    uint32_t column = (uint32_t) c;
+    y[column] += buffer.y[n];
+    hits[column]++;
+  }
+
+  const double kNaN = std::numeric_limits<double>::quiet_NaN();
+  for (uint32_t n = 0; n < columns; n++) {
+    y[n] = (0 != hits[n]) ? y[n] / hits[n] : kNaN;
+  }
+
+  // Bridge gaps narrow enough to be point spacing rather than a real hole
+  // in the profile. `last` is the previous valid column.
+  const uint32_t max_gap = (uint32_t) (m_max_gap * scale);
+  uint32_t valid_count = 0;
+  int64_t last = -1;
+  for (uint32_t n = 0; n < columns; n++) {
+    if (0 == hits[n]) {
+      continue;
+    }
+
+    uint32_t gap = (uint32_t) (n - last);
+    if ((0 <= last) && (1 < gap) && (max_gap >= gap)) {
+      double y0 = y[last];
+      double dy = (y[n] - y0) / gap;
+      for (uint32_t k = 1; k < gap; k++) {
+        y[last + k] = y0 + dy * k;
+      }
+      valid_count += gap - 1;
+    }
+
+    valid_count++;
+    last = n;
+  }
+
+  m_valid_count[row] = valid_count;
+}
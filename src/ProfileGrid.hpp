@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_GRID_H
+#define JOESCAN_PROFILE_GRID_H
+
+#include "ProfileBuffer.hpp"
+#include <cmath>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Profiles resampled onto a fixed, uniformly spaced X grid.
+ *
+ * Every row holds the Y value of one profile at each grid column, stored
+ * back to back in a single array, so rows can be compared, stacked or
+ * averaged column by column. Columns without data hold NaN, which carries
+ * through arithmetic and is skipped when plotted.
+ */
+class ProfileGrid {
+ public:
+  /**
+   * @param x_min Position of the first column, in inches.
+   * @param x_max Last position covered, in inches.
+   * @param pitch Spacing between columns, in inches.
+   * @param row_count Number of rows.
+   */
+  ProfileGrid(double x_min, double x_max, double pitch, uint32_t row_count);
+
+  /**
+   * @brief Changes the column spacing; all rows are cleared.
+   */
+  void SetPitch(double pitch);
+  double GetPitch() const { return m_pitch; }
+
+  /**
+   * @brief Sets how wide a gap between points may be, in inches, and still
+   * be filled in by linear interpolation. Wider gaps are left invalid.
+   */
+  void SetMaxGap(double max_gap);
+  double GetMaxGap() const { return m_max_gap; }
+
+  double GetXMin() const { return m_x_min; }
+  uint32_t GetColumnCount() const { return m_column_count; }
+  uint32_t GetRowCount() const { return m_row_count; }
+
+  /**
+   * @return X position of every column.
+   */
+  const double *GetX() const { return m_x.data(); }
+
+  /**
+   * @return Y value of every column of a row, NaN where invalid.
+   */
+  const double *GetRow(uint32_t row) const
+  {
+    return &m_y[(size_t) row * m_column_count];
+  }
+
+  /**
+   * @return Number of valid columns in a row.
+   */
+  uint32_t GetValidCount(uint32_t row) const { return m_valid_count[row]; }
+
+  static bool IsValid(double y) { return !std::isnan(y); }
+
+  /**
+   * @brief Resamples a profile into a row. Points falling into the same
+   * column are averaged, gaps up to the maximum gap are interpolated. Rows
+   * are independent, so different rows may be resampled concurrently.
+   */
+  void Resample(uint32_t row, const ProfileBuffer &buffer);
+
+  /**
+   * @brief Marks every column of a row as invalid.
+   */
+  void Clear(uint32_t row);
+
+ private:
+  double m_x_min;
+  double m_x_max;
+  double m_pitch;
+  double m_max_gap;
+  uint32_t m_column_count;
+  uint32_t m_row_count;
+  std::vector<double> m_x;
+  std::vector<double> m_y;
+  std::vector<uint32_t> m_hits;
+  std::vector<uint32_t> m_valid_count;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileLod.hpp"
+#include <cmath>
+
+using namespace joescan;
+
+// levels needed for a full profile, plus the level of single points
+static const uint32_t kMaxLevels = 12;
+
+ProfileLod::ProfileLod(uint32_t buffer_count) :
+  m_buffers(buffer_count)
+{
+  for (auto &lod : m_buffers) {
+    lod.nodes.reserve(JS_PROFILE_DATA_LEN);
+    lod.level_start.reserve(kMaxLevels);
+    lod.point_count = 0;
+    lod.x_min = 0.0;
+    lod.x_max = 0.0;
+    lod.x.resize(JS_PROFILE_DATA_LEN);
+    lod.y.resize(JS_PROFILE_DATA_LEN);
+    lod.brightness.resize(JS_PROFILE_DATA_LEN);
+    lod.count = 0;
+  }
+}
+
+void ProfileLod::Update(uint32_t buffer, const ProfileBuffer &data)
+{
+  BufferLod &lod = m_buffers[buffer];
+  lod.nodes.clear();
+  lod.level_start.clear();
+  lod.point_count = data.data_len;
+  if (2 > data.data_len) {
+    lod.x_min = (0 == data.data_len) ? 0.0 : data.x[0];
+    lod.x_max = lod.x_min;
+    return;
+  }
+
+  // first level, pairs of points
+  lod.level_start.push_back(0);
+  for (uint32_t n = 0; n < data.data_len; n += 2) {
+    uint32_t a = n;
+    uint32_t b = (n + 1 < data.data_len) ? n + 1 : n;
+    Node node;
+    node.x_min = (float) fmin(data.x[a], data.x[b]);
+    node.x_max = (float) fmax(data.x[a], data.x[b]);
+    node.low = (uint16_t) ((data.y[a] <= data.y[b]) ? a : b);
+    node.high = (uint16_t) ((data.y[a] <= data.y[b]) ? b : a);
+    lod.nodes.push_back(node);
+  }
+
+  // every level above merges pairs of nodes until one is left
+  uint32_t start = 0;
+  uint32_t count = (uint32_t) lod.nodes.size();
+  while (1 < count) {
+    lod.level_start.push_back((uint32_t) lod.nodes.size());
+    for (uint32_t n = 0; n < count; n += 2) {
+      const Node a = lod.nodes[start + n];
+      const Node b = (n + 1 < count) ? lod.nodes[start + n + 1] : a;
+      Node node;
+      node.x_min = (a.x_min < b.x_min) ? a.x_min : b.x_min;
+      node.x_max = (a.x_max > b.x_max) ? a.x_max : b.x_max;
+      node.low = (data.y[a.low] <= data.y[b.low]) ? a.low : b.low;
+      node.high = (data.y[a.high] >= data.y[b.high]) ? a.high : b.high;
+      lod.nodes.push_back(node);
+    }
+    start = lod.level_start.back();
+    count = (uint32_t) lod.nodes.size() - start;
+  }
+
+  lod.x_min = lod.nodes.back().x_min;
+  lod.x_max = lod.nodes.back().x_max;
+}
+
+void ProfileLod::Emit(BufferLod &lod, const ProfileBuffer &data,
+                      uint32_t point)
+{
+  lod.x[lod.count] = data.x[point];
+  lod.y[lod.count] = data.y[point];
+  lod.brightness[lod.count] = data.brightness[point];
+  lod.count++;
+}
+
+void ProfileLod::Descend(BufferLod &lod,
+                         const ProfileBuffer &data,
+                         uint32_t level,
+                         uint32_t node,
+                         int target,
+                         double x_min,
+                         double x_max)
+{
+  const Node &n = lod.nodes[lod.level_start[level] + node];
+  if ((x_min > n.x_max) || (x_max < n.x_min)) {
+    return;
+  }
+
+  // kept in the order they were measured in, so lines still join up
+  if ((int) level == target) {
+    Emit(lod, data, (n.low < n.high) ? n.low : n.high);
+    if (n.low != n.high) {
+      Emit(lod, data, (n.low < n.high) ? n.high : n.low);
+    }
+    return;
+  }
+
+  if (0 == level) {
+    for (uint32_t p = 2 * node; (p < 2 * node + 2) &&
+                                (p < lod.point_count); p++) {
+      if ((x_min <= data.x[p]) && (x_max >= data.x[p])) {
+        Emit(lod, data, p);
+      }
+    }
+    return;
+  }
+
+  uint32_t child_count = lod.level_start[level] - lod.level_start[level - 1];
+  Descend(lod, data, level - 1, 2 * node, target, x_min, x_max);
+  if (2 * node + 1 < child_count) {
+    Descend(lod, data, level - 1, 2 * node + 1, target, x_min, x_max);
+  }
+}
+
+void ProfileLod::Select(uint32_t buffer,
+                        const ProfileBuffer &data,
+                        double x_min,
+                        double x_max,
+                        double pixel_size)
+{
+  BufferLod &lod = m_buffers[buffer];
+  lod.count = 0;
+  if (lod.level_start.empty()) {
+    for (uint32_t n = 0; n < lod.point_count; n++) {
+      Emit(lod, data, n);
+    }
+    return;
+  }
+
+  // a node of level `n` covers `2^(n+1)` points and keeps two of them, so
+  // the level whose nodes span about a pixel leaves two points per pixel
+  double spacing = (lod.x_max - lod.x_min) / lod.point_count;
+  double points_per_pixel = (0.0 < spacing) ? pixel_size / spacing : 0.0;
+  int top = (int) lod.level_start.size() - 1;
+  int target = -1;
+  if (2.0 <= points_per_pixel) {
+    target = (int) floor(log2(points_per_pixel)) - 1;
+    target = (top < target) ? top : target;
+  }
+
+  Descend(lod, data, (uint32_t) top, 0, target, x_min, x_max);
+}
+
+const double *ProfileLod::GetX(uint32_t buffer) const
+{
+  return m_buffers[buffer].x.data();
+}
+
+const double *ProfileLod::GetY(uint32_t buffer) const
+{
+  return m_buffers[buffer].y.data();
+}
+
+const uint8_t *ProfileLod::GetBrightness(uint32_t buffer) const
+{
+  return m_buffers[buffer].brightness.data();
+}
+
+uint32_t ProfileLod::GetCount(uint32_t buffer) const
+{
+  return m_buffers[buffer].count;
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_LOD_H
+#define JOESCAN_PROFILE_LOD_H
+
+#include "ProfileBuffer.hpp"
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Level of detail for drawing element buffers, so that a zoomed out
+ * plot only touches a fraction of the points.
+ *
+ * Each buffer gets a min/max pyramid along the profile: a node on the
+ * first level covers two neighbouring points, each level above covers
+ * twice as many, and every node keeps its extent in X along with its
+ * lowest and highest point. Selecting points for a view walks down from
+ * the top, skipping nodes outside the visible range of X, and stops at the
+ * level where a node spans about a pixel, keeping its lowest and highest
+ * point so the outline of the profile survives. Zoomed in far enough, the
+ * visible points are selected as they are.
+ */
+class ProfileLod {
+ public:
+  /**
+   * @param buffer_count Number of element buffers.
+   */
+  explicit ProfileLod(uint32_t buffer_count);
+
+  /**
+   * @brief Rebuilds the pyramid of one buffer. Different buffers may be
+   * updated concurrently.
+   */
+  void Update(uint32_t buffer, const ProfileBuffer &data);
+
+  /**
+   * @brief Selects the points of one buffer worth drawing in a view.
+   * Different buffers may be selected concurrently.
+   *
+   * @param buffer The buffer, as last passed to `Update`.
+   * @param data The buffer's points.
+   * @param x_min Left edge of the view, in inches.
+   * @param x_max Right edge of the view, in inches.
+   * @param pixel_size Width of a pixel, in inches.
+   */
+  void Select(uint32_t buffer, const ProfileBuffer &data,
+              double x_min, double x_max, double pixel_size);
+
+  const double *GetX(uint32_t buffer) const;
+  const double *GetY(uint32_t buffer) const;
+  const uint8_t *GetBrightness(uint32_t buffer) const;
+  uint32_t GetCount(uint32_t buffer) const;
+
+ private:
+  struct Node {
+    float x_min;
+    float x_max;
+    // indices of the node's lowest and highest points
+    uint16_t low;
+    uint16_t high;
+  };
+
+  struct BufferLod {
+    // level `n` starts at `level_start[n]` in `nodes`
+    std::vector<Node> nodes;
+    std::vector<uint32_t> level_start;
+    uint32_t point_count;
+    double x_min;
+    double x_max;
+    // points selected by the last call to `Select`
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<uint8_t> brightness;
+    uint32_t count;
+  };
+
+  void Descend(BufferLod &lod, const ProfileBuffer &data, uint32_t level,
+               uint32_t node, int target, double x_min, double x_max);
+  void Emit(BufferLod &lod, const ProfileBuffer &data, uint32_t point);
+
+  std::vector<BufferLod> m_buffers;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfilePool.hpp"
+
+using namespace joescan;
+
+ProfilePool::ProfilePool(uint32_t capacity) :
+  m_profiles(capacity),
+  m_count(0),
+  m_exhausted(0)
+{
+}
+
+jsProfile *ProfilePool::Acquire()
+{
+  if (m_profiles.size() == m_count) {
+    m_exhausted++;
+    return nullptr;
+  }
+
+  return &m_profiles[m_count++];
+}
+
+void ProfilePool::ReleaseLast()
+{
+  if (0 != m_count) {
+    m_count--;
+  }
+}
+
+void ProfilePool::Reset()
+{
+  m_count = 0;
+}
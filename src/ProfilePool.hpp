@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_POOL_H
+#define JOESCAN_PROFILE_POOL_H
+
+#include "joescan_pinchot.h"
+#include <cstdint>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Fixed number of profiles, allocated up front, handed out one at a
+ * time and all taken back at once.
+ *
+ * Profiles handed out are consecutive, so whatever has been taken since the
+ * last `Reset` can be passed on as a single array, as plugin batches are.
+ * When every profile is in use, `Acquire` returns none rather than
+ * allocating more.
+ */
+class ProfilePool {
+ public:
+  explicit ProfilePool(uint32_t capacity);
+
+  /**
+   * @return The next free profile, or `nullptr` if all are in use.
+   */
+  jsProfile *Acquire();
+
+  /**
+   * @brief Takes back the profile handed out last, when it wasn't used.
+   */
+  void ReleaseLast();
+
+  /**
+   * @brief Takes back every profile handed out.
+   */
+  void Reset();
+
+  /**
+   * @return The profiles handed out since the last `Reset`, in order.
+   */
+  const jsProfile *GetData() const { return m_profiles.data(); }
+  uint32_t GetCount() const { return m_count; }
+  uint32_t GetCapacity() const { return (uint32_t) m_profiles.size(); }
+
+  /**
+   * @return Number of times `Acquire` found every profile in use.
+   */
+  uint64_t GetExhaustedCount() const { return m_exhausted; }
+
+ private:
+  std::vector<jsProfile> m_profiles;
+  uint32_t m_count;
+  uint64_t m_exhausted;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,519 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileProtocol.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace joescan;
+
+// length and type
+static const uint32_t kFrameHeaderLen = 5;
+// anything longer than a full profile with every varint at its longest is
+// not a message of ours
+static const uint32_t kMaxPayloadLen = 512 + JS_PROFILE_DATA_LEN * 3 * 10;
+
+static void PutVarint(std::vector<uint8_t> *out, uint64_t v)
+{
+  while (0x80 <= v) {
+    out->push_back((uint8_t) (v | 0x80));
+    v >>= 7;
+  }
+  out->push_back((uint8_t) v);
+}
+
+static void PutSigned(std::vector<uint8_t> *out, int64_t v)
+{
+  PutVarint(out, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+static bool GetVarint(const uint8_t **p, const uint8_t *end, uint64_t *v)
+{
+  uint64_t value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    if (*p == end) {
+      return false;
+    }
+
+    uint8_t b = *(*p)++;
+    value |= (uint64_t) (b & 0x7F) << shift;
+    if (0 == (b & 0x80)) {
+      *v = value;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool GetSigned(const uint8_t **p, const uint8_t *end, int64_t *v)
+{
+  uint64_t u = 0;
+  if (!GetVarint(p, end, &u)) {
+    return false;
+  }
+
+  *v = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+  return true;
+}
+
+// reserves room for the frame header, filled in by `EndMessage`
+static size_t BeginMessage(std::vector<uint8_t> *out, uint8_t type)
+{
+  size_t start = out->size();
+  out->resize(start + kFrameHeaderLen);
+  (*out)[start + 4] = type;
+  return start;
+}
+
+static void EndMessage(std::vector<uint8_t> *out, size_t start)
+{
+  uint32_t len = (uint32_t) (out->size() - start - kFrameHeaderLen);
+  for (uint32_t n = 0; n < 4; n++) {
+    (*out)[start + n] = (uint8_t) (len >> (8 * n));
+  }
+}
+
+static bool IsSent(const jsProfileData &d,
+                   const ProfileSubscription &subscription)
+{
+  return (JS_INVALID_XY != d.x) &&
+         (subscription.x_min <= d.x) && (subscription.x_max >= d.x);
+}
+
+void joescan::EncodeHello(const ProfileHello &hello,
+                          std::vector<uint8_t> *out)
+{
+  size_t start = BeginMessage(out, kMessageHello);
+  PutVarint(out, kProfileProtocolVersion);
+  PutVarint(out, hello.element_count);
+  PutVarint(out, (hello.is_mode_camera) ? 1 : 0);
+  PutVarint(out, hello.serial_numbers.size());
+  for (auto serial_number : hello.serial_numbers) {
+    PutVarint(out, serial_number);
+  }
+  EndMessage(out, start);
+}
+
+void joescan::EncodeSubscribe(const ProfileSubscription &subscription,
+                              std::vector<uint8_t> *out)
+{
+  size_t start = BeginMessage(out, kMessageSubscribe);
+  PutVarint(out, subscription.downsample_level);
+  PutSigned(out, subscription.x_min);
+  PutSigned(out, subscription.x_max);
+  EndMessage(out, start);
+}
+
+void joescan::EncodeProfile(uint32_t head_index,
+                            const jsProfile &profile,
+                            const ProfileSubscription &subscription,
+                            std::vector<uint8_t> *out)
+{
+  size_t start = BeginMessage(out, kMessageProfile);
+  PutVarint(out, head_index);
+  PutVarint(out, profile.scan_head_id);
+  PutVarint(out, profile.camera);
+  PutVarint(out, profile.laser);
+  PutVarint(out, profile.timestamp_ns);
+  PutVarint(out, profile.flags);
+  PutVarint(out, profile.sequence_number);
+  PutVarint(out, profile.laser_on_time_us);
+  PutVarint(out, profile.format);
+  uint32_t encoder_count = (JS_ENCODER_MAX < profile.num_encoder_values) ?
+                           JS_ENCODER_MAX : profile.num_encoder_values;
+  PutVarint(out, encoder_count);
+  for (uint32_t n = 0; n < encoder_count; n++) {
+    PutSigned(out, profile.encoder_values[n]);
+  }
+
+  // the point count goes ahead of the points, so they are counted first
+  uint32_t level = (kMaxDownsampleLevel < subscription.downsample_level) ?
+                   kMaxDownsampleLevel : subscription.downsample_level;
+  uint32_t len = (JS_PROFILE_DATA_LEN < profile.data_len) ?
+                 JS_PROFILE_DATA_LEN : profile.data_len;
+  uint32_t count = 0;
+  for (uint32_t n = 0; n < len; n++) {
+    count += IsSent(profile.data[n], subscription) ? 1 : 0;
+  }
+  count = (count + (1u << level) - 1) >> level;
+  PutVarint(out, level);
+  PutVarint(out, count);
+
+  int32_t x = 0;
+  int32_t y = 0;
+  int32_t brightness = 0;
+  uint32_t sent = 0;
+  for (uint32_t n = 0; n < len; n++) {
+    const jsProfileData &d = profile.data[n];
+    if (!IsSent(d, subscription)) {
+      continue;
+    }
+    if (0 != (sent++ & ((1u << level) - 1))) {
+      continue;
+    }
+
+    PutSigned(out, (int64_t) d.x - x);
+    PutSigned(out, (int64_t) d.y - y);
+    PutSigned(out, (int64_t) d.brightness - brightness);
+    x = d.x;
+    y = d.y;
+    brightness = d.brightness;
+  }
+
+  EndMessage(out, start);
+}
+
+size_t joescan::ParseMessage(const uint8_t *data,
+                             size_t len,
+                             uint8_t *type,
+                             const uint8_t **payload,
+                             uint32_t *payload_len)
+{
+  if (kFrameHeaderLen > len) {
+    return 0;
+  }
+
+  uint32_t n = (uint32_t) data[0] | ((uint32_t) data[1] << 8) |
+               ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+  if (kMaxPayloadLen < n) {
+    throw std::runtime_error("message too long");
+  }
+  if (kFrameHeaderLen + n > len) {
+    return 0;
+  }
+
+  *type = data[4];
+  *payload = data + kFrameHeaderLen;
+  *payload_len = n;
+  return kFrameHeaderLen + n;
+}
+
+bool joescan::DecodeHello(const uint8_t *payload,
+                          uint32_t len,
+                          ProfileHello *hello)
+{
+  const uint8_t *p = payload;
+  const uint8_t *end = payload + len;
+  uint64_t version = 0;
+  uint64_t element_count = 0;
+  uint64_t is_mode_camera = 0;
+  uint64_t head_count = 0;
+  if (!GetVarint(&p, end, &version) ||
+      (kProfileProtocolVersion != version) ||
+      !GetVarint(&p, end, &element_count) ||
+      !GetVarint(&p, end, &is_mode_camera) ||
+      !GetVarint(&p, end, &head_count) ||
+      (len < head_count)) {
+    return false;
+  }
+
+  hello->element_count = (uint32_t) element_count;
+  hello->is_mode_camera = (0 != is_mode_camera);
+  hello->serial_numbers.resize((size_t) head_count);
+  for (auto &serial_number : hello->serial_numbers) {
+    uint64_t v = 0;
+    if (!GetVarint(&p, end, &v)) {
+      return false;
+    }
+    serial_number = (uint32_t) v;
+  }
+
+  return true;
+}
+
+bool joescan::DecodeSubscribe(const uint8_t *payload,
+                              uint32_t len,
+                              ProfileSubscription *subscription)
+{
+  const uint8_t *p = payload;
+  const uint8_t *end = payload + len;
+  uint64_t level = 0;
+  int64_t x_min = 0;
+  int64_t x_max = 0;
+  if (!GetVarint(&p, end, &level) || !GetSigned(&p, end, &x_min) ||
+      !GetSigned(&p, end, &x_max) || (INT_MIN > x_min) ||
+      (INT_MAX < x_max) || (x_min > x_max)) {
+    return false;
+  }
+
+  subscription->downsample_level = (kMaxDownsampleLevel < level) ?
+                                   kMaxDownsampleLevel : (uint32_t) level;
+  subscription->x_min = (int32_t) x_min;
+  subscription->x_max = (int32_t) x_max;
+  return true;
+}
+
+bool joescan::DecodeProfile(const uint8_t *payload,
+                            uint32_t len,
+                            uint32_t *head_index,
+                            jsProfile *profile)
+{
+  const uint8_t *p = payload;
+  const uint8_t *end = payload + len;
+  uint64_t v[10];
+  for (uint32_t n = 0; n < 10; n++) {
+    if (!GetVarint(&p, end, &v[n])) {
+      return false;
+    }
+  }
+  if (JS_ENCODER_MAX < v[9]) {
+    return false;
+  }
+
+  *head_index = (uint32_t) v[0];
+  profile->scan_head_id = (uint32_t) v[1];
+  profile->camera = (jsCamera) v[2];
+  profile->laser = (jsLaser) v[3];
+  profile->timestamp_ns = v[4];
+  profile->flags = (uint32_t) v[5];
+  profile->sequence_number = (uint32_t) v[6];
+  profile->laser_on_time_us = (uint32_t) v[7];
+  profile->format = (jsDataFormat) v[8];
+  profile->num_encoder_values = (uint32_t) v[9];
+  for (uint32_t n = 0; n < profile->num_encoder_values; n++) {
+    if (!GetSigned(&p, end, &profile->encoder_values[n])) {
+      return false;
+    }
+  }
+
+  uint64_t level = 0;
+  uint64_t count = 0;
+  if (!GetVarint(&p, end, &level) || !GetVarint(&p, end, &count) ||
+      (JS_PROFILE_DATA_LEN < count)) {
+    return false;
+  }
+
+  int64_t x = 0;
+  int64_t y = 0;
+  int64_t brightness = 0;
+  for (uint32_t n = 0; n < count; n++) {
+    int64_t dx = 0;
+    int64_t dy = 0;
+    int64_t db = 0;
+    if (!GetSigned(&p, end, &dx) || !GetSigned(&p, end, &dy) ||
+        !GetSigned(&p, end, &db)) {
+      return false;
+    }
+
+    x += dx;
+    y += dy;
+    brightness += db;
+    profile->data[n].x = (int32_t) x;
+    profile->data[n].y = (int32_t) y;
+    profile->data[n].brightness = (int32_t) brightness;
+  }
+  profile->data_len = (uint32_t) count;
+  profile->packets_received = 0;
+  profile->packets_expected = 0;
+
+  return true;
+}
+
+#if defined(_WIN32)
+
+int joescan::OpenListenSocket(const std::string &address,
+                              std::string *unix_path)
+{
+  throw std::runtime_error(address + ": sockets need POSIX");
+}
+
+int joescan::OpenConnectSocket(const std::string &address)
+{
+  throw std::runtime_error(address + ": sockets need POSIX");
+}
+
+void joescan::CloseSocket(int fd)
+{
+}
+
+#else
+
+static bool IsUnixAddress(const std::string &address, std::string *path)
+{
+  if (0 == address.compare(0, 5, "unix:")) {
+    *path = address.substr(5);
+    return true;
+  }
+  if (std::string::npos != address.find('/')) {
+    *path = address;
+    return true;
+  }
+
+  path->clear();
+  return false;
+}
+
+/**
+ * @brief Removes a socket file left behind by a daemon that didn't exit
+ * cleanly. Only a socket nobody listens on is removed; anything else at the
+ * path is left alone and reported.
+ */
+static void RemoveStaleUnixSocket(const std::string &path,
+                                  const sockaddr_un &addr)
+{
+  struct stat st;
+  if (0 != lstat(path.c_str(), &st)) {
+    if (ENOENT == errno) {
+      return;
+    }
+    throw std::runtime_error(path + ": " + strerror(errno));
+  }
+  if (!S_ISSOCK(st.st_mode)) {
+    throw std::runtime_error(path + ": exists and is not a socket");
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (0 > fd) {
+    throw std::runtime_error(path + ": " + strerror(errno));
+  }
+  int r = connect(fd, (const sockaddr *) &addr, sizeof(addr));
+  int error = errno;
+  close(fd);
+  if (0 == r) {
+    throw std::runtime_error(path + ": in use");
+  }
+  if (ECONNREFUSED != error) {
+    throw std::runtime_error(path + ": " + strerror(error));
+  }
+
+  unlink(path.c_str());
+}
+
+static int OpenUnixSocket(const std::string &path, bool is_listen)
+{
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  if (sizeof(addr.sun_path) <= path.size()) {
+    throw std::runtime_error(path + ": path too long");
+  }
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path.c_str(), path.size());
+
+  if (is_listen) {
+    RemoveStaleUnixSocket(path, addr);
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (0 > fd) {
+    throw std::runtime_error(path + ": " + strerror(errno));
+  }
+
+  int r = 0;
+  if (is_listen) {
+    r = bind(fd, (sockaddr *) &addr, sizeof(addr));
+    r = (0 == r) ? listen(fd, 8) : r;
+  } else {
+    r = connect(fd, (sockaddr *) &addr, sizeof(addr));
+  }
+  if (0 != r) {
+    int error = errno;
+    close(fd);
+    throw std::runtime_error(path + ": " + strerror(error));
+  }
+
+  return fd;
+}
+
+static int OpenTcpSocket(const std::string &address, bool is_listen)
+{
+  std::string host;
+  std::string port = address;
+  size_t colon = address.rfind(':');
+  if (std::string::npos != colon) {
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+  }
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = (is_listen) ? AI_PASSIVE : 0;
+
+  addrinfo *info = nullptr;
+  int r = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                      &hints, &info);
+  if (0 != r) {
+    throw std::runtime_error(address + ": " + gai_strerror(r));
+  }
+
+  int fd = -1;
+  int error = 0;
+  for (addrinfo *ai = info; nullptr != ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (0 > fd) {
+      error = errno;
+      continue;
+    }
+
+    int one = 1;
+    if (is_listen) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      r = bind(fd, ai->ai_addr, ai->ai_addrlen);
+      r = (0 == r) ? listen(fd, 8) : r;
+    } else {
+      r = connect(fd, ai->ai_addr, ai->ai_addrlen);
+    }
+    if (0 == r) {
+      // profiles are sent as soon as they are written, not batched up
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      break;
+    }
+
+    error = errno;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(info);
+
+  if (0 > fd) {
+    throw std::runtime_error(address + ": " + strerror(error));
+  }
+
+  return fd;
+}
+
+int joescan::OpenListenSocket(const std::string &address,
+                              std::string *unix_path)
+{
+  if (IsUnixAddress(address, unix_path)) {
+    return OpenUnixSocket(*unix_path, true);
+  }
+
+  return OpenTcpSocket(address, true);
+}
+
+int joescan::OpenConnectSocket(const std::string &address)
+{
+  std::string path;
+  if (IsUnixAddress(address, &path)) {
+    return OpenUnixSocket(path, false);
+  }
+
+  return OpenTcpSocket(address, false);
+}
+
+void joescan::CloseSocket(int fd)
+{
+  if (0 <= fd) {
+    close(fd);
+  }
+}
+
+#endif
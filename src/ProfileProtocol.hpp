@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_PROTOCOL_H
+#define JOESCAN_PROFILE_PROTOCOL_H
+
+#include "joescan_pinchot.h"
+#include <climits>
+#include <string>
+#include <vector>
+
+/**
+ * Messages exchanged between the acquisition daemon and its viewers.
+ *
+ * Every message is framed as a 32-bit little endian payload length and a
+ * one byte message type, followed by the payload. Integers within payloads
+ * are LEB128 varints, signed ones zigzag encoded first. Upon connecting, a
+ * viewer receives a hello describing the scan heads, followed by every
+ * profile published from then on. A viewer may send a subscribe message at
+ * any time to change how far profiles are downsampled for it and the range
+ * of X it wants points for, so that it is only sent the detail it can show.
+ *
+ * Profile points are sent as the difference to the previous point, so the
+ * slowly changing coordinates along a profile mostly take a byte or two
+ * each. Only valid points are sent.
+ */
+
+namespace joescan {
+
+const uint32_t kProfileProtocolVersion = 2;
+
+/**
+ * @brief Highest downsampling level; level `n` sends every `2^n`th point.
+ */
+const uint32_t kMaxDownsampleLevel = 4;
+
+enum ProfileMessageType {
+  kMessageHello = 1,
+  kMessageSubscribe = 2,
+  kMessageProfile = 3,
+};
+
+struct ProfileHello {
+  uint32_t element_count;
+  bool is_mode_camera;
+  std::vector<uint32_t> serial_numbers;
+};
+
+/**
+ * @brief What a viewer wants to be sent; by default every point.
+ */
+struct ProfileSubscription {
+  uint32_t downsample_level = 0;
+  // points outside this range of X, in mils, are left out
+  int32_t x_min = INT_MIN;
+  int32_t x_max = INT_MAX;
+
+  bool operator==(const ProfileSubscription &other) const
+  {
+    return (downsample_level == other.downsample_level) &&
+           (x_min == other.x_min) && (x_max == other.x_max);
+  }
+};
+
+/**
+ * @brief Appends a hello message to `out`.
+ */
+void EncodeHello(const ProfileHello &hello, std::vector<uint8_t> *out);
+
+/**
+ * @brief Appends a subscribe message to `out`.
+ */
+void EncodeSubscribe(const ProfileSubscription &subscription,
+                     std::vector<uint8_t> *out);
+
+/**
+ * @brief Appends a profile message to `out`.
+ *
+ * @param head_index Index of the scan head the profile came from.
+ * @param profile The profile; invalid points are left out.
+ * @param subscription Only every `2^level`th valid point within the range
+ * of X is sent.
+ */
+void EncodeProfile(uint32_t head_index, const jsProfile &profile,
+                   const ProfileSubscription &subscription,
+                   std::vector<uint8_t> *out);
+
+/**
+ * @brief Finds the first message in a stream of received bytes.
+ *
+ * @param data Received bytes, starting at a message boundary.
+ * @param len Number of bytes received.
+ * @param type Receives the message type.
+ * @param payload Receives the start of the payload, within `data`.
+ * @param payload_len Receives the length of the payload.
+ * @return Length of the whole message, or zero if it hasn't been received
+ * in full yet.
+ * @throw std::runtime_error if the message is too long to be valid.
+ */
+size_t ParseMessage(const uint8_t *data, size_t len, uint8_t *type,
+                    const uint8_t **payload, uint32_t *payload_len);
+
+/**
+ * @return `false` if the payload is malformed.
+ */
+bool DecodeHello(const uint8_t *payload, uint32_t len, ProfileHello *hello);
+bool DecodeSubscribe(const uint8_t *payload, uint32_t len,
+                     ProfileSubscription *subscription);
+bool DecodeProfile(const uint8_t *payload, uint32_t len,
+                   uint32_t *head_index, jsProfile *profile);
+
+/**
+ * @brief Opens a socket listening on an address: `unix:PATH` or anything
+ * with a `/` in it is a Unix domain socket, `[HOST:]PORT` is TCP, on all
+ * interfaces if no host is given.
+ *
+ * @param address Address to listen on.
+ * @param unix_path Receives the path of a Unix domain socket, which the
+ * caller removes when done; cleared for TCP.
+ * @throw std::runtime_error on failure.
+ */
+int OpenListenSocket(const std::string &address, std::string *unix_path);
+
+/**
+ * @brief Connects to an address given as for `OpenListenSocket`, with TCP
+ * connecting to the local machine if no host is given.
+ *
+ * @throw std::runtime_error on failure.
+ */
+int OpenConnectSocket(const std::string &address);
+
+/**
+ * @brief Closes a socket opened by one of the above.
+ */
+void CloseSocket(int fd);
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileRecorder.hpp"
+#include "Trace.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+using namespace joescan;
+
+// how long the writing thread sleeps when every ring is empty
+static const uint32_t kIdleSleepMs = 2;
+
+ProfileRecorder::ProfileRecorder(const std::string &path,
+                                 const RecordingInfo &info) :
+  m_path(path),
+  m_writer(path, info),
+  m_is_running(true),
+  m_is_failed(false),
+  m_written(0),
+  m_dropped(0),
+  m_bytes_written(0),
+  m_writer_memory(0)
+{
+  static_assert(0 == (kRingSize & (kRingSize - 1)),
+                "ring size must be a power of two");
+
+  for (uint32_t n = 0; n < info.serial_numbers.size(); n++) {
+    std::unique_ptr<HeadRing> head(new HeadRing);
+    head->ring.resize(kRingSize);
+    head->read_idx = 0;
+    head->write_idx = 0;
+    m_heads.push_back(std::move(head));
+  }
+
+  m_thread = std::thread(&ProfileRecorder::RecordThread, this);
+}
+
+ProfileRecorder::~ProfileRecorder()
+{
+  m_is_running = false;
+  m_thread.join();
+}
+
+void ProfileRecorder::Add(uint32_t head_index, const jsProfile &profile)
+{
+  if ((m_heads.size() <= head_index) || m_is_failed) {
+    return;
+  }
+
+  HeadRing &head = *m_heads[head_index];
+  uint32_t write_idx = head.write_idx.load(std::memory_order_relaxed);
+  if (kRingSize == write_idx - head.read_idx.load(std::memory_order_acquire)) {
+    m_dropped++;
+    return;
+  }
+
+  // only copy the points actually used
+  jsProfile &dst = head.ring[write_idx & (kRingSize - 1)];
+  uint32_t len = (JS_PROFILE_DATA_LEN < profile.data_len) ?
+                 JS_PROFILE_DATA_LEN : profile.data_len;
+  memcpy(&dst, &profile, offsetof(jsProfile, data));
+  memcpy(dst.data, profile.data, len * sizeof(jsProfileData));
+  dst.data_len = len;
+  head.write_idx.store(write_idx + 1, std::memory_order_release);
+}
+
+size_t ProfileRecorder::GetMemoryUsage() const
+{
+  size_t len = (size_t) m_writer_memory;
+  for (auto &head : m_heads) {
+    len += head->ring.size() * sizeof(jsProfile);
+  }
+
+  return len;
+}
+
+std::string ProfileRecorder::GetError() const
+{
+  std::lock_guard<std::mutex> lock(m_error_mutex);
+  return m_error;
+}
+
+bool ProfileRecorder::Drain()
+{
+  bool is_drained = false;
+  for (uint32_t n = 0; n < m_heads.size(); n++) {
+    HeadRing &head = *m_heads[n];
+    uint32_t read_idx = head.read_idx.load(std::memory_order_relaxed);
+    uint32_t write_idx = head.write_idx.load(std::memory_order_acquire);
+    for (; read_idx != write_idx; read_idx++) {
+      m_writer.Append(n, head.ring[read_idx & (kRingSize - 1)]);
+      head.read_idx.store(read_idx + 1, std::memory_order_release);
+      m_written++;
+      is_drained = true;
+    }
+  }
+
+  return is_drained;
+}
+
+void ProfileRecorder::RecordThread()
+{
+  const auto kFlushInterval = std::chrono::milliseconds(kFlushIntervalMs);
+  auto next_flush = std::chrono::steady_clock::now() + kFlushInterval;
+
+  Trace::SetThreadName("Recorder");
+  try {
+    while (m_is_running) {
+      // idle passes are left out of the trace
+      uint64_t begin_ns = (Trace::IsEnabled()) ? Trace::Now() : 0;
+      bool is_drained = Drain();
+      if (is_drained && (0 != begin_ns)) {
+        Trace::Add("Write Profiles", begin_ns, Trace::Now());
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      if (now >= next_flush) {
+        TraceSpan span("Flush Recording");
+        m_writer.Flush();
+        next_flush = now + kFlushInterval;
+      }
+      m_bytes_written = m_writer.GetBytesWritten();
+      m_writer_memory = m_writer.GetMemoryUsage();
+
+      if (!is_drained) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kIdleSleepMs));
+      }
+    }
+
+    Drain();
+    m_writer.Flush();
+    m_bytes_written = m_writer.GetBytesWritten();
+  } catch (std::runtime_error &e) {
+    std::lock_guard<std::mutex> lock(m_error_mutex);
+    m_error = e.what();
+    m_is_failed = true;
+  }
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_RECORDER_H
+#define JOESCAN_PROFILE_RECORDER_H
+
+#include "Recording.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Records every profile acquired to a recording file, which other
+ * viewers can follow as it grows.
+ *
+ * Profiles are queued in one single producer / single consumer ring per
+ * scan head, filled from that scan head's acquisition thread, and written
+ * by a thread of its own. Whatever has been queued is written out at least
+ * every `kFlushIntervalMs`, so followers are never far behind. Profiles
+ * that arrive while a ring is full are dropped.
+ */
+class ProfileRecorder {
+ public:
+  /**
+   * @brief Number of profiles queued per scan head; must be a power of
+   * two.
+   */
+  static const uint32_t kRingSize = 256;
+  static const uint32_t kFlushIntervalMs = 100;
+
+  /**
+   * @brief Creates the recording and starts the writing thread.
+   *
+   * @throw std::runtime_error if the file can't be written.
+   */
+  ProfileRecorder(const std::string &path, const RecordingInfo &info);
+
+  /**
+   * @brief Writes out whatever is queued and closes the file.
+   */
+  ~ProfileRecorder();
+
+  /**
+   * @brief Queues a profile; for each scan head, only ever called from one
+   * thread at a time.
+   */
+  void Add(uint32_t head_index, const jsProfile &profile);
+
+  const std::string &GetPath() const { return m_path; }
+  uint64_t GetProfilesWritten() const { return m_written; }
+  uint64_t GetProfilesDropped() const { return m_dropped; }
+  uint64_t GetBytesWritten() const { return m_bytes_written; }
+
+  /**
+   * @return Bytes allocated for the rings and the writer's buffers.
+   */
+  size_t GetMemoryUsage() const;
+
+  /**
+   * @return Why recording stopped, if it has.
+   */
+  std::string GetError() const;
+
+ private:
+  struct HeadRing {
+    std::vector<jsProfile> ring;
+    std::atomic<uint32_t> read_idx;
+    std::atomic<uint32_t> write_idx;
+  };
+
+  void RecordThread();
+  bool Drain();
+
+  std::string m_path;
+  RecordingWriter m_writer;
+  std::vector<std::unique_ptr<HeadRing>> m_heads;
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+  std::atomic<bool> m_is_failed;
+  std::atomic<uint64_t> m_written;
+  std::atomic<uint64_t> m_dropped;
+  std::atomic<uint64_t> m_bytes_written;
+  // the writer's buffers only change on the writing thread
+  std::atomic<uint64_t> m_writer_memory;
+
+  mutable std::mutex m_error_mutex;
+  std::string m_error;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,300 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ProfileServer.hpp"
+#include "Trace.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace joescan;
+
+// how long the server thread sleeps when there is nothing to do, which is
+// also the most a queued profile waits before being sent
+static const int kPollTimeoutMs = 2;
+// sent bytes are only cut from the front of a backlog past this much
+static const size_t kCompactBytes = 1024 * 1024;
+
+ProfileServer::ProfileServer(const std::string &address,
+                             const ProfileHello &hello) :
+  m_listen_fd(-1),
+  m_hello(hello),
+  m_is_running(true),
+  m_queue(kQueueLen),
+  m_queue_heads(kQueueLen),
+  m_read_idx(0),
+  m_write_idx(0),
+  m_dropped(0),
+  m_client_count(0),
+  m_dropped_clients(0),
+  m_bytes_sent(0)
+{
+  m_listen_fd = OpenListenSocket(address, &m_unix_path);
+#if !defined(_WIN32)
+  fcntl(m_listen_fd, F_SETFL, fcntl(m_listen_fd, F_GETFL) | O_NONBLOCK);
+#endif
+  m_thread = std::thread(&ProfileServer::ServerThread, this);
+}
+
+ProfileServer::~ProfileServer()
+{
+  m_is_running = false;
+  m_thread.join();
+
+  for (auto &client : m_clients) {
+    CloseSocket(client.fd);
+  }
+  CloseSocket(m_listen_fd);
+#if !defined(_WIN32)
+  if (!m_unix_path.empty()) {
+    unlink(m_unix_path.c_str());
+  }
+#endif
+}
+
+void ProfileServer::Publish(uint32_t head_index, const jsProfile &profile)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (kQueueLen == m_write_idx - m_read_idx) {
+    m_dropped++;
+    return;
+  }
+
+  // only as much of the profile as holds points
+  uint32_t slot = (uint32_t) (m_write_idx % kQueueLen);
+  uint32_t len = (JS_PROFILE_DATA_LEN < profile.data_len) ?
+                 JS_PROFILE_DATA_LEN : profile.data_len;
+  memcpy(&m_queue[slot], &profile,
+         offsetof(jsProfile, data) + len * sizeof(jsProfileData));
+  m_queue[slot].data_len = len;
+  m_queue_heads[slot] = head_index;
+  m_write_idx++;
+}
+
+ProfileServer::Stats ProfileServer::GetStats() const
+{
+  Stats stats;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.published = m_write_idx;
+    stats.dropped = m_dropped;
+  }
+  stats.clients = m_client_count;
+  stats.dropped_clients = m_dropped_clients;
+  stats.bytes_sent = m_bytes_sent;
+  return stats;
+}
+
+void ProfileServer::Encode(uint32_t slot)
+{
+  // each subscription is encoded once, however many viewers share it
+  for (uint32_t n = 0; n < m_clients.size(); n++) {
+    Client &client = m_clients[n];
+    const std::vector<uint8_t> *shared = nullptr;
+    for (uint32_t m = 0; (m < n) && (nullptr == shared); m++) {
+      if (m_clients[m].subscription == client.subscription) {
+        shared = &m_clients[m].encoded;
+      }
+    }
+
+    if (nullptr == shared) {
+      client.encoded.clear();
+      EncodeProfile(m_queue_heads[slot], m_queue[slot], client.subscription,
+                    &client.encoded);
+    }
+    const std::vector<uint8_t> &message =
+      (nullptr == shared) ? client.encoded : *shared;
+
+    size_t backlog = client.out.size() - client.out_sent;
+    if (kMaxBacklogBytes < backlog + message.size()) {
+      m_dropped_clients++;
+      continue;
+    }
+    client.out.insert(client.out.end(), message.begin(), message.end());
+  }
+}
+
+#if defined(_WIN32)
+
+void ProfileServer::ServerThread() {}
+void ProfileServer::Accept() {}
+bool ProfileServer::Receive(Client &client) { return false; }
+bool ProfileServer::Send(Client &client) { return false; }
+
+#else
+
+void ProfileServer::Accept()
+{
+  while (true) {
+    int fd = accept(m_listen_fd, nullptr, nullptr);
+    if (0 > fd) {
+      return;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    Client client;
+    client.fd = fd;
+    client.out_sent = 0;
+    EncodeHello(m_hello, &client.out);
+    m_clients.push_back(std::move(client));
+  }
+}
+
+bool ProfileServer::Receive(Client &client)
+{
+  uint8_t buf[4096];
+  while (true) {
+    ssize_t n = recv(client.fd, buf, sizeof(buf), 0);
+    if (0 < n) {
+      client.in.insert(client.in.end(), buf, buf + n);
+      continue;
+    }
+    if ((0 > n) && ((EAGAIN == errno) || (EWOULDBLOCK == errno))) {
+      break;
+    }
+    return false;
+  }
+
+  size_t used = 0;
+  try {
+    while (true) {
+      uint8_t type = 0;
+      const uint8_t *payload = nullptr;
+      uint32_t payload_len = 0;
+      size_t len = ParseMessage(client.in.data() + used,
+                                client.in.size() - used,
+                                &type,
+                                &payload,
+                                &payload_len);
+      if (0 == len) {
+        break;
+      }
+
+      ProfileSubscription subscription;
+      if ((kMessageSubscribe == type) &&
+          DecodeSubscribe(payload, payload_len, &subscription)) {
+        client.subscription = subscription;
+      }
+      used += len;
+    }
+  } catch (std::runtime_error &) {
+    return false;
+  }
+
+  client.in.erase(client.in.begin(), client.in.begin() + used);
+  return true;
+}
+
+bool ProfileServer::Send(Client &client)
+{
+  while (client.out_sent < client.out.size()) {
+    ssize_t n = send(client.fd,
+                     client.out.data() + client.out_sent,
+                     client.out.size() - client.out_sent,
+                     MSG_NOSIGNAL);
+    if (0 > n) {
+      return (EAGAIN == errno) || (EWOULDBLOCK == errno);
+    }
+
+    client.out_sent += n;
+    m_bytes_sent += n;
+  }
+
+  if (client.out_sent == client.out.size()) {
+    client.out.clear();
+    client.out_sent = 0;
+  } else if (kCompactBytes < client.out_sent) {
+    client.out.erase(client.out.begin(),
+                     client.out.begin() + client.out_sent);
+    client.out_sent = 0;
+  }
+
+  return true;
+}
+
+void ProfileServer::ServerThread()
+{
+  std::vector<pollfd> fds;
+  std::vector<bool> is_open;
+  Trace::SetThreadName("Server");
+
+  while (m_is_running) {
+    fds.resize(m_clients.size() + 1);
+    fds[0].fd = m_listen_fd;
+    fds[0].events = POLLIN;
+    for (uint32_t n = 0; n < m_clients.size(); n++) {
+      const Client &client = m_clients[n];
+      fds[n + 1].fd = client.fd;
+      fds[n + 1].events = POLLIN;
+      if (client.out_sent < client.out.size()) {
+        fds[n + 1].events |= POLLOUT;
+      }
+    }
+    for (auto &fd : fds) {
+      fd.revents = 0;
+    }
+
+    poll(fds.data(), (nfds_t) fds.size(), kPollTimeoutMs);
+
+    is_open.assign(m_clients.size(), true);
+    for (uint32_t n = 0; n < m_clients.size(); n++) {
+      if (0 != (fds[n + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+        is_open[n] = Receive(m_clients[n]);
+      }
+    }
+
+    uint64_t read_idx = 0;
+    uint64_t write_idx = 0;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      read_idx = m_read_idx;
+      write_idx = m_write_idx;
+    }
+    if (read_idx != write_idx) {
+      TraceSpan span("Encode Profiles");
+      for (uint64_t n = read_idx; n < write_idx; n++) {
+        Encode((uint32_t) (n % kQueueLen));
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_read_idx = write_idx;
+    }
+
+    for (uint32_t n = 0; n < m_clients.size(); n++) {
+      is_open[n] = is_open[n] && Send(m_clients[n]);
+    }
+
+    for (uint32_t n = (uint32_t) m_clients.size(); 0 < n; n--) {
+      if (!is_open[n - 1]) {
+        CloseSocket(m_clients[n - 1].fd);
+        m_clients.erase(m_clients.begin() + (n - 1));
+      }
+    }
+
+    // new viewers only start with the profiles published after they join
+    if (0 != (fds[0].revents & POLLIN)) {
+      Accept();
+    }
+    m_client_count = (uint32_t) m_clients.size();
+  }
+}
+
+#endif
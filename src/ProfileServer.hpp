@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_PROFILE_SERVER_H
+#define JOESCAN_PROFILE_SERVER_H
+
+#include "ProfileProtocol.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Serves profiles to any number of viewers over a socket, using
+ * the messages of `ProfileProtocol.hpp`.
+ *
+ * Publishing only copies the profile into a queue, so it is cheap enough
+ * for the acquisition threads. Everything else, accepting viewers, encoding
+ * for what each viewer subscribed to and sending, happens on the server's
+ * own thread. Viewers subscribed alike share one encoding of each profile.
+ * A viewer that can't keep up has profiles dropped once its backlog is
+ * full; one that goes away is simply forgotten.
+ */
+class ProfileServer {
+ public:
+  static const uint32_t kQueueLen = 1024;
+  static const uint32_t kMaxBacklogBytes = 16 * 1024 * 1024;
+
+  struct Stats {
+    uint32_t clients;
+    uint64_t published;
+    // dropped before encoding because the queue was full
+    uint64_t dropped;
+    // dropped for individual viewers because their backlog was full
+    uint64_t dropped_clients;
+    uint64_t bytes_sent;
+  };
+
+  /**
+   * @brief Starts listening and the server thread.
+   *
+   * @param address Address as for `OpenListenSocket`.
+   * @param hello Sent to every viewer as it connects.
+   * @throw std::runtime_error if the address can't be listened on.
+   */
+  ProfileServer(const std::string &address, const ProfileHello &hello);
+
+  /**
+   * @brief Stops the server thread and disconnects all viewers.
+   */
+  ~ProfileServer();
+
+  /**
+   * @brief Queues a profile for all viewers; may be called from any
+   * thread.
+   */
+  void Publish(uint32_t head_index, const jsProfile &profile);
+
+  Stats GetStats() const;
+
+ private:
+  struct Client {
+    int fd;
+    ProfileSubscription subscription;
+    // the latest profile as encoded for this subscription
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    size_t out_sent;
+  };
+
+  void ServerThread();
+  void Accept();
+  bool Receive(Client &client);
+  bool Send(Client &client);
+  void Encode(uint32_t slot);
+
+  std::string m_unix_path;
+  int m_listen_fd;
+  ProfileHello m_hello;
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+
+  // profiles waiting to be encoded; slots between the read and write
+  // indices are only touched by the server thread
+  mutable std::mutex m_mutex;
+  std::vector<jsProfile> m_queue;
+  std::vector<uint32_t> m_queue_heads;
+  uint64_t m_read_idx;
+  uint64_t m_write_idx;
+  uint64_t m_dropped;
+
+  // only touched by the server thread, apart from the counts
+  std::vector<Client> m_clients;
+  std::atomic<uint32_t> m_client_count;
+  std::atomic<uint64_t> m_dropped_clients;
+  std::atomic<uint64_t> m_bytes_sent;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,434 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "Recording.hpp"
+#include "PointCodec.hpp"
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace joescan;
+
+static const uint32_t kRecordingEncoders = 3;
+// stdio buffers at most this much before writing; chunks larger than it
+// are written straight from the chunk buffer
+static const size_t kFileBufferLen = 1 << 20;
+// far more than a chunk of whole profiles takes; anything larger is taken
+// to be corrupt rather than allocated
+static const uint32_t kMaxChunkLen = 256 << 20;
+// recordings are read through a window of the file mapped this large, or
+// larger if a chunk needs it
+static const uint64_t kMapWindowLen = 64 << 20;
+
+static uint32_t ReadLe32(const uint8_t *p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t ReadLe64(const uint8_t *p)
+{
+  return (uint64_t) ReadLe32(p) | ((uint64_t) ReadLe32(p + 4) << 32);
+}
+
+static void WriteLe32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+
+static void WriteLe64(uint8_t *p, uint64_t v)
+{
+  WriteLe32(p, (uint32_t) v);
+  WriteLe32(p + 4, (uint32_t) (v >> 32));
+}
+
+RecordingWriter::RecordingWriter(const std::string &path,
+                                 const RecordingInfo &info) :
+  m_path(path),
+  m_file(nullptr),
+  m_chunk_profiles(0),
+  m_first_timestamp_ns(0),
+  m_last_timestamp_ns(0),
+  m_profiles_written(0),
+  m_bytes_written(0)
+{
+  if (kRecordingMaxHeads < info.serial_numbers.size()) {
+    throw std::runtime_error("too many scan heads to record");
+  }
+
+  m_file = fopen(path.c_str(), "wb");
+  if (nullptr == m_file) {
+    throw std::runtime_error("failed to create recording " + path);
+  }
+  setvbuf(m_file, nullptr, _IOFBF, kFileBufferLen);
+
+  m_records.reserve(kChunkProfiles * kRecordingProfileLen);
+  m_points.reserve(kChunkProfiles * JS_PROFILE_DATA_LEN);
+
+  uint8_t header[kRecordingHeaderLen];
+  memset(header, 0, sizeof(header));
+  WriteLe32(header, kRecordingMagic);
+  WriteLe32(header + 4, kRecordingVersion);
+  WriteLe32(header + 8, kRecordingHeaderLen);
+  WriteLe32(header + 12, info.element_count);
+  WriteLe32(header + 16, (info.is_mode_camera) ? 1 : 0);
+  WriteLe32(header + 20, (uint32_t) info.serial_numbers.size());
+  for (uint32_t n = 0; n < info.serial_numbers.size(); n++) {
+    WriteLe32(header + 24 + 4 * n, info.serial_numbers[n]);
+  }
+
+  try {
+    Write(header, sizeof(header));
+    if (0 != fflush(m_file)) {
+      throw std::runtime_error("failed to write recording " + m_path);
+    }
+  } catch (...) {
+    fclose(m_file);
+    throw;
+  }
+}
+
+RecordingWriter::~RecordingWriter()
+{
+  try {
+    Flush();
+  } catch (std::exception &) {
+    // nothing more can be done with what is left; the file still reads up
+    // to its last whole chunk
+  }
+  fclose(m_file);
+}
+
+void RecordingWriter::Append(uint32_t head_index, const jsProfile &profile)
+{
+  if (0 == m_chunk_profiles) {
+    m_first_timestamp_ns = profile.timestamp_ns;
+  }
+  m_last_timestamp_ns = profile.timestamp_ns;
+
+  uint32_t point_count = 0;
+  for (uint32_t n = 0; n < profile.data_len; n++) {
+    if (JS_INVALID_XY != profile.data[n].x) {
+      m_points.push_back(profile.data[n]);
+      point_count++;
+    }
+  }
+
+  const uint32_t num_encoders = (kRecordingEncoders <
+                                 profile.num_encoder_values) ?
+                                kRecordingEncoders :
+                                profile.num_encoder_values;
+  const size_t offset = m_records.size();
+  m_records.resize(offset + kRecordingProfileLen);
+  uint8_t *p = m_records.data() + offset;
+  memset(p, 0, kRecordingProfileLen);
+  WriteLe32(p, head_index);
+  WriteLe32(p + 4, profile.scan_head_id);
+  WriteLe32(p + 8, (uint32_t) profile.camera);
+  WriteLe32(p + 12, (uint32_t) profile.laser);
+  WriteLe64(p + 16, profile.timestamp_ns);
+  WriteLe32(p + 24, profile.flags);
+  WriteLe32(p + 28, profile.sequence_number);
+  WriteLe32(p + 32, profile.laser_on_time_us);
+  WriteLe32(p + 36, (uint32_t) profile.format);
+  WriteLe32(p + 40, num_encoders);
+  WriteLe32(p + 44, point_count);
+  for (uint32_t n = 0; n < num_encoders; n++) {
+    WriteLe64(p + 48 + 8 * n, (uint64_t) profile.encoder_values[n]);
+  }
+
+  m_chunk_profiles++;
+  if (kChunkProfiles <= m_chunk_profiles) {
+    Flush();
+  }
+}
+
+size_t RecordingWriter::GetMemoryUsage() const
+{
+  return kFileBufferLen + m_chunk.capacity() + m_records.capacity() +
+         m_points.capacity() * sizeof(jsProfileData);
+}
+
+void RecordingWriter::Flush()
+{
+  if (0 == m_chunk_profiles) {
+    return;
+  }
+
+  // the whole chunk is assembled in one buffer and written at once, so the
+  // file only ever grows by whole chunks as far as a reader can tell
+  m_chunk.resize(kRecordingChunkHeaderLen);
+  m_chunk.insert(m_chunk.end(), m_records.begin(), m_records.end());
+  EncodePointChunk(m_points.data(), (uint32_t) m_points.size(), &m_chunk);
+
+  uint8_t *header = m_chunk.data();
+  memset(header, 0, kRecordingChunkHeaderLen);
+  WriteLe32(header, kRecordingChunkMagic);
+  WriteLe32(header + 4, (uint32_t) m_chunk.size());
+  WriteLe32(header + 8, m_chunk_profiles);
+  WriteLe64(header + 16, m_first_timestamp_ns);
+  WriteLe64(header + 24, m_last_timestamp_ns);
+
+  const uint32_t profile_count = m_chunk_profiles;
+  m_records.clear();
+  m_points.clear();
+  m_chunk_profiles = 0;
+
+  Write(m_chunk.data(), m_chunk.size());
+  if (0 != fflush(m_file)) {
+    throw std::runtime_error("failed to write recording " + m_path);
+  }
+  m_profiles_written += profile_count;
+}
+
+void RecordingWriter::Write(const uint8_t *data, size_t len)
+{
+  if (len != fwrite(data, 1, len, m_file)) {
+    throw std::runtime_error("failed to write recording " + m_path);
+  }
+  m_bytes_written += len;
+}
+
+RecordingReader::RecordingReader(const std::string &path) :
+  m_path(path),
+  m_file(nullptr),
+  m_map(nullptr),
+  m_map_offset(0),
+  m_map_len(0),
+  m_chunk_profiles(0),
+  m_next_profile(0),
+  m_next_point(0),
+  m_position(0)
+{
+  m_file = fopen(path.c_str(), "rb");
+  if (nullptr == m_file) {
+    throw std::runtime_error("failed to open recording " + path);
+  }
+  setvbuf(m_file, nullptr, _IOFBF, kFileBufferLen);
+
+  // the header is written out before anything else, so a file too short
+  // to hold one isn't a recording
+  uint8_t header[kRecordingHeaderLen];
+  size_t len = fread(header, 1, sizeof(header), m_file);
+  uint32_t head_count = ReadLe32(header + 20);
+  bool is_valid = (sizeof(header) == len) &&
+                  (kRecordingMagic == ReadLe32(header)) &&
+                  (kRecordingVersion == ReadLe32(header + 4)) &&
+                  (kRecordingHeaderLen == ReadLe32(header + 8)) &&
+                  (kRecordingMaxHeads >= head_count);
+  if (!is_valid) {
+    fclose(m_file);
+    throw std::runtime_error(path + " is not a recording");
+  }
+
+  m_info.element_count = ReadLe32(header + 12);
+  m_info.is_mode_camera = (0 != ReadLe32(header + 16));
+  for (uint32_t n = 0; n < head_count; n++) {
+    m_info.serial_numbers.push_back(ReadLe32(header + 24 + 4 * n));
+  }
+  m_position = kRecordingHeaderLen;
+}
+
+RecordingReader::~RecordingReader()
+{
+#if !defined(_WIN32)
+  if (nullptr != m_map) {
+    munmap((void *) m_map, m_map_len);
+  }
+#endif
+  fclose(m_file);
+}
+
+bool RecordingReader::Next(uint32_t *head_index, jsProfile *profile)
+{
+  while (m_next_profile >= m_chunk_profiles) {
+    if (!ReadChunk()) {
+      return false;
+    }
+  }
+
+  const uint8_t *p = &m_records[m_next_profile * kRecordingProfileLen];
+  const uint32_t point_count = ReadLe32(p + 44);
+  if ((JS_PROFILE_DATA_LEN < point_count) ||
+      (m_points.size() - m_next_point < point_count)) {
+    throw std::runtime_error(m_path + " has a malformed profile");
+  }
+
+  memset(profile, 0, offsetof(jsProfile, data));
+  *head_index = ReadLe32(p);
+  profile->scan_head_id = ReadLe32(p + 4);
+  profile->camera = (jsCamera) ReadLe32(p + 8);
+  profile->laser = (jsLaser) ReadLe32(p + 12);
+  profile->timestamp_ns = ReadLe64(p + 16);
+  profile->flags = ReadLe32(p + 24);
+  profile->sequence_number = ReadLe32(p + 28);
+  profile->laser_on_time_us = ReadLe32(p + 32);
+  profile->format = (jsDataFormat) ReadLe32(p + 36);
+  profile->num_encoder_values = ReadLe32(p + 40);
+  if (kRecordingEncoders < profile->num_encoder_values) {
+    profile->num_encoder_values = kRecordingEncoders;
+  }
+  for (uint32_t n = 0; n < profile->num_encoder_values; n++) {
+    profile->encoder_values[n] = (int64_t) ReadLe64(p + 48 + 8 * n);
+  }
+  profile->data_len = point_count;
+  memcpy(profile->data, &m_points[m_next_point],
+         point_count * sizeof(jsProfileData));
+
+  m_next_profile++;
+  m_next_point += point_count;
+  return true;
+}
+
+void RecordingReader::SkipToEnd()
+{
+  m_next_profile = m_chunk_profiles;
+  const uint64_t size = GetSize();
+  uint32_t len = 0;
+  while (ReadChunkHeader(&len, nullptr) && (m_position + len <= size)) {
+    m_position += len;
+  }
+}
+
+uint64_t RecordingReader::GetSize() const
+{
+#if defined(_WIN32)
+  struct _stat64 st;
+  int r = _fstat64(_fileno(m_file), &st);
+#else
+  struct stat st;
+  int r = fstat(fileno(m_file), &st);
+#endif
+  return (0 == r) ? (uint64_t) st.st_size : 0;
+}
+
+#if defined(_WIN32)
+
+const uint8_t *RecordingReader::Map(uint64_t offset, size_t len)
+{
+  // the end of the file may have been reached before, and since moved
+  clearerr(m_file);
+  m_chunk.resize(len);
+  if ((0 != _fseeki64(m_file, (int64_t) offset, SEEK_SET)) ||
+      (len != fread(m_chunk.data(), 1, len, m_file))) {
+    return nullptr;
+  }
+
+  return m_chunk.data();
+}
+
+#else
+
+const uint8_t *RecordingReader::Map(uint64_t offset, size_t len)
+{
+  if ((m_map_offset <= offset) &&
+      (offset + len <= m_map_offset + m_map_len)) {
+    return m_map + (offset - m_map_offset);
+  }
+
+  const uint64_t size = GetSize();
+  if (offset + len > size) {
+    return nullptr;
+  }
+
+  if (nullptr != m_map) {
+    munmap((void *) m_map, m_map_len);
+    m_map = nullptr;
+  }
+
+  // the window is never mapped past the end of the file, so it is mapped
+  // again further along whenever the file has grown past it
+  const uint64_t page_size = (uint64_t) sysconf(_SC_PAGESIZE);
+  const uint64_t start = offset & ~(page_size - 1);
+  uint64_t end = start + kMapWindowLen;
+  end = (offset + len > end) ? offset + len : end;
+  end = (size < end) ? size : end;
+  void *p = mmap(nullptr, (size_t) (end - start), PROT_READ, MAP_SHARED,
+                 fileno(m_file), (off_t) start);
+  if (MAP_FAILED == p) {
+    throw std::runtime_error("failed to map recording " + m_path);
+  }
+
+  m_map = (const uint8_t *) p;
+  m_map_offset = start;
+  m_map_len = (size_t) (end - start);
+  return m_map + (offset - m_map_offset);
+}
+
+#endif
+
+bool RecordingReader::ReadChunkHeader(uint32_t *len, uint32_t *profile_count)
+{
+  const uint8_t *header = Map(m_position, kRecordingChunkHeaderLen);
+  if (nullptr == header) {
+    return false;
+  }
+
+  const uint32_t chunk_len = ReadLe32(header + 4);
+  const uint32_t count = ReadLe32(header + 8);
+  if ((kRecordingChunkMagic != ReadLe32(header)) ||
+      (kMaxChunkLen < chunk_len) ||
+      (kRecordingChunkHeaderLen + (uint64_t) count * kRecordingProfileLen >
+       chunk_len)) {
+    throw std::runtime_error(m_path + " has a malformed chunk");
+  }
+
+  *len = chunk_len;
+  if (nullptr != profile_count) {
+    *profile_count = count;
+  }
+  return true;
+}
+
+bool RecordingReader::ReadChunk()
+{
+  uint32_t len = 0;
+  uint32_t profile_count = 0;
+  if (!ReadChunkHeader(&len, &profile_count)) {
+    return false;
+  }
+
+  const uint8_t *chunk = Map(m_position, len);
+  if (nullptr == chunk) {
+    return false;
+  }
+
+  const uint8_t *records = chunk + kRecordingChunkHeaderLen;
+  const size_t records_len = profile_count * kRecordingProfileLen;
+  const uint8_t *points = records + records_len;
+  const size_t points_len = len - kRecordingChunkHeaderLen - records_len;
+  const uint32_t point_count = GetPointChunkCount(points, points_len);
+  // the count comes from the file, so it is checked against what the
+  // chunk could hold before anything is allocated for it: every point
+  // takes at least a byte for each of its three values
+  if (((uint64_t) profile_count * JS_PROFILE_DATA_LEN < point_count) ||
+      (points_len / 3 < point_count)) {
+    throw std::runtime_error(m_path + " has malformed points");
+  }
+  m_points.resize(point_count);
+  if ((0 != point_count) &&
+      (points_len != DecodePointChunk(points, points_len, m_points.data(),
+                                      point_count))) {
+    throw std::runtime_error(m_path + " has malformed points");
+  }
+  m_records.assign(records, records + records_len);
+
+  m_chunk_profiles = profile_count;
+  m_next_profile = 0;
+  m_next_point = 0;
+  m_position += len;
+  return true;
+}
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_RECORDING_H
+#define JOESCAN_RECORDING_H
+
+#include "joescan_pinchot.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Recording files hold profiles as received from the scan heads, in chunks
+ * that can be read independently, so a file that is cut short or still
+ * being written can be read up to its last whole chunk.
+ *
+ * All integers are little endian. The file starts with a header:
+ *
+ *   offset  size
+ *        0     4  magic, `kRecordingMagic`
+ *        4     4  version, `kRecordingVersion`
+ *        8     4  header size, offset of the first chunk
+ *       12     4  elements (cameras or lasers) per scan head
+ *       16     4  non-zero if scan heads are camera driven
+ *       20     4  number of scan heads, at most `kRecordingMaxHeads`
+ *       24    64  serial number of each scan head, by index
+ *
+ * followed by any number of chunks, each starting with:
+ *
+ *        0     4  magic, `kRecordingChunkMagic`
+ *        4     4  chunk size, including this header
+ *        8     4  number of profiles
+ *       12     4  reserved, zero
+ *       16     8  timestamp of the first profile, in nanoseconds
+ *       24     8  timestamp of the last profile, in nanoseconds
+ *
+ * then a fixed size record for each profile, holding everything but its
+ * points:
+ *
+ *        0     4  scan head index
+ *        4     4  scan head id
+ *        8     4  camera
+ *       12     4  laser
+ *       16     8  timestamp, in nanoseconds
+ *       24     4  flags
+ *       28     4  sequence number
+ *       32     4  laser on time, in microseconds
+ *       36     4  data format
+ *       40     4  number of encoder values, at most three
+ *       44     4  number of points
+ *       48    24  encoder values
+ *
+ * and finally the points of all profiles in order, as one chunk of
+ * `PointCodec.hpp`. Only valid points are recorded, so a profile's number
+ * of points is its number of valid points.
+ */
+
+namespace joescan {
+
+const uint32_t kRecordingMagic = 0x4345524A;
+const uint32_t kRecordingChunkMagic = 0x4B48434A;
+const uint32_t kRecordingVersion = 1;
+const uint32_t kRecordingMaxHeads = 16;
+const uint32_t kRecordingHeaderLen = 88;
+const uint32_t kRecordingChunkHeaderLen = 32;
+const uint32_t kRecordingProfileLen = 72;
+
+/**
+ * @brief What a recording was made of.
+ */
+struct RecordingInfo {
+  uint32_t element_count;
+  bool is_mode_camera;
+  std::vector<uint32_t> serial_numbers;
+};
+
+/**
+ * @brief Writes profiles to a recording file, a chunk at a time, each with
+ * a single large write.
+ */
+class RecordingWriter {
+ public:
+  /**
+   * @brief Profiles per chunk, unless flushed sooner.
+   */
+  static const uint32_t kChunkProfiles = 64;
+
+  /**
+   * @brief Creates the file, replacing any of the same name, and writes
+   * the header.
+   *
+   * @throw std::runtime_error if the file can't be written.
+   */
+  RecordingWriter(const std::string &path, const RecordingInfo &info);
+
+  /**
+   * @brief Writes what is left and closes the file.
+   */
+  ~RecordingWriter();
+
+  /**
+   * @brief Adds a profile, writing out a chunk once it is full.
+   *
+   * @throw std::runtime_error if the file can't be written.
+   */
+  void Append(uint32_t head_index, const jsProfile &profile);
+
+  /**
+   * @brief Writes the profiles added so far as a chunk of their own, so
+   * readers following the file see them.
+   *
+   * @throw std::runtime_error if the file can't be written.
+   */
+  void Flush();
+
+  const std::string &GetPath() const { return m_path; }
+  uint64_t GetProfilesWritten() const { return m_profiles_written; }
+  uint64_t GetBytesWritten() const { return m_bytes_written; }
+
+  /**
+   * @return Bytes allocated for the chunk being assembled and the file buffer.
+   */
+  size_t GetMemoryUsage() const;
+
+ private:
+  void Write(const uint8_t *data, size_t len);
+
+  std::string m_path;
+  FILE *m_file;
+  std::vector<uint8_t> m_records;
+  std::vector<jsProfileData> m_points;
+  std::vector<uint8_t> m_chunk;
+  uint32_t m_chunk_profiles;
+  uint64_t m_first_timestamp_ns;
+  uint64_t m_last_timestamp_ns;
+  uint64_t m_profiles_written;
+  uint64_t m_bytes_written;
+};
+
+/**
+ * @brief Reads profiles back from a recording file, a chunk at a time.
+ *
+ * Reading stops at the end of the last whole chunk and can carry on from
+ * there once more has been written, so a recording can be read while it
+ * is still being made. Chunks are read in place through a window of the
+ * file mapped into memory, moved along as reading gets past it, except on
+ * Windows where they are read into a buffer.
+ */
+class RecordingReader {
+ public:
+  /**
+   * @brief Opens the file and reads its header.
+   *
+   * @throw std::runtime_error if the file can't be read or isn't a
+   * recording.
+   */
+  explicit RecordingReader(const std::string &path);
+  ~RecordingReader();
+
+  const RecordingInfo &GetInfo() const { return m_info; }
+
+  /**
+   * @brief Reads the next profile.
+   *
+   * @param head_index Receives the index of the scan head.
+   * @param profile Receives the profile.
+   * @return `false` if there are no more whole chunks yet.
+   * @throw std::runtime_error if the file is malformed.
+   */
+  bool Next(uint32_t *head_index, jsProfile *profile);
+
+  /**
+   * @brief Skips past all the whole chunks written so far, so that reading
+   * carries on with whatever is written next.
+   *
+   * @throw std::runtime_error if the file is malformed.
+   */
+  void SkipToEnd();
+
+  /**
+   * @return Offset of the end of the chunks read so far.
+   */
+  uint64_t GetPosition() const { return m_position; }
+
+  /**
+   * @return Size of the file, as of now.
+   */
+  uint64_t GetSize() const;
+
+ private:
+  bool ReadChunk();
+
+  const uint8_t *Map(uint64_t offset, size_t len);
+  bool ReadChunkHeader(uint32_t *len, uint32_t *profile_count);
+
+  std::string m_path;
+  FILE *m_file;
+  RecordingInfo m_info;
+  const uint8_t *m_map;
+  uint64_t m_map_offset;
+  size_t m_map_len;
+  // the chunk being read, where it can't be mapped
+  std::vector<uint8_t> m_chunk;
+  std::vector<uint8_t> m_records;
+  std::vector<jsProfileData> m_points;
+  uint32_t m_chunk_profiles;
+  uint32_t m_next_profile;
+  uint32_t m_next_point;
+  uint64_t m_position;
+};
+
+} // namespace joescan
+
+#endif
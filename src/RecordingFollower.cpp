@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "RecordingFollower.hpp"
+#include "Trace.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace joescan;
+
+uint32_t RecordingFollower::GetScanHeadCount() const
+{
+  return (uint32_t) m_heads.size();
+}
+
+bool RecordingFollower::GetProfile(uint32_t head_index, jsProfile *profile)
+{
+  HeadRing &head = *m_heads[head_index];
+  uint32_t read_idx = head.read_idx.load(std::memory_order_relaxed);
+  if (read_idx == head.write_idx.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  // only copy the points actually used
+  const jsProfile &src = head.ring[read_idx & (kRingSize - 1)];
+  memcpy(profile, &src, offsetof(jsProfile, data));
+  memcpy(profile->data, src.data, src.data_len * sizeof(jsProfileData));
+  head.read_idx.store(read_idx + 1, std::memory_order_release);
+
+  return true;
+}
+
+size_t RecordingFollower::GetMemoryUsage() const
+{
+  size_t len = sizeof(jsProfile);
+  for (auto &head : m_heads) {
+    len += head->ring.size() * sizeof(jsProfile);
+  }
+
+  return len;
+}
+
+std::string RecordingFollower::GetError() const
+{
+  std::lock_guard<std::mutex> lock(m_error_mutex);
+  return m_error;
+}
+
+void RecordingFollower::Push(uint32_t head_index, const jsProfile &profile)
+{
+  HeadRing &head = *m_heads[head_index];
+  uint32_t write_idx = head.write_idx.load(std::memory_order_relaxed);
+  if (kRingSize == write_idx - head.read_idx.load(std::memory_order_acquire)) {
+    m_dropped++;
+    return;
+  }
+
+  jsProfile &dst = head.ring[write_idx & (kRingSize - 1)];
+  memcpy(&dst, &profile, offsetof(jsProfile, data));
+  memcpy(dst.data, profile.data, profile.data_len * sizeof(jsProfileData));
+  head.write_idx.store(write_idx + 1, std::memory_order_release);
+}
+
+void RecordingFollower::SetError(const std::string &error)
+{
+  std::lock_guard<std::mutex> lock(m_error_mutex);
+  m_error = error;
+}
+
+void RecordingFollower::ReadAdded()
+{
+  TraceSpan span("Read Recording");
+  uint32_t head_index = 0;
+  while (m_reader.Next(&head_index, m_scratch.get())) {
+    m_read++;
+    if (head_index < m_heads.size()) {
+      Push(head_index, *m_scratch);
+    }
+  }
+  m_position = m_reader.GetPosition();
+}
+
+#if !defined(__linux__)
+
+RecordingFollower::RecordingFollower(const std::string &path) :
+  m_path(path),
+  m_reader(path),
+  m_inotify_fd(-1),
+  m_stop_fds{ -1, -1 },
+  m_is_following(false),
+  m_read(0),
+  m_dropped(0),
+  m_position(0)
+{
+  throw std::runtime_error(path + ": following recordings needs Linux");
+}
+
+RecordingFollower::~RecordingFollower() {}
+void RecordingFollower::FollowThread() {}
+
+#else
+
+RecordingFollower::RecordingFollower(const std::string &path) :
+  m_path(path),
+  m_reader(path),
+  m_inotify_fd(-1),
+  m_stop_fds{ -1, -1 },
+  m_scratch(new jsProfile),
+  m_is_following(true),
+  m_read(0),
+  m_dropped(0),
+  m_position(0)
+{
+  static_assert(0 == (kRingSize & (kRingSize - 1)),
+                "ring size must be a power of two");
+
+  for (uint32_t n = 0; n < GetInfo().serial_numbers.size(); n++) {
+    std::unique_ptr<HeadRing> head(new HeadRing);
+    head->ring.resize(kRingSize);
+    head->read_idx = 0;
+    head->write_idx = 0;
+    m_heads.push_back(std::move(head));
+  }
+
+  m_reader.SkipToEnd();
+  m_position = m_reader.GetPosition();
+
+  // anything written between skipping to the end and the watch starting
+  // is read as soon as the thread starts
+  m_inotify_fd = inotify_init1(IN_CLOEXEC);
+  if ((0 > m_inotify_fd) ||
+      (0 > inotify_add_watch(m_inotify_fd, path.c_str(),
+                             IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF)) ||
+      (0 != pipe(m_stop_fds))) {
+    int error = errno;
+    if (0 <= m_inotify_fd) {
+      close(m_inotify_fd);
+    }
+    throw std::runtime_error(path + ": " + strerror(error));
+  }
+
+  m_thread = std::thread(&RecordingFollower::FollowThread, this);
+}
+
+RecordingFollower::~RecordingFollower()
+{
+  // wakes the thread out of `poll`
+  const char stop = 0;
+  while ((1 != write(m_stop_fds[1], &stop, 1)) && (EINTR == errno)) {
+  }
+  m_thread.join();
+  close(m_stop_fds[0]);
+  close(m_stop_fds[1]);
+  close(m_inotify_fd);
+}
+
+void RecordingFollower::FollowThread()
+{
+  // aligned for the events read into it
+  alignas(struct inotify_event) char events[4096];
+  Trace::SetThreadName("Follower");
+
+  try {
+    ReadAdded();
+    while (true) {
+      struct pollfd fds[2];
+      fds[0].fd = m_inotify_fd;
+      fds[0].events = POLLIN;
+      fds[1].fd = m_stop_fds[0];
+      fds[1].events = POLLIN;
+      if (0 > poll(fds, 2, -1)) {
+        if (EINTR == errno) {
+          continue;
+        }
+        throw std::runtime_error(m_path + ": " + strerror(errno));
+      }
+      if (0 != fds[1].revents) {
+        break;
+      }
+
+      ssize_t len = read(m_inotify_fd, events, sizeof(events));
+      if (0 >= len) {
+        throw std::runtime_error(m_path + ": " + strerror(errno));
+      }
+
+      // unlinking the file only shows up as its link count changing, since
+      // it is still open here
+      bool is_gone = false;
+      for (ssize_t n = 0; n < len;) {
+        const struct inotify_event *e =
+          (const struct inotify_event *) &events[n];
+        if (0 != (e->mask & (IN_DELETE_SELF | IN_IGNORED))) {
+          is_gone = true;
+        } else if (0 != (e->mask & IN_ATTRIB)) {
+          struct stat st;
+          is_gone = (0 != stat(m_path.c_str(), &st)) && (ENOENT == errno);
+        }
+        n += sizeof(struct inotify_event) + e->len;
+      }
+
+      ReadAdded();
+      if (is_gone) {
+        throw std::runtime_error(m_path + " was removed");
+      }
+    }
+  } catch (std::runtime_error &e) {
+    SetError(e.what());
+  }
+
+  m_is_following = false;
+}
+
+#endif
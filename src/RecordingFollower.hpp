@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_RECORDING_FOLLOWER_H
+#define JOESCAN_RECORDING_FOLLOWER_H
+
+#include "Recording.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Follows a recording that another process is still writing,
+ * standing in for `ProfileAcquisition` in a viewer that has no scan heads
+ * of its own.
+ *
+ * Following starts at the end of the file as it is when opened. A
+ * background thread sleeps until the kernel reports the file has been
+ * written to, then reads the chunks that have been added into one single
+ * producer / single consumer ring per scan head, which the render thread
+ * empties once per frame. Profiles read while a ring is full are dropped.
+ *
+ * Changes to the file are waited for with inotify, so following needs
+ * Linux.
+ */
+class RecordingFollower {
+ public:
+  /**
+   * @brief Number of profiles buffered per scan head; must be a power of
+   * two.
+   */
+  static const uint32_t kRingSize = 256;
+
+  /**
+   * @brief Opens the recording and starts following it.
+   *
+   * @throw std::runtime_error if the file isn't a recording or can't be
+   * watched.
+   */
+  explicit RecordingFollower(const std::string &path);
+
+  /**
+   * @brief Stops following and closes the file.
+   */
+  ~RecordingFollower();
+
+  const RecordingInfo &GetInfo() const { return m_reader.GetInfo(); }
+  uint32_t GetScanHeadCount() const;
+
+  /**
+   * @brief Pops the oldest profile read of a scan head.
+   *
+   * @return `true` if a profile was returned, `false` if none is queued.
+   */
+  bool GetProfile(uint32_t head_index, jsProfile *profile);
+
+  /**
+   * @return `false` once the file has gone away or can't be read.
+   */
+  bool IsFollowing() const { return m_is_following; }
+
+  /**
+   * @return Why following ended, if it has.
+   */
+  std::string GetError() const;
+
+  const std::string &GetPath() const { return m_path; }
+  uint64_t GetProfilesRead() const { return m_read; }
+  uint64_t GetProfilesDropped() const { return m_dropped; }
+  uint64_t GetPosition() const { return m_position; }
+
+  /**
+   * @return Bytes allocated for the rings of profiles.
+   */
+  size_t GetMemoryUsage() const;
+
+ private:
+  struct HeadRing {
+    std::vector<jsProfile> ring;
+    std::atomic<uint32_t> read_idx;
+    std::atomic<uint32_t> write_idx;
+  };
+
+  void FollowThread();
+  void ReadAdded();
+  void Push(uint32_t head_index, const jsProfile &profile);
+  void SetError(const std::string &error);
+
+  std::string m_path;
+  RecordingReader m_reader;
+  int m_inotify_fd;
+  // written to wake the thread when stopping
+  int m_stop_fds[2];
+  std::vector<std::unique_ptr<HeadRing>> m_heads;
+  std::unique_ptr<jsProfile> m_scratch;
+  std::thread m_thread;
+  std::atomic<bool> m_is_following;
+  std::atomic<uint64_t> m_read;
+  std::atomic<uint64_t> m_dropped;
+  std::atomic<uint64_t> m_position;
+
+  mutable std::mutex m_error_mutex;
+  std::string m_error;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "ReferenceProfile.hpp"
+#include "Json.hpp"
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+using namespace joescan;
+
+// reference points are resampled this finely, in inches
+static const double kReferencePitch = 0.01;
+
+static ImU32 LerpColor(const ImVec4 &a, const ImVec4 &b, float t)
+{
+  return ImGui::ColorConvertFloat4ToU32(ImVec4(a.x + (b.x - a.x) * t,
+                                               a.y + (b.y - a.y) * t,
+                                               a.z + (b.z - a.z) * t,
+                                               1.0f));
+}
+
+ReferenceProfile::ReferenceProfile(double x_min,
+                                   double x_max,
+                                   uint32_t row_count) :
+  m_grid(x_min, x_max, kReferencePitch, row_count),
+  m_x(row_count),
+  m_y(row_count),
+  m_scratch(new ProfileBuffer)
+{
+  const ImVec4 kBelow(0.2f, 0.4f, 1.0f, 1.0f);
+  const ImVec4 kWithin(0.2f, 0.9f, 0.2f, 1.0f);
+  const ImVec4 kAbove(1.0f, 0.2f, 0.2f, 1.0f);
+
+  // the middle third is solid, the outer thirds fade from the edge of the
+  // tolerance to twice the tolerance
+  for (uint32_t n = 0; n < kNoReference; n++) {
+    float t = (float) n / (float) (kNoReference - 1);
+    if (1.0f / 3.0f > t) {
+      m_lut[n] = LerpColor(kBelow, kWithin, t * 3.0f);
+    } else if (2.0f / 3.0f >= t) {
+      m_lut[n] = ImGui::ColorConvertFloat4ToU32(kWithin);
+    } else {
+      m_lut[n] = LerpColor(kWithin, kAbove, (t - 2.0f / 3.0f) * 3.0f);
+    }
+  }
+  m_lut[kNoReference] = IM_COL32(128, 128, 128, 255);
+}
+
+void ReferenceProfile::Capture(uint32_t row, const ProfileBuffer &buffer)
+{
+  m_x[row].assign(buffer.x, buffer.x + buffer.data_len);
+  m_y[row].assign(buffer.y, buffer.y + buffer.data_len);
+  m_grid.Resample(row, buffer);
+}
+
+void ReferenceProfile::Clear()
+{
+  for (uint32_t n = 0; n < m_grid.GetRowCount(); n++) {
+    m_x[n].clear();
+    m_y[n].clear();
+    m_grid.Clear(n);
+  }
+}
+
+bool ReferenceProfile::HasRow(uint32_t row) const
+{
+  return (row < m_grid.GetRowCount()) && !m_x[row].empty();
+}
+
+void ReferenceProfile::Save(const std::string &path,
+                            const std::vector<uint32_t> &serial_numbers,
+                            uint32_t elements_per_head) const
+{
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error(path + ": can't be written");
+  }
+
+  file.precision(6);
+  file << std::fixed << "{\n  \"Elements\": [";
+
+  const char *separator = "\n";
+  for (uint32_t row = 0; row < m_grid.GetRowCount(); row++) {
+    uint32_t head = row / elements_per_head;
+    if (!HasRow(row) || (head >= serial_numbers.size())) {
+      continue;
+    }
+
+    file << separator << "    {\n"
+         << "      \"Serial\": " << serial_numbers[head] << ",\n"
+         << "      \"Element\": " << (row % elements_per_head) + 1 << ",\n";
+
+    const std::vector<double> *values[2] = { &m_x[row], &m_y[row] };
+    const char *names[2] = { "X", "Y" };
+    for (uint32_t k = 0; k < 2; k++) {
+      file << "      \"" << names[k] << "\": [";
+      for (size_t n = 0; n < values[k]->size(); n++) {
+        file << ((0 == n) ? "" : ", ") << (*values[k])[n];
+      }
+      file << ((0 == k) ? "],\n" : "]\n");
+    }
+
+    file << "    }";
+    separator = ",\n";
+  }
+
+  file << "\n  ]\n}\n";
+  if (!file) {
+    throw std::runtime_error(path + ": write failed");
+  }
+}
+
+void ReferenceProfile::Load(const std::string &path,
+                            const std::vector<uint32_t> &serial_numbers,
+                            uint32_t elements_per_head)
+{
+  JsonValue j = JsonValue::ParseFile(path);
+  Clear();
+
+  for (auto &element : j["Elements"].GetArray()) {
+    uint32_t serial_number = (uint32_t) element["Serial"].AsNumber();
+    int32_t id = (int32_t) element["Element"].AsNumber();
+    const JsonValue &x = element["X"];
+    const JsonValue &y = element["Y"];
+    if ((1 > id) || ((int32_t) elements_per_head < id)) {
+      throw std::runtime_error(path + ": invalid element " +
+                               std::to_string(id));
+    }
+    if ((x.Size() != y.Size()) || (JS_PROFILE_DATA_LEN < x.Size())) {
+      throw std::runtime_error(path + ": bad point count for element " +
+                               std::to_string(id));
+    }
+
+    for (uint32_t head = 0; head < serial_numbers.size(); head++) {
+      if (serial_number != serial_numbers[head]) {
+        continue;
+      }
+
+      ProfileBuffer &buffer = *m_scratch;
+      buffer.data_len = (uint32_t) x.Size();
+      for (uint32_t n = 0; n < buffer.data_len; n++) {
+        buffer.x[n] = x[n].AsNumber();
+        buffer.y[n] = y[n].AsNumber();
+      }
+      Capture(head * elements_per_head + (id - 1), buffer);
+    }
+  }
+}
+
+uint32_t ReferenceProfile::Compare(uint32_t row,
+                                   const ProfileBuffer &buffer,
+                                   double tolerance,
+                                   uint8_t *levels) const
+{
+  const double *ref = m_grid.GetRow(row);
+  const double x_min = m_grid.GetXMin();
+  const double scale = 1.0 / m_grid.GetPitch();
+  const double last = (double) m_grid.GetColumnCount() - 1.0;
+  const double inv_tolerance = 1.0 / ((0.0 < tolerance) ? tolerance : 1e-6);
+  const double kLevelMax = (double) (kNoReference - 1);
+  uint32_t out_of_tolerance = 0;
+
+  for (uint32_t n = 0; n < buffer.data_len; n++) {
+    double u = (buffer.x[n] - x_min) * scale;
+    if ((0.0 > u) || (last <= u)) {
+      levels[n] = kNoReference;
+      continue;
+    }
+
+    // interpolate between the two columns either side of the point; a
+    // missing column reads as NaN, which is caught below
+    uint32_t c = (uint32_t) u;
+    double f = u - c;
+    double y_ref = ref[c] + (ref[c + 1] - ref[c]) * f;
+    double d = (buffer.y[n] - y_ref) * inv_tolerance;
+    if (std::isnan(d)) {
+      levels[n] = kNoReference;
+      continue;
+    }
+
+    // within tolerance covers [1/3, 2/3] of the table, twice the tolerance
+    // reaches either end
+    double a = fabs(d);
+    double t = 0.5 + d / 6.0 + copysign((1.0 < a) ? a - 1.0 : 0.0, d) / 6.0;
+    t = (0.0 > t) ? 0.0 : ((1.0 < t) ? 1.0 : t);
+    levels[n] = (uint8_t) (t * kLevelMax + 0.5);
+    out_of_tolerance += (1.0 < a) ? 1 : 0;
+  }
+
+  return out_of_tolerance;
+}
@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_REFERENCE_PROFILE_H
+#define JOESCAN_REFERENCE_PROFILE_H
+
+#include "imgui.h"
+#include "ProfileBuffer.hpp"
+#include "ProfileGrid.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief A stored reference shape, one row per scan head element, that
+ * live profiles are compared against.
+ *
+ * Reference points are resampled onto a fine X grid when captured or
+ * loaded, so the deviation of a live point is a single interpolated lookup
+ * rather than a search through the reference.
+ */
+class ReferenceProfile {
+ public:
+  /**
+   * @brief Level given to points without reference data at their X.
+   */
+  static const uint8_t kNoReference = 255;
+
+  /**
+   * @param x_min Smallest X covered, in inches.
+   * @param x_max Largest X covered, in inches.
+   * @param row_count Number of rows, one per scan head element.
+   */
+  ReferenceProfile(double x_min, double x_max, uint32_t row_count);
+
+  /**
+   * @brief Stores a profile as the reference of a row.
+   */
+  void Capture(uint32_t row, const ProfileBuffer &buffer);
+
+  void Clear();
+
+  bool HasRow(uint32_t row) const;
+
+  /**
+   * @brief Writes all rows holding a reference to a JSON file.
+   *
+   * @param path File to write.
+   * @param serial_numbers Serial number of each scan head.
+   * @param elements_per_head Number of rows per scan head.
+   * @throw std::runtime_error if the file can't be written.
+   */
+  void Save(const std::string &path,
+            const std::vector<uint32_t> &serial_numbers,
+            uint32_t elements_per_head) const;
+
+  /**
+   * @brief Replaces the reference with the one in a JSON file. Scan heads
+   * not in `serial_numbers` are ignored.
+   *
+   * @throw std::runtime_error if the file can't be read or is malformed.
+   */
+  void Load(const std::string &path,
+            const std::vector<uint32_t> &serial_numbers,
+            uint32_t elements_per_head);
+
+  /**
+   * @brief Compares a profile against the reference of its row.
+   *
+   * Deviation is the difference in Y to the reference at the same X. It is
+   * turned into a color level: levels within `tolerance` map to the middle
+   * third of the lookup table, larger deviations to the outer thirds.
+   *
+   * @param row Row of the profile.
+   * @param buffer The profile.
+   * @param tolerance Allowed deviation, in inches.
+   * @param levels Receives the level of every point.
+   * @return Number of points outside the tolerance.
+   */
+  uint32_t Compare(uint32_t row,
+                   const ProfileBuffer &buffer,
+                   double tolerance,
+                   uint8_t *levels) const;
+
+  /**
+   * @return Colors indexed by the levels from `Compare`: blue below, green
+   * within and red above the tolerance, grey without a reference.
+   */
+  const ImU32 *GetLut() const { return m_lut; }
+
+  /**
+   * @return The resampled reference, for drawing.
+   */
+  const ProfileGrid &GetGrid() const { return m_grid; }
+
+ private:
+  ProfileGrid m_grid;
+  std::vector<std::vector<double>> m_x;
+  std::vector<std::vector<double>> m_y;
+  std::unique_ptr<ProfileBuffer> m_scratch;
+  ImU32 m_lut[256];
+};
+
+} // namespace joescan
+
+#endif
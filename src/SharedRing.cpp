@@ -0,0 +1,391 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "SharedRing.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace joescan;
+
+static_assert(0 == offsetof(jsSharedRingHeader, write_seq) % 64,
+              "write_seq must start a cache line");
+static_assert(0 == offsetof(jsSharedRingHeader, readers) % 64,
+              "readers must start a cache line");
+static_assert(0 == offsetof(jsSharedRingSlot, profile) % 8,
+              "profile must be 64-bit aligned");
+
+static uint32_t RoundUp64(size_t size)
+{
+  return (uint32_t) ((size + 63) & ~((size_t) 63));
+}
+
+static std::string ObjectName(const std::string &name)
+{
+  return (!name.empty() && ('/' == name[0])) ? name : "/" + name;
+}
+
+#if defined(_WIN32)
+
+SharedRingWriter::SharedRingWriter(const std::string &name,
+                                   uint32_t slot_count,
+                                   const std::vector<uint32_t> &serials) :
+  m_name(ObjectName(name)),
+  m_slot_count(0),
+  m_slot_size(0),
+  m_size(0),
+  m_base(nullptr),
+  m_header(nullptr)
+{
+  throw std::runtime_error(m_name + ": shared memory rings need POSIX");
+}
+
+SharedRingWriter::~SharedRingWriter() {}
+void SharedRingWriter::Publish(uint32_t, const jsProfile &) {}
+uint64_t SharedRingWriter::GetPublished() const { return 0; }
+void SharedRingWriter::GetReaders(std::vector<ReaderInfo> *readers) const
+{
+  readers->clear();
+}
+
+SharedRingReader::SharedRingReader(const std::string &name) :
+  m_name(ObjectName(name)),
+  m_size(0),
+  m_base(nullptr),
+  m_header(nullptr),
+  m_entry(nullptr),
+  m_cursor(0),
+  m_acquired(nullptr)
+{
+  throw std::runtime_error(m_name + ": shared memory rings need POSIX");
+}
+
+SharedRingReader::~SharedRingReader() {}
+uint32_t SharedRingReader::GetScanHeadCount() const { return 0; }
+uint32_t SharedRingReader::GetSerialNumber(uint32_t) const { return 0; }
+const jsProfile *SharedRingReader::Acquire(uint32_t *) { return nullptr; }
+bool SharedRingReader::Release() { return false; }
+uint64_t SharedRingReader::GetLapped() const { return 0; }
+void SharedRingReader::Skip(uint64_t) {}
+
+#else
+
+static uint64_t Load(const uint64_t *p)
+{
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void Store(uint64_t *p, uint64_t value)
+{
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+// Process id of the writer of an existing ring, zero if there is no ring
+// by that name or it can't be read as one.
+static uint64_t GetWriterPid(const std::string &name)
+{
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (0 > fd) {
+    return 0;
+  }
+
+  struct stat st;
+  void *p = MAP_FAILED;
+  if ((0 == fstat(fd, &st)) &&
+      (sizeof(jsSharedRingHeader) <= (size_t) st.st_size)) {
+    p = mmap(nullptr, sizeof(jsSharedRingHeader), PROT_READ, MAP_SHARED,
+             fd, 0);
+  }
+  close(fd);
+  if (MAP_FAILED == p) {
+    return 0;
+  }
+
+  const jsSharedRingHeader *header = (const jsSharedRingHeader *) p;
+  uint64_t pid = __atomic_load_n(&header->writer_pid, __ATOMIC_RELAXED);
+  munmap(p, sizeof(jsSharedRingHeader));
+  return pid;
+}
+
+static jsSharedRingSlot *GetSlot(uint8_t *base,
+                                 const jsSharedRingHeader &header,
+                                 uint64_t seq)
+{
+  uint64_t slot = seq & (header.slot_count - 1);
+  return (jsSharedRingSlot *) (base + header.header_size +
+                               slot * header.slot_size);
+}
+
+SharedRingWriter::SharedRingWriter(const std::string &name,
+                                   uint32_t slot_count,
+                                   const std::vector<uint32_t> &serials) :
+  m_name(ObjectName(name)),
+  m_slot_count(2),
+  m_slot_size(RoundUp64(sizeof(jsSharedRingSlot))),
+  m_size(0),
+  m_base(nullptr),
+  m_header(nullptr)
+{
+  if (JS_SHARED_RING_MAX_HEADS < serials.size()) {
+    throw std::runtime_error(m_name + ": too many scan heads");
+  }
+
+  while (m_slot_count < slot_count) {
+    m_slot_count <<= 1;
+  }
+  const uint32_t header_size = RoundUp64(sizeof(jsSharedRingHeader));
+  m_size = header_size + (size_t) m_slot_count * m_slot_size;
+
+  // an object left behind by a run that didn't exit cleanly is replaced;
+  // its readers keep the old mapping until they open the ring again
+  uint64_t owner = GetWriterPid(m_name);
+  if ((0 != owner) && ((uint64_t) getpid() != owner) &&
+      !((0 != kill((pid_t) owner, 0)) && (ESRCH == errno))) {
+    throw std::runtime_error(m_name + ": in use by process " +
+                             std::to_string(owner));
+  }
+  shm_unlink(m_name.c_str());
+  int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (0 > fd) {
+    throw std::runtime_error(m_name + ": " + strerror(errno));
+  }
+
+  // the object starts out zero filled, so all slots read as being written
+  void *p = MAP_FAILED;
+  if (0 == ftruncate(fd, (off_t) m_size)) {
+    p = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  int error = errno;
+  close(fd);
+  if (MAP_FAILED == p) {
+    shm_unlink(m_name.c_str());
+    throw std::runtime_error(m_name + ": " + strerror(error));
+  }
+
+  m_base = (uint8_t *) p;
+  m_header = (jsSharedRingHeader *) m_base;
+  m_header->version = JS_SHARED_RING_VERSION;
+  m_header->header_size = header_size;
+  m_header->slot_size = m_slot_size;
+  m_header->slot_count = m_slot_count;
+  m_header->num_heads = (uint32_t) serials.size();
+  for (uint32_t n = 0; n < serials.size(); n++) {
+    m_header->serial_numbers[n] = serials[n];
+  }
+  m_header->writer_pid = (uint64_t) getpid();
+  // readers check the magic first, so it goes in last
+  __atomic_store_n(&m_header->magic, JS_SHARED_RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+SharedRingWriter::~SharedRingWriter()
+{
+  munmap(m_base, m_size);
+  shm_unlink(m_name.c_str());
+}
+
+void SharedRingWriter::Publish(uint32_t head_index, const jsProfile &profile)
+{
+  uint64_t seq =
+    __atomic_fetch_add(&m_header->write_seq, 1, __ATOMIC_ACQ_REL);
+  jsSharedRingSlot *slot = GetSlot(m_base, *m_header, seq);
+
+  // zero marks the slot as being written before any of it changes, so a
+  // reader that was lapped in the middle of a read can tell
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  uint32_t len = (JS_PROFILE_DATA_LEN < profile.data_len) ?
+                 JS_PROFILE_DATA_LEN : profile.data_len;
+  slot->head_index = head_index;
+  memcpy(&slot->profile, &profile,
+         offsetof(jsProfile, data) + len * sizeof(jsProfileData));
+  slot->profile.data_len = len;
+
+  Store(&slot->seq, seq + 1);
+}
+
+uint64_t SharedRingWriter::GetPublished() const
+{
+  return Load(&m_header->write_seq);
+}
+
+void SharedRingWriter::GetReaders(std::vector<ReaderInfo> *readers) const
+{
+  readers->clear();
+  uint64_t published = Load(&m_header->write_seq);
+  for (auto &entry : m_header->readers) {
+    uint64_t pid = Load(&entry.pid);
+    if (0 == pid) {
+      continue;
+    }
+
+    uint64_t cursor = Load(&entry.cursor);
+    ReaderInfo info;
+    info.pid = pid;
+    info.lag = (cursor < published) ? published - cursor : 0;
+    info.lapped = Load(&entry.lapped);
+    readers->push_back(info);
+  }
+}
+
+SharedRingReader::SharedRingReader(const std::string &name) :
+  m_name(ObjectName(name)),
+  m_size(0),
+  m_base(nullptr),
+  m_header(nullptr),
+  m_entry(nullptr),
+  m_cursor(0),
+  m_acquired(nullptr)
+{
+  int fd = shm_open(m_name.c_str(), O_RDWR, 0);
+  if (0 > fd) {
+    throw std::runtime_error(m_name + ": " + strerror(errno));
+  }
+
+  struct stat st;
+  void *p = MAP_FAILED;
+  if (0 == fstat(fd, &st)) {
+    m_size = (size_t) st.st_size;
+    p = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  int error = errno;
+  close(fd);
+  if (MAP_FAILED == p) {
+    throw std::runtime_error(m_name + ": " + strerror(error));
+  }
+
+  m_base = (uint8_t *) p;
+  m_header = (jsSharedRingHeader *) m_base;
+  const jsSharedRingHeader &h = *m_header;
+  bool is_valid =
+    (sizeof(jsSharedRingHeader) <= m_size) &&
+    (JS_SHARED_RING_MAGIC ==
+     __atomic_load_n(&m_header->magic, __ATOMIC_ACQUIRE)) &&
+    (JS_SHARED_RING_VERSION == h.version) &&
+    (sizeof(jsSharedRingSlot) <= h.slot_size) &&
+    (0 != h.slot_count) && (0 == (h.slot_count & (h.slot_count - 1))) &&
+    (h.header_size + (size_t) h.slot_count * h.slot_size <= m_size);
+  if (!is_valid) {
+    munmap(m_base, m_size);
+    throw std::runtime_error(m_name + ": not a compatible profile ring");
+  }
+
+  // a free entry, or one left behind by a reader that has since died
+  const uint64_t pid = (uint64_t) getpid();
+  for (auto &entry : m_header->readers) {
+    uint64_t owner = 0;
+    if (!__atomic_compare_exchange_n(&entry.pid, &owner, pid, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      bool is_stale =
+        (0 != kill((pid_t) owner, 0)) && (ESRCH == errno);
+      if (!is_stale ||
+          !__atomic_compare_exchange_n(&entry.pid, &owner, pid, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        continue;
+      }
+    }
+
+    m_entry = &entry;
+    break;
+  }
+
+  if (nullptr == m_entry) {
+    munmap(m_base, m_size);
+    throw std::runtime_error(m_name + ": no free reader entries");
+  }
+
+  m_cursor = Load(&m_header->write_seq);
+  Store(&m_entry->cursor, m_cursor);
+  Store(&m_entry->lapped, 0);
+}
+
+SharedRingReader::~SharedRingReader()
+{
+  Store(&m_entry->pid, 0);
+  munmap(m_base, m_size);
+}
+
+uint32_t SharedRingReader::GetScanHeadCount() const
+{
+  return m_header->num_heads;
+}
+
+uint32_t SharedRingReader::GetSerialNumber(uint32_t head_index) const
+{
+  return m_header->serial_numbers[head_index];
+}
+
+void SharedRingReader::Skip(uint64_t count)
+{
+  m_cursor += count;
+  Store(&m_entry->lapped, Load(&m_entry->lapped) + count);
+  Store(&m_entry->cursor, m_cursor);
+}
+
+const jsProfile *SharedRingReader::Acquire(uint32_t *head_index)
+{
+  const uint64_t slot_count = m_header->slot_count;
+  uint64_t published = Load(&m_header->write_seq);
+  if (published - m_cursor > slot_count) {
+    Skip(published - m_cursor - slot_count);
+  }
+  if (m_cursor >= published) {
+    return nullptr;
+  }
+
+  const jsSharedRingSlot *slot = GetSlot(m_base, *m_header, m_cursor);
+  uint64_t seq = Load(&slot->seq);
+  if (m_cursor + 1 == seq) {
+    m_acquired = slot;
+    *head_index = slot->head_index;
+    return &slot->profile;
+  }
+
+  // lapped since `write_seq` was read; whatever is left in the window is
+  // picked up on the next call
+  if (m_cursor + 1 < seq) {
+    Skip(seq - slot_count - m_cursor);
+  }
+  return nullptr;
+}
+
+bool SharedRingReader::Release()
+{
+  if (nullptr == m_acquired) {
+    return false;
+  }
+
+  // the reads of the profile must be done before the check that they
+  // weren't overwritten
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  bool is_intact =
+    (m_cursor + 1 == __atomic_load_n(&m_acquired->seq, __ATOMIC_RELAXED));
+  m_acquired = nullptr;
+
+  m_cursor++;
+  if (!is_intact) {
+    Store(&m_entry->lapped, Load(&m_entry->lapped) + 1);
+  }
+  Store(&m_entry->cursor, m_cursor);
+  return is_intact;
+}
+
+uint64_t SharedRingReader::GetLapped() const
+{
+  return Load(&m_entry->lapped);
+}
+
+#endif
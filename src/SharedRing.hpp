@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_SHARED_RING_H
+#define JOESCAN_SHARED_RING_H
+
+#include "joescan_profile_ring.h"
+#include <string>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Publishes profiles into a shared memory ring for other processes,
+ * laid out as described in `joescan_profile_ring.h`.
+ *
+ * Publishing is lock-free and may be done from several threads at once,
+ * such as the acquisition thread of every scan head. It never waits on
+ * readers; ones that fall behind get lapped.
+ */
+class SharedRingWriter {
+ public:
+  static const uint32_t kDefaultSlotCount = 1024;
+
+  struct ReaderInfo {
+    uint64_t pid;
+    // profiles published that the reader hasn't read yet
+    uint64_t lag;
+    uint64_t lapped;
+  };
+
+  /**
+   * @brief Creates the shared memory object, replacing any left behind by
+   * a previous run whose process has since exited.
+   *
+   * @param name Name of the object; a leading `/` is added if missing.
+   * @param slot_count Number of slots, rounded up to a power of two.
+   * @param serial_numbers Serial number of each scan head, by index.
+   * @throw std::runtime_error if the object can't be created, or another
+   * running process is publishing into it.
+   */
+  SharedRingWriter(const std::string &name, uint32_t slot_count,
+                   const std::vector<uint32_t> &serial_numbers);
+
+  /**
+   * @brief Unmaps and removes the shared memory object. Readers that still
+   * have it mapped keep their mapping.
+   */
+  ~SharedRingWriter();
+
+  /**
+   * @brief Copies a profile into the next slot.
+   */
+  void Publish(uint32_t head_index, const jsProfile &profile);
+
+  const std::string &GetName() const { return m_name; }
+  uint32_t GetSlotCount() const { return m_slot_count; }
+  uint64_t GetPublished() const;
+
+  /**
+   * @brief Gets the registered readers.
+   */
+  void GetReaders(std::vector<ReaderInfo> *readers) const;
+
+ private:
+  std::string m_name;
+  uint32_t m_slot_count;
+  uint32_t m_slot_size;
+  size_t m_size;
+  uint8_t *m_base;
+  jsSharedRingHeader *m_header;
+};
+
+/**
+ * @brief Reads profiles from a shared memory ring in place, for processes
+ * other than the viewer.
+ *
+ * Reading starts at the newest profile. `Acquire` hands out a pointer into
+ * shared memory, and `Release` tells whether the profile stayed intact
+ * while it was in use; anything derived from it must be thrown away if
+ * not.
+ */
+class SharedRingReader {
+ public:
+  /**
+   * @brief Maps an existing ring and registers as one of its readers.
+   *
+   * @throw std::runtime_error if the ring doesn't exist, isn't compatible
+   * or has no free reader entries.
+   */
+  explicit SharedRingReader(const std::string &name);
+  ~SharedRingReader();
+
+  uint32_t GetScanHeadCount() const;
+  uint32_t GetSerialNumber(uint32_t head_index) const;
+
+  /**
+   * @brief Gets the next profile, skipping ahead first if lapped.
+   *
+   * @param head_index Receives the index of the scan head.
+   * @return The profile, in shared memory, or `nullptr` if there is none
+   * yet. Must be released before the next one is acquired.
+   */
+  const jsProfile *Acquire(uint32_t *head_index);
+
+  /**
+   * @brief Moves past the acquired profile.
+   *
+   * @return `false` if the profile was overwritten while in use.
+   */
+  bool Release();
+
+  /**
+   * @return Profiles lost to being lapped so far.
+   */
+  uint64_t GetLapped() const;
+
+ private:
+  void Skip(uint64_t count);
+
+  std::string m_name;
+  size_t m_size;
+  uint8_t *m_base;
+  jsSharedRingHeader *m_header;
+  jsSharedRingReader *m_entry;
+  uint64_t m_cursor;
+  const jsSharedRingSlot *m_acquired;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "SpatialIndex.hpp"
+#include <cmath>
+
+using namespace joescan;
+
+// marks the end of a cell's chain of points
+static const uint32_t kNone = 0xFFFFFFFF;
+
+// a lookup never searches more than this many cells either side of the one
+// holding the position, no matter the radius
+static const int32_t kMaxCellReach = 4;
+
+SpatialIndex::SpatialIndex(double x_min,
+                           double x_max,
+                           double y_min,
+                           double y_max,
+                           double cell_size,
+                           uint32_t buffer_count) :
+  m_x_min(x_min),
+  m_y_min(y_min),
+  m_inv_cell_size(1.0 / cell_size),
+  m_columns((uint32_t) ceil((x_max - x_min) / cell_size)),
+  m_rows((uint32_t) ceil((y_max - y_min) / cell_size)),
+  m_buffers(buffer_count)
+{
+  for (auto &b : m_buffers) {
+    b.cell_head.assign((size_t) m_columns * m_rows, kNone);
+    b.next.resize(JS_PROFILE_DATA_LEN);
+    b.cell.resize(JS_PROFILE_DATA_LEN);
+    b.x.resize(JS_PROFILE_DATA_LEN);
+    b.y.resize(JS_PROFILE_DATA_LEN);
+    b.count = 0;
+  }
+}
+
+uint32_t SpatialIndex::CellX(double x) const
+{
+  double c = floor((x - m_x_min) * m_inv_cell_size);
+  return (0.0 > c) ? 0 : ((m_columns <= c) ? m_columns - 1 : (uint32_t) c);
+}
+
+uint32_t SpatialIndex::CellY(double y) const
+{
+  double c = floor((y - m_y_min) * m_inv_cell_size);
+  return (0.0 > c) ? 0 : ((m_rows <= c) ? m_rows - 1 : (uint32_t) c);
+}
+
+void SpatialIndex::Update(uint32_t buffer, const ProfileBuffer &data)
+{
+  BufferIndex &b = m_buffers[buffer];
+
+  // only the cells the old points were in need clearing
+  for (uint32_t n = 0; n < b.count; n++) {
+    b.cell_head[b.cell[n]] = kNone;
+  }
+
+  b.count = (JS_PROFILE_DATA_LEN < data.data_len) ?
+            JS_PROFILE_DATA_LEN : data.data_len;
+  for (uint32_t n = 0; n < b.count; n++) {
+    uint32_t cell = CellY(data.y[n]) * m_columns + CellX(data.x[n]);
+    b.cell[n] = cell;
+    b.x[n] = (float) data.x[n];
+    b.y[n] = (float) data.y[n];
+    b.next[n] = b.cell_head[cell];
+    b.cell_head[cell] = n;
+  }
+}
+
+bool SpatialIndex::FindNearest(double x,
+                               double y,
+                               double radius,
+                               const std::vector<bool> &is_enabled,
+                               uint32_t *buffer,
+                               uint32_t *point) const
+{
+  int32_t reach = (int32_t) ceil(radius * m_inv_cell_size);
+  reach = (kMaxCellReach < reach) ? kMaxCellReach : reach;
+
+  const int32_t cx = (int32_t) CellX(x);
+  const int32_t cy = (int32_t) CellY(y);
+  const int32_t x0 = (0 > cx - reach) ? 0 : cx - reach;
+  const int32_t y0 = (0 > cy - reach) ? 0 : cy - reach;
+  const int32_t x1 = ((int32_t) m_columns <= cx + reach) ?
+                     (int32_t) m_columns - 1 : cx + reach;
+  const int32_t y1 = ((int32_t) m_rows <= cy + reach) ?
+                     (int32_t) m_rows - 1 : cy + reach;
+
+  double best = radius * radius;
+  bool is_found = false;
+
+  for (uint32_t k = 0; k < m_buffers.size(); k++) {
+    const BufferIndex &b = m_buffers[k];
+    if ((0 == b.count) || (k >= is_enabled.size()) || !is_enabled[k]) {
+      continue;
+    }
+
+    for (int32_t row = y0; row <= y1; row++) {
+      for (int32_t col = x0; col <= x1; col++) {
+        uint32_t n = b.cell_head[(size_t) row * m_columns + col];
+        for (; kNone != n; n = b.next[n]) {
+          double dx = b.x[n] - x;
+          double dy = b.y[n] - y;
+          double d2 = dx * dx + dy * dy;
+          if (d2 <= best) {
+            best = d2;
+            *buffer = k;
+            *point = n;
+            is_found = true;
+          }
+        }
+      }
+    }
+  }
+
+  return is_found;
+}
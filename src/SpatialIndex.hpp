@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_SPATIAL_INDEX_H
+#define JOESCAN_SPATIAL_INDEX_H
+
+#include "ProfileBuffer.hpp"
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Uniform grid over the points of every element buffer, for finding
+ * the point nearest a position without scanning all of them.
+ *
+ * Each buffer has its own grid, holding the first point of every cell,
+ * with the rest of a cell's points chained behind it. Updating a buffer
+ * only resets the cells its previous points were in before inserting the
+ * new ones, so the cost follows the number of points, not the grid size.
+ * Points outside the grid are kept in its border cells.
+ */
+class SpatialIndex {
+ public:
+  /**
+   * @param x_min Left edge of the grid, in inches.
+   * @param x_max Right edge of the grid, in inches.
+   * @param y_min Bottom edge of the grid, in inches.
+   * @param y_max Top edge of the grid, in inches.
+   * @param cell_size Width and height of a cell, in inches.
+   * @param buffer_count Number of element buffers indexed.
+   */
+  SpatialIndex(double x_min, double x_max, double y_min, double y_max,
+               double cell_size, uint32_t buffer_count);
+
+  /**
+   * @brief Replaces the points of one buffer. Different buffers may be
+   * updated concurrently.
+   */
+  void Update(uint32_t buffer, const ProfileBuffer &data);
+
+  /**
+   * @brief Finds the point nearest a position.
+   *
+   * @param x X position, in inches.
+   * @param y Y position, in inches.
+   * @param radius Points farther away than this are ignored, in inches.
+   * @param is_enabled Per buffer flag, disabled buffers are skipped.
+   * @param buffer Receives the buffer of the point found.
+   * @param point Receives the index of the point within its buffer.
+   * @return `true` if a point was found.
+   */
+  bool FindNearest(double x, double y, double radius,
+                   const std::vector<bool> &is_enabled,
+                   uint32_t *buffer, uint32_t *point) const;
+
+ private:
+  struct BufferIndex {
+    std::vector<uint32_t> cell_head;
+    std::vector<uint32_t> next;
+    std::vector<uint32_t> cell;
+    std::vector<float> x;
+    std::vector<float> y;
+    uint32_t count;
+  };
+
+  uint32_t CellX(double x) const;
+  uint32_t CellY(double y) const;
+
+  double m_x_min;
+  double m_y_min;
+  double m_inv_cell_size;
+  uint32_t m_columns;
+  uint32_t m_rows;
+  std::vector<BufferIndex> m_buffers;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "SyntheticSource.hpp"
+#include "Trace.hpp"
+#include <chrono>
+#include <cmath>
+
+using namespace joescan;
+
+static const double kPi = 3.14159265358979323846;
+// each camera sees this much of the log either side of where it looks
+static const double kHalfSpanRad = 0.7;
+// cameras look this far either side of their scan head's direction
+static const double kCameraOffsetRad = 0.35;
+static const uint32_t kEncoderCountsPerTick = 10;
+
+SyntheticSource::SyntheticSource(uint32_t head_count, uint32_t rate_hz) :
+  m_head_count(head_count),
+  m_rate_hz((0 == rate_hz) ? 1 : rate_hz),
+  m_profile(new jsProfile),
+  m_is_running(false)
+{
+}
+
+SyntheticSource::~SyntheticSource()
+{
+  Stop();
+}
+
+void SyntheticSource::Start(ProfileCallback callback)
+{
+  if (m_is_running) {
+    return;
+  }
+
+  m_callback = callback;
+  m_is_running = true;
+  m_thread = std::thread(&SyntheticSource::SourceThread, this);
+}
+
+void SyntheticSource::Stop()
+{
+  if (!m_is_running) {
+    return;
+  }
+
+  m_is_running = false;
+  m_thread.join();
+}
+
+void SyntheticSource::Generate(uint32_t head_index,
+                               uint32_t element,
+                               uint64_t tick,
+                               jsProfile *profile) const
+{
+  const double t = (double) tick / m_rate_hz;
+  const double radius = 6.0 + 1.5 * sin(2.0 * kPi * t / 7.0);
+  const double center_x = 0.5 * sin(2.0 * kPi * t / 3.1);
+  const double center_y = 0.3 * cos(2.0 * kPi * t / 4.3);
+  // the first scan head sits above the log
+  const double head_angle = 0.5 * kPi + 2.0 * kPi * head_index / m_head_count;
+  const double camera_angle = (0 == element) ?
+                              head_angle - kCameraOffsetRad :
+                              head_angle + kCameraOffsetRad;
+
+  profile->scan_head_id = head_index;
+  profile->camera = (jsCamera) (JS_CAMERA_A + element);
+  profile->laser = JS_LASER_1;
+  profile->timestamp_ns = (uint64_t)
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  profile->flags = 0;
+  profile->sequence_number = (uint32_t) tick;
+  profile->laser_on_time_us = 500;
+  profile->format = JS_DATA_FORMAT_XY_BRIGHTNESS_FULL;
+  profile->packets_received = 1;
+  profile->packets_expected = 1;
+  profile->num_encoder_values = 1;
+  profile->encoder_values[0] = (int64_t) (tick * kEncoderCountsPerTick);
+  profile->data_len = JS_PROFILE_DATA_LEN;
+
+  // a little bark roughness, drifting along the log, so that consecutive
+  // profiles differ in their detail as well as their shape
+  for (uint32_t n = 0; n < JS_PROFILE_DATA_LEN; n++) {
+    double u = (double) n / (JS_PROFILE_DATA_LEN - 1) - 0.5;
+    double a = camera_angle + 2.0 * kHalfSpanRad * u;
+    double r = radius * (1.0 + 0.01 * sin(23.0 * a + 3.0 * t));
+    jsProfileData &d = profile->data[n];
+    d.x = (int32_t) (1000.0 * (center_x + r * cos(a)));
+    d.y = (int32_t) (1000.0 * (center_y + r * sin(a)));
+    d.brightness = (int32_t) (60.0 + 150.0 * cos(a - camera_angle));
+  }
+}
+
+void SyntheticSource::SourceThread()
+{
+  const std::chrono::nanoseconds period(1000000000ULL / m_rate_hz);
+  auto next = std::chrono::steady_clock::now();
+  uint64_t tick = 0;
+  Trace::SetThreadName("Synthetic Source");
+
+  while (m_is_running) {
+    {
+      TraceSpan span("Generate Profiles");
+      for (uint32_t h = 0; h < m_head_count; h++) {
+        for (uint32_t e = 0; e < kElementCount; e++) {
+          Generate(h, e, tick, m_profile.get());
+          m_callback(h, *m_profile);
+        }
+      }
+    }
+    tick++;
+
+    // falling behind skips ahead rather than catching up in a burst
+    next += period;
+    auto now = std::chrono::steady_clock::now();
+    if (now > next + 10 * period) {
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
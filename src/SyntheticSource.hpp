@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_SYNTHETIC_SOURCE_H
+#define JOESCAN_SYNTHETIC_SOURCE_H
+
+#include "joescan_pinchot.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace joescan {
+
+/**
+ * @brief Generates profiles of a log passing through a ring of camera
+ * driven scan heads, for exercising the daemon and its viewers without any
+ * hardware.
+ *
+ * The heads are spread evenly around the log and each sees the part of its
+ * surface facing it, already in mill coordinates. The log's diameter and
+ * position wander slowly over time and the encoder advances steadily.
+ */
+class SyntheticSource {
+ public:
+  typedef std::function<void(uint32_t head_index, const jsProfile &profile)>
+    ProfileCallback;
+
+  /**
+   * @brief Number of cameras each synthetic scan head has.
+   */
+  static const uint32_t kElementCount = 2;
+
+  /**
+   * @param head_count Number of scan heads to generate profiles for.
+   * @param rate_hz Profiles per second generated for each camera.
+   */
+  SyntheticSource(uint32_t head_count, uint32_t rate_hz);
+  ~SyntheticSource();
+
+  /**
+   * @brief Starts generating profiles, calling `callback` for each on the
+   * source's own thread.
+   */
+  void Start(ProfileCallback callback);
+
+  /**
+   * @brief Stops generating profiles; blocks until the thread has exited.
+   */
+  void Stop();
+
+  /**
+   * @brief Fills in the profile the source generates for a camera at a
+   * tick, the count of profiles per camera since it started.
+   */
+  void Generate(uint32_t head_index, uint32_t element, uint64_t tick,
+                jsProfile *profile) const;
+
+ private:
+  void SourceThread();
+
+  uint32_t m_head_count;
+  uint32_t m_rate_hz;
+  ProfileCallback m_callback;
+  std::unique_ptr<jsProfile> m_profile;
+  std::thread m_thread;
+  std::atomic<bool> m_is_running;
+};
+
+} // namespace joescan
+
+#endif
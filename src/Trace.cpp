@@ -0,0 +1,215 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "Trace.hpp"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace joescan;
+
+// Fields are atomic so a ring can be read while its thread writes to it;
+// relaxed loads and stores of them compile to plain moves.
+struct TraceSlot {
+  std::atomic<const char *> name;
+  std::atomic<uint64_t> begin_ns;
+  std::atomic<uint64_t> end_ns;
+};
+
+struct TraceRing {
+  std::unique_ptr<TraceSlot[]> slots;
+  std::atomic<uint64_t> write_idx;
+  // spans before this one were recorded by a thread that has since exited
+  std::atomic<uint64_t> first_idx;
+  std::atomic<bool> is_in_use;
+  uint32_t tid;
+  // only touched under `s_mutex`
+  std::string thread_name;
+};
+
+// frees the ring of a thread for the next one when the thread exits
+struct TraceRingOwner {
+  TraceRing *ring = nullptr;
+  std::string name;
+
+  ~TraceRingOwner()
+  {
+    if (nullptr != ring) {
+      ring->is_in_use = false;
+    }
+  }
+};
+
+struct TraceEvent {
+  const char *name;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+};
+
+std::atomic<bool> Trace::s_is_enabled(false);
+
+static std::mutex s_mutex;
+static std::vector<std::unique_ptr<TraceRing>> s_rings;
+// spans are timed from when the program started
+static const uint64_t s_epoch_ns = Trace::Now();
+static thread_local TraceRingOwner s_owner;
+
+static TraceRing *GetRing()
+{
+  if (nullptr != s_owner.ring) {
+    return s_owner.ring;
+  }
+
+  std::lock_guard<std::mutex> lock(s_mutex);
+  TraceRing *ring = nullptr;
+  for (auto &r : s_rings) {
+    if (!r->is_in_use) {
+      ring = r.get();
+      ring->first_idx = ring->write_idx.load();
+      break;
+    }
+  }
+
+  if (nullptr == ring) {
+    std::unique_ptr<TraceRing> r(new TraceRing);
+    r->slots.reset(new TraceSlot[Trace::kSpansPerThread]);
+    r->write_idx = 0;
+    r->first_idx = 0;
+    r->tid = (uint32_t) s_rings.size() + 1;
+    ring = r.get();
+    s_rings.push_back(std::move(r));
+  }
+
+  ring->is_in_use = true;
+  ring->thread_name = s_owner.name;
+  s_owner.ring = ring;
+  return ring;
+}
+
+static void WriteEscaped(FILE *file, const char *text)
+{
+  for (const char *c = text; '\0' != *c; c++) {
+    if (('"' == *c) || ('\\' == *c)) {
+      fputc('\\', file);
+      fputc(*c, file);
+    } else if (' ' <= (unsigned char) *c) {
+      fputc(*c, file);
+    }
+  }
+}
+
+void Trace::SetEnabled(bool is_enabled)
+{
+  s_is_enabled = is_enabled;
+}
+
+void Trace::SetThreadName(const std::string &name)
+{
+  // the ring is only allocated once the thread records something
+  s_owner.name = name;
+  if (nullptr != s_owner.ring) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_owner.ring->thread_name = name;
+  }
+}
+
+void Trace::Add(const char *name, uint64_t begin_ns, uint64_t end_ns)
+{
+  TraceRing &ring = *GetRing();
+  uint64_t idx = ring.write_idx.load(std::memory_order_relaxed);
+
+  // orders the slot after the index published for the span before, so a
+  // reader that sees any of this span also sees that index
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceSlot &slot = ring.slots[idx % kSpansPerThread];
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.begin_ns.store(begin_ns, std::memory_order_relaxed);
+  slot.end_ns.store(end_ns, std::memory_order_relaxed);
+  ring.write_idx.store(idx + 1, std::memory_order_release);
+}
+
+uint64_t Trace::Write(const std::string &path)
+{
+  FILE *file = fopen(path.c_str(), "wb");
+  if (nullptr == file) {
+    throw std::runtime_error("failed to create " + path);
+  }
+  setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  uint64_t count = 0;
+  bool is_first = true;
+  std::vector<TraceEvent> events;
+  {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (auto &r : s_rings) {
+      const TraceRing &ring = *r;
+      const uint64_t first = ring.first_idx;
+      const uint64_t end = ring.write_idx.load(std::memory_order_acquire);
+      uint64_t begin = (end > kSpansPerThread) ? end - kSpansPerThread : 0;
+      begin = (first > begin) ? first : begin;
+
+      events.clear();
+      for (uint64_t idx = begin; idx < end; idx++) {
+        const TraceSlot &slot = ring.slots[idx % kSpansPerThread];
+        TraceEvent e;
+        e.name = slot.name.load(std::memory_order_relaxed);
+        e.begin_ns = slot.begin_ns.load(std::memory_order_relaxed);
+        e.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+        events.push_back(e);
+      }
+
+      // spans the thread may have started overwriting while they were
+      // copied are left out
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint64_t now = ring.write_idx.load(std::memory_order_relaxed);
+      const uint64_t valid =
+        (now + 1 > kSpansPerThread) ? now + 1 - kSpansPerThread : 0;
+      const size_t skip =
+        (valid > begin) ? (size_t) (valid - begin) : 0;
+
+      fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+              "\"tid\":%u,\"args\":{\"name\":\"",
+              (is_first) ? "" : ",\n", ring.tid);
+      WriteEscaped(file, (ring.thread_name.empty()) ?
+                         "Thread" :
+                         ring.thread_name.c_str());
+      fprintf(file, "\"}}");
+      is_first = false;
+
+      for (size_t n = skip; n < events.size(); n++) {
+        const TraceEvent &e = events[n];
+        fprintf(file, ",\n{\"name\":\"");
+        WriteEscaped(file, e.name);
+        fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                ring.tid,
+                (e.begin_ns - s_epoch_ns) / 1000.0,
+                (e.end_ns - e.begin_ns) / 1000.0);
+        count++;
+      }
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  bool is_failed = (0 != ferror(file));
+  is_failed = (0 != fclose(file)) || is_failed;
+  if (is_failed) {
+    throw std::runtime_error("failed to write " + path);
+  }
+
+  return count;
+}
+
+size_t Trace::GetMemoryUsage()
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  return s_rings.size() *
+         (sizeof(TraceRing) + kSpansPerThread * sizeof(TraceSlot));
+}
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_TRACE_H
+#define JOESCAN_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace joescan {
+
+/**
+ * @brief Timing spans of every thread, written out as Chrome trace event
+ * JSON, which Perfetto and chrome://tracing open, to show what the threads
+ * were doing at the same time.
+ *
+ * Each thread records into a ring of its own, allocated the first time it
+ * records, so recording takes no locks and never waits: the last
+ * `kSpansPerThread` spans of every thread are kept. Writing the trace out
+ * reads the rings while threads keep recording, leaving out any span
+ * overwritten while it was being read. The ring of a thread that has
+ * exited is taken over by the next thread to start recording.
+ *
+ * Recording is off until enabled; a disabled span costs one relaxed load.
+ */
+class Trace {
+ public:
+  static const uint32_t kSpansPerThread = 16384;
+
+  static void SetEnabled(bool is_enabled);
+  static bool IsEnabled()
+  {
+    return s_is_enabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Names the calling thread in the trace.
+   */
+  static void SetThreadName(const std::string &name);
+
+  /**
+   * @brief Records a span of the calling thread.
+   *
+   * @param name Name of the span, which has to outlive the trace; normally
+   * a string literal.
+   */
+  static void Add(const char *name, uint64_t begin_ns, uint64_t end_ns);
+
+  /**
+   * @brief Writes the spans recorded so far to a JSON file.
+   *
+   * @return Number of spans written.
+   * @throw std::runtime_error if the file can't be written.
+   */
+  static uint64_t Write(const std::string &path);
+
+  /**
+   * @return Bytes allocated for the rings of every thread.
+   */
+  static size_t GetMemoryUsage();
+
+  static uint64_t Now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+ private:
+  static std::atomic<bool> s_is_enabled;
+};
+
+/**
+ * @brief Records the time from its construction to its destruction as a
+ * span of the calling thread.
+ */
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char *name) :
+    m_name(name),
+    m_begin_ns((Trace::IsEnabled()) ? Trace::Now() : 0)
+  {
+  }
+
+  ~TraceSpan()
+  {
+    if (0 != m_begin_ns) {
+      Trace::Add(m_name, m_begin_ns, Trace::Now());
+    }
+  }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+ private:
+  const char *m_name;
+  uint64_t m_begin_ns;
+};
+
+} // namespace joescan
+
+#endif
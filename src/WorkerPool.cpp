@@ -0,0 +1,273 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#include "WorkerPool.hpp"
+#include "Trace.hpp"
+#include <string>
+
+using namespace joescan;
+
+// tasks each queue has room for before it first has to grow
+static const size_t kInitialQueueLen = 64;
+
+// identifies the pool and queue of a worker thread, so that work created
+// by a task lands on the queue of the worker running it
+static thread_local const WorkerPool *s_pool = nullptr;
+static thread_local uint32_t s_queue = 0;
+
+WorkerPool::WorkerPool(uint32_t thread_count) :
+  m_queued(0),
+  m_next_queue(0),
+  m_is_running(true)
+{
+  if (0 == thread_count) {
+    uint32_t hw = std::thread::hardware_concurrency();
+    thread_count = (1 < hw) ? hw - 1 : 1;
+  }
+
+  for (uint32_t n = 0; n <= thread_count; n++) {
+    std::unique_ptr<Queue> queue(new Queue);
+    queue->tasks.resize(kInitialQueueLen);
+    queue->first = 0;
+    queue->count = 0;
+    queue->tasks_run = 0;
+    queue->steals = 0;
+    m_queues.push_back(std::move(queue));
+  }
+
+  for (uint32_t n = 0; n < thread_count; n++) {
+    m_threads.push_back(std::thread(&WorkerPool::WorkerThread, this, n));
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_is_running = false;
+  }
+  m_cv_work.notify_all();
+
+  for (auto &thread : m_threads) {
+    thread.join();
+  }
+}
+
+uint32_t WorkerPool::GetThreadCount() const
+{
+  return (uint32_t) m_threads.size();
+}
+
+void WorkerPool::ParallelFor(uint32_t count, const void *fn, IndexFn call)
+{
+  if (0 == count) {
+    return;
+  }
+
+  // callers from outside the pool share a queue, so they take turns; they
+  // pass for workers on it until done, so nested calls don't wait on
+  // themselves
+  std::unique_lock<std::mutex> caller_lock(m_caller_mutex, std::defer_lock);
+  const bool is_outside = (this != s_pool);
+  const WorkerPool *outer_pool = s_pool;
+  const uint32_t outer_queue = s_queue;
+  if (is_outside) {
+    caller_lock.lock();
+    s_pool = this;
+    s_queue = (uint32_t) m_threads.size();
+  }
+
+  const uint32_t queue = s_queue;
+  Job job;
+  job.fn = fn;
+  job.call = call;
+  job.remaining = count;
+
+  Task task;
+  task.job = &job;
+  task.begin = 0;
+  task.end = count;
+  Push(queue, std::move(task));
+
+  // the caller only helps with its own job; anything else it picked up
+  // could keep it away for much longer than the job takes
+  while (0 != job.remaining) {
+    if (Pop(queue, &task) || Steal(queue, &job, &task)) {
+      Run(queue, task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv_done.wait(lock, [&] { return 0 == job.remaining; });
+  }
+
+  if (is_outside) {
+    s_pool = outer_pool;
+    s_queue = outer_queue;
+  }
+}
+
+void WorkerPool::Submit(std::function<void()> task)
+{
+  Task t;
+  t.fn = std::move(task);
+  t.job = nullptr;
+  t.begin = 0;
+  t.end = 0;
+
+  // tasks from outside the pool are dealt out over the workers in turn
+  uint32_t queue = (this == s_pool) ?
+                   s_queue :
+                   m_next_queue.fetch_add(1) % (uint32_t) m_threads.size();
+  Push(queue, std::move(t));
+}
+
+void WorkerPool::GetStats(std::vector<QueueStats> *stats) const
+{
+  stats->resize(m_queues.size());
+  for (uint32_t n = 0; n < m_queues.size(); n++) {
+    const Queue &queue = *m_queues[n];
+    QueueStats &s = (*stats)[n];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      s.depth = (uint32_t) queue.count;
+    }
+    s.tasks_run = queue.tasks_run;
+    s.steals = queue.steals;
+  }
+}
+
+void WorkerPool::Push(uint32_t queue, Task task)
+{
+  {
+    Queue &q = *m_queues[queue];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    // counted before it is visible, so the count never falls short
+    m_queued++;
+    if (q.tasks.size() == q.count) {
+      Grow(&q);
+    }
+    q.tasks[(q.first + q.count) % q.tasks.size()] = std::move(task);
+    q.count++;
+  }
+
+  // taking the lock orders this against a worker about to go to sleep
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+  }
+  m_cv_work.notify_one();
+}
+
+void WorkerPool::Grow(Queue *q)
+{
+  // unwrapped into a ring twice the size, oldest first
+  std::vector<Task> tasks(q->tasks.size() * 2);
+  for (size_t n = 0; n < q->count; n++) {
+    tasks[n] = std::move(q->tasks[(q->first + n) % q->tasks.size()]);
+  }
+  q->tasks.swap(tasks);
+  q->first = 0;
+}
+
+bool WorkerPool::Pop(uint32_t queue, Task *task)
+{
+  // the owner takes its newest task, whose data is most likely in cache
+  Queue &q = *m_queues[queue];
+  std::lock_guard<std::mutex> lock(q.mutex);
+  if (0 == q.count) {
+    return false;
+  }
+
+  q.count--;
+  *task = std::move(q.tasks[(q.first + q.count) % q.tasks.size()]);
+  m_queued--;
+  return true;
+}
+
+bool WorkerPool::Steal(uint32_t queue, Job *job, Task *task)
+{
+  // thieves take the oldest task, which for a parallel job is the largest
+  // range left; `job` limits them to the ranges of one job
+  const uint32_t count = (uint32_t) m_queues.size();
+  for (uint32_t k = 1; (k < count) && (0 != m_queued); k++) {
+    Queue &victim = *m_queues[(queue + k) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if ((0 == victim.count) ||
+        ((nullptr != job) && (job != victim.tasks[victim.first].job))) {
+      continue;
+    }
+
+    *task = std::move(victim.tasks[victim.first]);
+    victim.first = (victim.first + 1) % victim.tasks.size();
+    victim.count--;
+    m_queued--;
+    m_queues[queue]->steals++;
+    return true;
+  }
+
+  return false;
+}
+
+void WorkerPool::Run(uint32_t queue, Task &task)
+{
+  m_queues[queue]->tasks_run++;
+
+  if (nullptr == task.job) {
+    TraceSpan span("Task");
+    task.fn();
+    // drop whatever the task holds on to now rather than at the next one
+    task.fn = nullptr;
+    return;
+  }
+
+  // keep the first index and leave the rest behind in halves, so idle
+  // workers can take over the bulk of a range while this one is busy
+  while (1 < task.end - task.begin) {
+    Task half;
+    half.job = task.job;
+    half.begin = task.begin + (task.end - task.begin) / 2;
+    half.end = task.end;
+    task.end = half.begin;
+    Push(queue, std::move(half));
+  }
+
+  Job &job = *task.job;
+  {
+    TraceSpan span("Parallel For");
+    job.call(job.fn, task.begin);
+  }
+
+  if (1 == job.remaining.fetch_sub(1)) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cv_done.notify_all();
+  }
+}
+
+void WorkerPool::WorkerThread(uint32_t queue)
+{
+  s_pool = this;
+  s_queue = queue;
+  Trace::SetThreadName("Worker " + std::to_string(queue));
+
+  Task task;
+  while (true) {
+    if (Pop(queue, &task) || Steal(queue, nullptr, &task)) {
+      Run(queue, task);
+      continue;
+    }
+
+    // queued tasks are still finished off once the pool is stopping
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (0 != m_queued) {
+      continue;
+    }
+    if (!m_is_running) {
+      return;
+    }
+    m_cv_work.wait(lock, [this] { return !m_is_running || 0 != m_queued; });
+  }
+}
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+#ifndef JOESCAN_WORKER_POOL_H
+#define JOESCAN_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace joescan {
+
+/**
+ * @brief Fixed set of worker threads for splitting per element work across
+ * cores, and for running tasks in the background.
+ *
+ * Work is scheduled by stealing: every worker has its own queue, taking
+ * its newest task first, and an idle worker takes the oldest task of
+ * another's queue. The ranges of `ParallelFor` are split in half as they
+ * run, so the halves left in a queue are there to be stolen by whichever
+ * core runs out first, however uneven the cost of the elements.
+ */
+class WorkerPool {
+ public:
+  /**
+   * @brief Activity of one queue, for instrumentation.
+   */
+  struct QueueStats {
+    uint32_t depth;
+    uint64_t tasks_run;
+    // tasks taken from other queues
+    uint64_t steals;
+  };
+
+  /**
+   * @brief Creates the pool.
+   *
+   * @param thread_count Number of worker threads; zero picks one less than
+   * the number of hardware threads, as the calling thread also works.
+   */
+  explicit WorkerPool(uint32_t thread_count = 0);
+  ~WorkerPool();
+
+  uint32_t GetThreadCount() const;
+
+  /**
+   * @brief Calls `fn` once for every index in `[0, count)`, spread over the
+   * workers and the calling thread, and returns when all calls are done.
+   * May also be called from within a task.
+   *
+   * `fn` is called through a pointer rather than wrapped in a
+   * `std::function`, so a call allocates nothing whatever `fn` captures.
+   */
+  template <typename Fn>
+  void ParallelFor(uint32_t count, const Fn &fn)
+  {
+    ParallelFor(count, &fn, [](const void *f, uint32_t n) {
+      (*(const Fn *) f)(n);
+    });
+  }
+
+  /**
+   * @brief Queues a task to run on one of the workers and returns at once.
+   * Tasks still queued when the pool is destroyed are run before the
+   * workers exit.
+   */
+  void Submit(std::function<void()> task);
+
+  /**
+   * @brief Gets the activity of every worker's queue, followed by that of
+   * the queue shared by callers of `ParallelFor` outside the pool.
+   */
+  void GetStats(std::vector<QueueStats> *stats) const;
+
+ private:
+  typedef void (*IndexFn)(const void *fn, uint32_t n);
+
+  struct Job {
+    const void *fn;
+    IndexFn call;
+    std::atomic<uint32_t> remaining;
+  };
+
+  // either a submitted task or a range of a parallel job
+  struct Task {
+    std::function<void()> fn;
+    Job *job;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  // tasks are kept in a ring that only ever grows, so once it has grown
+  // to the most tasks queued at once, queueing allocates nothing
+  struct Queue {
+    mutable std::mutex mutex;
+    std::vector<Task> tasks;
+    size_t first;
+    size_t count;
+    std::atomic<uint64_t> tasks_run;
+    std::atomic<uint64_t> steals;
+  };
+
+  void ParallelFor(uint32_t count, const void *fn, IndexFn call);
+  void WorkerThread(uint32_t queue);
+  void Push(uint32_t queue, Task task);
+  void Grow(Queue *q);
+  bool Pop(uint32_t queue, Task *task);
+  bool Steal(uint32_t queue, Job *job, Task *task);
+  void Run(uint32_t queue, Task &task);
+
+  std::vector<std::thread> m_threads;
+  // one per worker, plus one for callers from outside the pool
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::atomic<uint32_t> m_queued;
+  std::atomic<uint32_t> m_next_queue;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv_work;
+  std::condition_variable m_cv_done;
+  bool m_is_running;
+
+  // outside callers of ParallelFor take turns on their shared queue
+  std::mutex m_caller_mutex;
+};
+
+} // namespace joescan
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+/**
+ * @file joescan_profile_plugin.h
+ * @brief C interface for processing plugins loaded by the viewer.
+ *
+ * A plugin is a shared library exporting `jsPluginEntry`. The viewer calls
+ * it once when loading the library and keeps the returned interface for
+ * the life of the process. Batches of profiles are then passed to
+ * `process` on a worker thread; a plugin is never called from more than
+ * one thread at a time, but not always from the same one.
+ *
+ * Profiles are handed over by pointer into the viewer's own buffers and
+ * are only valid for the duration of the call. Coordinates are in 1/1000
+ * inch, as the viewer received them, so host alignment has been applied if
+ * it was on. Overlay primitives are given in inches, as plotted.
+ */
+
+#ifndef JOESCAN_PROFILE_PLUGIN_H
+#define JOESCAN_PROFILE_PLUGIN_H
+
+#include "joescan_pinchot.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JS_PLUGIN_API_VERSION 1
+#define JS_PLUGIN_ENTRY_NAME "jsPluginEntry"
+#define JS_PLUGIN_METRIC_NAME_LEN 32
+/**
+ * @brief Name of a metric that dumps the viewer's black box, if it keeps
+ * one, whenever it goes from zero to non-zero.
+ */
+#define JS_PLUGIN_METRIC_TRIGGER "trigger"
+
+#if defined(_WIN32)
+#define JS_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define JS_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+/**
+ * @brief Profiles received since the previous batch, across all scan
+ * heads, in the order they were received per scan head.
+ *
+ * Profiles that arrive while the plugins are still busy with a batch, or
+ * after a batch is full, are drawn but never batched; `dropped_profiles`
+ * counts them.
+ */
+typedef struct {
+  /** @brief Profiles of the batch. */
+  const jsProfile *profiles;
+  /** @brief Scan head index of each profile. */
+  const uint32_t *head_indices;
+  /** @brief Number of profiles. */
+  uint32_t num_profiles;
+  /** @brief Serial number of each scan head, by index. */
+  const uint32_t *serial_numbers;
+  /** @brief Number of scan heads. */
+  uint32_t num_heads;
+  /**
+   * @brief Increases by one with every batch; a plugin sitting out
+   * batches sees gaps.
+   */
+  uint64_t batch_number;
+  /**
+   * @brief Profiles received since the previous batch that are not in
+   * this one.
+   */
+  uint64_t dropped_profiles;
+} jsPluginBatch;
+
+typedef enum {
+  /** @brief Square marker at (x0, y0). */
+  JS_PLUGIN_PRIMITIVE_POINT = 0,
+  /** @brief Line from (x0, y0) to (x1, y1). */
+  JS_PLUGIN_PRIMITIVE_LINE = 1,
+  /** @brief Circle centered on (x0, y0) with radius x1. */
+  JS_PLUGIN_PRIMITIVE_CIRCLE = 2,
+} jsPluginPrimitiveType;
+
+typedef struct {
+  jsPluginPrimitiveType type;
+  /** @brief Color as 0xAABBGGRR. */
+  uint32_t color;
+  double x0;
+  double y0;
+  double x1;
+  double y1;
+} jsPluginPrimitive;
+
+typedef struct {
+  char name[JS_PLUGIN_METRIC_NAME_LEN];
+  double value;
+} jsPluginMetric;
+
+/**
+ * @brief Storage provided by the viewer for a plugin's results. Both
+ * counts are zero on entry to `process`; a plugin fills up to the maximum
+ * and sets the counts. Results replace those of the previous batch.
+ */
+typedef struct {
+  jsPluginPrimitive *primitives;
+  uint32_t max_primitives;
+  uint32_t num_primitives;
+  jsPluginMetric *metrics;
+  uint32_t max_metrics;
+  uint32_t num_metrics;
+} jsPluginOutput;
+
+typedef struct {
+  /** @brief Must be `JS_PLUGIN_API_VERSION`. */
+  uint32_t api_version;
+  /** @brief Name shown in the viewer. */
+  const char *name;
+  /**
+   * @brief Time a call to `process` is expected to take, in microseconds;
+   * zero uses the viewer's default. Plugins that run over are skipped for
+   * as many batches as they ran over by.
+   */
+  uint32_t budget_us;
+  /** @brief Creates the plugin's state; may return NULL if it has none. */
+  void *(*create)(void);
+  /** @brief Frees what `create` returned. */
+  void (*destroy)(void *ctx);
+  /** @brief Processes a batch. */
+  void (*process)(void *ctx,
+                  const jsPluginBatch *batch,
+                  jsPluginOutput *output);
+} jsPluginInterface;
+
+/**
+ * @brief Signature of `jsPluginEntry`.
+ *
+ * @param host_api_version `JS_PLUGIN_API_VERSION` of the viewer.
+ * @return The plugin's interface, or NULL if it can't work with the
+ * viewer's version.
+ */
+typedef const jsPluginInterface *(*jsPluginEntryFn)(
+  uint32_t host_api_version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+/**
+ * @file joescan_profile_ring.h
+ * @brief Layout of the shared memory ring the viewer publishes profiles
+ * into, for other processes on the same machine.
+ *
+ * The ring is a POSIX shared memory object, named by the `--shm` option,
+ * holding a `jsSharedRingHeader` followed by `slot_count` slots of
+ * `slot_size` bytes each, starting `header_size` bytes in. Profiles are
+ * numbered from zero in the order they are published, across all scan
+ * heads; profile `n` goes into slot `n % slot_count`.
+ *
+ * There is one writing process, which never waits on readers, but it
+ * publishes from several threads at once, one per scan head. A thread
+ * claims profile `n` with an atomic fetch and add on `write_seq`, sets the
+ * slot's `seq` to zero, copies the profile in and then sets `seq` to
+ * `n + 1`. Profiles are written in place and only as far as `data_len`
+ * points. As threads copy at the same time, profile `n + 1` can be ready
+ * before profile `n`, and `write_seq` passing `n` only means it has been
+ * claimed. A reader wanting profile `n` waits for `write_seq` to pass `n`
+ * and the slot's `seq` to read `n + 1`, uses the profile in place, and
+ * then checks `seq` again: if it changed, a writer lapped the reader while
+ * it was reading and what was read must be discarded. A reader that falls
+ * more than `slot_count` profiles behind `write_seq` has been lapped and
+ * skips ahead, whether or not the profiles it skips were ever finished.
+ *
+ * Fields marked atomic are 64-bit aligned and must be accessed with
+ * atomic operations; `seq` and `write_seq` with acquire loads.
+ *
+ * Readers may register in the `readers` table, by atomically swapping
+ * their process id into a free entry (or one whose process no longer
+ * exists), so the writer can show how far behind each one is. A reader
+ * keeps `cursor` at the next profile it will read and adds the profiles
+ * it lost to being lapped to `lapped`, and clears `pid` when done.
+ */
+
+#ifndef JOESCAN_PROFILE_RING_H
+#define JOESCAN_PROFILE_RING_H
+
+#include "joescan_pinchot.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief "JSPR" in little endian. */
+#define JS_SHARED_RING_MAGIC 0x5250534Au
+#define JS_SHARED_RING_VERSION 1
+#define JS_SHARED_RING_MAX_HEADS 16
+#define JS_SHARED_RING_MAX_READERS 16
+
+typedef struct {
+  /** @brief Atomic; id of the reader's process, zero if the entry is free. */
+  uint64_t pid;
+  /** @brief Atomic; number of the next profile the reader will read. */
+  uint64_t cursor;
+  /** @brief Atomic; profiles the reader lost to being lapped. */
+  uint64_t lapped;
+  uint64_t reserved[5];
+} jsSharedRingReader;
+
+typedef struct {
+  /** @brief `JS_SHARED_RING_MAGIC` once the ring is ready for readers. */
+  uint32_t magic;
+  /** @brief `JS_SHARED_RING_VERSION`. */
+  uint32_t version;
+  /** @brief Offset of the first slot, in bytes. */
+  uint32_t header_size;
+  /** @brief Distance between slots, in bytes. */
+  uint32_t slot_size;
+  /** @brief Number of slots; a power of two. */
+  uint32_t slot_count;
+  /** @brief Number of scan heads. */
+  uint32_t num_heads;
+  /** @brief Serial number of each scan head, by index. */
+  uint32_t serial_numbers[JS_SHARED_RING_MAX_HEADS];
+  /**
+   * @brief Id of the writer's process; a new writer refuses to replace a
+   * ring whose writer is still running.
+   */
+  uint64_t writer_pid;
+  uint64_t reserved_0[4];
+  /** @brief Atomic; number of profiles claimed by the writer's threads. */
+  uint64_t write_seq;
+  uint64_t reserved_1[7];
+  jsSharedRingReader readers[JS_SHARED_RING_MAX_READERS];
+} jsSharedRingHeader;
+
+typedef struct {
+  /**
+   * @brief Atomic; one more than the number of the profile in the slot,
+   * zero while it is being written.
+   */
+  uint64_t seq;
+  /** @brief Index of the scan head the profile came from. */
+  uint32_t head_index;
+  uint32_t reserved;
+  /** @brief The profile; only the first `data_len` points are written. */
+  jsProfile profile;
+} jsSharedRingSlot;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,6 +9,38 @@
 #include "implot.h"
 #include "joescan_pinchot.h"
 #include "jsScanApplication.hpp"
+#include "AllocationCounter.hpp"
+#include "AlignmentTable.hpp"
+#include "AreaIntegrator.hpp"
+#include "AutoExposure.hpp"
+#include "BlackBox.hpp"
+#include "BrightnessView.hpp"
+#include "CameraImageView.hpp"
+#include "ElementStats.hpp"
+#include "FrameArena.hpp"
+#include "FitEngine.hpp"
+#include "MemoryAccounting.hpp"
+#include "MergedCloud.hpp"
+#include "Metrics.hpp"
+#include "MetricsServer.hpp"
+#include "PluginHost.hpp"
+#include "ProfileAcquisition.hpp"
+#include "ProfileBuffer.hpp"
+#include "ProfileClient.hpp"
+#include "ProfileExporter.hpp"
+#include "ProfileFilter.hpp"
+#include "ProfileGrid.hpp"
+#include "ProfileLod.hpp"
+#include "ProfilePool.hpp"
+#include "ProfileRecorder.hpp"
+#include "ProfileServer.hpp"
+#include "RecordingFollower.hpp"
+#include "ReferenceProfile.hpp"
+#include "SharedRing.hpp"
+#include "SpatialIndex.hpp"
+#include "SyntheticSource.hpp"
+#include "Trace.hpp"
+#include "WorkerPool.hpp"
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -21,8 +53,16 @@
 #endif
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <string>
 #include <sstream>
+#include <thread>
 
 // [Win32] Our example includes a copy of glfw3.lib pre-compiled with VS2010 to maximize ease of testing and compatibility with old VS compilers.
 // To link with VS2010-era libraries, VS2015+ requires linking with legacy_stdio_definitions.lib, which we do using this pragma.
@@ -31,104 +71,864 @@
 #pragma comment(lib, "legacy_stdio_definitions")
 #endif
 
-#if 0
-#include "json.hpp"
+static volatile std::sig_atomic_t s_is_stopping = 0;
+static volatile std::sig_atomic_t s_is_dump_requested = 0;
+static volatile std::sig_atomic_t s_is_trace_requested = 0;
 
-static void apply_alignment_json(jsScanHead &scan_head)
+static void glfw_error_callback(int error, const char* description)
+{
+  fprintf(stderr, "Glfw Error %d: %s\n", error, description);
+}
+
+static void stop_signal_handler(int)
+{
+  s_is_stopping = 1;
+}
+
+static void dump_signal_handler(int)
+{
+  s_is_dump_requested = 1;
+}
+
+static void trace_signal_handler(int)
 {
-  std::string file_name = std::to_string(serial_number) + ".json";
-  std::ifstream fstream(file_name);
+  s_is_trace_requested = 1;
+}
 
+// Writes the spans traced so far, reporting how many there were.
+static void write_trace(const std::string &path)
+{
   try {
-    using nlohmann::json;
-
-    std::stringstream ss;
-    ss << fstream.rdbuf();
-    auto j = json::parse(ss.str());
-
-    int32_t orientation = j["Orientation"];
-    bool is_cable_downstream = (0 == orientation) ? false : true;
-
-    for (auto& e : j["Alignment"]) {
-      std::cout << e["Laser"] << std::endl;
-      int32_t laser_id = e["Laser"]["Id"];
-      double roll = e["Laser"]["RollDeg"];
-      double shift_x = e["Laser"]["ShiftX"];
-      double shift_y = e["Laser"]["ShiftY"];
-      std::cout << id << std::endl;
-      std::cout << roll << std::endl;
-      std::cout << shift_x << std::endl;
-      std::cout << shift_y << std::endl;
-
-      r = jsScanHeadSetAlignmentLaser(scan_head,
-                                      (jsLaser)laser_id,
-                                      roll,
-                                      shift_x,
-                                      shift_y);
-      if (0 > r) {
-        throw std::runtime_error("failed to set alignment");
-      }
+    uint64_t count = joescan::Trace::Write(path);
+    std::cout << "wrote " << count << " spans to " << path << std::endl;
+  } catch (std::exception &e) {
+    std::cout << "ERROR: " << e.what() << std::endl;
+  }
+}
+
+// Converts inches to mils, saturating well inside the range of int32_t.
+static int32_t to_mils(double inches)
+{
+  const double kLimit = 2.0e9;
+  double mils = 1000.0 * inches;
+  return (int32_t) ((kLimit < mils) ? kLimit :
+                    (-kLimit > mils) ? -kLimit : mils);
+}
+
+// Runs a daemon until interrupted or terminated, calling `poll` every so
+// often and reporting how the server is doing every few seconds.
+static void serve_until_stopped(const joescan::ProfileServer &server,
+                                const std::function<void()> &poll)
+{
+  const auto kReportInterval = std::chrono::seconds(5);
+  signal(SIGINT, stop_signal_handler);
+  signal(SIGTERM, stop_signal_handler);
+
+  auto next_report = std::chrono::steady_clock::now() + kReportInterval;
+  while (!s_is_stopping) {
+    poll();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (std::chrono::steady_clock::now() < next_report) {
+      continue;
     }
-  } catch (std::exception& e) {
-    // TODO: handle JSON exception
+
+    joescan::ProfileServer::Stats stats = server.GetStats();
+    std::cout << stats.clients << " viewers, "
+              << stats.published << " profiles published, "
+              << stats.dropped << " dropped, "
+              << stats.dropped_clients << " dropped by viewers, "
+              << stats.bytes_sent / (1024 * 1024) << " MB sent"
+              << std::endl;
+    next_report += kReportInterval;
   }
 }
-#endif
 
-static void glfw_error_callback(int error, const char* description)
+// Draws overlay primitives emitted by a plugin into the current plot.
+static void draw_plugin_primitives(
+  const std::vector<jsPluginPrimitive> &primitives)
 {
-  fprintf(stderr, "Glfw Error %d: %s\n", error, description);
+  ImDrawList *draw_list = ImPlot::GetPlotDrawList();
+  ImPlot::PushPlotClipRect();
+  for (auto &p : primitives) {
+    ImVec2 p0 = ImPlot::PlotToPixels(p.x0, p.y0);
+    if (JS_PLUGIN_PRIMITIVE_POINT == p.type) {
+      draw_list->AddRectFilled(ImVec2(p0.x - 2.0f, p0.y - 2.0f),
+                               ImVec2(p0.x + 2.0f, p0.y + 2.0f),
+                               p.color);
+    } else if (JS_PLUGIN_PRIMITIVE_LINE == p.type) {
+      ImVec2 p1 = ImPlot::PlotToPixels(p.x1, p.y1);
+      draw_list->AddLine(p0, p1, p.color, 1.5f);
+    } else if (JS_PLUGIN_PRIMITIVE_CIRCLE == p.type) {
+      ImVec2 edge = ImPlot::PlotToPixels(p.x0 + p.x1, p.y0);
+      draw_list->AddCircle(p0, fabsf(edge.x - p0.x), p.color, 0, 1.5f);
+    }
+  }
+  ImPlot::PopPlotClipRect();
+}
+
+// Draws a small line plot of `count` values spaced `stride` bytes apart,
+// kept in a ring starting at `offset`, filling the current table cell.
+static void draw_sparkline(const char *id, const double *values, int count,
+                           int offset, int stride, const ImVec4 &color)
+{
+  ImPlot::PushStyleVar(ImPlotStyleVar_PlotPadding, ImVec2(0, 0));
+  if (ImPlot::BeginPlot(id, ImVec2(-1, 32), ImPlotFlags_CanvasOnly |
+                                            ImPlotFlags_NoInputs)) {
+    ImPlot::SetupAxes(nullptr,
+                      nullptr,
+                      ImPlotAxisFlags_NoDecorations | ImPlotAxisFlags_AutoFit,
+                      ImPlotAxisFlags_NoDecorations | ImPlotAxisFlags_AutoFit);
+    ImPlot::SetNextLineStyle(color);
+    ImPlot::PlotLine(id, values, count, 1.0, 0.0, offset, stride);
+    ImPlot::EndPlot();
+  }
+  ImPlot::PopStyleVar();
 }
 
 int main(int argc, char* argv[])
 {
   const int kMaxElementCount = 8;
-  double x_data[kMaxElementCount][JS_PROFILE_DATA_LEN];
-  double y_data[kMaxElementCount][JS_PROFILE_DATA_LEN];
-  int data_length[kMaxElementCount] = { 0 };
-  int laser_on_time_us[kMaxElementCount];
+  const uint32_t kLaserOnTimeMinUs = 100;
+  const uint32_t kLaserOnTimeDefUs = 500;
+  const uint32_t kLaserOnTimeMaxUs = 2000;
+  const double kWindowTop = 40.0;
+  const double kWindowBottom = -40.0;
+  const double kWindowLeft = -40.0;
+  const double kWindowRight = 40.0;
+  const uint32_t kSyntheticRateHz = 500;
+  std::vector<joescan::ProfileBuffer> element_data;
   bool is_element_enabled[kMaxElementCount];
   bool is_mode_camera = false;
+  bool is_image_view = false;
+  bool is_brightness_view = false;
+  bool is_raw_profile = false;
+  bool is_merged_view = false;
+  bool is_auto_exposure = false;
+  int auto_exposure_target = 180;
+  int auto_exposure_percentile = 95;
+  bool is_filter = false;
+  int filter_min_brightness = 20;
+  int filter_spike_distance = 250;
+  int filter_median_window = 3;
+  bool is_resampled_view = false;
+  double resample_pitch = 0.05;
+  bool is_reference_view = false;
+  float reference_tolerance = 0.05f;
+  std::string reference_file = "reference.json";
+  std::string reference_status;
+  bool is_reference_load = false;
+  bool is_fit = false;
+  bool is_fit_circle = true;
+  bool is_fit_ellipse = false;
+  bool is_fit_lines = false;
+  float fit_tolerance = 0.05f;
+  bool is_area = false;
+  double area_counts_per_inch = 1000.0;
+  bool is_export = false;
+  int export_source = 0;
+  int export_format = joescan::ProfileExporter::kFormatCsv;
+  double export_from_s = 10.0;
+  double export_to_s = 0.0;
+  char export_recording[256] = "";
+  char export_path[256] = "export.csv";
+  int image_element = 0;
+  int64_t encoder_value = 0;
   GLFWwindow* window = nullptr;
-  uint32_t serial_number;
+  std::vector<uint32_t> serial_numbers;
+  std::string alignment_file;
+  std::vector<std::string> plugin_paths;
+  std::string shared_ring_name;
+  std::string serve_address;
+  std::string connect_address;
+  std::string black_box_spec;
+  std::string black_box_dir;
+  double black_box_seconds = 0.0;
+  uint64_t black_box_bytes = 0;
+  std::string record_path;
+  std::string follow_path;
+  std::string trace_path = "trace.json";
+  std::string trace_status;
+  bool is_trace = false;
+  std::string metrics_address;
+  bool is_synthetic = false;
+  bool is_plugin_view = true;
+  bool is_instrumentation = false;
+  bool is_memory_view = false;
+  bool is_element_stats = false;
+  bool is_host_alignment = false;
   int32_t r = 0;
 
   for (int i = 0; i < kMaxElementCount; ++i) {
     is_element_enabled[i] = true;
   }
 
-  if (2 != argc) {
-    std::cout << "Usage: " << argv[0] << " SERIAL" << std::endl;
+  for (int n = 1; n < argc; n++) {
+    std::string arg = argv[n];
+    if (("--alignment" == arg) && (n + 1 < argc)) {
+      alignment_file = argv[++n];
+    } else if (("--plugin" == arg) && (n + 1 < argc)) {
+      plugin_paths.push_back(argv[++n]);
+    } else if (("--shm" == arg) && (n + 1 < argc)) {
+      shared_ring_name = argv[++n];
+    } else if (("--serve" == arg) && (n + 1 < argc)) {
+      serve_address = argv[++n];
+    } else if (("--connect" == arg) && (n + 1 < argc)) {
+      connect_address = argv[++n];
+    } else if ("--synthetic" == arg) {
+      is_synthetic = true;
+    } else if (("--black-box" == arg) && (n + 1 < argc)) {
+      black_box_spec = argv[++n];
+    } else if (("--black-box-dir" == arg) && (n + 1 < argc)) {
+      black_box_dir = argv[++n];
+    } else if (("--record" == arg) && (n + 1 < argc)) {
+      record_path = argv[++n];
+    } else if (("--follow" == arg) && (n + 1 < argc)) {
+      follow_path = argv[++n];
+    } else if (("--trace" == arg) && (n + 1 < argc)) {
+      trace_path = argv[++n];
+      is_trace = true;
+    } else if (("--metrics" == arg) && (n + 1 < argc)) {
+      metrics_address = argv[++n];
+    } else if (("--reference" == arg) && (n + 1 < argc)) {
+      reference_file = argv[++n];
+      is_reference_load = true;
+    } else if ("--host-alignment" == arg) {
+      is_host_alignment = true;
+    } else if ('-' != arg[0]) {
+      serial_numbers.push_back(strtoul(argv[n], NULL, 0));
+    } else {
+      serial_numbers.clear();
+      connect_address.clear();
+      follow_path.clear();
+      break;
+    }
+  }
+
+  // a viewer gets its scan heads from the daemon it connects to, and only
+  // the profiles it subscribed to, so it has nothing to keep a black box of,
+  // record or share; one following a recording gets them from the file
+  const bool is_viewer = !connect_address.empty() || !follow_path.empty();
+  bool is_usage_valid = (!is_viewer) ?
+                        !serial_numbers.empty() :
+                        serial_numbers.empty() && serve_address.empty() &&
+                        black_box_spec.empty() && record_path.empty() &&
+                        shared_ring_name.empty() &&
+                        (connect_address.empty() || follow_path.empty());
+  // synthetic profiles have no scan heads to align and are only served
+  if (is_synthetic) {
+    is_usage_valid = is_usage_valid && !serve_address.empty() &&
+                     alignment_file.empty() && !is_host_alignment &&
+                     shared_ring_name.empty();
+  }
+  if (!is_usage_valid) {
+    std::cout << "Usage: " << argv[0]
+              << " [--alignment FILE] [--host-alignment] [--reference FILE]"
+              << " [--plugin FILE]... [--shm NAME]"
+              << " [--black-box SPEC [--black-box-dir DIR]] [--record FILE]"
+              << " [--trace FILE] [--metrics ADDRESS] SERIAL [SERIAL...]"
+              << std::endl
+              << "       " << argv[0]
+              << " --serve ADDRESS [--alignment FILE] [--host-alignment]"
+              << " [--shm NAME]"
+              << " [--black-box SPEC [--black-box-dir DIR]] [--record FILE]"
+              << " [--trace FILE] [--metrics ADDRESS] SERIAL [SERIAL...]"
+              << std::endl
+              << "       " << argv[0]
+              << " --serve ADDRESS --synthetic"
+              << " [--black-box SPEC [--black-box-dir DIR]] [--record FILE]"
+              << " [--trace FILE] [--metrics ADDRESS] SERIAL [SERIAL...]"
+              << std::endl
+              << "       " << argv[0]
+              << " [--reference FILE] [--plugin FILE]... [--trace FILE]"
+              << " [--metrics ADDRESS] --connect ADDRESS"
+              << std::endl
+              << "       " << argv[0]
+              << " [--reference FILE] [--plugin FILE]... [--trace FILE]"
+              << " [--metrics ADDRESS] --follow FILE"
+              << std::endl;
+    return 1;
+  }
+  if (!black_box_spec.empty() &&
+      !joescan::BlackBox::ParseSpec(black_box_spec,
+                                    &black_box_seconds,
+                                    &black_box_bytes)) {
+    std::cout << "Black box size " << black_box_spec << " not understood,"
+              << " expected e.g. 30s, 512MB or 30s,1GB" << std::endl;
     return 1;
   }
 
-  serial_number = strtoul(argv[1], NULL, 0);
+  // tracing from the start, the trace is written on exit and on SIGUSR2
+  if (is_trace) {
+    joescan::Trace::SetEnabled(true);
+#if defined(SIGUSR2)
+    signal(SIGUSR2, trace_signal_handler);
+#endif
+  }
 
   try {
+    // the black box is dumped on SIGUSR1 as well as from the UI, so a
+    // daemon can be told to save what it just saw
+    std::unique_ptr<joescan::BlackBox> black_box;
+    std::unique_ptr<joescan::ProfileRecorder> recorder;
+    auto create_recorders = [&](uint32_t element_count, bool is_camera,
+                                double profile_rate_hz) {
+      joescan::RecordingInfo info;
+      info.element_count = element_count;
+      info.is_mode_camera = is_camera;
+      info.serial_numbers = serial_numbers;
+      if (!record_path.empty()) {
+        recorder.reset(new joescan::ProfileRecorder(record_path, info));
+      }
+      if (black_box_spec.empty()) {
+        return;
+      }
+
+      black_box.reset(new joescan::BlackBox(info,
+                                            black_box_dir,
+                                            black_box_seconds,
+                                            black_box_bytes,
+                                            profile_rate_hz));
+      joescan::BlackBox::Stats stats = black_box->GetStats();
+      if ((0.0 < stats.expected_s) && (stats.expected_s < black_box_seconds)) {
+        std::cout << "WARNING: black box holds about " << stats.expected_s
+                  << " s of profiles, not " << black_box_seconds << " s"
+                  << std::endl;
+      }
+#if defined(SIGUSR1)
+      signal(SIGUSR1, dump_signal_handler);
+#endif
+    };
+    auto dump_if_requested = [&]() {
+      if (0 != s_is_trace_requested) {
+        s_is_trace_requested = 0;
+        write_trace(trace_path);
+      }
+      if (!s_is_dump_requested) {
+        return;
+      }
+
+      s_is_dump_requested = 0;
+      std::string path;
+      std::string error;
+      if (black_box && black_box->Dump()) {
+        black_box->GetLastDump(&path, &error);
+        std::cout << "dumping black box to " << path << std::endl;
+      }
+    };
+
+    // metrics are brought up to date by the thread that owns what they
+    // measure, once a frame or daemon poll, so serving them only reads
+    // atomics and never reaches into acquisition
+    using joescan::Metrics;
+    Metrics metrics;
+    std::unique_ptr<joescan::MetricsServer> metrics_server;
+    if (!metrics_address.empty()) {
+      metrics_server.reset(new joescan::MetricsServer(metrics_address,
+                                                      metrics));
+    }
+    std::vector<std::function<void()>> metric_updates;
+    auto update_metrics = [&]() {
+      for (auto &update : metric_updates) {
+        update();
+      }
+    };
+    auto add_total = [&](const char *name,
+                         const char *help,
+                         const std::string &labels,
+                         std::function<uint64_t()> get_total) {
+      Metrics::Counter *counter = metrics.AddCounter(name, help, labels);
+      metric_updates.push_back([=]() { counter->Set(get_total()); });
+      return counter;
+    };
+    auto add_value = [&](const char *name,
+                         const char *help,
+                         const std::string &labels,
+                         std::function<double()> get_value) {
+      Metrics::Gauge *gauge = metrics.AddGauge(name, help, labels);
+      metric_updates.push_back([=]() { gauge->Set(get_value()); });
+    };
+    // rates are worked out over whole seconds, as in the memory panel
+    auto add_rate = [&](const char *name,
+                        const char *help,
+                        const std::string &labels,
+                        const Metrics::Counter *counter) {
+      Metrics::Gauge *gauge = metrics.AddGauge(name, help, labels);
+      auto start_time = std::chrono::steady_clock::now();
+      uint64_t start = counter->Get();
+      metric_updates.push_back([=]() mutable {
+        auto now = std::chrono::steady_clock::now();
+        double seconds =
+          std::chrono::duration<double>(now - start_time).count();
+        if (1.0 <= seconds) {
+          uint64_t total = counter->Get();
+          gauge->Set((total - start) / seconds);
+          start = total;
+          start_time = now;
+        }
+      });
+    };
+    const char *kDroppedMetric = "profile_view_profiles_dropped_total";
+    const char *kDroppedHelp = "Profiles dropped, by where they were dropped.";
+    auto add_server_metrics = [&](const joescan::ProfileServer &server) {
+      Metrics::Gauge *viewers =
+        metrics.AddGauge("profile_view_viewers",
+                         "Viewers connected to the daemon.");
+      Metrics::Counter *published =
+        metrics.AddCounter("profile_view_profiles_published_total",
+                           "Profiles queued to be sent to viewers.");
+      Metrics::Counter *dropped =
+        metrics.AddCounter(kDroppedMetric, kDroppedHelp,
+                           Metrics::Label("stage", "server"));
+      Metrics::Counter *dropped_viewers =
+        metrics.AddCounter(kDroppedMetric, kDroppedHelp,
+                           Metrics::Label("stage", "viewer"));
+      Metrics::Counter *sent =
+        metrics.AddCounter("profile_view_network_bytes_sent_total",
+                           "Bytes sent to viewers.");
+      metric_updates.push_back([=, &server]() {
+        joescan::ProfileServer::Stats stats = server.GetStats();
+        viewers->Set(stats.clients);
+        published->Set(stats.published);
+        dropped->Set(stats.dropped);
+        dropped_viewers->Set(stats.dropped_clients);
+        sent->Set(stats.bytes_sent);
+      });
+      add_rate("profile_view_network_bytes_sent_per_second",
+               "Bytes sent to viewers over the last second.", "", sent);
+    };
+    auto add_recorder_metrics = [&]() {
+      if (recorder) {
+        const joescan::ProfileRecorder *rec = recorder.get();
+        Metrics::Counter *written =
+          add_total("profile_view_disk_bytes_written_total",
+                    "Bytes written to the recording.", "",
+                    [=]() { return rec->GetBytesWritten(); });
+        add_rate("profile_view_disk_bytes_written_per_second",
+                 "Bytes written to the recording over the last second.", "",
+                 written);
+        add_total("profile_view_profiles_recorded_total",
+                  "Profiles written to the recording.", "",
+                  [=]() { return rec->GetProfilesWritten(); });
+        add_total(kDroppedMetric, kDroppedHelp,
+                  Metrics::Label("stage", "recorder"),
+                  [=]() { return rec->GetProfilesDropped(); });
+      }
+      if (black_box) {
+        const joescan::BlackBox *box = black_box.get();
+        add_total("profile_view_black_box_dumps_total",
+                  "Black box dumps written.", "",
+                  [=]() { return box->GetStats().dumps; });
+      }
+    };
+
+    // a synthetic daemon has no scan heads to set up, only the server
+    if (is_synthetic) {
+      joescan::ProfileHello hello;
+      hello.element_count = joescan::SyntheticSource::kElementCount;
+      hello.is_mode_camera = true;
+      hello.serial_numbers = serial_numbers;
+      joescan::ProfileServer server(serve_address, hello);
+      create_recorders(hello.element_count, hello.is_mode_camera,
+                       (double) serial_numbers.size() * hello.element_count *
+                       kSyntheticRateHz);
+      if (metrics_server) {
+        add_server_metrics(server);
+        add_recorder_metrics();
+      }
+      joescan::SyntheticSource source((uint32_t) serial_numbers.size(),
+                                      kSyntheticRateHz);
+      source.Start([&](uint32_t head_index, const jsProfile &p) {
+        if (black_box) {
+          black_box->Add(head_index, p);
+        }
+        if (recorder) {
+          recorder->Add(head_index, p);
+        }
+        server.Publish(head_index, p);
+      });
+      serve_until_stopped(server, [&]() {
+        dump_if_requested();
+        update_metrics();
+      });
+      source.Stop();
+      if (is_trace) {
+        write_trace(trace_path);
+      }
+      return 0;
+    }
+
     joescan::ScanApplication app;
-    jsScanHead scan_head;
+    jsScanHead scan_head = 0;
+    jsScanHeadCapabilities cap;
     jsProfile profile;
+    uint32_t element_count = 0;
+    uint32_t head_count = 0;
+    joescan::AlignmentTable alignment;
+    std::unique_ptr<joescan::ProfileClient> remote;
+    std::unique_ptr<joescan::RecordingFollower> follower;
 
-    app.SetSerialNumber(serial_number);
-    app.Connect();
-    app.SetThreshold(80);
-    app.SetLaserOn(500, 100, 2000);
-    app.SetWindow(40.0, -40.0, -40.0, 40.0);
-    app.Configure();
-    app.ConfigureDistinctElementPhaseTable();
-    app.StartScanning();
+    if (!follow_path.empty()) {
+      follower.reset(new joescan::RecordingFollower(follow_path));
+      const joescan::RecordingInfo &info = follower->GetInfo();
+      if (kMaxElementCount < info.element_count) {
+        throw std::runtime_error(follow_path + ": too many elements");
+      }
 
-    scan_head = app.GetScanHeads()[0];
-    jsScanHeadCapabilities cap;
-    r = jsScanHeadGetCapabilities(scan_head, &cap);
-    if (0 > r) {
-      throw joescan::ApiError("jsScanHeadGetCapabilities failed", r);
+      memset(&cap, 0, sizeof(cap));
+      is_mode_camera = info.is_mode_camera;
+      element_count = info.element_count;
+      serial_numbers = info.serial_numbers;
+      head_count = follower->GetScanHeadCount();
+    } else if (!connect_address.empty()) {
+      remote.reset(new joescan::ProfileClient(connect_address));
+      const joescan::ProfileHello &hello = remote->GetHello();
+      if (kMaxElementCount < hello.element_count) {
+        throw std::runtime_error(connect_address + ": too many elements");
+      }
+
+      memset(&cap, 0, sizeof(cap));
+      is_mode_camera = hello.is_mode_camera;
+      element_count = hello.element_count;
+      serial_numbers = hello.serial_numbers;
+      head_count = remote->GetScanHeadCount();
+    } else {
+      app.SetSerialNumber(serial_numbers);
+      app.Connect();
+
+      // all scan heads are expected to be of the same type
+      scan_head = app.GetScanHeads()[0];
+      r = jsScanHeadGetCapabilities(scan_head, &cap);
+      if (0 > r) {
+        throw joescan::ApiError("jsScanHeadGetCapabilities failed", r);
+      }
+
+      is_mode_camera = (1 == cap.num_lasers) ? true : false;
+      element_count = (is_mode_camera) ? cap.num_cameras : cap.num_lasers;
+      head_count = (uint32_t) app.GetScanHeads().size();
+
+      // Alignment comes from the file given on the command line, falling
+      // back to a "<serial>.json" file for scan heads it doesn't list.
+      if (!alignment_file.empty()) {
+        alignment.LoadFile(alignment_file);
+      }
+      for (auto serial_number : serial_numbers) {
+        if (!alignment.HasScanHead(serial_number)) {
+          alignment.LoadScanHeadFile(serial_number,
+                                     std::to_string(serial_number) + ".json");
+        }
+      }
+
+      app.SetThreshold(80);
+      app.SetLaserOn(kLaserOnTimeDefUs, kLaserOnTimeMinUs, kLaserOnTimeMaxUs);
+      app.SetWindow(kWindowTop, kWindowBottom, kWindowLeft, kWindowRight);
+      app.Configure();
+      alignment.Apply(app.GetScanHeads(),
+                      element_count,
+                      is_mode_camera,
+                      is_host_alignment);
+      app.ConfigureDistinctElementPhaseTable();
+      app.StartScanning();
+    }
+
+    // camera / laser pair used when viewing camera images; for laser driven
+    // heads the camera is updated from the profiles as they arrive
+    element_data.resize(head_count * kMaxElementCount);
+    for (uint32_t h = 0; h < head_count; h++) {
+      for (uint32_t i = 0; i < element_count; i++) {
+        joescan::ProfileBuffer &buffer = element_data[h * kMaxElementCount + i];
+        buffer.data_len = 0;
+        buffer.laser_on_time_us = 0;
+        buffer.camera = (is_mode_camera) ?
+                        (jsCamera) (JS_CAMERA_A + i) :
+                        JS_CAMERA_A;
+        buffer.laser = (is_mode_camera) ?
+                       JS_LASER_1 :
+                       (jsLaser) (JS_LASER_1 + i);
+      }
     }
 
-    is_mode_camera = (1 == cap.num_lasers) ? true : false;
-    uint32_t element_count = (is_mode_camera) ?
-                             cap.num_cameras :
-                             cap.num_lasers;
+    joescan::CameraImageView image_view;
+    joescan::BrightnessView brightness_view(head_count);
+    // the pool, filter, shared ring, server and black box must outlive
+    // acquisition, which hands them work
+    joescan::WorkerPool worker_pool;
+    joescan::ProfileFilter profile_filter(cap.camera_brightness_bit_depth);
+    std::unique_ptr<joescan::SharedRingWriter> shared_ring;
+    std::vector<joescan::SharedRingWriter::ReaderInfo> shared_ring_readers;
+    if (!shared_ring_name.empty()) {
+      shared_ring.reset(new joescan::SharedRingWriter(
+        shared_ring_name,
+        joescan::SharedRingWriter::kDefaultSlotCount,
+        serial_numbers));
+    }
+    std::unique_ptr<joescan::ProfileServer> server;
+    if (!serve_address.empty()) {
+      joescan::ProfileHello hello;
+      hello.element_count = element_count;
+      hello.is_mode_camera = is_mode_camera;
+      hello.serial_numbers = serial_numbers;
+      server.reset(new joescan::ProfileServer(serve_address, hello));
+    }
+    // only a viewer with scan heads of its own can set them up, or has
+    // anything to record
+    const bool is_local = !remote && !follower;
+    if (is_local) {
+      // every element of every scan head is scanned once a scan period
+      int32_t period_us = jsScanSystemGetMinScanPeriod(app.GetScanSystem());
+      double profile_rate_hz = (0 < period_us) ?
+                               1.0e6 * head_count * element_count / period_us :
+                               0.0;
+      create_recorders(element_count, is_mode_camera, profile_rate_hz);
+    }
+    // a remote or following viewer has no scan heads, so acquisition has
+    // nothing to do
+    joescan::ProfileAcquisition acquisition(app.GetScanHeads());
+    joescan::MergedCloud merged_cloud(head_count * kMaxElementCount);
+    std::vector<bool> is_buffer_enabled(head_count * kMaxElementCount);
+    std::vector<bool> is_buffer_updated(head_count * kMaxElementCount);
+    joescan::ProfileGrid profile_grid(kWindowLeft,
+                                      kWindowRight,
+                                      resample_pitch,
+                                      head_count * kMaxElementCount);
+    joescan::ReferenceProfile reference(kWindowLeft,
+                                        kWindowRight,
+                                        head_count * kMaxElementCount);
+    std::vector<uint8_t> deviation_levels(head_count * kMaxElementCount *
+                                          JS_PROFILE_DATA_LEN);
+    std::vector<uint32_t> deviation_count(head_count * kMaxElementCount);
+    if (is_reference_load) {
+      reference.Load(reference_file, serial_numbers, kMaxElementCount);
+    }
+    joescan::FitEngine fit_engine(head_count * kMaxElementCount *
+                                  JS_PROFILE_DATA_LEN, worker_pool);
+    joescan::AreaIntegrator area_integrator;
+    // encoder value of the scan period the buffers are filling with
+    int64_t area_encoder = 0;
+    bool is_area_pending = false;
+    joescan::ProfileExporter exporter;
+    joescan::SpatialIndex spatial_index(-50.0, 50.0, -50.0, 50.0, 0.25,
+                                        head_count * kMaxElementCount);
+    std::vector<bool> is_index_stale(head_count * kMaxElementCount);
+    joescan::ProfileLod profile_lod(head_count * kMaxElementCount);
+
+    // plugins read their batches straight out of these, so they have to
+    // outlive the plugin host
+    using joescan::ProfileAcquisition;
+    joescan::ProfilePool plugin_profiles(
+      (plugin_paths.empty()) ? 0 : head_count * ProfileAcquisition::kRingSize);
+    std::vector<uint32_t> plugin_head_indices(plugin_profiles.GetCapacity());
+    std::vector<jsPluginPrimitive> plugin_primitives;
+    std::vector<jsPluginMetric> plugin_metrics;
+    uint64_t plugin_batch_number = 0;
+    uint64_t plugin_dropped_profiles = 0;
+    joescan::PluginHost plugin_host;
+    for (auto &path : plugin_paths) {
+      plugin_host.Load(path);
+    }
+    std::vector<bool> is_plugin_triggered(plugin_host.GetPluginCount());
+    std::vector<joescan::WorkerPool::QueueStats> pool_stats;
+    // scratch of the render loop, taken back at the start of every frame
+    joescan::FrameArena frame_arena(256 * 1024);
+    uint64_t heap_allocations = 0;
+    uint64_t imgui_allocations = 0;
+    uint64_t frame_heap_allocations = 0;
+    uint64_t frame_imgui_allocations = 0;
+    uint64_t allocation_free_frames = 0;
+    // ImPlot allocates through ImGui, so its share is measured and taken
+    // out of what ImGui has allocated
+    joescan::MemoryAccounting memory;
+    const uint32_t memory_imgui = memory.AddRow("ImGui", true, true);
+    const uint32_t memory_implot = memory.AddRow("ImPlot", true, false);
+    const uint32_t memory_profiles = memory.AddRow("Profiles", true, false);
+    const uint32_t memory_recording = memory.AddRow("Recording", true, false);
+    const uint32_t memory_textures = memory.AddRow("GPU Textures", true, false);
+    const uint32_t memory_trace = memory.AddRow("Trace", true, false);
+    const uint32_t memory_heap = memory.AddRow("Heap", false, true);
+    joescan::ElementStats element_stats(head_count * kMaxElementCount);
+    joescan::FitEngine::Result fit_result;
+    std::vector<joescan::FitEngine::Result> fit_history;
+    joescan::AutoExposure auto_exposure(acquisition.GetScanHeadCount(),
+                                        element_count,
+                                        is_mode_camera,
+                                        kLaserOnTimeMinUs,
+                                        kLaserOnTimeDefUs,
+                                        kLaserOnTimeMaxUs,
+                                        cap.camera_brightness_bit_depth);
+
+    acquisition.AddObserver([&](uint32_t head_index, const jsProfile &p) {
+      if (auto_exposure.IsEnabled()) {
+        auto_exposure.AddProfile(head_index, p);
+      }
+      if (shared_ring) {
+        shared_ring->Publish(head_index, p);
+      }
+      if (server) {
+        server->Publish(head_index, p);
+      }
+      if (black_box) {
+        black_box->Add(head_index, p);
+      }
+      if (recorder) {
+        recorder->Add(head_index, p);
+      }
+    });
+
+    // host alignment is applied as profiles are read, so whatever records,
+    // serves or publishes them gets aligned profiles
+    if (alignment.IsHost()) {
+      acquisition.SetPreprocessor([&](uint32_t head_index, jsProfile *p) {
+        alignment.Transform(head_index, p);
+      });
+    }
+
+    acquisition.SetProcessor([&](uint32_t, jsProfile *p) {
+      profile_filter.Apply(p);
+    }, &worker_pool);
+
+    // profiles a remote or following viewer took in, counted as drained
+    std::vector<Metrics::Counter *> head_received;
+    if (metrics_server) {
+      for (uint32_t h = 0; h < head_count; h++) {
+        std::string labels =
+          Metrics::Label("head", std::to_string(serial_numbers[h]));
+        const char *kReceivedMetric = "profile_view_profiles_received_total";
+        const char *kReceivedHelp = "Profiles received from each scan head.";
+        Metrics::Counter *received = nullptr;
+        if (is_local) {
+          received = add_total(kReceivedMetric, kReceivedHelp, labels,
+                               [&acquisition, h]() {
+            return acquisition.GetProfilesReceived(h);
+          });
+          add_total(kDroppedMetric, kDroppedHelp,
+                    labels + "," + Metrics::Label("stage", "acquisition"),
+                    [&acquisition, h]() {
+            return acquisition.GetProfilesDropped(h);
+          });
+          add_value("profile_view_acquisition_queue_depth",
+                    "Profiles queued for each scan head.", labels,
+                    [&acquisition, h]() {
+            return acquisition.GetQueueDepth(h);
+          });
+        } else {
+          received = metrics.AddCounter(kReceivedMetric, kReceivedHelp,
+                                        labels);
+          head_received.push_back(received);
+        }
+        add_rate("profile_view_profiles_per_second",
+                 "Profiles received from each scan head over the last "
+                 "second.", labels, received);
+      }
+
+      std::vector<Metrics::Gauge *> queue_depths;
+      for (uint32_t n = 0; n <= worker_pool.GetThreadCount(); n++) {
+        std::string name = (n < worker_pool.GetThreadCount()) ?
+                           std::to_string(n) :
+                           "callers";
+        queue_depths.push_back(
+          metrics.AddGauge("profile_view_worker_queue_depth",
+                           "Tasks queued for each worker.",
+                           Metrics::Label("queue", name)));
+      }
+      std::vector<joescan::WorkerPool::QueueStats> stats;
+      metric_updates.push_back([&worker_pool, queue_depths, stats]() mutable {
+        worker_pool.GetStats(&stats);
+        for (uint32_t n = 0; n < stats.size(); n++) {
+          queue_depths[n]->Set(stats[n].depth);
+        }
+      });
+
+      if (server) {
+        add_server_metrics(*server);
+      }
+      add_recorder_metrics();
+      plugin_host.AddMetrics(&metrics);
+    }
+
+    // the daemon serves profiles as the scan heads deliver them, leaving
+    // any processing to the viewers
+    if (server) {
+      acquisition.Start();
+      serve_until_stopped(*server, [&]() {
+        acquisition.CheckError();
+        dump_if_requested();
+        update_metrics();
+      });
+      acquisition.Stop();
+      app.StopScanning();
+      if (is_trace) {
+        write_trace(trace_path);
+      }
+      return 0;
+    }
+
+    // only a viewer has frames to time
+    Metrics::Histogram *frame_seconds = nullptr;
+    Metrics::Histogram *drain_seconds = nullptr;
+    if (metrics_server) {
+      frame_seconds =
+        metrics.AddHistogram("profile_view_frame_seconds",
+                             "Time from the start of one frame to the next.",
+                             Metrics::ExponentialBounds(0.001, 2.0, 11));
+      drain_seconds =
+        metrics.AddHistogram("profile_view_drain_seconds",
+                             "Time frames took to take in new profiles.",
+                             Metrics::ExponentialBounds(0.00001, 2.0, 14));
+      add_value("profile_view_resident_memory_bytes",
+                "Memory of the viewer resident in RAM.", "",
+                [&memory]() { return memory.GetResidentBytes(); });
+
+      if (remote) {
+        const joescan::ProfileClient *client = remote.get();
+        add_total(kDroppedMetric, kDroppedHelp,
+                  Metrics::Label("stage", "remote"),
+                  [=]() { return client->GetProfilesDropped(); });
+        Metrics::Counter *received =
+          add_total("profile_view_network_bytes_received_total",
+                    "Bytes received from the daemon.", "",
+                    [=]() { return client->GetBytesReceived(); });
+        add_rate("profile_view_network_bytes_received_per_second",
+                 "Bytes received from the daemon over the last second.", "",
+                 received);
+      }
+      if (follower) {
+        const joescan::RecordingFollower *follow = follower.get();
+        add_total(kDroppedMetric, kDroppedHelp,
+                  Metrics::Label("stage", "follower"),
+                  [=]() { return follow->GetProfilesDropped(); });
+        Metrics::Counter *read =
+          add_total("profile_view_disk_bytes_read_total",
+                    "Bytes read of the recording followed.", "",
+                    [=]() { return follow->GetPosition(); });
+        add_rate("profile_view_disk_bytes_read_per_second",
+                 "Bytes read of the recording followed over the last second.",
+                 "", read);
+      }
+    }
+
+    auto store_profile = [&](uint32_t head_index, const jsProfile &p) {
+      uint32_t idx = (is_mode_camera) ?
+                     ((uint32_t) p.camera) - 1 :
+                     ((uint32_t) p.laser) - 1;
+      if (element_count <= idx) {
+        return;
+      }
+
+      // Worst case, we redraw laser1 data
+      joescan::ProfileBuffer &buffer =
+        element_data[head_index * kMaxElementCount + idx];
+      joescan::LoadProfileBuffer(p, &buffer, cap.camera_brightness_bit_depth);
+      is_buffer_updated[head_index * kMaxElementCount + idx] = true;
+      is_index_stale[head_index * kMaxElementCount + idx] = true;
+      element_stats.Add(head_index * kMaxElementCount + idx,
+                        p.data_len,
+                        buffer);
+
+      encoder_value = p.encoder_values[0];
+      brightness_view.AddToHistogram(head_index,
+                                     idx,
+                                     buffer.brightness,
+                                     buffer.data_len);
+    };
 
     // Setup window
     glfwSetErrorCallback(glfw_error_callback);
@@ -157,6 +957,7 @@ int main(int argc, char* argv[])
 
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
+    joescan::AllocationCounter::InstallImGuiAllocator();
     ImGui::CreateContext();
     ImPlot::CreateContext();
 
@@ -170,12 +971,97 @@ int main(int argc, char* argv[])
 
     // Our state
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+    brightness_view.SetColormap(ImPlotColormap_Viridis);
+
+    if (is_local) {
+      acquisition.Start();
+    }
+
+    auto save_trace = [&]() {
+      try {
+        uint64_t count = joescan::Trace::Write(trace_path);
+        trace_status = "wrote " + std::to_string(count) + " spans to " +
+                       trace_path;
+      } catch (std::exception &e) {
+        trace_status = e.what();
+      }
+    };
 
     // Main loop
+    joescan::Trace::SetThreadName("Render");
+    auto frame_start = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(window)) {
       if (!glfwGetWindowAttrib(window, GLFW_VISIBLE)) {
         continue;
       }
+      joescan::TraceSpan frame_span("Frame");
+      {
+        auto now = std::chrono::steady_clock::now();
+        if (nullptr != frame_seconds) {
+          frame_seconds->Observe(
+            std::chrono::duration<double>(now - frame_start).count());
+        }
+        frame_start = now;
+      }
+
+      // allocations are counted from the start of one frame to the next;
+      // the render loop is meant to make none once it has warmed up
+      {
+        using joescan::AllocationCounter;
+        uint64_t heap = AllocationCounter::GetThreadAllocations();
+        uint64_t imgui = AllocationCounter::GetImGuiAllocations();
+        frame_heap_allocations = heap - heap_allocations;
+        frame_imgui_allocations = imgui - imgui_allocations;
+        heap_allocations = heap;
+        imgui_allocations = imgui;
+        bool is_allocation_free =
+          (0 == frame_heap_allocations) && (0 == frame_imgui_allocations);
+        allocation_free_frames =
+          (is_allocation_free) ? allocation_free_frames + 1 : 0;
+
+        // measured every frame, so the high water marks miss nothing
+        uint64_t imgui_bytes = AllocationCounter::GetImGuiBytes();
+        uint64_t implot_bytes = joescan::MemoryAccounting::GetImPlotBytes();
+        if (implot_bytes > imgui_bytes) {
+          implot_bytes = imgui_bytes;
+        }
+        memory.Set(memory_imgui, imgui_bytes - implot_bytes, imgui);
+        memory.Set(memory_implot, implot_bytes);
+
+        uint64_t profile_bytes =
+          acquisition.GetMemoryUsage() +
+          element_data.size() * sizeof(joescan::ProfileBuffer) +
+          plugin_profiles.GetCapacity() * sizeof(jsProfile) +
+          plugin_head_indices.size() * sizeof(uint32_t) +
+          fit_engine.GetMemoryUsage();
+        if (remote) {
+          profile_bytes += remote->GetMemoryUsage();
+        }
+        if (follower) {
+          profile_bytes += follower->GetMemoryUsage();
+        }
+        memory.Set(memory_profiles, profile_bytes);
+
+        uint64_t recording_bytes = exporter.GetMemoryUsage();
+        if (black_box) {
+          recording_bytes += black_box->GetMemoryUsage();
+        }
+        if (recorder) {
+          recording_bytes += recorder->GetMemoryUsage();
+        }
+        memory.Set(memory_recording, recording_bytes);
+
+        // the font atlas is uploaded as RGBA
+        const ImFontAtlas *fonts = ImGui::GetIO().Fonts;
+        memory.Set(memory_textures,
+                   image_view.GetTextureBytes() +
+                   (uint64_t) fonts->TexWidth * fonts->TexHeight * 4);
+        memory.Set(memory_trace, joescan::Trace::GetMemoryUsage());
+        memory.Set(memory_heap, 0, AllocationCounter::GetAllocations());
+        memory.Update();
+        update_metrics();
+      }
+      frame_arena.Reset();
 
       glfwPollEvents();
       // Start the Dear ImGui frame
@@ -183,6 +1069,34 @@ int main(int argc, char* argv[])
       ImGui_ImplGlfw_NewFrame();
       ImGui::NewFrame();
 
+      // the black box is dumped on F9, on SIGUSR1 or when a plugin raises
+      // its trigger metric; one already being dumped covers any of these
+      if (black_box) {
+        bool is_dump = ImGui::IsKeyPressed(ImGuiKey_F9, false) ||
+                       (0 != s_is_dump_requested);
+        s_is_dump_requested = 0;
+        for (uint32_t n = 0; n < plugin_host.GetPluginCount(); n++) {
+          plugin_host.GetOutput(n, &plugin_primitives, &plugin_metrics);
+          bool is_triggered = false;
+          for (auto &metric : plugin_metrics) {
+            if ((0 == strncmp(JS_PLUGIN_METRIC_TRIGGER, metric.name,
+                              JS_PLUGIN_METRIC_NAME_LEN)) &&
+                (0.0 != metric.value)) {
+              is_triggered = true;
+            }
+          }
+          is_dump = is_dump || (is_triggered && !is_plugin_triggered[n]);
+          is_plugin_triggered[n] = is_triggered;
+        }
+        if (is_dump) {
+          black_box->Dump();
+        }
+      }
+      if (0 != s_is_trace_requested) {
+        s_is_trace_requested = 0;
+        save_trace();
+      }
+
       static float f = 0.0f;
       static int counter = 0;
 #ifdef IMGUI_HAS_VIEWPORTV
@@ -198,7 +1112,9 @@ int main(int argc, char* argv[])
       bool open = true;
       ImGui::Begin("ScanData",
                    &open,
-                   ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoResize);
+                   ImGuiWindowFlags_NoDecoration |
+                   ImGuiWindowFlags_NoResize |
+                   ImGuiWindowFlags_NoBringToFrontOnFocus);
 
       char buf[64];
       for (uint32_t i = 0; i < element_count; i++) {
@@ -212,84 +1128,1271 @@ int main(int argc, char* argv[])
         ImGui::SameLine();
       }
 
-      ImGui::Text("Encoder = %lu", (int64_t) profile.encoder_values[0]);
-
-      auto is_plot_sucess = ImPlot::BeginPlot("Profile Plot",
-                                              "X [inches]",
-                                              "Y [inches]",
-                                              ImVec2(-1, -1),
-                                              ImPlotFlags_Equal);
-      if (!is_plot_sucess) {
-        continue;
+      ImGui::Text("Encoder = %lu", encoder_value);
+      ImGui::SameLine();
+      if (remote && !remote->IsConnected()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f),
+                           "Disconnected: %s", remote->GetError().c_str());
+        ImGui::SameLine();
+      }
+      if (follower && !follower->IsFollowing()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f),
+                           "Stopped following: %s",
+                           follower->GetError().c_str());
+        ImGui::SameLine();
+      }
+      ImGui::Checkbox("Brightness", &is_brightness_view);
+      ImGui::SameLine();
+      if (is_local) {
+        ImGui::Checkbox("Raw", &is_raw_profile);
+        ImGui::SameLine();
+      }
+      ImGui::Checkbox("Merged", &is_merged_view);
+      ImGui::SameLine();
+      ImGui::Checkbox("Resampled", &is_resampled_view);
+      ImGui::SameLine();
+      if (is_resampled_view) {
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::InputDouble("Pitch", &resample_pitch, 0.01, 0.1, "%.3f");
+        ImGui::SameLine();
+      }
+      if (is_local) {
+        ImGui::Checkbox("Auto Exposure", &is_auto_exposure);
+        ImGui::SameLine();
+      }
+      if (is_auto_exposure) {
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::SliderInt("Target", &auto_exposure_target, 16, 254);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::SliderInt("Percentile", &auto_exposure_percentile, 50, 99);
+        ImGui::SameLine();
       }
 
-      ImPlot::SetupAxesLimits(-50.0, 50.0, -50.0, 50.0);
-      ImPlot::SetupFinish();
-
-      r = jsScanHeadWaitUntilProfilesAvailable(scan_head, 1, 10000);
-      if (0 > r) {
-        throw joescan::ApiError(
-          "jsScanHeadWaitUntilProfilesAvailable failed", r);
+      ImGui::Checkbox("Filter", &is_filter);
+      ImGui::SameLine();
+      if (is_filter) {
+        if (ImGui::Button("...##Filter")) {
+          ImGui::OpenPopup("Filter Settings");
+        }
+        ImGui::SameLine();
       }
+      if (ImGui::BeginPopup("Filter Settings")) {
+        ImGui::SetNextItemWidth(200.0f);
+        ImGui::SliderInt("Min Brightness", &filter_min_brightness, 0, 255);
+        ImGui::SetNextItemWidth(200.0f);
+        ImGui::SliderInt("Spike Distance [mils]", &filter_spike_distance,
+                         0, 2000);
+        ImGui::Text("Median");
+        ImGui::SameLine();
+        ImGui::RadioButton("Off", &filter_median_window, 0);
+        ImGui::SameLine();
+        ImGui::RadioButton("3", &filter_median_window, 3);
+        ImGui::SameLine();
+        ImGui::RadioButton("5", &filter_median_window, 5);
+        ImGui::EndPopup();
+      }
+
+      // filtering runs on the worker pool as profiles are queued
+      profile_filter.SetMinBrightness((is_filter) ? filter_min_brightness : 0);
+      profile_filter.SetSpikeDistance((is_filter) ? filter_spike_distance : 0);
+      profile_filter.SetMedianWindow((is_filter) ? filter_median_window : 0);
+      acquisition.SetProcessingEnabled(profile_filter.IsEnabled());
 
-      uint32_t profiles_available = r;
-      for (uint32_t k = 0; k < profiles_available; k++) {
-        r = jsScanHeadGetProfiles(scan_head, &profile, 1);
-        if (0 > r) {
-          throw joescan::ApiError("jsScanHeadGetProfiles failed", r);
+      ImGui::Checkbox("Fit", &is_fit);
+      ImGui::SameLine();
+      if (is_fit) {
+        if (ImGui::Button("...##Fit")) {
+          ImGui::OpenPopup("Fit Settings");
         }
+        ImGui::SameLine();
+      }
+      if (ImGui::BeginPopup("Fit Settings")) {
+        ImGui::Checkbox("Circle", &is_fit_circle);
+        ImGui::SameLine();
+        ImGui::Checkbox("Ellipse", &is_fit_ellipse);
+        ImGui::SameLine();
+        ImGui::Checkbox("Lines", &is_fit_lines);
+        ImGui::SetNextItemWidth(200.0f);
+        ImGui::SliderFloat("Tolerance [inches]", &fit_tolerance, 0.001f, 0.5f,
+                           "%.3f");
+        ImGui::EndPopup();
+      }
 
-        uint32_t idx = (is_mode_camera) ?
-                       ((uint32_t) profile.camera) - 1 :
-                       ((uint32_t) profile.laser) - 1;
+      fit_engine.SetShapes(
+        ((is_fit_circle) ? joescan::FitEngine::kFitCircle : 0) |
+        ((is_fit_ellipse) ? joescan::FitEngine::kFitEllipse : 0) |
+        ((is_fit_lines) ? joescan::FitEngine::kFitLines : 0));
+      fit_engine.SetTolerance(fit_tolerance);
 
-        data_length[idx] = profile.data_len;
-        laser_on_time_us[idx] = profile.laser_on_time_us;
+      ImGui::Checkbox("Area", &is_area);
+      ImGui::SameLine();
+      if (0 != plugin_host.GetPluginCount()) {
+        ImGui::Checkbox("Plugins", &is_plugin_view);
+        ImGui::SameLine();
+      }
+      ImGui::Checkbox("Stats", &is_element_stats);
+      ImGui::SameLine();
+      ImGui::Checkbox("Instrumentation", &is_instrumentation);
+      ImGui::SameLine();
+      ImGui::Checkbox("Memory", &is_memory_view);
+      ImGui::SameLine();
+      ImGui::Checkbox("Export", &is_export);
+      ImGui::SameLine();
+      if (black_box) {
+        ImGui::BeginDisabled(black_box->IsDumping());
+        if (ImGui::Button("Black Box")) {
+          black_box->Dump();
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+      }
 
-        // Worst case, we redraw laser1 data
-        for (uint32_t n = 0; n < profile.data_len; n++) {
-          x_data[idx][n] = profile.data[n].x / 1000.0;
-          y_data[idx][n] = profile.data[n].y / 1000.0;
+      ImGui::Checkbox("Reference", &is_reference_view);
+      ImGui::SameLine();
+      if (is_reference_view) {
+        if (ImGui::Button("Capture")) {
+          for (uint32_t n = 0; n < element_data.size(); n++) {
+            if (is_element_enabled[n % kMaxElementCount] &&
+                (0 != element_data[n].data_len)) {
+              reference.Capture(n, element_data[n]);
+            }
+          }
+          reference_status = "captured";
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Save")) {
+          try {
+            reference.Save(reference_file, serial_numbers, kMaxElementCount);
+            reference_status = "saved " + reference_file;
+          } catch (std::exception &e) {
+            reference_status = e.what();
+          }
+        }
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::SliderFloat("Tolerance", &reference_tolerance, 0.001f, 0.5f,
+                           "%.3f");
+        ImGui::SameLine();
+        ImGui::TextUnformatted(reference_status.c_str());
+        ImGui::SameLine();
       }
 
-      char legend[32];
-      for (uint32_t i = 0; i < element_count; i++)
-      {
-        ImPlot::SetNextMarkerStyle(ImPlotMarker_Square,
-                                   1,
-                                   ImPlot::GetColormapColor(i),
-                                   IMPLOT_AUTO,
-                                   ImPlot::GetColormapColor(i));
+      // camera images need the scan heads themselves
+      bool is_image_view_toggled = false;
+      bool is_image_element_changed = false;
+      if (is_local) {
+        is_image_view_toggled =
+          ImGui::Checkbox("Camera Image", &is_image_view);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
         if (is_mode_camera) {
-          sprintf(legend, "Camera %d [%duS]", i + 1, laser_on_time_us[i]);
+          sprintf(buf, "Camera %d", image_element + 1);
         } else {
-          sprintf(legend, "Laser %d [%duS]", i + 1, laser_on_time_us[i]);
+          sprintf(buf, "Laser %d", image_element + 1);
+        }
+        if (ImGui::BeginCombo("##ImageElement", buf)) {
+          for (uint32_t i = 0; i < element_count; i++) {
+            if (is_mode_camera) {
+              sprintf(buf, "Camera %d", i + 1);
+            } else {
+              sprintf(buf, "Laser %d", i + 1);
+            }
+
+            if (ImGui::Selectable(buf, (int) i == image_element)) {
+              is_image_element_changed |= ((int) i != image_element);
+              image_element = (int) i;
+            }
+          }
+          ImGui::EndCombo();
         }
+      }
 
-        if (is_element_enabled[i]) {
-          ImPlot::PlotScatter(legend, x_data[i], y_data[i], data_length[i]);
+      // camera images can only be captured while the head isn't scanning,
+      // so scanning is only stopped and started again when the view itself
+      // is turned on or off; picking another element just moves the capture
+      if (is_image_view_toggled && !is_image_view) {
+        image_view.Stop();
+        app.StartScanning();
+        acquisition.Start();
+      } else if (is_image_view &&
+                 (is_image_view_toggled || is_image_element_changed)) {
+        if (!image_view.IsRunning()) {
+          acquisition.Stop();
+          app.StopScanning();
+        }
+        image_view.Start(scan_head,
+                         element_data[image_element].camera,
+                         element_data[image_element].laser);
+      }
+
+      if (is_image_view) {
+        image_view.Upload();
+
+        std::string image_error = image_view.GetLastError();
+        ImGui::Text("Images: %u captured, %u dropped, %u uploaded [%duS] %s",
+                    image_view.GetFramesCaptured(),
+                    image_view.GetFramesDropped(),
+                    image_view.GetFramesUploaded(),
+                    image_view.GetExposureTime(),
+                    image_error.c_str());
+
+        if (ImPlot::BeginPlot("Camera Image", ImVec2(-1, -1),
+                              ImPlotFlags_Equal)) {
+          ImPlot::SetupAxes("Column [pixels]", "Row [pixels]");
+          ImPlot::SetupAxis(ImAxis_X2, "X [inches]",
+                            ImPlotAxisFlags_AuxDefault);
+          ImPlot::SetupAxis(ImAxis_Y2, "Y [inches]",
+                            ImPlotAxisFlags_AuxDefault);
+          ImPlot::SetupAxesLimits(0.0, cap.max_camera_image_width,
+                                  0.0, cap.max_camera_image_height);
+          ImPlot::SetupAxisLimits(ImAxis_X2, -50.0, 50.0);
+          ImPlot::SetupAxisLimits(ImAxis_Y2, -50.0, 50.0);
+          ImPlot::SetupFinish();
+
+          image_view.PlotImage("Image");
+
+          // overlay the last profile seen before scanning was paused
+          ImPlot::SetAxes(ImAxis_X2, ImAxis_Y2);
+          ImPlot::SetNextMarkerStyle(ImPlotMarker_Square,
+                                     1,
+                                     ImPlot::GetColormapColor(image_element),
+                                     IMPLOT_AUTO,
+                                     ImPlot::GetColormapColor(image_element));
+          const joescan::ProfileBuffer &buffer = element_data[image_element];
+          ImPlot::PlotScatter("Profile",
+                              buffer.x,
+                              buffer.y,
+                              buffer.data_len);
+          ImPlot::EndPlot();
+        }
+      } else {
+        // leave room on the right for the brightness histogram
+        const float kHistogramWidth = 420.0f;
+        float plot_width = (is_brightness_view) ? -kHistogramWidth : -1.0f;
+        auto is_plot_sucess = ImPlot::BeginPlot("Profile Plot",
+                                                "X [inches]",
+                                                "Y [inches]",
+                                                ImVec2(plot_width, -1),
+                                                ImPlotFlags_Equal);
+        if (!is_plot_sucess) {
+          continue;
+        }
+
+        ImPlot::SetupAxesLimits(-50.0, 50.0, -50.0, 50.0);
+        ImPlot::SetupFinish();
+
+        // only the detail the view can show is drawn
+        const ImPlotRect view = ImPlot::GetPlotLimits();
+        const double pixel_size = view.X.Size() / ImPlot::GetPlotSize().x;
+
+        // a remote viewer is only sent that much detail too, with a margin
+        // either side of the view so panning doesn't run out of points;
+        // zooming in asks for more once the view no longer fits
+        if (remote) {
+          // a profile's columns are spread across the scan window
+          const double points_per_pixel =
+            JS_PROFILE_DATA_LEN / (kWindowRight - kWindowLeft) * pixel_size;
+          joescan::ProfileSubscription subscription =
+            remote->GetSubscription();
+          uint32_t level = 0;
+          while ((joescan::kMaxDownsampleLevel > level) &&
+                 ((2u << level) <= points_per_pixel)) {
+            level++;
+          }
+
+          bool is_covered = (subscription.x_min <= to_mils(view.X.Min)) &&
+                            (subscription.x_max >= to_mils(view.X.Max));
+          if ((level != subscription.downsample_level) || !is_covered) {
+            const double margin = 0.5 * view.X.Size();
+            subscription.downsample_level = level;
+            subscription.x_min = to_mils(view.X.Min - margin);
+            subscription.x_max = to_mils(view.X.Max + margin);
+            remote->Subscribe(subscription);
+          }
+        }
+
+        // new laser on times can only be applied while not scanning
+        auto_exposure.SetEnabled(is_auto_exposure);
+        auto_exposure.SetTarget(auto_exposure_target, auto_exposure_percentile);
+        if (auto_exposure.IsUpdatePending()) {
+          acquisition.Stop();
+          app.StopScanning();
+          auto_exposure.Apply(app.GetScanSystem(), app.GetScanHeads());
+          app.StartScanning();
+          acquisition.Start();
+        }
+
+        acquisition.SetRawProfiles(is_raw_profile);
+        acquisition.CheckError();
+        brightness_view.BeginHistogramUpdate();
+        // profiles go straight into the plugin batch while the plugins are
+        // ready to take a new one
+        bool is_plugin_batch =
+          (0 != plugin_host.GetPluginCount()) && !plugin_host.IsBusy();
+        if (is_plugin_batch) {
+          plugin_profiles.Reset();
+        }
+        auto drain_start = std::chrono::steady_clock::now();
+        uint64_t drain_begin_ns =
+          (joescan::Trace::IsEnabled()) ? joescan::Trace::Now() : 0;
+        // scan heads take turns, one profile each, so the profiles of one
+        // scan period land together for the area integration
+        bool is_area_drained = false;
+        bool is_area_moved = false;
+        bool is_draining = true;
+        while (is_draining) {
+          is_draining = false;
+          for (uint32_t h = 0; h < head_count; h++) {
+            // once the batch is full the rest are only drawn
+            jsProfile *p = (is_plugin_batch) ?
+                           plugin_profiles.Acquire() :
+                           nullptr;
+            bool is_batched = (nullptr != p);
+            if (!is_batched) {
+              p = &profile;
+            }
+            bool is_received = false;
+            if (remote) {
+              is_received = remote->GetProfile(h, p);
+            } else if (follower) {
+              is_received = follower->GetProfile(h, p);
+            } else {
+              is_received = acquisition.GetProfile(h, p);
+            }
+            if (!is_received) {
+              if (is_batched) {
+                plugin_profiles.ReleaseLast();
+              }
+              continue;
+            }
+            is_draining = true;
+            // profiles of our own scan heads are filtered on acquisition
+            if (!is_local && profile_filter.IsEnabled()) {
+              profile_filter.Apply(p);
+            }
+
+            // Every scan period's cross-section is integrated, however many
+            // are drained in a frame: once the encoder moves on, the
+            // buffers hold the whole of the period before.
+            int64_t encoder = p->encoder_values[0];
+            if (is_area && is_area_pending && (encoder != area_encoder)) {
+              merged_cloud.Merge(element_data, is_buffer_enabled, worker_pool);
+              area_integrator.AddFrame(merged_cloud.GetX(),
+                                       merged_cloud.GetY(),
+                                       merged_cloud.GetCount(),
+                                       area_encoder);
+              is_area_moved = true;
+            }
+            area_encoder = encoder;
+            is_area_pending = is_area;
+            is_area_drained = true;
+
+            store_profile(h, *p);
+            if (h < head_received.size()) {
+              head_received[h]->Add();
+            }
+            if (is_batched) {
+              plugin_head_indices[plugin_profiles.GetCount() - 1] = h;
+            } else if (0 != plugin_host.GetPluginCount()) {
+              plugin_dropped_profiles++;
+            }
+          }
+        }
+        if (0 != drain_begin_ns) {
+          joescan::Trace::Add("Drain Profiles",
+                              drain_begin_ns,
+                              joescan::Trace::Now());
+        }
+        // an encoder standing still never moves on, so its cross-section is
+        // taken once a whole frame's worth of profiles has kept to it
+        if (is_area && is_area_drained && !is_area_moved) {
+          merged_cloud.Merge(element_data, is_buffer_enabled, worker_pool);
+          area_integrator.AddFrame(merged_cloud.GetX(),
+                                   merged_cloud.GetY(),
+                                   merged_cloud.GetCount(),
+                                   area_encoder);
+        }
+        if (nullptr != drain_seconds) {
+          drain_seconds->Observe(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - drain_start).count());
+        }
+
+        if (is_plugin_batch && (0 != plugin_profiles.GetCount())) {
+          jsPluginBatch batch;
+          batch.profiles = plugin_profiles.GetData();
+          batch.head_indices = plugin_head_indices.data();
+          batch.num_profiles = plugin_profiles.GetCount();
+          batch.serial_numbers = serial_numbers.data();
+          batch.num_heads = head_count;
+          batch.batch_number = plugin_batch_number++;
+          batch.dropped_profiles = plugin_dropped_profiles;
+          plugin_dropped_profiles = 0;
+          plugin_host.Run(batch, worker_pool);
+        }
+
+        // the hover lookup index and detail pyramid are kept current for
+        // elements with new data
+        worker_pool.ParallelFor(head_count * kMaxElementCount,
+                                [&](uint32_t n) {
+          if (is_index_stale[n]) {
+            spatial_index.Update(n, element_data[n]);
+            profile_lod.Update(n, element_data[n]);
+          }
+          if (is_element_enabled[n % kMaxElementCount]) {
+            profile_lod.Select(n, element_data[n], view.X.Min, view.X.Max,
+                               pixel_size);
+          }
+        });
+        std::fill(is_index_stale.begin(), is_index_stale.end(), false);
+
+        // only elements with new data are resampled, unless the grid itself
+        // changed and every row has to be redone
+        if (is_resampled_view) {
+          if (resample_pitch != profile_grid.GetPitch()) {
+            profile_grid.SetPitch(resample_pitch);
+            resample_pitch = profile_grid.GetPitch();
+            std::fill(is_buffer_updated.begin(), is_buffer_updated.end(), true);
+          }
+
+          worker_pool.ParallelFor(head_count * kMaxElementCount,
+                                  [&](uint32_t n) {
+            if (is_buffer_updated[n]) {
+              profile_grid.Resample(n, element_data[n]);
+            }
+          });
+          std::fill(is_buffer_updated.begin(), is_buffer_updated.end(), false);
+        }
+
+        if (is_reference_view) {
+          worker_pool.ParallelFor(head_count * kMaxElementCount,
+                                  [&](uint32_t n) {
+            deviation_count[n] = 0;
+            if (reference.HasRow(n)) {
+              deviation_count[n] =
+                reference.Compare(n,
+                                  element_data[n],
+                                  reference_tolerance,
+                                  &deviation_levels[n * JS_PROFILE_DATA_LEN]);
+            }
+          });
+        }
+
+        // each element is drawn on its own unless merged into one item
+        bool is_merged_drawn =
+          is_merged_view && !is_resampled_view && !is_reference_view;
+
+        char legend[64];
+        for (uint32_t h = 0; h < head_count; h++) {
+          // only tell scan heads apart when there is more than one
+          char prefix[16] = "";
+          if (1 < head_count) {
+            sprintf(prefix, "%u ", serial_numbers[h]);
+          }
+
+          for (uint32_t i = 0; i < element_count; i++) {
+            const joescan::ProfileBuffer &buffer =
+              element_data[h * kMaxElementCount + i];
+            ImVec4 color = ImPlot::GetColormapColor(h * element_count + i);
+            ImPlot::SetNextMarkerStyle(ImPlotMarker_Square,
+                                       1,
+                                       color,
+                                       IMPLOT_AUTO,
+                                       color);
+            if (is_mode_camera) {
+              sprintf(legend, "%sCamera %d [%duS]", prefix, i + 1,
+                      buffer.laser_on_time_us);
+            } else {
+              sprintf(legend, "%sLaser %d [%duS]", prefix, i + 1,
+                      buffer.laser_on_time_us);
+            }
+
+            // brightness percentile the exposure loop is regulating
+            if (is_auto_exposure) {
+              size_t len = strlen(legend);
+              snprintf(legend + len, sizeof(legend) - len, " p%d=%u",
+                       auto_exposure_percentile,
+                       auto_exposure.GetBrightness(h, i));
+            }
+
+            uint32_t n = h * kMaxElementCount + i;
+            if (is_reference_view && reference.HasRow(n)) {
+              size_t len = strlen(legend);
+              snprintf(legend + len, sizeof(legend) - len, " out=%u",
+                       deviation_count[n]);
+            }
+
+            // merged data is drawn as a single item after this loop
+            is_buffer_enabled[n] = is_element_enabled[i];
+            if (!is_element_enabled[i]) {
+              continue;
+            }
+
+            if (is_resampled_view) {
+              ImPlot::SetNextLineStyle(color);
+              ImPlot::PlotLine(legend,
+                               profile_grid.GetX(),
+                               profile_grid.GetRow(n),
+                               profile_grid.GetColumnCount());
+              continue;
+            }
+
+            if (is_reference_view && reference.HasRow(n)) {
+              const joescan::ProfileGrid &grid = reference.GetGrid();
+              ImPlot::SetNextLineStyle(ImVec4(0.5f, 0.5f, 0.5f, 1.0f));
+              ImPlot::PlotLine("Reference",
+                               grid.GetX(),
+                               grid.GetRow(n),
+                               grid.GetColumnCount());
+              joescan::PlotColorScatter(legend,
+                                        buffer.x,
+                                        buffer.y,
+                                        &deviation_levels[n *
+                                                          JS_PROFILE_DATA_LEN],
+                                        reference.GetLut(),
+                                        buffer.data_len,
+                                        1.0f);
+              continue;
+            }
+
+            if (is_merged_drawn) {
+              continue;
+            }
+
+            if (is_brightness_view) {
+              brightness_view.PlotScatter(legend,
+                                          profile_lod.GetX(n),
+                                          profile_lod.GetY(n),
+                                          profile_lod.GetBrightness(n),
+                                          profile_lod.GetCount(n),
+                                          1.0f);
+            } else {
+              ImPlot::PlotScatter(legend,
+                                  profile_lod.GetX(n),
+                                  profile_lod.GetY(n),
+                                  profile_lod.GetCount(n));
+            }
+          }
+        }
+
+        // fits run on the whole frame, merged the same way as for drawing
+        if (is_merged_drawn || is_fit) {
+          merged_cloud.Merge(element_data, is_buffer_enabled, worker_pool);
+        }
+        if (is_fit) {
+          fit_engine.Submit(merged_cloud.GetX(),
+                            merged_cloud.GetY(),
+                            merged_cloud.GetCount(),
+                            encoder_value);
+        }
+
+        if (is_merged_drawn) {
+          sprintf(legend, "Merged [%u points]###Merged",
+                  merged_cloud.GetCount());
+          if (is_brightness_view) {
+            brightness_view.PlotScatter(legend,
+                                        merged_cloud.GetX(),
+                                        merged_cloud.GetY(),
+                                        merged_cloud.GetBrightness(),
+                                        merged_cloud.GetCount(),
+                                        1.0f);
+          } else {
+            ImPlot::SetNextMarkerStyle(ImPlotMarker_Square, 1);
+            ImPlot::PlotScatter(legend,
+                                merged_cloud.GetX(),
+                                merged_cloud.GetY(),
+                                merged_cloud.GetCount());
+          }
+        }
+
+        joescan::FitEngine::Result fit;
+        if (is_fit && fit_engine.GetResult(&fit)) {
+          // shapes are drawn as closed outlines through a fixed point count,
+          // which only have to last until drawn
+          const int kOutlinePoints = 129;
+          const double kPi = 3.14159265358979323846;
+          double *outline_x = frame_arena.AllocateArray<double>(kOutlinePoints);
+          double *outline_y = frame_arena.AllocateArray<double>(kOutlinePoints);
+
+          if (fit.is_circle_valid) {
+            for (int n = 0; n < kOutlinePoints; n++) {
+              double t = 2.0 * kPi * n / (kOutlinePoints - 1);
+              outline_x[n] = fit.circle_x + fit.circle_r * cos(t);
+              outline_y[n] = fit.circle_y + fit.circle_r * sin(t);
+            }
+            ImPlot::PlotLine("Circle", outline_x, outline_y, kOutlinePoints);
+          }
+
+          if (fit.is_ellipse_valid) {
+            double a = fit.ellipse_angle_deg * kPi / 180.0;
+            for (int n = 0; n < kOutlinePoints; n++) {
+              double t = 2.0 * kPi * n / (kOutlinePoints - 1);
+              double u = fit.ellipse_major * cos(t);
+              double v = fit.ellipse_minor * sin(t);
+              outline_x[n] = fit.ellipse_x + u * cos(a) - v * sin(a);
+              outline_y[n] = fit.ellipse_y + u * sin(a) + v * cos(a);
+            }
+            ImPlot::PlotLine("Ellipse", outline_x, outline_y, kOutlinePoints);
+          }
+
+          for (uint32_t n = 0; n < fit.line_count; n++) {
+            const joescan::FitEngine::Line &line = fit.lines[n];
+            double line_x[2] = { line.x0, line.x1 };
+            double line_y[2] = { line.y0, line.y1 };
+            ImPlot::SetNextLineStyle(IMPLOT_AUTO_COL, 2.0f);
+            ImPlot::PlotLine("Lines", line_x, line_y, 2);
+          }
+        }
+
+        if (is_plugin_view) {
+          for (uint32_t n = 0; n < plugin_host.GetPluginCount(); n++) {
+            plugin_host.GetOutput(n, &plugin_primitives, &plugin_metrics);
+            draw_plugin_primitives(plugin_primitives);
+          }
+        }
+
+        // readout of the point nearest the mouse, within a few pixels
+        uint32_t hover_buffer = 0;
+        uint32_t hover_point = 0;
+        if (ImPlot::IsPlotHovered()) {
+          const float kHoverRadiusPixels = 8.0f;
+          ImPlotPoint mouse = ImPlot::GetPlotMousePos();
+          ImVec2 mouse_px = ImPlot::PlotToPixels(mouse);
+          ImPlotPoint edge =
+            ImPlot::PixelsToPlot(mouse_px.x + kHoverRadiusPixels, mouse_px.y);
+          double radius = fabs(edge.x - mouse.x);
+
+          if (spatial_index.FindNearest(mouse.x, mouse.y, radius,
+                                        is_buffer_enabled,
+                                        &hover_buffer, &hover_point)) {
+            const joescan::ProfileBuffer &buffer = element_data[hover_buffer];
+            uint32_t h = hover_buffer / kMaxElementCount;
+            uint32_t i = hover_buffer % kMaxElementCount;
+            ImVec2 p = ImPlot::PlotToPixels(buffer.x[hover_point],
+                                            buffer.y[hover_point]);
+            ImPlot::GetPlotDrawList()->AddCircle(p, 5.0f,
+                                                 IM_COL32(255, 255, 255, 255));
+
+            ImGui::BeginTooltip();
+            ImGui::Text("X %.3f  Y %.3f", buffer.x[hover_point],
+                        buffer.y[hover_point]);
+            ImGui::Text("Brightness %u", buffer.brightness[hover_point]);
+            ImGui::Text("Scan Head %u %s %u", serial_numbers[h],
+                        (is_mode_camera) ? "Camera" : "Laser", i + 1);
+            ImGui::Text("Encoder %lld", (long long) buffer.encoder);
+            ImGui::EndTooltip();
+          }
+        }
+
+        ImPlot::EndPlot();
+
+        if (is_brightness_view) {
+          ImGui::SameLine();
+          ImGui::BeginGroup();
+
+          // clicking the colormap cycles to the next one
+          ImPlotColormap cmap = brightness_view.GetColormap();
+          if (ImPlot::ColormapButton(ImPlot::GetColormapName(cmap),
+                                     ImVec2(-1, 0),
+                                     cmap)) {
+            cmap = (cmap + 1) % ImPlot::GetColormapCount();
+            brightness_view.SetColormap(cmap);
+          }
+
+          if (ImPlot::BeginPlot("Brightness", ImVec2(-1, -1))) {
+            ImPlot::SetupAxes("Brightness",
+                              "Points",
+                              ImPlotAxisFlags_None,
+                              ImPlotAxisFlags_AutoFit);
+            ImPlot::SetupAxisLimits(ImAxis_X1, 0.0, 255.0);
+            for (uint32_t h = 0; h < head_count; h++) {
+              char prefix[16] = "";
+              if (1 < head_count) {
+                sprintf(prefix, "%u ", serial_numbers[h]);
+              }
+
+              for (uint32_t i = 0; i < element_count; i++) {
+                if (!is_element_enabled[i]) {
+                  continue;
+                }
+
+                if (is_mode_camera) {
+                  sprintf(legend, "%sCamera %d", prefix, i + 1);
+                } else {
+                  sprintf(legend, "%sLaser %d", prefix, i + 1);
+                }
+
+                ImVec4 color = ImPlot::GetColormapColor(h * element_count + i);
+                ImPlot::SetNextLineStyle(color);
+                brightness_view.PlotHistogram(legend, h, i);
+              }
+            }
+            ImPlot::EndPlot();
+          }
+
+          ImGui::EndGroup();
         }
       }
 
-      ImPlot::EndPlot();
       ImGui::End();
       ImGui::PopStyleVar();
-      ImGui::Render();
-      int display_w, display_h;
-      glfwGetFramebufferSize(window, &display_w, &display_h);
-      glViewport(0, 0, display_w, display_h);
-      glClearColor(clear_color.x * clear_color.w,
-                   clear_color.y * clear_color.w,
-                   clear_color.z * clear_color.w,
-                   clear_color.w);
-      glClear(GL_COLOR_BUFFER_BIT);
-      ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+
+      if (is_fit) {
+        fit_engine.GetResult(&fit_result);
+        fit_engine.GetHistory(&fit_history);
+
+        ImGui::SetNextWindowSize(ImVec2(600, 400), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Fit", &is_fit);
+        ImGui::Text("%llu fit, %llu skipped, last %.2f ms",
+                    (unsigned long long) fit_engine.GetFramesFit(),
+                    (unsigned long long) fit_engine.GetFramesSkipped(),
+                    fit_result.fit_time_ms);
+        if (fit_result.is_circle_valid) {
+          ImGui::Text("Circle: center (%.3f, %.3f) diameter %.3f",
+                      fit_result.circle_x,
+                      fit_result.circle_y,
+                      2.0 * fit_result.circle_r);
+        }
+        if (fit_result.is_ellipse_valid) {
+          ImGui::Text("Ellipse: center (%.3f, %.3f) axes %.3f x %.3f "
+                      "at %.1f deg",
+                      fit_result.ellipse_x,
+                      fit_result.ellipse_y,
+                      2.0 * fit_result.ellipse_major,
+                      2.0 * fit_result.ellipse_minor,
+                      fit_result.ellipse_angle_deg);
+        }
+        for (uint32_t n = 0; n < fit_result.line_count; n++) {
+          const joescan::FitEngine::Line &line = fit_result.lines[n];
+          ImGui::Text("Line %u: (%.3f, %.3f) to (%.3f, %.3f)", n + 1,
+                      line.x0, line.y0, line.x1, line.y1);
+        }
+
+        if (ImPlot::BeginPlot("Fit History", ImVec2(-1, -1))) {
+          ImPlot::SetupAxes("Time [s]",
+                            "[inches]",
+                            ImPlotAxisFlags_AutoFit,
+                            ImPlotAxisFlags_AutoFit);
+          if (!fit_history.empty()) {
+            const joescan::FitEngine::Result &h = fit_history[0];
+            const int count = (int) fit_history.size();
+            const int stride = (int) sizeof(joescan::FitEngine::Result);
+            if (is_fit_circle) {
+              ImPlot::PlotLine("Circle Radius", &h.time_s, &h.circle_r,
+                               count, 0, stride);
+              ImPlot::PlotLine("Circle X", &h.time_s, &h.circle_x,
+                               count, 0, stride);
+              ImPlot::PlotLine("Circle Y", &h.time_s, &h.circle_y,
+                               count, 0, stride);
+            }
+            if (is_fit_ellipse) {
+              ImPlot::PlotLine("Ellipse Major", &h.time_s, &h.ellipse_major,
+                               count, 0, stride);
+              ImPlot::PlotLine("Ellipse Minor", &h.time_s, &h.ellipse_minor,
+                               count, 0, stride);
+            }
+          }
+          ImPlot::EndPlot();
+        }
+        ImGui::End();
+      }
+
+      if (is_plugin_view && (0 != plugin_host.GetPluginCount())) {
+        ImGui::SetNextWindowSize(ImVec2(600, 300), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Plugins", &is_plugin_view);
+        ImGui::Text("%llu batches skipped while busy",
+                    (unsigned long long) plugin_host.GetBatchesSkipped());
+
+        const ImGuiTableFlags kTableFlags =
+          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+        if (ImGui::BeginTable("PluginStats", 8, kTableFlags)) {
+          const char *columns[] = { "Plugin", "Calls", "Last [us]",
+                                    "Mean [us]", "Max [us]", "Budget [us]",
+                                    "Overruns", "Skipped" };
+          for (auto column : columns) {
+            ImGui::TableSetupColumn(column);
+          }
+          ImGui::TableHeadersRow();
+
+          for (uint32_t n = 0; n < plugin_host.GetPluginCount(); n++) {
+            joescan::PluginHost::Stats stats = plugin_host.GetStats(n);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stats.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) stats.calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stats.last_us);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stats.mean_us);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stats.max_us);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", stats.budget_us);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) stats.overruns);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) stats.skipped);
+          }
+          ImGui::EndTable();
+        }
+
+        for (uint32_t n = 0; n < plugin_host.GetPluginCount(); n++) {
+          plugin_host.GetOutput(n, &plugin_primitives, &plugin_metrics);
+          for (auto &metric : plugin_metrics) {
+            ImGui::Text("%s.%s = %g", plugin_host.GetStats(n).name.c_str(),
+                        metric.name, metric.value);
+          }
+        }
+        ImGui::End();
+      }
+
+      if (is_export) {
+        ImGui::SetNextWindowSize(ImVec2(500, 250), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Export", &is_export);
+
+        // profiles still in memory come from the black box, if there is one
+        if (black_box) {
+          ImGui::RadioButton("Black Box", &export_source, 0);
+          ImGui::SameLine();
+          ImGui::RadioButton("Recording", &export_source, 1);
+        } else {
+          export_source = 1;
+        }
+        if (1 == export_source) {
+          ImGui::InputText("Recording", export_recording,
+                           sizeof(export_recording));
+          ImGui::InputDouble("From [s]", &export_from_s, 1.0, 10.0, "%.1f");
+          ImGui::InputDouble("To [s]", &export_to_s, 1.0, 10.0, "%.1f");
+          ImGui::TextUnformatted("Seconds after the first profile");
+        } else {
+          ImGui::InputDouble("From [s ago]", &export_from_s, 1.0, 10.0,
+                             "%.1f");
+          ImGui::InputDouble("To [s ago]", &export_to_s, 1.0, 10.0, "%.1f");
+        }
+
+        using joescan::ProfileExporter;
+        bool is_format_changed =
+          ImGui::RadioButton("CSV", &export_format,
+                             ProfileExporter::kFormatCsv);
+        ImGui::SameLine();
+        is_format_changed |=
+          ImGui::RadioButton("PLY", &export_format,
+                             ProfileExporter::kFormatPly);
+        ImGui::SameLine();
+        is_format_changed |=
+          ImGui::RadioButton("Binary", &export_format,
+                             ProfileExporter::kFormatBinary);
+        ProfileExporter::Format format =
+          (ProfileExporter::Format) export_format;
+        if (is_format_changed) {
+          std::string path = export_path;
+          size_t dot = path.rfind('.');
+          if ((std::string::npos != dot) &&
+              (std::string::npos == path.find_first_of("/\\", dot))) {
+            path.resize(dot);
+          }
+          path += std::string(".") + ProfileExporter::GetExtension(format);
+          snprintf(export_path, sizeof(export_path), "%s", path.c_str());
+        }
+        ImGui::InputText("File", export_path, sizeof(export_path));
+
+        ProfileExporter::Progress progress = exporter.GetProgress();
+        if (progress.is_running) {
+          if (ImGui::Button("Cancel")) {
+            exporter.Cancel();
+          }
+        } else if (ImGui::Button("Export")) {
+          if (0 == export_source) {
+            exporter.Start(*black_box, export_from_s, export_to_s, format,
+                           export_path);
+          } else {
+            exporter.Start(export_recording, export_from_s, export_to_s,
+                           format, export_path);
+          }
+        }
+        ImGui::SameLine();
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.1f MB, %.1f MB/s",
+                 progress.bytes / (1024.0 * 1024.0),
+                 (0.0 < progress.seconds) ?
+                 progress.bytes / (1024.0 * 1024.0) / progress.seconds :
+                 0.0);
+        ImGui::ProgressBar((float) progress.fraction, ImVec2(-1.0f, 0.0f),
+                           overlay);
+        if (!progress.path.empty()) {
+          ImGui::Text("%s: %llu profiles, %llu points",
+                      progress.path.c_str(),
+                      (unsigned long long) progress.profiles,
+                      (unsigned long long) progress.points);
+        }
+        if (!progress.error.empty()) {
+          ImGui::TextUnformatted(progress.error.c_str());
+        }
+        ImGui::End();
+      }
+
+      if (is_area) {
+        ImGui::SetNextWindowSize(ImVec2(600, 400), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Area", &is_area);
+        ImGui::Text("Area %.3f in^2, volume %.3f in^3 over %.3f in",
+                    area_integrator.GetArea(),
+                    area_integrator.GetVolume(),
+                    area_integrator.GetTravel());
+        ImGui::SameLine();
+        if (ImGui::Button("Reset")) {
+          area_integrator.Reset();
+        }
+        ImGui::SetNextItemWidth(120.0f);
+        if (ImGui::InputDouble("Encoder Counts / Inch",
+                               &area_counts_per_inch, 0.0, 0.0, "%.3f")) {
+          area_integrator.SetCountsPerInch(area_counts_per_inch);
+          area_counts_per_inch = area_integrator.GetCountsPerInch();
+        }
+
+        if (ImPlot::BeginPlot("Area History", ImVec2(-1, -1))) {
+          ImPlot::SetupAxes("Encoder",
+                            "Area [in^2]",
+                            ImPlotAxisFlags_AutoFit,
+                            ImPlotAxisFlags_AutoFit);
+          ImPlot::PlotLine("Area",
+                           area_integrator.GetHistoryEncoder(),
+                           area_integrator.GetHistoryArea(),
+                           area_integrator.GetHistoryCount(),
+                           area_integrator.GetHistoryOffset());
+          ImPlot::EndPlot();
+        }
+        ImGui::End();
+      }
+
+      if (is_element_stats) {
+        ImGui::SetNextWindowSize(ImVec2(1200, 300), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Element Stats", &is_element_stats);
+        if (ImGui::Button("Reset")) {
+          element_stats.Reset();
+        }
+        ImGui::SameLine();
+        ImGui::Text("Over the last %u profiles of each element",
+                    joescan::ElementStats::kWindowLen);
+
+        const ImGuiTableFlags kTableFlags = ImGuiTableFlags_Borders |
+                                            ImGuiTableFlags_RowBg |
+                                            ImGuiTableFlags_ScrollY;
+        if (ImGui::BeginTable("ElementStats", 14, kTableFlags)) {
+          const char *columns[] = { "Element", "Profiles", "Rate [Hz]", "",
+                                    "Points", "", "Valid", "X Min", "X Max",
+                                    "X Mean", "Y Min", "Y Max", "Y Mean",
+                                    "Brightness" };
+          ImGui::TableSetupScrollFreeze(0, 1);
+          for (auto column : columns) {
+            ImGuiTableColumnFlags flags = ('\0' == column[0]) ?
+              ImGuiTableColumnFlags_WidthFixed :
+              ImGuiTableColumnFlags_None;
+            ImGui::TableSetupColumn(column, flags, 120.0f);
+          }
+          ImGui::TableHeadersRow();
+
+          const int kStride = sizeof(joescan::ElementStats::Sample);
+          char label[64];
+          for (uint32_t h = 0; h < head_count; h++) {
+            for (uint32_t i = 0; i < element_count; i++) {
+              const uint32_t n = h * kMaxElementCount + i;
+              joescan::ElementStats::Summary stats =
+                element_stats.GetSummary(n);
+              const joescan::ElementStats::Sample *samples =
+                element_stats.GetSamples(n);
+              const int count = element_stats.GetSampleCount(n);
+              const int offset = element_stats.GetSampleOffset(n);
+              ImVec4 color = ImPlot::GetColormapColor(h * element_count + i);
+
+              ImGui::PushID(n);
+              ImGui::TableNextRow();
+              ImGui::TableNextColumn();
+              sprintf(label, "%u %s %d", serial_numbers[h],
+                      (is_mode_camera) ? "Camera" : "Laser", i + 1);
+              ImGui::TextColored(color, "%s", label);
+              ImGui::TableNextColumn();
+              ImGui::Text("%u", stats.profiles);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.1f", stats.rate_hz);
+              ImGui::TableNextColumn();
+              draw_sparkline("##Rate", &samples[0].rate_hz, count, offset,
+                             kStride, color);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.1f", stats.points_mean);
+              ImGui::TableNextColumn();
+              draw_sparkline("##Points", &samples[0].points, count, offset,
+                             kStride, color);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.1f%%", 100.0 * stats.valid_ratio);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.3f", stats.x_min);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.3f", stats.x_max);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.3f", stats.x_mean);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.3f", stats.y_min);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.3f", stats.y_max);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.3f", stats.y_mean);
+              ImGui::TableNextColumn();
+              ImGui::Text("%.1f", stats.brightness_mean);
+              ImGui::PopID();
+            }
+          }
+          ImGui::EndTable();
+        }
+        ImGui::End();
+      }
+
+      if (is_memory_view) {
+        ImGui::SetNextWindowSize(ImVec2(560, 260), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Memory", &is_memory_view);
+        if (0 != memory.GetResidentBytes()) {
+          ImGui::Text("Process resident: %.1f MB, most %.1f MB",
+                      memory.GetResidentBytes() / (1024.0 * 1024.0),
+                      memory.GetResidentHighWater() / (1024.0 * 1024.0));
+        }
+
+        const ImGuiTableFlags kTableFlags =
+          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+        if (ImGui::BeginTable("Memory", 5, kTableFlags)) {
+          ImGui::TableSetupColumn("Subsystem");
+          ImGui::TableSetupColumn("In Use [MB]");
+          ImGui::TableSetupColumn("Most [MB]");
+          ImGui::TableSetupColumn("Change [KB/s]");
+          ImGui::TableSetupColumn("Allocations/s");
+          ImGui::TableHeadersRow();
+
+          for (auto &row : memory.GetRows()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(row.name);
+            ImGui::TableNextColumn();
+            if (row.is_sized) {
+              ImGui::Text("%.2f", row.bytes / (1024.0 * 1024.0));
+              ImGui::TableNextColumn();
+              ImGui::Text("%.2f", row.high_water / (1024.0 * 1024.0));
+              ImGui::TableNextColumn();
+              ImGui::Text("%+.1f", row.bytes_per_s / 1024.0);
+            } else {
+              ImGui::TableNextColumn();
+              ImGui::TableNextColumn();
+            }
+            ImGui::TableNextColumn();
+            if (row.is_counted) {
+              ImGui::Text("%.0f", row.allocations_per_s);
+            }
+          }
+          ImGui::EndTable();
+        }
+        ImGui::End();
+      }
+
+      if (is_instrumentation) {
+        ImGui::SetNextWindowSize(ImVec2(400, 400), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Instrumentation", &is_instrumentation);
+
+        joescan::FrameArena::Stats arena_stats = frame_arena.GetStats();
+        ImGui::Text("Allocations last frame: %llu heap, %llu ImGui; "
+                    "none for %llu frames",
+                    (unsigned long long) frame_heap_allocations,
+                    (unsigned long long) frame_imgui_allocations,
+                    (unsigned long long) allocation_free_frames);
+        ImGui::Text("Frame arena: %.1f of %.1f KB, most %.1f KB, "
+                    "%llu overflowed",
+                    arena_stats.used / 1024.0,
+                    arena_stats.capacity / 1024.0,
+                    arena_stats.high_water / 1024.0,
+                    (unsigned long long) arena_stats.overflows);
+        if (0 != plugin_profiles.GetCapacity()) {
+          ImGui::Text("Plugin batch: %u of %u profiles, full %llu times",
+                      plugin_profiles.GetCount(),
+                      plugin_profiles.GetCapacity(),
+                      (unsigned long long) plugin_profiles.GetExhaustedCount());
+        }
+
+        worker_pool.GetStats(&pool_stats);
+        uint32_t queued = 0;
+        for (auto &stats : pool_stats) {
+          queued += stats.depth;
+        }
+        ImGui::Text("Worker Pool: %u threads, %u tasks queued",
+                    worker_pool.GetThreadCount(), queued);
+
+        if (metrics_server) {
+          ImGui::Text("Metrics %s: scraped %llu times",
+                      metrics_server->GetAddress().c_str(),
+                      (unsigned long long) metrics_server->GetScrapes());
+        }
+
+        // spans of every thread, for a timeline of what they did together
+        bool is_tracing = joescan::Trace::IsEnabled();
+        if (ImGui::Checkbox("Trace", &is_tracing)) {
+          joescan::Trace::SetEnabled(is_tracing);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Save Trace")) {
+          save_trace();
+        }
+        ImGui::SameLine();
+        ImGui::TextUnformatted(trace_status.c_str());
+
+        const ImGuiTableFlags kTableFlags =
+          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+        if (ImGui::BeginTable("PoolStats", 4, kTableFlags)) {
+          ImGui::TableSetupColumn("Queue");
+          ImGui::TableSetupColumn("Depth");
+          ImGui::TableSetupColumn("Tasks Run");
+          ImGui::TableSetupColumn("Steals");
+          ImGui::TableHeadersRow();
+
+          // the last queue is the one shared by threads outside the pool
+          for (uint32_t n = 0; n < pool_stats.size(); n++) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (n < worker_pool.GetThreadCount()) {
+              ImGui::Text("Worker %u", n);
+            } else {
+              ImGui::TextUnformatted("Callers");
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", pool_stats[n].depth);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) pool_stats[n].tasks_run);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long) pool_stats[n].steals);
+          }
+          ImGui::EndTable();
+        }
+
+        if (shared_ring) {
+          shared_ring->GetReaders(&shared_ring_readers);
+          ImGui::Text("Shared Memory %s: %u slots, %llu published, "
+                      "%u readers",
+                      shared_ring->GetName().c_str(),
+                      shared_ring->GetSlotCount(),
+                      (unsigned long long) shared_ring->GetPublished(),
+                      (uint32_t) shared_ring_readers.size());
+          if (!shared_ring_readers.empty() &&
+              ImGui::BeginTable("RingReaders", 3, kTableFlags)) {
+            ImGui::TableSetupColumn("PID");
+            ImGui::TableSetupColumn("Lag");
+            ImGui::TableSetupColumn("Lapped");
+            ImGui::TableHeadersRow();
+            for (auto &reader : shared_ring_readers) {
+              ImGui::TableNextRow();
+              ImGui::TableNextColumn();
+              ImGui::Text("%llu", (unsigned long long) reader.pid);
+              ImGui::TableNextColumn();
+              ImGui::Text("%llu", (unsigned long long) reader.lag);
+              ImGui::TableNextColumn();
+              ImGui::Text("%llu", (unsigned long long) reader.lapped);
+            }
+            ImGui::EndTable();
+          }
+        }
+
+        if (black_box) {
+          joescan::BlackBox::Stats stats = black_box->GetStats();
+          std::string path;
+          std::string error;
+          black_box->GetLastDump(&path, &error);
+          ImGui::Text("Black Box: %u slots, %llu profiles added",
+                      stats.slot_count,
+                      (unsigned long long) stats.added);
+          // only known once the ring has filled, or from the expected rate
+          double span_s = (0.0 < stats.span_s) ?
+                          stats.span_s :
+                          stats.expected_s;
+          double max_seconds = black_box->GetMaxSeconds();
+          if ((0.0 < span_s) && (span_s < max_seconds)) {
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f),
+                               "Holds %.1f s of the %.1f s asked for",
+                               span_s,
+                               max_seconds);
+          }
+          if ((0 != stats.dumps) || black_box->IsDumping()) {
+            ImGui::Text("%s %s: %llu profiles, %llu lost",
+                        (black_box->IsDumping()) ? "Dumping" : "Dumped",
+                        path.c_str(),
+                        (unsigned long long) stats.dumped,
+                        (unsigned long long) stats.lost);
+          }
+          if (!error.empty()) {
+            ImGui::TextUnformatted(error.c_str());
+          }
+        }
+
+        if (remote) {
+          const joescan::ProfileSubscription &subscription =
+            remote->GetSubscription();
+          ImGui::Text("Remote %s: %s, downsampling %u, X %.1f to %.1f",
+                      connect_address.c_str(),
+                      (remote->IsConnected()) ? "connected" : "disconnected",
+                      subscription.downsample_level,
+                      subscription.x_min / 1000.0,
+                      subscription.x_max / 1000.0);
+          ImGui::Text("%llu profiles received, %llu dropped, %.1f MB",
+                      (unsigned long long) remote->GetProfilesReceived(),
+                      (unsigned long long) remote->GetProfilesDropped(),
+                      remote->GetBytesReceived() / (1024.0 * 1024.0));
+        }
+
+        if (recorder) {
+          std::string error = recorder->GetError();
+          ImGui::Text("Recording %s: %llu profiles, %llu dropped, %.1f MB",
+                      recorder->GetPath().c_str(),
+                      (unsigned long long) recorder->GetProfilesWritten(),
+                      (unsigned long long) recorder->GetProfilesDropped(),
+                      recorder->GetBytesWritten() / (1024.0 * 1024.0));
+          if (!error.empty()) {
+            ImGui::TextUnformatted(error.c_str());
+          }
+        }
+
+        if (follower) {
+          ImGui::Text("Following %s: %s, at %.1f MB",
+                      follower->GetPath().c_str(),
+                      (follower->IsFollowing()) ? "following" : "stopped",
+                      follower->GetPosition() / (1024.0 * 1024.0));
+          ImGui::Text("%llu profiles read, %llu dropped",
+                      (unsigned long long) follower->GetProfilesRead(),
+                      (unsigned long long) follower->GetProfilesDropped());
+        }
+        ImGui::End();
+      }
+
+      {
+        joescan::TraceSpan span("Render");
+        ImGui::Render();
+        int display_w, display_h;
+        glfwGetFramebufferSize(window, &display_w, &display_h);
+        glViewport(0, 0, display_w, display_h);
+        glClearColor(clear_color.x * clear_color.w,
+                     clear_color.y * clear_color.w,
+                     clear_color.z * clear_color.w,
+                     clear_color.w);
+        glClear(GL_COLOR_BUFFER_BIT);
+        ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+      }
       glfwMakeContextCurrent(window);
-      glfwSwapBuffers(window);
+      {
+        joescan::TraceSpan span("Swap Buffers");
+        glfwSwapBuffers(window);
+      }
     }
 
-    app.StopScanning();
+    image_view.Stop();
+    acquisition.Stop();
+    if (is_local && !is_image_view) {
+      app.StopScanning();
+    }
+    if (is_trace) {
+      write_trace(trace_path);
+    }
 
   } catch (joescan::ApiError &e) {
     std::cout << "ERROR: " << e.what() << std::endl;
@@ -301,13 +2404,18 @@ int main(int argc, char* argv[])
       jsGetError(err, &err_str);
       std::cout << "jsError (" << err << "): " << err_str << std::endl;
     }
+  } catch (std::exception &e) {
+    std::cout << "ERROR: " << e.what() << std::endl;
+    r = 1;
   }
 
-  // Cleanup
-  ImGui_ImplOpenGL2_Shutdown();
-  ImGui_ImplGlfw_Shutdown();
-  ImPlot::DestroyContext();
-  ImGui::DestroyContext();
+  // Cleanup; setup may have failed before the UI was created
+  if (nullptr != ImGui::GetCurrentContext()) {
+    ImGui_ImplOpenGL2_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImPlot::DestroyContext();
+    ImGui::DestroyContext();
+  }
 
   glfwDestroyWindow(window);
   glfwTerminate();
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+/**
+ * @file ExamplePlugin.c
+ * @brief Example processing plugin; marks the highest point of every batch
+ * and reports a few counts.
+ *
+ * Load with `--plugin libjs-plugin-example.so`.
+ */
+
+#include "joescan_profile_plugin.h"
+#include <stdio.h>
+#include <string.h>
+
+static void AddMetric(jsPluginOutput *output, const char *name, double value)
+{
+  if (output->num_metrics < output->max_metrics) {
+    jsPluginMetric *metric = &output->metrics[output->num_metrics++];
+    snprintf(metric->name, sizeof(metric->name), "%s", name);
+    metric->value = value;
+  }
+}
+
+static void Process(void *ctx,
+                    const jsPluginBatch *batch,
+                    jsPluginOutput *output)
+{
+  uint64_t points = 0;
+  int32_t top_x = 0;
+  int32_t top_y = 0;
+  int is_top = 0;
+  uint32_t n, k;
+
+  (void) ctx;
+
+  for (n = 0; n < batch->num_profiles; n++) {
+    const jsProfile *profile = &batch->profiles[n];
+    for (k = 0; k < profile->data_len; k++) {
+      const jsProfileData *d = &profile->data[k];
+      if (JS_INVALID_XY == d->x) {
+        continue;
+      }
+
+      if (!is_top || (d->y > top_y)) {
+        top_x = d->x;
+        top_y = d->y;
+        is_top = 1;
+      }
+      points++;
+    }
+  }
+
+  AddMetric(output, "profiles", batch->num_profiles);
+  AddMetric(output, "dropped", (double) batch->dropped_profiles);
+  AddMetric(output, "points", (double) points);
+
+  if (is_top && (output->num_primitives < output->max_primitives)) {
+    jsPluginPrimitive *p = &output->primitives[output->num_primitives++];
+    p->type = JS_PLUGIN_PRIMITIVE_CIRCLE;
+    p->color = 0xFF00FFFF;
+    p->x0 = top_x / 1000.0;
+    p->y0 = top_y / 1000.0;
+    p->x1 = 0.25;
+    p->y1 = 0.0;
+    AddMetric(output, "top_y", top_y / 1000.0);
+  }
+}
+
+static const jsPluginInterface kInterface = {
+  JS_PLUGIN_API_VERSION,
+  "Example",
+  0,
+  NULL,
+  NULL,
+  Process
+};
+
+JS_PLUGIN_EXPORT const jsPluginInterface *jsPluginEntry(
+  uint32_t host_api_version)
+{
+  return (JS_PLUGIN_API_VERSION == host_api_version) ? &kInterface : NULL;
+}
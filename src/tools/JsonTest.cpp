@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+/**
+ * @file JsonTest.cpp
+ * @brief Checks that the JSON parser reads well formed documents and
+ * rejects malformed ones, truncated documents in particular.
+ *
+ * Returns non-zero if any check fails, so it can be run by CTest.
+ */
+
+#include "Json.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace joescan;
+
+static int s_failures = 0;
+
+static void ExpectValid(const std::string &text)
+{
+  try {
+    JsonValue::Parse(text);
+  } catch (const std::exception &e) {
+    std::cerr << "rejected `" << text << "`: " << e.what() << std::endl;
+    s_failures++;
+  }
+}
+
+static void ExpectInvalid(const std::string &text)
+{
+  try {
+    JsonValue::Parse(text);
+    std::cerr << "accepted `" << text << "`" << std::endl;
+    s_failures++;
+  } catch (const std::runtime_error &) {
+  }
+}
+
+int main()
+{
+  ExpectValid("{}");
+  ExpectValid("[]");
+  ExpectValid("[[1]]");
+  ExpectValid("{\"a\":{}}");
+  ExpectValid(" { \"a\" : [ 1 , 2.5 , -3e2 ] , \"b\" : { \"c\" : null } } ");
+  ExpectValid("[true, false, \"x\\\"y\"]");
+
+  // truncated documents
+  ExpectInvalid("");
+  ExpectInvalid("[");
+  ExpectInvalid("{");
+  ExpectInvalid("[1");
+  ExpectInvalid("[1,");
+  ExpectInvalid("[[1]");
+  ExpectInvalid("{\"a\":{}");
+  ExpectInvalid("{\"a\":1");
+  ExpectInvalid("{\"a\":");
+  ExpectInvalid("{\"a\"");
+  ExpectInvalid("\"abc");
+
+  // other malformed documents
+  ExpectInvalid("[1 2]");
+  ExpectInvalid("{\"a\":1 \"b\":2}");
+  ExpectInvalid("[1,]");
+  ExpectInvalid("[1}");
+  ExpectInvalid("{\"a\":1]");
+  ExpectInvalid("[1] 2");
+
+  if (0 != s_failures) {
+    std::cerr << s_failures << " checks failed" << std::endl;
+    return 1;
+  }
+
+  std::cout << "all checks passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+/**
+ * @file PointCodecBench.cpp
+ * @brief Measures the compression ratio and speed of the recording point
+ * codec on synthetic profiles.
+ *
+ * Profiles come from the synthetic source, with random noise added to X
+ * and Y so the differences between points look more like a real scan.
+ * Speeds are given in MB/s of raw points, twelve bytes each.
+ */
+
+#include "PointCodec.hpp"
+#include "SyntheticSource.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// decodes are repeated until they have taken at least this long
+static const double kMinDecodeSeconds = 0.5;
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t profile_count = 20000;
+  uint32_t chunk_profiles = 64;
+  int32_t noise_mils = 2;
+
+  for (int n = 1; n < argc; n++) {
+    std::string arg = argv[n];
+    if (("--profiles" == arg) && (n + 1 < argc)) {
+      profile_count = strtoul(argv[++n], NULL, 0);
+    } else if (("--chunk" == arg) && (n + 1 < argc)) {
+      chunk_profiles = strtoul(argv[++n], NULL, 0);
+    } else if (("--noise" == arg) && (n + 1 < argc)) {
+      noise_mils = strtol(argv[++n], NULL, 0);
+    } else {
+      std::cout << "Usage: " << argv[0]
+                << " [--profiles N] [--chunk PROFILES] [--noise MILS]"
+                << std::endl;
+      return 1;
+    }
+  }
+  if ((0 == profile_count) || (0 == chunk_profiles) || (0 > noise_mils)) {
+    std::cout << "profiles and chunk must be positive" << std::endl;
+    return 1;
+  }
+
+  // profiles are alternately from either camera of one scan head
+  joescan::SyntheticSource source(1, 1000);
+  std::unique_ptr<jsProfile> profile(new jsProfile);
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int32_t> noise(-noise_mils, noise_mils);
+  std::vector<jsProfileData> points;
+  std::vector<uint32_t> chunk_counts;
+  for (uint32_t n = 0; n < profile_count; n++) {
+    source.Generate(0, n % joescan::SyntheticSource::kElementCount,
+                    n / joescan::SyntheticSource::kElementCount,
+                    profile.get());
+    for (uint32_t i = 0; i < profile->data_len; i++) {
+      jsProfileData d = profile->data[i];
+      d.x += noise(rng);
+      d.y += noise(rng);
+      points.push_back(d);
+    }
+
+    if (0 == n % chunk_profiles) {
+      chunk_counts.push_back(0);
+    }
+    chunk_counts.back() += profile->data_len;
+  }
+
+  const double raw_mb = points.size() * sizeof(jsProfileData) / 1.0e6;
+  std::vector<uint8_t> encoded;
+  encoded.reserve(points.size() * sizeof(jsProfileData));
+  auto start = std::chrono::steady_clock::now();
+  uint32_t offset = 0;
+  for (auto count : chunk_counts) {
+    joescan::EncodePointChunk(&points[offset], count, &encoded);
+    offset += count;
+  }
+  const double encode_s = SecondsSince(start);
+
+  std::cout << points.size() << " points in " << profile_count
+            << " profiles, " << chunk_counts.size() << " chunks of "
+            << chunk_profiles << " profiles" << std::endl;
+  std::cout << "raw " << raw_mb << " MB, encoded " << encoded.size() / 1.0e6
+            << " MB, ratio " << raw_mb * 1.0e6 / encoded.size() << ":1, "
+            << 8.0 * encoded.size() / points.size() << " bits/point"
+            << std::endl;
+  std::cout << "encode " << raw_mb / encode_s << " MB/s" << std::endl;
+
+  std::vector<jsProfileData> decoded(points.size());
+  const bool kDecoders[] = { false, true };
+  for (auto is_simd : kDecoders) {
+    if (is_simd && !joescan::HasPointCodecSimd()) {
+      std::cout << "decode ssse3 not supported by this CPU" << std::endl;
+      continue;
+    }
+
+    uint32_t passes = 0;
+    start = std::chrono::steady_clock::now();
+    do {
+      size_t pos = 0;
+      offset = 0;
+      for (auto count : chunk_counts) {
+        size_t len = joescan::DecodePointChunk(&encoded[pos],
+                                               encoded.size() - pos,
+                                               &decoded[offset],
+                                               count,
+                                               is_simd);
+        if (0 == len) {
+          std::cout << "decode failed" << std::endl;
+          return 1;
+        }
+        pos += len;
+        offset += count;
+      }
+      passes++;
+    } while (kMinDecodeSeconds > SecondsSince(start));
+    const double decode_s = SecondsSince(start) / passes;
+
+    if (0 != memcmp(decoded.data(), points.data(),
+                    points.size() * sizeof(jsProfileData))) {
+      std::cout << "decoded points differ" << std::endl;
+      return 1;
+    }
+
+    std::cout << "decode " << ((is_simd) ? "ssse3 " : "scalar ")
+              << raw_mb / decode_s << " MB/s, "
+              << profile_count / decode_s / 1.0e3 << "k profiles/s"
+              << std::endl;
+  }
+
+  return 0;
+}
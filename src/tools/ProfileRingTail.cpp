@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) JoeScan Inc. All Rights Reserved.
+ *
+ * Licensed under the BSD 3 Clause License. See LICENSE.txt in the project
+ * root for license information.
+ */
+
+/**
+ * @file ProfileRingTail.cpp
+ * @brief Example consumer of the viewer's shared memory ring; reads every
+ * profile in place and prints rates once a second.
+ *
+ * Run the viewer with `--shm NAME`, then `js-profile-ring-tail NAME`.
+ */
+
+#include "SharedRing.hpp"
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+  if (2 != argc) {
+    std::cout << "Usage: " << argv[0] << " NAME" << std::endl;
+    return 1;
+  }
+
+  try {
+    joescan::SharedRingReader reader(argv[1]);
+    const uint32_t head_count = reader.GetScanHeadCount();
+    std::vector<uint64_t> profiles(head_count);
+    uint64_t points = 0;
+    uint64_t torn = 0;
+    auto last = std::chrono::steady_clock::now();
+
+    while (true) {
+      uint32_t head_index = 0;
+      const jsProfile *profile = reader.Acquire(&head_index);
+      if (nullptr == profile) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      } else {
+        // only count the profile once it's known to be intact
+        uint32_t data_len = profile->data_len;
+        if (reader.Release()) {
+          profiles[head_index]++;
+          points += data_len;
+        } else {
+          torn++;
+        }
+      }
+
+      auto now = std::chrono::steady_clock::now();
+      if (std::chrono::seconds(1) <= now - last) {
+        for (uint32_t h = 0; h < head_count; h++) {
+          std::cout << reader.GetSerialNumber(h) << ": " << profiles[h]
+                    << " profiles/s  ";
+          profiles[h] = 0;
+        }
+        std::cout << points << " points/s  " << reader.GetLapped()
+                  << " lapped  " << torn << " torn" << std::endl;
+        points = 0;
+        last = now;
+      }
+    }
+  } catch (std::exception &e) {
+    std::cout << "ERROR: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}